@@ -0,0 +1,1028 @@
+#include <glob.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "browser.h"
+#include "diskcache.h"
+#include "fakenet.h"
+#include "feeds.h"
+#include "gemtext.h"
+#include "history.h"
+#include "knownhosts.h"
+#include "layout.h"
+#include "linktable.h"
+#include "lz.h"
+#include "memstats.h"
+#include "pagecache.h"
+#include "pages.h"
+#include "platform.h"
+#include "render_soft.h"
+#include "response.h"
+#include "trace.h"
+#include "url.h"
+#ifdef HOST_MBEDTLS
+#include "capsule.h"
+#include "network_tls.h"
+#endif
+
+//Times the hot paths of loading a page on the host, a run at a time:
+//    build-host/bench/run               every benchmark
+//    build-host/bench/run parse 500     one of them, 500 runs
+//Each run is timed on its own for the percentiles, throughput is the bytes
+//handled over all runs and allocs/op counts every memCharge, buffer growth
+//included, summed over the accounts. Peak is the most any account held
+//during the runs, added up, download prints the process's max resident set
+//next to it. The lz- ones print how small the corpus packs first, text-cache
+//its hit rate and the text buffers allocated per frame.
+//The navigate and lz- ones go through the capsule pages in bench/corpus, so run
+//it from the top of the tree the way make host-bench does. The scroll- and
+//inval- ones draw the browser's frames with the page in tiles and without.
+//The feeds- ones refresh the same gemlogs with 1, 2 and 4 workers.
+//The tls- ones are only built with HOST_MBEDTLS=1.
+
+#define DEFAULT_RUNS 200
+#define PAGE_SIZE (64 * 1024)
+#define BODY_SIZE (1024 * 1024)
+#define LINKS 1000
+#define BASE "gemini://example.org/dir/index.gmi"
+//Pages visited per navigation run and how much of them the page cache keeps
+#define VISITS 40
+#define BACK_STEPS 20
+#define NAVIGATE_CACHE_BUDGET (1024 * 1024)
+#define DISK_ENTRIES 10000
+#define KNOWN_HOSTS 5000
+//Page lengths the frame benchmarks sweep, a frame should cost the same on all of them
+#define FRAME_SMALL (16 * 1024)
+#define FRAME_MEDIUM (512 * 1024)
+#define FRAME_LARGE (8 * 1024 * 1024)
+#define FRAME_STEP 97
+//Touches tested against a long link list per run
+#define LINK_HITS 1000
+#define LINK_ROW 20
+//Spans timed per trace run, so p50 in us reads as ns per span
+#define TRACE_SPANS 1000
+//Page the browser frame benchmarks scroll through, three pixels a frame like D-pad down
+#define SCREEN_PAGE_SIZE (256 * 1024)
+#define SCREEN_STEP 3
+//A binary body fetched to a file per download run
+#define DOWNLOAD_SIZE (8 * 1024 * 1024)
+#define DOWNLOAD_URL "gemini://example.org/files/blob.bin"
+//Gemlogs refreshed per feeds run, each on a host of its own that takes this
+//long before every read
+#define FEED_HOSTS 8
+#define FEED_DELAY_MS 10
+#ifndef CORPUS_DIR
+#define CORPUS_DIR "bench/corpus"
+#endif
+#define CORPUS_PAGES_MAX 64
+
+typedef struct {
+    const char* name;
+    void (*setup)(void);
+    size_t (*run)(void);     //One op, returns the bytes it went through
+    void (*teardown)(void);
+} Bench;
+
+static Buffer page;
+static Document doc;
+static char* body;
+static size_t bodyLength;
+static FakeNetwork net;
+static FetchNetwork network;
+static Buffer corpus[CORPUS_PAGES_MAX];
+static int corpusCount;
+static size_t corpusBytes;
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static size_t peaks(void) {
+    size_t total = 0;
+    for (int i = 0; i < MEM_ACCOUNTS; i++) {
+        MemStats stats;
+        memStats(i, &stats);
+        total += stats.peak;
+    }
+    return total;
+}
+
+static unsigned long allocations(void) {
+    unsigned long total = 0;
+    for (int i = 0; i < MEM_ACCOUNTS; i++) {
+        MemStats stats;
+        memStats(i, &stats);
+        total += stats.allocations;
+    }
+    return total;
+}
+
+static void setupPage(void) {
+    bufferInit(&page, MEM_OTHER);
+    pageMake(&page, PAGE_SIZE, 1);
+}
+
+static void teardownPage(void) {
+    bufferFree(&page);
+}
+
+//Real pages read the way they come off the wire, links, preformatted blocks
+//and all, since the generated ones pack better than anything people write
+static void loadCorpus(void) {
+    glob_t found;
+    if (glob(CORPUS_DIR "/*.gmi", 0, NULL, &found) != 0) {
+        fprintf(stderr, "no pages in %s\n", CORPUS_DIR);
+        exit(1);
+    }
+    corpusCount = 0;
+    corpusBytes = 0;
+    for (size_t i = 0; i < found.gl_pathc && corpusCount < CORPUS_PAGES_MAX; i++) {
+        FILE* file = fopen(found.gl_pathv[i], "rb");
+        if (file == NULL) {
+            perror(found.gl_pathv[i]);
+            exit(1);
+        }
+        Buffer* text = &corpus[corpusCount++];
+        bufferInit(text, MEM_OTHER);
+        char chunk[4096];
+        size_t got;
+        while ((got = fread(chunk, 1, sizeof chunk, file)) > 0) {
+            bufferAppend(text, chunk, got);
+        }
+        fclose(file);
+        corpusBytes += text->length;
+    }
+    globfree(&found);
+}
+
+static void freeCorpus(void) {
+    for (int i = 0; i < corpusCount; i++) {
+        bufferFree(&corpus[i]);
+    }
+    corpusCount = 0;
+}
+
+static size_t runParse(void) {
+    Document parsed;
+    parseGemtext(page.data, &parsed);
+    freeDocument(&parsed);
+    return page.length;
+}
+
+//Every link on a long directory page, resolved the way the link table does it
+static void setupLinks(void) {
+    bufferInit(&page, MEM_OTHER);
+    pageMakeLinks(&page, LINKS, 2);
+    parseGemtext(page.data, &doc);
+}
+
+static void teardownLinks(void) {
+    freeDocument(&doc);
+    bufferFree(&page);
+}
+
+static size_t runResolve(void) {
+    Url base;
+    urlParse(BASE, strlen(BASE), &base);
+    char out[URL_MAX];
+    size_t bytes = 0;
+    for (int i = 0; i < doc.linkCount; i++) {
+        Url ref;
+        if (urlParse(doc.links[i].path, doc.links[i].pathLength, &ref) == 0 && urlResolve(&base, &ref, out, sizeof out) >= 0) {
+            bytes += doc.links[i].pathLength;
+        }
+    }
+    return bytes;
+}
+
+//Finding the link under a touch on a long directory page, at touches spread
+//over the whole list
+static LinkTable linkTable;
+
+static void setupLinkTable(void) {
+    setupLinks();
+    linkTableInit(&linkTable);
+    linkTableBuild(&linkTable, &doc, LINK_ROW);
+}
+
+static void teardownLinkTable(void) {
+    linkTableFree(&linkTable);
+    teardownLinks();
+}
+
+static size_t runLinkHit(void) {
+    size_t hits = 0;
+    for (int i = 0; i < LINK_HITS; i++) {
+        int y = (int)(((long)i * 7919) % linkTable.height);
+        hits += linkTableHit(&linkTable, y) >= 0;
+    }
+    //The slots found, there is no text to count
+    return hits * sizeof(LinkSlot);
+}
+
+//What a traceStart/traceEnd pair costs with tracing off, and on
+static void setupTraceOff(void) {
+    traceSetEnabled(0);
+}
+
+static void setupTraceOn(void) {
+    traceSetEnabled(1);
+}
+
+static void teardownTrace(void) {
+    traceSetEnabled(0);
+}
+
+static size_t runTrace(void) {
+    for (int i = 0; i < TRACE_SPANS; i++) {
+        traceEnd(TRACE_PARSE, traceStart());
+    }
+    return 0;
+}
+
+static void setupLayout(void) {
+    setupPage();
+    parseGemtext(page.data, &doc);
+    layoutSetFont(NULL, 388);
+}
+
+static size_t runLayout(void) {
+    //The layout arena only ever grows, start it again so every run does the whole page
+    arenaFree(&doc.layoutArena);
+    arenaInit(&doc.layoutArena, page.length / 4 + 1024, MEM_LAYOUT);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    return page.length;
+}
+
+static void teardownLayout(void) {
+    freeDocument(&doc);
+    teardownPage();
+}
+
+//One frame's worth of finding what is on screen and walking its rows, at a
+//new scroll position every run
+static PageLayout frameLayout;
+static int frameScroll;
+
+static void setupFrame(size_t size) {
+    bufferInit(&page, MEM_OTHER);
+    pageMake(&page, size, 1);
+    parseGemtext(page.data, &doc);
+    layoutSetFont(NULL, 388);
+    resetLayout(&frameLayout);
+    layoutDocument(&doc, &frameLayout);
+    frameScroll = 0;
+}
+
+static void setupFrameSmall(void) {
+    setupFrame(FRAME_SMALL);
+}
+
+static void setupFrameMedium(void) {
+    setupFrame(FRAME_MEDIUM);
+}
+
+static void setupFrameLarge(void) {
+    setupFrame(FRAME_LARGE);
+}
+
+//Text of the rows on a screen from top down
+static size_t bytesInView(const PageLayout* layout, int top) {
+    int end;
+    int first = layoutVisibleLines(layout, top, top + 240, &end);
+    size_t bytes = 0;
+    for (int i = first; i < end; i++) {
+        for (int row = layout->firstRows[i]; row < layout->firstRows[i + 1]; row++) {
+            bytes += layout->rows[row].length;
+        }
+    }
+    return bytes;
+}
+
+static size_t runFrame(void) {
+    size_t bytes = bytesInView(&frameLayout, frameScroll);
+    frameScroll = (frameScroll + FRAME_STEP) % layoutHeight(&frameLayout);
+    return bytes;
+}
+
+//The browser drawing a long page on the software renderer, a frame per run.
+//The flat ones get a renderer without surfaces, so the tile cache gives up
+//and every frame draws the page's text, the way it was before the tiles.
+static Fetcher screenFetcher;
+static Renderer screenRenderer;
+static Renderer statusRenderer;
+static SoftRenderer screenSoft;
+static SoftRenderer statusSoft;
+static StubRenderer screenStub;
+static StubRenderer statusStub;
+static Browser browser;
+static int screenFrames;
+static int screenInvalidate;
+
+static int noSurface(void* ctx, int width, int height) {
+    (void)ctx;
+    (void)width;
+    (void)height;
+    return -1;
+}
+
+//Once the renderers are set up
+static void startBrowser(void) {
+    layoutSetFont(NULL, TOP_SCREEN_WIDTH - 12);
+    fakeNetworkInit(&net);
+    networkInitFake(&network, &net);
+    if (fetcherStart(&screenFetcher, &network, NULL, NULL) != 0) {
+        exit(1);
+    }
+    BrowserHooks hooks = { NULL, NULL, NULL };
+    browserInit(&browser, &screenRenderer, &statusRenderer, &screenFetcher, &hooks);
+    bufferInit(&page, MEM_OTHER);
+    pageMake(&page, SCREEN_PAGE_SIZE, 5);
+    browserShowText(&browser, "gemini://capsule.example/", page.data, 0, 0);
+    screenFrames = 0;
+}
+
+static void stopBrowser(void) {
+    browserStop(&browser);
+    fetcherStop(&screenFetcher);
+    browserFree(&browser);
+    bufferFree(&page);
+}
+
+static void startSoft(int tiled, int invalidate) {
+    if (rendererInitSoft(&screenRenderer, &screenSoft, TOP_SCREEN_WIDTH, TOP_SCREEN_HEIGHT, NULL) != 0 ||
+        rendererInitSoft(&statusRenderer, &statusSoft, BOTTOM_SCREEN_WIDTH, BOTTOM_SCREEN_HEIGHT, NULL) != 0) {
+        exit(1);
+    }
+    if (!tiled) {
+        screenRenderer.surfaceNew = noSurface;
+    }
+    screenInvalidate = invalidate;
+    startBrowser();
+}
+
+static void setupScrollTiled(void) {
+    startSoft(1, 0);
+}
+
+static void setupScrollFlat(void) {
+    startSoft(0, 0);
+}
+
+//Every frame something changes the look of the page, like sideways
+//scrolling of preformatted text, so every tile in view is painted again
+static void setupInvalidateTiled(void) {
+    startSoft(1, 1);
+}
+
+static void setupInvalidateFlat(void) {
+    startSoft(0, 1);
+}
+
+static void teardownSoft(void) {
+    stopBrowser();
+    rendererFreeSoft(&statusSoft);
+    rendererFreeSoft(&screenSoft);
+}
+
+//One frame further down the page, back to the top at the end
+static void scrollFrame(void) {
+    int range = layoutHeight(&browser.layout) - TOP_SCREEN_HEIGHT;
+    browser.scroll = -(screenFrames++ * SCREEN_STEP % range);
+    if (screenInvalidate) {
+        tileCacheInvalidate(&browser.tiles);
+    }
+    browserDrawPage(&browser);
+}
+
+//Bytes are the pixels of the top screen, so MB/s is the fill rate
+static size_t runScreenFrame(void) {
+    softClear(&screenSoft, 0);
+    scrollFrame();
+    return (size_t)TOP_SCREEN_WIDTH * TOP_SCREEN_HEIGHT * sizeof(uint32_t);
+}
+
+//The text cache on its own: no tiles, so every row in view comes out of it
+//every frame. The stub counts the text buffers the renderer would allocate.
+static void setupTextCache(void) {
+    rendererInitStub(&screenRenderer, &screenStub);
+    rendererInitStub(&statusRenderer, &statusStub);
+    screenRenderer.surfaceNew = noSurface;
+    screenInvalidate = 0;
+    startBrowser();
+}
+
+static void teardownTextCache(void) {
+    const TextCache* text = &browser.text;
+    unsigned long draws = text->hits + text->misses;
+    printf("%-10s %8.1f %% hits  %6.2f text allocs/frame  %lu builds over %d frames\n", "text",
+        draws > 0 ? text->hits * 100.0 / draws : 0, (double)screenStub.allocations / screenFrames,
+        text->builds, screenFrames);
+    stopBrowser();
+}
+
+static size_t runTextCache(void) {
+    scrollFrame();
+    return bytesInView(&browser.layout, -browser.scroll);
+}
+
+static void setupResponse(void) {
+    bodyLength = BODY_SIZE;
+    body = malloc(bodyLength);
+    int headerLength = sprintf(body, "20 text/gemini\r\n");
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, bodyLength, 3);
+    memcpy(body + headerLength, text.data, bodyLength - headerLength);
+    bufferFree(&text);
+    fakeNetworkInit(&net);
+    fakeNetworkAdd(&net, BASE, body, bodyLength);
+    networkInitFake(&network, &net);
+}
+
+static void teardownResponse(void) {
+    free(body);
+}
+
+static void feedBody(void* user, const char* data, size_t len) {
+    feedGemtext(user, data, len);
+}
+
+//Header, records and parsing the body as it arrives, what the fetch worker does per page
+static size_t runResponse(void) {
+    FetchJob* job = fetchJobNew(BASE);
+    Transport transport;
+    void* conn;
+    if (job == NULL || network.open(network.ctx, job, BASE "\r\n", &transport, &conn) != FETCH_OK) {
+        fetchJobFree(job);
+        return 0;
+    }
+    GeminiHeader header;
+    Document received;
+    beginDocument(&received, bodyLength);
+    readGeminiResponse(&transport, &header, feedBody, &received);
+    endDocument(&received);
+    network.close(network.ctx, conn);
+    fetchJobFree(job);
+    freeDocument(&received);
+    return bodyLength;
+}
+
+//Header, the first record and laying it out, how long a 1 MB page takes to
+//get a line on screen. The job is cancelled then, which ends the read.
+typedef struct {
+    FetchJob* job;
+    Document doc;
+    PageLayout layout;
+    size_t bytes;
+} FirstLine;
+
+static void firstLineBody(void* user, const char* data, size_t len) {
+    FirstLine* first = user;
+    first->bytes += len;
+    feedGemtext(&first->doc, data, len);
+    layoutDocument(&first->doc, &first->layout);
+    if (first->layout.lineCount > 0) {
+        first->job->cancelled = 1;
+    }
+}
+
+static size_t runFirstLine(void) {
+    FirstLine first;
+    first.job = fetchJobNew(BASE);
+    first.bytes = 0;
+    Transport transport;
+    void* conn;
+    if (first.job == NULL || network.open(network.ctx, first.job, BASE "\r\n", &transport, &conn) != FETCH_OK) {
+        fetchJobFree(first.job);
+        return 0;
+    }
+    GeminiHeader header;
+    beginDocument(&first.doc, 0);
+    resetLayout(&first.layout);
+    readGeminiResponse(&transport, &header, firstLineBody, &first);
+    network.close(network.ctx, conn);
+    fetchJobFree(first.job);
+    freeDocument(&first.doc);
+    return first.bytes;
+}
+
+static void setupFirstLine(void) {
+    setupResponse();
+    layoutSetFont(NULL, 388);
+}
+
+static void setupNavigate(void) {
+    layoutSetFont(NULL, 388);
+    loadCorpus();
+}
+
+//The corpus page a visit lands on, so every visit isn't the same page
+static const Buffer* visitPage(int visit) {
+    return &corpus[visit % corpusCount];
+}
+
+//Visits pages, each one pushing the last into the page cache, then goes back
+//through half of them. What the cache holds is most of the peak.
+static size_t navigate(int compress) {
+    PageCache cache;
+    History history;
+    pageCacheInit(&cache, NAVIGATE_CACHE_BUDGET, compress);
+    historyInit(&history);
+    Document current;
+    PageLayout layout;
+    char url[64];
+    size_t bytes = 0;
+    for (int i = 0; i < VISITS; i++) {
+        if (i > 0) {
+            pageCachePut(&cache, historyCurrent(&history), &current, &layout, 0, 0);
+        }
+        snprintf(url, sizeof url, "gemini://example.org/%d", i);
+        parseGemtext(visitPage(i)->data, &current);
+        resetLayout(&layout);
+        layoutDocument(&current, &layout);
+        historyVisit(&history, url);
+        bytes += visitPage(i)->length;
+    }
+    for (int i = 0; i < BACK_STEPS; i++) {
+        pageCachePut(&cache, historyCurrent(&history), &current, &layout, 0, 0);
+        const char* back = historyBack(&history);
+        int scroll;
+        if (pageCacheTake(&cache, back, &current, &layout, &scroll) != 0) {
+            const Buffer* text = visitPage(VISITS - 2 - i);
+            parseGemtext(text->data, &current);
+            resetLayout(&layout);
+            layoutDocument(&current, &layout);
+            bytes += text->length;
+        }
+    }
+    freeDocument(&current);
+    pageCacheFree(&cache);
+    return bytes;
+}
+
+static Fetcher downloadFetcher;
+static char downloadDir[64];
+static long downloadRss;
+
+//The most the process has had resident, in KB on Linux. It only ever goes up,
+//so what matters is how far it moved during the runs.
+static long maxRss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void setupDownload(void) {
+    const char* header = "20 application/octet-stream\r\n";
+    size_t headerLength = strlen(header);
+    bodyLength = headerLength + DOWNLOAD_SIZE;
+    body = malloc(bodyLength);
+    snprintf(downloadDir, sizeof downloadDir, "/tmp/gemini-bench-XXXXXX");
+    if (body == NULL || mkdtemp(downloadDir) == NULL) {
+        perror(downloadDir);
+        exit(1);
+    }
+    memcpy(body, header, headerLength);
+    uint32_t state = 1;
+    for (size_t i = headerLength; i < bodyLength; i++) {
+        state = state * 1664525u + 1013904223u;
+        body[i] = state >> 24;
+    }
+    fakeNetworkInit(&net);
+    fakeNetworkAdd(&net, DOWNLOAD_URL, body, bodyLength);
+    networkInitFake(&network, &net);
+    if (fetcherStart(&downloadFetcher, &network, NULL, NULL) != 0) {
+        exit(1);
+    }
+    downloadRss = maxRss();
+}
+
+//Peak only sees what is charged to an account, the resident set also has the
+//thread stacks and anything allocated outside the accounts
+static void teardownDownload(void) {
+    long rss = maxRss();
+    printf("%-10s %8ld KB max resident, grew %ld KB over the runs\n", "rss", rss, rss - downloadRss);
+    fetcherStop(&downloadFetcher);
+    rmdir(downloadDir);
+    free(body);
+}
+
+//The whole body through the fetch worker and the writer thread to a file,
+//which is removed again so every run saves under the same name
+static size_t runDownload(void) {
+    FetchJob* job = fetchJobNew(DOWNLOAD_URL);
+    if (job == NULL) {
+        return 0;
+    }
+    job->downloadDir = downloadDir;
+    if (fetcherSubmit(&downloadFetcher, job) != 0) {
+        fetchJobFree(job);
+        return 0;
+    }
+    job = fakeWait(&downloadFetcher);
+    if (job == NULL) {
+        return 0;
+    }
+    size_t bytes = 0;
+    if (job->error == FETCH_OK) {
+        bytes = fetchJobBytes(job);
+        remove(job->savedAs);
+    }
+    fetchJobFree(job);
+    return bytes;
+}
+
+static size_t runNavigate(void) {
+    return navigate(0);
+}
+
+//The same with the cache holding most pages packed, so going back unpacks
+//and parses them again
+static size_t runNavigatePacked(void) {
+    return navigate(1);
+}
+
+static Buffer packed[CORPUS_PAGES_MAX];
+
+static void setupPacked(void) {
+    loadCorpus();
+    size_t packedBytes = 0;
+    for (int i = 0; i < corpusCount; i++) {
+        bufferInit(&packed[i], MEM_OTHER);
+        if (lzCompress(corpus[i].data, corpus[i].length, &packed[i]) != 0) {
+            exit(1);
+        }
+        packedBytes += packed[i].length;
+    }
+    printf("%-10s %8.1f %% of %zu KB packed over %d pages\n", "lz",
+        packedBytes * 100.0 / corpusBytes, corpusBytes / 1024, corpusCount);
+}
+
+static void teardownPacked(void) {
+    for (int i = 0; i < corpusCount; i++) {
+        bufferFree(&packed[i]);
+    }
+    freeCorpus();
+}
+
+static size_t runPack(void) {
+    for (int i = 0; i < corpusCount; i++) {
+        bufferClear(&packed[i]);
+        lzCompress(corpus[i].data, corpus[i].length, &packed[i]);
+    }
+    return corpusBytes;
+}
+
+static void countUnpacked(void* user, const char* data, size_t len) {
+    *(size_t*)user += len;
+    (void)data;
+}
+
+static size_t runUnpack(void) {
+    size_t bytes = 0;
+    for (int i = 0; i < corpusCount; i++) {
+        lzDecode(packed[i].data, packed[i].length, countUnpacked, &bytes);
+    }
+    return bytes;
+}
+
+//Unpacked straight into the parser, what taking a packed page costs
+static size_t runUnpackParse(void) {
+    for (int i = 0; i < corpusCount; i++) {
+        Document parsed;
+        beginDocument(&parsed, corpus[i].length);
+        lzDecode(packed[i].data, packed[i].length, feedBody, &parsed);
+        endDocument(&parsed);
+        freeDocument(&parsed);
+    }
+    return corpusBytes;
+}
+
+static FeedReader feeds;
+static char feedUrls[FEED_HOSTS][64];
+
+static void setupFeeds(int workers) {
+    bodyLength = 0;
+    fakeNetworkInit(&net);
+    feedsInit(&feeds);
+    for (int i = 0; i < FEED_HOSTS; i++) {
+        snprintf(feedUrls[i], sizeof feedUrls[i], "gemini://host%d.example/gemlog/", i);
+        fakeNetworkAddText(&net, feedUrls[i],
+            "20 text/gemini\r\n"
+            "# A gemlog\n"
+            "=> 2024-03-02-rabbits.gmi 2024-03-02 - On rabbits\n"
+            "=> 2024-02-24-ringbuf.gmi 2024-02-24 - What I got wrong about memory ordering\n"
+            "=> 2024-02-18-bike-hubs.gmi 2024-02-18 - Repacking the hubs on the old tourer\n");
+        bodyLength += net.responses[i].length;
+        feedsAdd(&feeds, feedUrls[i]);
+    }
+    net.delayMs = FEED_DELAY_MS;
+    NetworkFactory networks;
+    networkFactoryInitFake(&networks, &net);
+    if (feedsStart(&feeds, workers, &networks, NULL) != 0) {
+        exit(1);
+    }
+}
+
+static void setupFeeds1(void) {
+    setupFeeds(1);
+}
+
+static void setupFeeds2(void) {
+    setupFeeds(2);
+}
+
+static void setupFeeds4(void) {
+    setupFeeds(4);
+}
+
+static void teardownFeeds(void) {
+    feedsFree(&feeds);
+}
+
+//A forced refresh of every feed, stepped every millisecond, as if the last
+//one was long enough ago that no host is still owed a pause. p50 is the wall
+//time a refresh takes with that many workers.
+static size_t runFeeds(void) {
+    for (int i = 0; i < feeds.count; i++) {
+        feeds.subs[i].finishedUs = 0;
+    }
+    feedsRefresh(&feeds, 1);
+    while (feeds.pending > 0) {
+        feedsStep(&feeds);
+        platformSleepMs(1);
+    }
+    return bodyLength;
+}
+
+static DiskCache disk;
+static char diskDir[64];
+
+static void setupDisk(void) {
+    snprintf(diskDir, sizeof diskDir, "/tmp/gemini-bench-XXXXXX");
+    if (mkdtemp(diskDir) == NULL || diskCacheOpen(&disk, diskDir, 64 * 1024 * 1024, 24 * 3600, 0) != 0) {
+        perror(diskDir);
+        exit(1);
+    }
+    char url[64];
+    char text[64];
+    for (int i = 0; i < DISK_ENTRIES; i++) {
+        snprintf(url, sizeof url, "gemini://host%d.example/page", i);
+        int length = snprintf(text, sizeof text, "# Page %d\n", i);
+        diskCachePut(&disk, url, 20, "text/gemini", text, length);
+    }
+}
+
+static void teardownDisk(void) {
+    char path[128];
+    diskCacheClose(&disk);
+    snprintf(path, sizeof path, "%s/data.bin", diskDir);
+    remove(path);
+    snprintf(path, sizeof path, "%s/index.bin", diskDir);
+    remove(path);
+    rmdir(diskDir);
+}
+
+//Every one of the 10k pages looked up and read back once
+static size_t runDisk(void) {
+    char url[64];
+    size_t bytes = 0;
+    for (int i = 0; i < DISK_ENTRIES; i++) {
+        snprintf(url, sizeof url, "gemini://host%d.example/page", i);
+        DiskCacheEntry entry;
+        if (diskCacheGet(&disk, url, &entry) == 0) {
+            bytes += entry.bodyLength;
+            diskCacheEntryFree(&entry);
+        }
+    }
+    return bytes;
+}
+
+static KnownHosts knownHosts;
+static char knownHostsPath[128];
+
+static void knownHostName(char* out, size_t size, int i, uint8_t* fingerprint) {
+    snprintf(out, size, "capsule%d.example", i);
+    memset(fingerprint, i, KNOWN_HOST_FINGERPRINT_SIZE);
+}
+
+static void setupKnownHosts(void) {
+    snprintf(diskDir, sizeof diskDir, "/tmp/gemini-bench-XXXXXX");
+    if (mkdtemp(diskDir) == NULL) {
+        perror(diskDir);
+        exit(1);
+    }
+    snprintf(knownHostsPath, sizeof knownHostsPath, "%s/known_hosts.bin", diskDir);
+    knownHostsOpen(&knownHosts, knownHostsPath);
+    char host[64];
+    uint8_t fingerprint[KNOWN_HOST_FINGERPRINT_SIZE];
+    for (int i = 0; i < KNOWN_HOSTS; i++) {
+        knownHostName(host, sizeof host, i, fingerprint);
+        knownHostsCheck(&knownHosts, host, "1965", fingerprint, 0);
+    }
+}
+
+static void teardownKnownHosts(void) {
+    knownHostsClose(&knownHosts);
+    remove(knownHostsPath);
+    rmdir(diskDir);
+}
+
+//Every host checked once, as the handshake of each would
+static size_t runKnownHosts(void) {
+    char host[64];
+    uint8_t fingerprint[KNOWN_HOST_FINGERPRINT_SIZE];
+    size_t bytes = 0;
+    for (int i = 0; i < KNOWN_HOSTS; i++) {
+        knownHostName(host, sizeof host, i, fingerprint);
+        if (knownHostsCheck(&knownHosts, host, "1965", fingerprint, 0) == KNOWN_HOST_MATCH) {
+            bytes += sizeof(KnownHostSlot);
+        }
+    }
+    return bytes;
+}
+
+#ifdef HOST_MBEDTLS
+//A navigation over TLS to a capsule on this machine: connect, handshake, the
+//request and the whole response. tls-cold sets the TLS client up again for
+//every navigation, seeding the DRBG and all, which is what every fetch used
+//to do. tls-warm shares one client between them but the capsule won't resume
+//sessions, tls-resumed is the same against one that does.
+static LocalCapsule capsule;
+static TlsClient tlsClient;
+static TlsNetwork tlsNetwork;
+static char capsuleUrl[64];
+
+static void startCapsule(int resume) {
+    if (capsuleStart(&capsule, "20 text/gemini\r\n# Capsule\n=> /next Next\n", resume) != 0) {
+        fprintf(stderr, "Couldn't start the local capsule\n");
+        exit(1);
+    }
+    snprintf(capsuleUrl, sizeof capsuleUrl, "gemini://127.0.0.1:%s/", capsule.port);
+}
+
+static void setupTls(void) {
+    startCapsule(0);
+}
+
+static void teardownTls(void) {
+    capsuleStop(&capsule);
+}
+
+static void setupTlsWarm(void) {
+    setupTls();
+    tlsClientInit(&tlsClient, NULL);
+    networkInitTls(&network, &tlsNetwork, &tlsClient);
+}
+
+static void teardownTlsWarm(void) {
+    tlsClientFree(&tlsClient);
+    teardownTls();
+}
+
+static void setupTlsResumed(void) {
+    startCapsule(1);
+    tlsClientInit(&tlsClient, NULL);
+    networkInitTls(&network, &tlsNetwork, &tlsClient);
+}
+
+//Every navigation but the first should have resumed the session of the one before
+static void teardownTlsResumed(void) {
+    if (tlsClient.sessionMisses > 1) {
+        fprintf(stderr, "tls-resumed: %lu of %lu handshakes resumed a session\n",
+            tlsClient.sessionHits, tlsClient.sessionHits + tlsClient.sessionMisses);
+    }
+    teardownTlsWarm();
+}
+
+static void countBody(void* user, const char* data, size_t len) {
+    *(size_t*)user += len;
+}
+
+static size_t navigateTls(void) {
+    FetchJob* job = fetchJobNew(capsuleUrl);
+    if (job == NULL) {
+        return 0;
+    }
+    char request[URL_MAX + 2];
+    snprintf(request, sizeof request, "%s\r\n", capsuleUrl);
+    Transport transport;
+    void* conn = NULL;
+    size_t bytes = 0;
+    if (network.open(network.ctx, job, request, &transport, &conn) == FETCH_OK) {
+        GeminiHeader header;
+        readGeminiResponse(&transport, &header, countBody, &bytes);
+    }
+    if (conn != NULL) {
+        network.close(network.ctx, conn);
+    }
+    fetchJobFree(job);
+    return bytes;
+}
+
+static size_t runTlsCold(void) {
+    tlsClientInit(&tlsClient, NULL);
+    networkInitTls(&network, &tlsNetwork, &tlsClient);
+    size_t bytes = navigateTls();
+    tlsClientFree(&tlsClient);
+    return bytes;
+}
+#endif
+
+static const Bench benches[] = {
+    { "parse", setupPage, runParse, teardownPage },
+    { "resolve", setupLinks, runResolve, teardownLinks },
+    { "link-hit", setupLinkTable, runLinkHit, teardownLinkTable },
+    { "layout", setupLayout, runLayout, teardownLayout },
+    { "frame-16k", setupFrameSmall, runFrame, teardownLayout },
+    { "frame-512k", setupFrameMedium, runFrame, teardownLayout },
+    { "frame-8m", setupFrameLarge, runFrame, teardownLayout },
+    { "scroll-tiled", setupScrollTiled, runScreenFrame, teardownSoft },
+    { "scroll-flat", setupScrollFlat, runScreenFrame, teardownSoft },
+    { "inval-tiled", setupInvalidateTiled, runScreenFrame, teardownSoft },
+    { "inval-flat", setupInvalidateFlat, runScreenFrame, teardownSoft },
+    { "text-cache", setupTextCache, runTextCache, teardownTextCache },
+    { "response", setupResponse, runResponse, teardownResponse },
+    { "first-line", setupFirstLine, runFirstLine, teardownResponse },
+    { "navigate", setupNavigate, runNavigate, freeCorpus },
+    { "navigate-lz", setupNavigate, runNavigatePacked, freeCorpus },
+    { "lz-pack", setupPacked, runPack, teardownPacked },
+    { "lz-unpack", setupPacked, runUnpack, teardownPacked },
+    { "lz-parse", setupPacked, runUnpackParse, teardownPacked },
+    { "download", setupDownload, runDownload, teardownDownload },
+    { "disk", setupDisk, runDisk, teardownDisk },
+    { "feeds-1", setupFeeds1, runFeeds, teardownFeeds },
+    { "feeds-2", setupFeeds2, runFeeds, teardownFeeds },
+    { "feeds-4", setupFeeds4, runFeeds, teardownFeeds },
+    { "knownhosts", setupKnownHosts, runKnownHosts, teardownKnownHosts },
+    { "trace-off", setupTraceOff, runTrace, teardownTrace },
+    { "trace-on", setupTraceOn, runTrace, teardownTrace },
+#ifdef HOST_MBEDTLS
+    { "tls-cold", setupTls, runTlsCold, teardownTls },
+    { "tls-warm", setupTlsWarm, navigateTls, teardownTlsWarm },
+    { "tls-resumed", setupTlsResumed, navigateTls, teardownTlsResumed },
+#endif
+};
+
+static int compareTimes(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void runBench(const Bench* bench, int runs, uint64_t* times) {
+    bench->setup();
+    //One run first so the caches and the allocator are warm
+    bench->run();
+    memResetPeaks();
+    unsigned long allocated = allocations();
+    size_t bytes = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < runs; i++) {
+        uint64_t started = nowNs();
+        bytes += bench->run();
+        times[i] = nowNs() - started;
+        total += times[i];
+    }
+    allocated = allocations() - allocated;
+    size_t peak = peaks();
+    bench->teardown();
+
+    qsort(times, runs, sizeof *times, compareTimes);
+    printf("%-10s %8.1f MB/s  p50 %9.1f us  p95 %9.1f us  p99 %9.1f us  %8.1f allocs/op  peak %6zu KB\n",
+        bench->name, total > 0 ? bytes * 1e3 / total : 0,
+        times[runs / 2] / 1e3, times[runs * 95 / 100] / 1e3, times[runs * 99 / 100] / 1e3,
+        (double)allocated / runs, peak / 1024);
+}
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    int runs = argc > 2 ? atoi(argv[2]) : DEFAULT_RUNS;
+    if (runs <= 0) {
+        fprintf(stderr, "usage: %s [name] [runs]\n", argv[0]);
+        return 2;
+    }
+    uint64_t* times = malloc(runs * sizeof *times);
+    if (times == NULL) {
+        return 1;
+    }
+    int ran = 0;
+    for (size_t i = 0; i < sizeof benches / sizeof benches[0]; i++) {
+        if (filter == NULL || strcmp(filter, benches[i].name) == 0) {
+            runBench(&benches[i], runs, times);
+            ran++;
+        }
+    }
+    free(times);
+    return ran == 0;
+}
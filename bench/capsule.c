@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <mbedtls/certs.h>
+
+#include "capsule.h"
+
+//One request, answered and closed
+static void serve(LocalCapsule* capsule, mbedtls_net_context* client) {
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_init( &ssl );
+    if( mbedtls_ssl_setup( &ssl, &capsule->conf ) != 0 ) {
+        mbedtls_ssl_free( &ssl );
+        return;
+    }
+    mbedtls_ssl_set_bio( &ssl, client, mbedtls_net_send, mbedtls_net_recv, NULL );
+
+    int ret;
+    while( ( ret = mbedtls_ssl_handshake( &ssl ) ) != 0 ) {
+        if( ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE ) {
+            mbedtls_ssl_free( &ssl );
+            return;
+        }
+    }
+
+    //The request is a single line, the response doesn't depend on it
+    unsigned char request[1026];
+    size_t length = 0;
+    while (length < sizeof request && (length < 2 || memcmp(request + length - 2, "\r\n", 2) != 0)) {
+        ret = mbedtls_ssl_read( &ssl, request + length, sizeof request - length );
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        length += ret;
+    }
+
+    const unsigned char* data = (const unsigned char*)capsule->response;
+    size_t left = strlen(capsule->response);
+    while (left > 0) {
+        ret = mbedtls_ssl_write( &ssl, data, left );
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        data += ret;
+        left -= ret;
+    }
+    mbedtls_ssl_close_notify( &ssl );
+    mbedtls_ssl_free( &ssl );
+    capsule->served++;
+}
+
+static void capsuleThread(void* arg) {
+    LocalCapsule* capsule = arg;
+    while (capsule->running) {
+        mbedtls_net_context client;
+        mbedtls_net_init( &client );
+        if( mbedtls_net_accept( &capsule->listen, &client, NULL, 0, NULL ) == 0 ) {
+            serve(capsule, &client);
+        }
+        mbedtls_net_free( &client );
+    }
+}
+
+int capsuleStart(LocalCapsule* capsule, const char* response, int resume) {
+    memset(capsule, 0, sizeof *capsule);
+    capsule->response = response;
+    mbedtls_entropy_init( &capsule->entropy );
+    mbedtls_ctr_drbg_init( &capsule->ctr_drbg );
+    mbedtls_ssl_config_init( &capsule->conf );
+    mbedtls_x509_crt_init( &capsule->cert );
+    mbedtls_pk_init( &capsule->key );
+    mbedtls_net_init( &capsule->listen );
+    mbedtls_ssl_cache_init( &capsule->cache );
+
+    if( mbedtls_ctr_drbg_seed( &capsule->ctr_drbg, mbedtls_entropy_func, &capsule->entropy, NULL, 0 ) != 0 ||
+        mbedtls_x509_crt_parse( &capsule->cert, (const unsigned char*)mbedtls_test_srv_crt, mbedtls_test_srv_crt_len ) != 0 ||
+        mbedtls_pk_parse_key( &capsule->key, (const unsigned char*)mbedtls_test_srv_key, mbedtls_test_srv_key_len, NULL, 0 ) != 0 ||
+        mbedtls_ssl_config_defaults( &capsule->conf, MBEDTLS_SSL_IS_SERVER, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT ) != 0 ||
+        mbedtls_ssl_conf_own_cert( &capsule->conf, &capsule->cert, &capsule->key ) != 0) {
+        capsuleStop(capsule);
+        return -1;
+    }
+    mbedtls_ssl_conf_rng( &capsule->conf, mbedtls_ctr_drbg_random, &capsule->ctr_drbg );
+    if (resume) {
+        mbedtls_ssl_conf_session_cache( &capsule->conf, &capsule->cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set );
+    }
+
+    //Port 0 lets the system pick one that is free
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof address;
+    if( mbedtls_net_bind( &capsule->listen, "127.0.0.1", "0", MBEDTLS_NET_PROTO_TCP ) != 0 ||
+        getsockname(capsule->listen.fd, (struct sockaddr*)&address, &addressLength) != 0) {
+        capsuleStop(capsule);
+        return -1;
+    }
+    snprintf(capsule->port, sizeof capsule->port, "%u", ntohs(address.sin_port));
+
+    capsule->running = 1;
+    capsule->thread = platformThreadStart(capsuleThread, capsule, 64 * 1024);
+    if (capsule->thread == NULL) {
+        capsule->running = 0;
+        capsuleStop(capsule);
+        return -1;
+    }
+    return 0;
+}
+
+void capsuleStop(LocalCapsule* capsule) {
+    if (capsule->thread != NULL) {
+        capsule->running = 0;
+        //Wakes the accept up, it fails and the thread sees it should stop
+        shutdown(capsule->listen.fd, SHUT_RDWR);
+        platformThreadJoin(capsule->thread);
+        capsule->thread = NULL;
+    }
+    mbedtls_net_free( &capsule->listen );
+    mbedtls_ssl_cache_free( &capsule->cache );
+    mbedtls_pk_free( &capsule->key );
+    mbedtls_x509_crt_free( &capsule->cert );
+    mbedtls_ssl_config_free( &capsule->conf );
+    mbedtls_ctr_drbg_free( &capsule->ctr_drbg );
+    mbedtls_entropy_free( &capsule->entropy );
+}
@@ -0,0 +1,37 @@
+#ifndef CAPSULE_H
+#define CAPSULE_H
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ssl_cache.h>
+#include <mbedtls/x509_crt.h>
+
+#include "platform.h"
+
+//A gemini server on 127.0.0.1 for the TLS benchmarks, answering every request
+//with the same response. It uses mbedtls' test certificate and serves one
+//connection at a time on a thread of its own.
+typedef struct {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt cert;
+    mbedtls_pk_context key;
+    mbedtls_net_context listen;
+    mbedtls_ssl_cache_context cache;
+    const char* response;
+    char port[6];
+    unsigned long served;
+    PlatformThread* thread;
+    volatile int running;
+} LocalCapsule;
+
+//Listens on a free port, capsule->port says which. With resume set it keeps
+//sessions so clients that offer one get the abbreviated handshake.
+int capsuleStart(LocalCapsule* capsule, const char* response, int resume);
+void capsuleStop(LocalCapsule* capsule);
+
+#endif
@@ -0,0 +1,154 @@
+#---------------------------------------------------------------------------------
+# Native build of the platform independent core (no devkitARM needed)
+#   make host        builds $(HOST_BUILD)/libgemini.a with the system compiler
+#   make host-test   builds and runs the unit tests in tests/
+#   make host-bench  builds and runs the benchmarks in bench/
+#   make host-replay SESSION=file  plays a recorded session headless, see replay/
+#   make host-clean  removes it all
+#---------------------------------------------------------------------------------
+HOSTCC		?=	cc
+HOST_BUILD	:=	build-host
+HOST_SOURCES	:=	source/arena.c \
+			source/browser.c \
+			source/buffer.c \
+			source/connector.c \
+			source/diskcache.c \
+			source/dnscache.c \
+			source/download.c \
+			source/feeds.c \
+			source/fetch.c \
+			source/gemtext.c \
+			source/glyphs.c \
+			source/history.c \
+			source/knownhosts.c \
+			source/layout.c \
+			source/linktable.c \
+			source/lz.c \
+			source/memstats.c \
+			source/pagecache.c \
+			source/platform_posix.c \
+			source/prefetch.c \
+			source/redirects.c \
+			source/render_soft.c \
+			source/render_stub.c \
+			source/response.c \
+			source/session.c \
+			source/spsc.c \
+			source/textcache.c \
+			source/trace.c \
+			source/tilecache.c \
+			source/url.c
+
+# TLS needs mbedtls 2.x headers, e.g. make host HOST_MBEDTLS=1. Without it the
+# fetcher and the feed reader still build and run over any FetchNetwork.
+ifeq ($(HOST_MBEDTLS),1)
+HOST_SOURCES	+=	source/network_tls.c \
+			source/tls.c
+endif
+
+HOST_CFLAGS	:=	-g -Wall -O2 -std=gnu11 -pthread
+ifeq ($(HOST_MBEDTLS),1)
+HOST_CFLAGS	+=	-DHOST_MBEDTLS
+endif
+
+HOST_OFILES	:=	$(patsubst source/%.c,$(HOST_BUILD)/%.o,$(HOST_SOURCES))
+
+# Shared by the tests and the benchmarks: a FetchNetwork that answers from
+# memory and a generator of made up pages
+HOST_TEST_HELPERS	:=	tests/fakenet.c \
+			tests/pages.c
+HOST_TEST_SOURCES	:=	tests/main.c \
+			$(HOST_TEST_HELPERS) \
+			tests/test_connect.c \
+			tests/test_diskcache.c \
+			tests/test_download.c \
+			tests/test_feeds.c \
+			tests/test_fetch.c \
+			tests/test_gemtext.c \
+			tests/test_history.c \
+			tests/test_knownhosts.c \
+			tests/test_layout.c \
+			tests/test_linktable.c \
+			tests/test_lz.c \
+			tests/test_memstats.c \
+			tests/test_prefetch.c \
+			tests/test_redirects.c \
+			tests/test_render.c \
+			tests/test_response.c \
+			tests/test_session.c \
+			tests/test_trace.c \
+			tests/test_url.c
+HOST_BENCH_SOURCES	:=	bench/bench.c \
+			$(HOST_TEST_HELPERS)
+# The TLS benchmarks talk to a local capsule
+ifeq ($(HOST_MBEDTLS),1)
+HOST_BENCH_SOURCES	+=	bench/capsule.c
+endif
+
+HOST_REPLAY_SOURCES	:=	replay/replay.c
+
+HOST_TEST_OFILES	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,$(HOST_TEST_SOURCES))
+HOST_BENCH_OFILES	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,$(HOST_BENCH_SOURCES))
+HOST_REPLAY_OFILES	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,$(HOST_REPLAY_SOURCES))
+HOST_LIBS	:=	-lm -pthread
+ifeq ($(HOST_MBEDTLS),1)
+HOST_LIBS	+=	-lmbedtls -lmbedx509 -lmbedcrypto
+endif
+
+.PHONY: host host-test host-bench host-replay host-clean
+
+#---------------------------------------------------------------------------------
+host: $(HOST_BUILD)/libgemini.a
+
+$(HOST_BUILD)/libgemini.a: $(HOST_OFILES)
+	@echo $(notdir $@)
+	@$(AR) rcs $@ $^
+
+$(HOST_BUILD)/%.o: source/%.c
+	@mkdir -p $(HOST_BUILD)
+	@echo $(notdir $<)
+	@$(HOSTCC) $(HOST_CFLAGS) -MMD -MP -c $< -o $@
+
+$(HOST_BUILD)/tests/%.o: tests/%.c
+	@mkdir -p $(dir $@)
+	@echo $(notdir $<)
+	@$(HOSTCC) $(HOST_CFLAGS) -Isource -Itests -MMD -MP -c $< -o $@
+
+$(HOST_BUILD)/bench/%.o: bench/%.c
+	@mkdir -p $(dir $@)
+	@echo $(notdir $<)
+	@$(HOSTCC) $(HOST_CFLAGS) -Isource -Itests -MMD -MP -c $< -o $@
+
+$(HOST_BUILD)/replay/%.o: replay/%.c
+	@mkdir -p $(dir $@)
+	@echo $(notdir $<)
+	@$(HOSTCC) $(HOST_CFLAGS) -Isource -MMD -MP -c $< -o $@
+
+#---------------------------------------------------------------------------------
+host-test: $(HOST_BUILD)/tests/run
+	@$< $(TEST)
+
+$(HOST_BUILD)/tests/run: $(HOST_TEST_OFILES) $(HOST_BUILD)/libgemini.a
+	@echo $(notdir $@)
+	@$(HOSTCC) $^ $(HOST_LIBS) -o $@
+
+host-bench: $(HOST_BUILD)/bench/run
+	@$< $(BENCH)
+
+$(HOST_BUILD)/bench/run: $(HOST_BENCH_OFILES) $(HOST_BUILD)/libgemini.a
+	@echo $(notdir $@)
+	@$(HOSTCC) $^ $(HOST_LIBS) -o $@
+
+host-replay: $(HOST_BUILD)/replay/run
+	@$< $(SESSION)
+
+$(HOST_BUILD)/replay/run: $(HOST_REPLAY_OFILES) $(HOST_BUILD)/libgemini.a
+	@echo $(notdir $@)
+	@$(HOSTCC) $^ $(HOST_LIBS) -o $@
+
+#---------------------------------------------------------------------------------
+host-clean:
+	@echo clean host ...
+	@rm -fr $(HOST_BUILD)
+
+-include $(HOST_OFILES:.o=.d) $(HOST_TEST_OFILES:.o=.d) $(HOST_BENCH_OFILES:.o=.d) $(HOST_REPLAY_OFILES:.o=.d)
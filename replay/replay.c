@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "browser.h"
+#include "fetch.h"
+#include "layout.h"
+#include "memstats.h"
+#include "render.h"
+#include "render_soft.h"
+#include "session.h"
+#include "trace.h"
+
+//Plays a session recorded on the 3DS (hold L while the app starts) through
+//the same frame code, without a screen or a network:
+//    build-host/replay/run session.gss          counting draws only
+//    build-host/replay/run session.gss soft     drawing into memory as well
+//Frames run back to back, so the times are what the frame code costs on this
+//machine rather than what the 3DS would show. Pages come from the recording.
+
+static SessionReplay replay;
+static Buffer memoryText;
+
+static int typeRecorded(void* user, const char* prompt, char* out, size_t size) {
+    return sessionReplayText(&replay, out, size);
+}
+
+//Subscriptions need TLS workers, only the memory page is made up here
+static int showAbout(void* user, Browser* browser, const char* url, int reload) {
+    if (strcmp(url, "about:memory") != 0) {
+        return -1;
+    }
+    memReport(&memoryText);
+    browserShowText(browser, url, memoryText.data, 0, 0);
+    return 0;
+}
+
+static void report(const Browser* browser, const StubRenderer* stub) {
+    sessionReplayReport(&replay, stdout);
+    for (int i = 0; i < TRACE_NAMES; i++) {
+        TraceSummary summary;
+        traceSummarize(i, &summary);
+        if (summary.count > 0 && i != TRACE_BYTES) {
+            printf("%-10s ms: p50 %.2f, p95 %.2f, max %.2f\n", traceNameOf(i), summary.p50 / 1000.0, summary.p95 / 1000.0, summary.max / 1000.0);
+        }
+    }
+    printf("page cache %lu hits, %lu misses, text cache %lu hits, %lu misses, tiles %lu hits, %lu misses\n",
+        browser->pages.hits, browser->pages.misses, browser->text.hits, browser->text.misses, browser->tiles.hits, browser->tiles.misses);
+    if (stub != NULL) {
+        printf("renderer %lu text draws, %lu rects, %lu tile paints, %lu blits, %lu allocations\n",
+            stub->textDraws, stub->rectDraws, stub->surfacePaints, stub->surfaceDraws, stub->allocations);
+    }
+    unsigned long allocations = 0;
+    for (int i = 0; i < MEM_ACCOUNTS; i++) {
+        MemStats stats;
+        memStats(i, &stats);
+        allocations += stats.allocations;
+    }
+    printf("%lu allocations\n", allocations);
+    memDump(stdout);
+}
+
+int main(int argc, char** argv) {
+    int soft = argc > 2 && strcmp(argv[2], "soft") == 0;
+    if (argc < 2 || (argc > 2 && !soft)) {
+        fprintf(stderr, "usage: %s session.gss [soft]\n", argv[0]);
+        return 2;
+    }
+    if (sessionReplayOpen(&replay, argv[1]) != 0) {
+        fprintf(stderr, "%s: not a session recording\n", argv[1]);
+        return 1;
+    }
+
+    Renderer renderer;
+    Renderer statusRenderer;
+    StubRenderer stub;
+    StubRenderer statusStub;
+    SoftRenderer softRenderer;
+    SoftRenderer softStatus;
+    if (soft) {
+        if (rendererInitSoft(&renderer, &softRenderer, TOP_SCREEN_WIDTH, TOP_SCREEN_HEIGHT, NULL) != 0 ||
+            rendererInitSoft(&statusRenderer, &softStatus, BOTTOM_SCREEN_WIDTH, BOTTOM_SCREEN_HEIGHT, NULL) != 0) {
+            fprintf(stderr, "Out of memory for the screens\n");
+            return 1;
+        }
+    } else {
+        rendererInitStub(&renderer, &stub);
+        rendererInitStub(&statusRenderer, &statusStub);
+    }
+    layoutSetFont(NULL, TOP_SCREEN_WIDTH - 12);
+    bufferInit(&memoryText, MEM_OTHER);
+
+    //Like a replay on the 3DS, past the disk cache and the stored redirects
+    FetchNetwork network;
+    Fetcher fetcher;
+    networkInitReplay(&network, &replay);
+    if (fetcherStart(&fetcher, &network, NULL, NULL) != 0) {
+        fprintf(stderr, "Failed to start the fetch thread\n");
+        return 1;
+    }
+    traceSetEnabled(1);
+    static Browser browser;
+    BrowserHooks hooks = { NULL, typeRecorded, showAbout };
+    browserInit(&browser, &renderer, &statusRenderer, &fetcher, &hooks);
+    memResetPeaks();
+
+    uint32_t clrClear = renderColor(0x04, 0x0D, 0x13, 0xFF);
+    SessionInput input;
+    while (sessionReplayFrame(&replay, &input) == 0) {
+        uint64_t frameStart = traceStart();
+        browserInput(&browser, &input);
+        traceEnd(TRACE_INPUT, frameStart);
+        uint64_t drawStart = traceStart();
+        if (soft) {
+            softClear(&softRenderer, clrClear);
+        }
+        browserDrawPage(&browser);
+        browserDrawControls(&browser);
+        traceEnd(TRACE_DRAW, drawStart);
+        browserAct(&browser);
+        traceEnd(TRACE_FRAME, frameStart);
+    }
+
+    report(&browser, soft ? NULL : &stub);
+    int missing = replay.missing > 0;
+    browserStop(&browser);
+    fetcherStop(&fetcher);
+    browserFree(&browser);
+    bufferFree(&memoryText);
+    sessionReplayFree(&replay);
+    if (soft) {
+        rendererFreeSoft(&softRenderer);
+        rendererFreeSoft(&softStatus);
+    }
+    //A replay that asked for pages the recording doesn't have went another way
+    return missing;
+}
@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "memstats.h"
+
+#define ARENA_ALIGN 8
+#define ARENA_MIN_BLOCK 1024
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t size;
+    size_t offset;
+    //Data follows the header
+};
+
+static size_t alignUp(size_t value) {
+    return (value + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+void arenaInit(Arena* arena, size_t blockSize, int account) {
+    memset(arena, 0, sizeof *arena);
+    arena->blockSize = blockSize < ARENA_MIN_BLOCK ? ARENA_MIN_BLOCK : blockSize;
+    arena->account = account;
+}
+
+//What the blocks really cost, headers included
+static size_t arenaBytes(const Arena* arena) {
+    return arena->reserved + arena->blockCount * alignUp(sizeof(ArenaBlock));
+}
+
+static ArenaBlock* arenaNewBlock(Arena* arena, size_t size) {
+    size_t blockSize = size > arena->blockSize ? size : arena->blockSize;
+    ArenaBlock* block = malloc(alignUp(sizeof(ArenaBlock)) + blockSize);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->size = blockSize;
+    block->offset = 0;
+    block->next = arena->head;
+    arena->head = block;
+    arena->reserved += blockSize;
+    arena->blockCount++;
+    memCharge(arena->account, alignUp(sizeof(ArenaBlock)) + blockSize);
+    return block;
+}
+
+void* arenaAlloc(Arena* arena, size_t size) {
+    size = alignUp(size == 0 ? 1 : size);
+    ArenaBlock* block = arena->head;
+    if (block == NULL || block->size - block->offset < size) {
+        block = arenaNewBlock(arena, size);
+        if (block == NULL) {
+            return NULL;
+        }
+    }
+    char* data = (char*)block + alignUp(sizeof(ArenaBlock)) + block->offset;
+    block->offset += size;
+    arena->used += size;
+    return data;
+}
+
+char* arenaStrndup(Arena* arena, const char* str, size_t len) {
+    char* copy = arenaAlloc(arena, len + 1);
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+void* arenaGrow(Arena* arena, void* ptr, size_t oldSize, size_t newSize) {
+    if (ptr == NULL) {
+        return arenaAlloc(arena, newSize);
+    }
+    oldSize = alignUp(oldSize == 0 ? 1 : oldSize);
+    newSize = alignUp(newSize);
+    if (newSize <= oldSize) {
+        return ptr;
+    }
+
+    ArenaBlock* block = arena->head;
+    char* blockData = (char*)block + alignUp(sizeof(ArenaBlock));
+    if ((char*)ptr + oldSize == blockData + block->offset && block->size - (block->offset - oldSize) >= newSize) {
+        block->offset += newSize - oldSize;
+        arena->used += newSize - oldSize;
+        return ptr;
+    }
+
+    void* grown = arenaAlloc(arena, newSize);
+    if (grown != NULL) {
+        memcpy(grown, ptr, oldSize);
+    }
+    return grown;
+}
+
+void arenaFree(Arena* arena) {
+    memRelease(arena->account, arenaBytes(arena));
+    ArenaBlock* block = arena->head;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->used = 0;
+    arena->reserved = 0;
+    arena->blockCount = 0;
+}
+
+void arenaSetAccount(Arena* arena, int account) {
+    memMove(arena->account, account, arenaBytes(arena));
+    arena->account = account;
+}
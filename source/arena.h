@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+//Bump allocator, everything handed out lives until arenaFree releases it all at once
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;
+    size_t blockSize;   //Default size of a new block, bigger requests get their own block
+    size_t used;        //Bytes handed out to callers
+    size_t reserved;    //Bytes requested from malloc
+    int blockCount;     //Number of mallocs made by this arena
+    int account;        //MemAccount the blocks are charged to
+} Arena;
+
+void arenaInit(Arena* arena, size_t blockSize, int account);
+void* arenaAlloc(Arena* arena, size_t size);
+char* arenaStrndup(Arena* arena, const char* str, size_t len);
+//Resize an allocation, in place when it was the last one made
+void* arenaGrow(Arena* arena, void* ptr, size_t oldSize, size_t newSize);
+void arenaFree(Arena* arena);
+//Moves everything the arena holds over to another account
+void arenaSetAccount(Arena* arena, int account);
+
+#endif
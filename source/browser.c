@@ -0,0 +1,590 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "browser.h"
+#include "trace.h"
+#include "url.h"
+
+static const char* welcomeText = "3DS Gemini Client\nBy abraxas@hidden.nexus\n=> gemini://hidden.nexus Visit the Hidden Nexus\n=> about:feeds Subscriptions\n=> about:memory Memory";
+
+static void initButton(UiButton* button, int x, int w, const char* text, enum Action action) {
+    uint32_t clrWhite = renderColor(0xFF, 0xFF, 0xFF, 0xFF);
+    uint32_t clrIced  = renderColor(0xFB, 0xFC, 0xFC, 0xFF);
+    uint32_t clrClear = renderColor(0x04, 0x0D, 0x13, 0xFF);
+    UiButton made = { x, 0, 0, w, BOTTOM_SCREEN_HEIGHT / 10, 6, clrClear, clrWhite, clrIced, "", action };
+    snprintf(made.text, sizeof made.text, "%s", text);
+    *button = made;
+}
+
+//Rebuild the button list for the current page, only needed when the page or the fixed buttons change
+static void layoutUiButtons(Browser* browser) {
+    browser->generation++;
+    browser->buttons[0] = &browser->backButton;
+    browser->buttons[1] = &browser->forwardButton;
+    browser->buttons[2] = &browser->urlButton;
+    linkTableBuild(&browser->links, &browser->doc, LINK_ROW_HEIGHT);
+    browser->linkScroll = 0;
+}
+
+//Prepare the text of every row and button, only runs when the generation moves on
+static void buildTextCache(Browser* browser, const Line* lines, const PageLayout* layout) {
+    uint64_t traced = traceStart();
+    int rowCount = layout->firstRows != NULL ? layout->firstRows[layout->lineCount] : 0;
+    size_t bytes = 0;
+    for (int i = 0; i < rowCount; i++) {
+        bytes += layout->rows[i].length;
+    }
+    for (int i = 0; i < FIXED_BUTTONS; i++) {
+        bytes += strlen(browser->buttons[i]->text);
+    }
+    for (int i = 0; i < browser->links.count; i++) {
+        bytes += browser->doc.links[browser->links.slots[i].link].captionLength;
+    }
+
+    textCacheReset(&browser->text, browser->generation, rowCount + FIXED_BUTTONS + browser->links.count, bytes);
+    for (int i = 0; i < layout->lineCount; i++) {
+        for (int row = layout->firstRows[i]; row < layout->firstRows[i + 1]; row++) {
+            textCacheAdd(&browser->text, lines[i].text + layout->rows[row].start, layout->rows[row].length);
+        }
+    }
+    browser->buttonTextBase = rowCount;
+    for (int i = 0; i < FIXED_BUTTONS; i++) {
+        textCacheAdd(&browser->text, browser->buttons[i]->text, strlen(browser->buttons[i]->text));
+    }
+    browser->linkTextBase = browser->buttonTextBase + FIXED_BUTTONS;
+    for (int i = 0; i < browser->links.count; i++) {
+        const Link* link = &browser->doc.links[browser->links.slots[i].link];
+        textCacheAdd(&browser->text, link->caption, link->captionLength);
+    }
+    traceEnd(TRACE_TEXT, traced);
+}
+
+//Make a parsed page the one on screen. The page being left goes into the page
+//cache so going back to it needs neither the network nor the parser.
+static void showPage(Browser* browser, const char* key, int cacheable, Document* doc, const PageLayout* layout, int pageScroll) {
+    if (browser->cacheable) {
+        pageCachePut(&browser->pages, browser->key, &browser->doc, &browser->layout, browser->scroll, 0);
+    } else {
+        freeDocument(&browser->doc);
+    }
+
+    browser->doc = *doc;
+    browser->layout = *layout;
+    memset(doc, 0, sizeof *doc);
+    snprintf(browser->key, sizeof browser->key, "%s", key);
+    browser->cacheable = cacheable;
+    browser->scroll = pageScroll;
+    browser->preScroll = 0;
+    browser->certChanged = 0;
+
+    if (strncmp(key, "about:", 6) != 0) {
+        prefetchPage(&browser->prefetcher, key, &browser->doc);
+    } else {
+        prefetchCancel(&browser->prefetcher);
+    }
+}
+
+void browserShowText(Browser* browser, const char* url, const char* text, int cacheable, int scroll) {
+    Document doc;
+    PageLayout layout;
+    parseGemtext(text, &doc);
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    showPage(browser, url, cacheable, &doc, &layout, scroll);
+    layoutUiButtons(browser);
+}
+
+void browserShowStatus(Browser* browser, const char* message) {
+    snprintf(browser->statusMessage, sizeof browser->statusMessage, "%s", message);
+    browser->statusFrames = STATUS_FRAMES;
+}
+
+//The welcome page is built in, the others come from the app
+static int showAbout(Browser* browser, const char* url, int reload) {
+    if (strcmp(url, WELCOME_URL) == 0) {
+        browserShowText(browser, WELCOME_URL, welcomeText, 1, 0);
+        return 0;
+    }
+    return browser->hooks.about != NULL ? browser->hooks.about(browser->hooks.user, browser, url, reload) : -1;
+}
+
+void browserInit(Browser* browser, Renderer* renderer, Renderer* statusRenderer, Fetcher* fetcher, const BrowserHooks* hooks) {
+    memset(browser, 0, sizeof *browser);
+    browser->renderer = renderer;
+    browser->hooks = *hooks;
+    browser->fetcher = fetcher;
+    textCacheInit(&browser->text, renderer);
+    textCacheInit(&browser->statusCache, statusRenderer);
+    tileCacheInit(&browser->tiles, renderer, TOP_SCREEN_WIDTH, PAGE_TILE_HEIGHT, renderColor(0x04, 0x0D, 0x13, 0xFF));
+    initButton(&browser->backButton, 0, BOTTOM_SCREEN_WIDTH / 4, "<=", ACTION_PAGE_BACK);
+    initButton(&browser->forwardButton, BOTTOM_SCREEN_WIDTH / 4, BOTTOM_SCREEN_WIDTH / 4, "=>", ACTION_PAGE_FORW);
+    initButton(&browser->urlButton, (BOTTOM_SCREEN_WIDTH / 2) - 3, (BOTTOM_SCREEN_WIDTH / 2) + 3, "Enter URL", ACTION_NEW_PAGE);
+    snprintf(browser->typed, sizeof browser->typed, "Enter URL");
+    pageCacheInit(&browser->pages, PAGE_CACHE_BUDGET, PAGE_CACHE_COMPRESS);
+    prefetchInit(&browser->prefetcher, fetcher, &browser->pages, PREFETCH_LINKS, PREFETCH_IN_FLIGHT, PREFETCH_BUDGET);
+    historyInit(&browser->history);
+    historyVisit(&browser->history, WELCOME_URL);
+    linkTableInit(&browser->links);
+    showAbout(browser, WELCOME_URL, 0);
+}
+
+//Puts the history back where it was before a back or forward step
+static void undoStep(Browser* browser, int step) {
+    if (step < 0) {
+        historyForward(&browser->history);
+    } else if (step > 0) {
+        historyBack(&browser->history);
+    }
+}
+
+static void stopLoading(Browser* browser) {
+    if (browser->loading != NULL) {
+        //The worker still hands it back through the completion queue, it is freed then
+        fetchJobCancel(browser->loading);
+        browser->loading = NULL;
+        browser->generation++;
+
+        //A cancelled back or forward step leaves us where we were
+        undoStep(browser, browser->loadingStep);
+        browser->loadingStep = 0;
+    }
+}
+
+//url is canonical, step is 0 for a new page, -1 or 1 when stepping through
+//the history. reload skips the disk cache. Returns -1 if nothing is loading.
+static int openPage(Browser* browser, const char* url, int step, int reload) {
+    FetchJob* job = fetchJobNew(url);
+    if (job == NULL) {
+        browserShowStatus(browser, "Only gemini:// urls can be opened");
+        return -1;
+    }
+    stopLoading(browser);
+    prefetchCancel(&browser->prefetcher);
+    job->reload = reload;
+    job->downloadDir = browser->downloadDir;
+    //Reloading the warning is how the user says the new certificate is fine
+    job->trustNewCert = browser->certChanged && strcmp(url, browser->key) == 0;
+    if (fetcherSubmit(browser->fetcher, job) != 0) {
+        fetchJobFree(job);
+        return -1;
+    }
+    browser->loading = job;
+    browser->loadingLines = 0;
+    browser->loadingStep = step;
+    browser->leavingScroll = browser->scroll;
+    return 0;
+}
+
+//The url button shows the start of the url, without the scheme
+static void setUrlButton(Browser* browser, const char* url) {
+    if (strncmp(url, "gemini://", 9) == 0) {
+        url += 9;
+    }
+    snprintf(browser->urlButton.text, sizeof browser->urlButton.text, "%.14s", url);
+}
+
+//Back or forward, straight out of the page cache when the page is still there
+static void stepHistory(Browser* browser, int step) {
+    stopLoading(browser);
+    prefetchCancel(&browser->prefetcher);
+    const char* url = step < 0 ? historyBack(&browser->history) : historyForward(&browser->history);
+    if (url == NULL) {
+        return;
+    }
+
+    Document doc;
+    PageLayout layout;
+    int pageScroll;
+    if (pageCacheTake(&browser->pages, url, &doc, &layout, &pageScroll) == 0) {
+        showPage(browser, url, 1, &doc, &layout, pageScroll);
+    } else if (strncmp(url, "about:", 6) != 0 || showAbout(browser, url, 0) != 0) {
+        //The page on screen stays, and so does the place in the history
+        if (openPage(browser, url, step, 0) != 0) {
+            undoStep(browser, step);
+        }
+        return;
+    }
+
+    setUrlButton(browser, url);
+    layoutUiButtons(browser);
+}
+
+//Following a link to a page that is already in the page cache, prefetched or
+//visited before, needs no network at all
+static int openCachedPage(Browser* browser, const char* url) {
+    Document doc;
+    PageLayout layout;
+    int pageScroll;
+    if (pageCacheTake(&browser->pages, url, &doc, &layout, &pageScroll) != 0) {
+        return -1;
+    }
+
+    stopLoading(browser);
+    historyVisit(&browser->history, url);
+    showPage(browser, url, 1, &doc, &layout, 0);
+    layoutUiButtons(browser);
+    return 0;
+}
+
+void browserNavigate(Browser* browser, const char* url) {
+    //A page that moved for good is opened, and looked for in the cache, under where it went
+    char moved[URL_MAX];
+    if (browser->redirects != NULL && redirectsLookup(browser->redirects, url, moved) == 0) {
+        url = moved;
+    }
+    setUrlButton(browser, url);
+    layoutUiButtons(browser);
+    if (strncmp(url, "about:", 6) == 0 && strcmp(url, WELCOME_URL) != 0) {
+        stopLoading(browser);
+        historyVisit(&browser->history, url);
+        if (showAbout(browser, url, 0) != 0) {
+            browserShowStatus(browser, "There is no such page");
+        }
+    } else if (openCachedPage(browser, url) != 0) {
+        openPage(browser, url, 0, 0);
+    }
+}
+
+//Input prompts need the keyboard so they are answered here rather than on the worker
+static void answerPrompt(Browser* browser, FetchJob* job) {
+    char query[1024] = "";
+    char escaped[URL_MAX];
+    if (browser->hooks.keyboard != NULL) {
+        browser->hooks.keyboard(browser->hooks.user, job->header.meta, query, sizeof query);
+    }
+    urlEscape(query, escaped, sizeof escaped);
+
+    //The answer replaces any query the prompting url had
+    Url prompt;
+    urlParse(job->url, strlen(job->url), &prompt);
+    prompt.hasQuery = 0;
+    char base[URL_MAX];
+    urlFormat(&prompt, base, sizeof base);
+
+    char reply[URL_MAX * 2 + 1024 + 32];
+    snprintf(reply, sizeof reply, "=> %s?%s Send Input\n%s", base, escaped, query);
+    bufferSet(&job->body, reply);
+    freeDocument(&job->doc);
+    parseGemtext(reply, &job->doc);
+    resetLayout(&job->layout);
+    layoutDocument(&job->doc, &job->layout);
+}
+
+//Swap a finished page in as the current one
+static void finishPage(Browser* browser, FetchJob* job) {
+    if (job->error == FETCH_CANCELLED) {
+        fetchJobFree(job);
+        return;
+    }
+
+    //A step through the history that got no answer leaves the page on screen
+    //and the history where they were. The warning about a changed certificate
+    //is still shown, reloading it is how the new one gets trusted.
+    if (browser->loadingStep != 0 && job->error != FETCH_OK && job->header.status == 0 && job->error != FETCH_CERT_CHANGED) {
+        undoStep(browser, browser->loadingStep);
+        browser->loadingStep = 0;
+        browser->scroll = browser->leavingScroll;
+        browser->generation++;
+        if (job->doc.lineCount > 0) {
+            char message[sizeof browser->statusMessage];
+            snprintf(message, sizeof message, "%.*s", job->doc.lines[0].length, job->doc.lines[0].text);
+            browserShowStatus(browser, message);
+        }
+        fetchJobFree(job);
+        return;
+    }
+
+    const char* key = job->url;
+    if (browser->loadingStep == 0) {
+        historyVisit(&browser->history, key);
+    }
+    browser->loadingStep = 0;
+    //Errors, prompts and redirects are fetched again rather than coming back out of the cache
+    int cacheable = job->error == FETCH_OK && job->header.status / 10 == 2;
+    if (job->header.status / 10 == 1) {
+        answerPrompt(browser, job);
+    }
+
+    //Keep the scroll if the preview was already on screen
+    int pageScroll = browser->loadingLines == 0 ? 0 : browser->scroll;
+    browser->scroll = browser->leavingScroll;
+    showPage(browser, key, cacheable, &job->doc, &job->layout, pageScroll);
+    browser->certChanged = job->error == FETCH_CERT_CHANGED;
+    //Redirects may have taken it somewhere else than the url button says
+    setUrlButton(browser, key);
+    if (browser->redirects != NULL && browser->redirectsFile != NULL && redirectsSave(browser->redirects, browser->redirectsFile) != 0) {
+        browserShowStatus(browser, "Couldn't save the redirects");
+    }
+    fetchJobFree(job);
+    layoutUiButtons(browser);
+}
+
+static void clamp(int* value, int max) {
+    if (*value > max) {
+        *value = max;
+    }
+    if (*value < 0) {
+        *value = 0;
+    }
+}
+
+void browserInput(Browser* browser, const SessionInput* input) {
+    uint32_t kDown = input->kDown;
+    uint32_t kHeld = input->kHeld;
+    browser->kDown = kDown;
+    browser->action = ACTION_NONE;
+    browser->hitLink = -1;
+
+    //Pick up pages the worker has finished
+    FetchJob* done;
+    while ((done = fetcherPoll(browser->fetcher)) != NULL) {
+        if (done == browser->loading) {
+            browser->loading = NULL;
+            finishPage(browser, done);
+        } else if (!prefetchFinish(&browser->prefetcher, done)) {
+            fetchJobFree(done);
+        }
+    }
+    if (browser->loading == NULL) {
+        prefetchIdle(&browser->prefetcher);
+    }
+
+    if ((kDown & BUTTON_B) && browser->loading != NULL) {
+        stopLoading(browser);
+    }
+    if (kDown & BUTTON_L) {
+        browser->action = ACTION_PAGE_BACK;
+    }
+    if (kDown & BUTTON_R) {
+        browser->action = ACTION_PAGE_FORW;
+    }
+    if ((kDown & BUTTON_Y) && strcmp(browser->key, WELCOME_URL) != 0) {
+        browser->action = ACTION_RELOAD;
+    }
+    if (kDown & BUTTON_SELECT) {
+        Prefetcher* prefetcher = &browser->prefetcher;
+        prefetcher->enabled = !prefetcher->enabled;
+        if (prefetcher->enabled && strcmp(browser->key, WELCOME_URL) != 0) {
+            prefetchPage(prefetcher, browser->key, &browser->doc);
+        } else {
+            prefetchCancel(prefetcher);
+        }
+        char message[64];
+        snprintf(message, sizeof message, "Prefetch %s, %lu/%lu used, %u KB wasted", prefetcher->enabled ? "on" : "off",
+            browser->pages.prefetchHits, prefetcher->stored, (unsigned int)((prefetcher->wastedBytes + browser->pages.prefetchWasted) / 1024));
+        browserShowStatus(browser, message);
+    }
+    if (kHeld & BUTTON_DOWN) {
+        browser->scroll -= 3;
+    }
+    if (kHeld & BUTTON_UP) {
+        browser->scroll += 3;
+    }
+
+    //Preformatted blocks aren't wrapped, left and right scroll them sideways
+    const PageSnapshot* preview = browser->loading != NULL ? fetchJobSnapshot(browser->loading) : NULL;
+    const PageLayout* shownLayout = preview != NULL && preview->layout.lineCount > 0 ? &preview->layout : &browser->layout;
+    int oldPreScroll = browser->preScroll;
+    if (kHeld & BUTTON_RIGHT) {
+        browser->preScroll += 4;
+    }
+    if (kHeld & BUTTON_LEFT) {
+        browser->preScroll -= 4;
+    }
+    clamp(&browser->preScroll, shownLayout->preWidth - (TOP_SCREEN_WIDTH - 12));
+    if (browser->preScroll != oldPreScroll) {
+        tileCacheInvalidate(&browser->tiles);
+    }
+
+    //The circle pad scrolls the link list
+    if (kHeld & BUTTON_CPAD_DOWN) {
+        browser->linkScroll += 4;
+    }
+    if (kHeld & BUTTON_CPAD_UP) {
+        browser->linkScroll -= 4;
+    }
+    clamp(&browser->linkScroll, browser->links.height - (BOTTOM_SCREEN_HEIGHT - LINK_LIST_TOP));
+
+    if ((kDown & BUTTON_TOUCH) && input->touchY > LINK_LIST_TOP) {
+        int slot = linkTableHit(&browser->links, input->touchY - LINK_LIST_TOP + browser->linkScroll);
+        if (slot >= 0) {
+            browser->action = ACTION_OPEN_LINK;
+            browser->hitLink = browser->links.slots[slot].link;
+        }
+    }
+    //The fixed buttons go over any links scrolled up under them
+    for (int i = 0; i < FIXED_BUTTONS; i++) {
+        const UiButton* button = browser->buttons[i];
+        if ((kDown & BUTTON_TOUCH) && input->touchX > button->x && input->touchY > button->y && input->touchY < button->y + button->h) {
+            browser->action = button->action;
+        }
+    }
+}
+
+//Draws the rows of the page overlapping [top, bottom) with top at y = 0.
+//Page coordinates start at the first line, the screen adds a margin on top.
+static void drawPageRows(Browser* browser, const Line* lines, const PageLayout* layout, int top, int bottom) {
+    uint32_t clrGreen = renderColor(0x00, 0xFF, 0x00, 0xFF);
+    uint32_t clrRed   = renderColor(0xFF, 0x00, 0x00, 0xFF);
+    uint32_t clrBlue  = renderColor(0x00, 0x00, 0xFF, 0xFF);
+    uint32_t clrIced  = renderColor(0xFB, 0xFC, 0xFC, 0xFF);
+    uint32_t clrLink  = renderColor(0xFF, 0xF4, 0xD2, 0xFF);
+
+    //Layout already did the wrapping, each row goes out as is
+    uint32_t lineColors[] = { clrIced, clrGreen, clrRed, clrBlue, clrLink, clrIced };
+    int lastLine;
+    int firstLine = layoutVisibleLines(layout, top, bottom, &lastLine);
+    for (int i = firstLine; i < lastLine; i++ ) {
+        const Line* line = &lines[i];
+        const LineStyle* style = lineStyle(line->type);
+        int height = rowHeight(line->type);
+        int x = line->type == LINE_PRE ? 6 - browser->preScroll : 6;
+        int y = layout->offsets[i] + style->top;
+        for (int row = layout->firstRows[i]; row < layout->firstRows[i + 1]; row++, y += height) {
+            //A preview can be ahead of the text cache, rows past what it holds aren't drawn yet
+            if (y + height > top && y < bottom && row < browser->buttonTextBase) {
+                textCacheDraw(&browser->text, row, x, y - top, 0, style->scale, lineColors[line->type], 0);
+            }
+        }
+    }
+}
+
+static void paintPageTile(void* user, int top, int bottom) {
+    Browser* browser = user;
+    drawPageRows(browser, browser->doc.lines, &browser->layout, top, bottom);
+}
+
+static void drawPage(Browser* browser, const Line* lines, const PageLayout* layout, int tiled) {
+    if (browser->text.generation != browser->generation) {
+        buildTextCache(browser, lines, layout);
+    }
+
+    int top = -6 - browser->scroll;
+    if (!tiled || tileCacheDraw(&browser->tiles, browser->generation, top, TOP_SCREEN_HEIGHT, paintPageTile, browser) != 0) {
+        drawPageRows(browser, lines, layout, top, top + TOP_SCREEN_HEIGHT);
+    }
+}
+
+void browserDrawPage(Browser* browser) {
+    //While loading, show the new page as soon as it has lines until the first screen is full
+    const PageSnapshot* preview = browser->loading != NULL ? fetchJobSnapshot(browser->loading) : NULL;
+    if (preview != NULL && preview->layout.lineCount > 0) {
+        if (preview->layout.lineCount != browser->loadingLines &&
+            preview->layout.offsets[browser->loadingLines] < TOP_SCREEN_HEIGHT - browser->scroll) {
+            if (browser->loadingLines == 0) {
+                browser->scroll = 0;
+            }
+            browser->loadingLines = preview->layout.lineCount;
+            browser->generation++;
+        }
+        drawPage(browser, preview->lines, &preview->layout, 0);
+    } else {
+        drawPage(browser, browser->doc.lines, &browser->layout, 1);
+    }
+}
+
+static void drawButtonAt(Browser* browser, int x, int y, int z, int w, int h, int padding, uint32_t background, uint32_t border, uint32_t color, int slot) {
+    Renderer* renderer = browser->renderer;
+    renderer->drawRect(renderer->ctx, x, y, z - 1, w, h, border);
+    renderer->drawRect(renderer->ctx, x+(padding / 2), y + (padding / 2), z, w-padding, h-padding, background);
+    float scale = 0.8;
+    textCacheDraw(&browser->text, slot, x + padding, y + ( (1-scale) * padding ), z, scale, color, 0);
+}
+
+static void drawStatus(Browser* browser, const char* text) {
+    uint32_t clrWhite = renderColor(0xFF, 0xFF, 0xFF, 0xFF);
+    uint32_t clrClear = renderColor(0x04, 0x0D, 0x13, 0xFF);
+
+    TextCache* cache = &browser->statusCache;
+    if (strcmp(text, browser->statusText) != 0 || cache->count == 0) {
+        snprintf(browser->statusText, sizeof browser->statusText, "%s", text);
+        textCacheReset(cache, cache->generation + 1, 1, strlen(browser->statusText));
+        textCacheAdd(cache, browser->statusText, strlen(browser->statusText));
+    }
+    int y = BOTTOM_SCREEN_HEIGHT - BOTTOM_SCREEN_HEIGHT / 10;
+    cache->renderer->drawRect(cache->renderer->ctx, 0, y, 1, BOTTOM_SCREEN_WIDTH, BOTTOM_SCREEN_HEIGHT / 10, clrClear);
+    textCacheDraw(cache, 0, 6, y + 2, 2, 0.6, clrWhite, 0);
+}
+
+void browserDrawControls(Browser* browser) {
+    uint32_t clrWhite = renderColor(0xFF, 0xFF, 0xFF, 0xFF);
+    uint32_t clrClear = renderColor(0x04, 0x0D, 0x13, 0xFF);
+    uint32_t clrLink  = renderColor(0xFF, 0xF4, 0xD2, 0xFF);
+
+    //Only the links in view are drawn, the fixed buttons go over any that are scrolled up under them
+    int lastSlot;
+    int top = browser->linkScroll;
+    int firstSlot = linkTableVisible(&browser->links, top, top + BOTTOM_SCREEN_HEIGHT - LINK_LIST_TOP, &lastSlot);
+    for (int i = firstSlot; i < lastSlot; i++) {
+        const LinkSlot* slot = &browser->links.slots[i];
+        drawButtonAt(browser, 0, LINK_LIST_TOP + slot->y - top, 0, BOTTOM_SCREEN_WIDTH, slot->height, 6, clrClear, clrWhite, clrLink, browser->linkTextBase + i);
+    }
+    for (int i = 0; i < FIXED_BUTTONS; i++) {
+        const UiButton* button = browser->buttons[i];
+        drawButtonAt(browser, button->x, button->y, button->z, button->w, button->h, button->padding, button->background, button->border, button->color, browser->buttonTextBase + i);
+    }
+
+    if (browser->loading != NULL) {
+        const char* phases[] = { "Waiting", "Looking up", "Connecting", "Shaking hands", "Loading", "Saving", "Done" };
+        char status[64];
+        snprintf(status, sizeof status, "%s... %u KB (B to stop)", phases[fetchJobPhase(browser->loading)], (unsigned int)(fetchJobBytes(browser->loading) / 1024));
+        drawStatus(browser, status);
+    } else if (browser->statusFrames > 0) {
+        drawStatus(browser, browser->statusMessage);
+        browser->statusFrames--;
+    }
+}
+
+void browserAct(Browser* browser) {
+    if (browser->action == ACTION_NEW_PAGE) {
+        if (browser->hooks.keyboard == NULL || browser->hooks.keyboard(browser->hooks.user, "Enter a URL", browser->typed, sizeof browser->typed) != 0) {
+            return;
+        }
+        //Typing the scheme is optional
+        char typed[sizeof browser->typed + 16];
+        char url[URL_MAX];
+        snprintf(typed, sizeof typed, "%s%s", strstr(browser->typed, "://") != NULL ? "" : "gemini://", browser->typed);
+        if (urlNormalize(typed, url, sizeof url) < 0) {
+            browserShowStatus(browser, "That isn't a valid url");
+        } else {
+            browserNavigate(browser, url);
+        }
+    } else if (browser->action == ACTION_OPEN_LINK) {
+        //Links are relative to the page they are on
+        const Link* link = &browser->doc.links[browser->hitLink];
+        Url base, ref;
+        char url[URL_MAX];
+        if (urlParse(browser->key, strlen(browser->key), &base) != 0 ||
+            urlParse(link->path, link->pathLength, &ref) != 0 ||
+            urlResolve(&base, &ref, url, sizeof url) < 0) {
+            browserShowStatus(browser, "That link isn't a valid url");
+        } else {
+            browserNavigate(browser, url);
+        }
+    } else if (browser->action == ACTION_PAGE_BACK) {
+        stepHistory(browser, -1);
+    } else if (browser->action == ACTION_PAGE_FORW) {
+        stepHistory(browser, 1);
+    } else if (browser->action == ACTION_RELOAD && strncmp(browser->key, "about:", 6) == 0) {
+        showAbout(browser, browser->key, 1);
+    } else if (browser->action == ACTION_RELOAD) {
+        char url[PAGE_URL_SIZE];
+        memcpy(url, browser->key, sizeof url);
+        openPage(browser, url, 0, 1);
+    }
+    browser->action = ACTION_NONE;
+}
+
+void browserStop(Browser* browser) {
+    stopLoading(browser);
+    prefetchCancel(&browser->prefetcher);
+}
+
+void browserFree(Browser* browser) {
+    freeDocument(&browser->doc);
+    pageCacheFree(&browser->pages);
+    linkTableFree(&browser->links);
+    tileCacheFree(&browser->tiles);
+    textCacheFree(&browser->text);
+    textCacheFree(&browser->statusCache);
+}
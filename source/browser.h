@@ -0,0 +1,178 @@
+#ifndef BROWSER_H
+#define BROWSER_H
+
+#include <stdint.h>
+
+#include "fetch.h"
+#include "gemtext.h"
+#include "history.h"
+#include "layout.h"
+#include "linktable.h"
+#include "pagecache.h"
+#include "prefetch.h"
+#include "redirects.h"
+#include "render.h"
+#include "session.h"
+#include "textcache.h"
+#include "tilecache.h"
+
+#define TOP_SCREEN_WIDTH 400
+#define TOP_SCREEN_HEIGHT 240
+#define BOTTOM_SCREEN_WIDTH 320
+#define BOTTOM_SCREEN_HEIGHT 240
+
+//The buttons as hid reports them, sessions store them like this too
+#define BUTTON_A (1u << 0)
+#define BUTTON_B (1u << 1)
+#define BUTTON_SELECT (1u << 2)
+#define BUTTON_START (1u << 3)
+#define BUTTON_DRIGHT (1u << 4)
+#define BUTTON_DLEFT (1u << 5)
+#define BUTTON_DUP (1u << 6)
+#define BUTTON_DDOWN (1u << 7)
+#define BUTTON_R (1u << 8)
+#define BUTTON_L (1u << 9)
+#define BUTTON_X (1u << 10)
+#define BUTTON_Y (1u << 11)
+#define BUTTON_TOUCH (1u << 20)
+#define BUTTON_CPAD_RIGHT (1u << 28)
+#define BUTTON_CPAD_LEFT (1u << 29)
+#define BUTTON_CPAD_UP (1u << 30)
+#define BUTTON_CPAD_DOWN (1u << 31)
+//Either the d-pad or the circle pad
+#define BUTTON_UP (BUTTON_DUP | BUTTON_CPAD_UP)
+#define BUTTON_DOWN (BUTTON_DDOWN | BUTTON_CPAD_DOWN)
+#define BUTTON_LEFT (BUTTON_DLEFT | BUTTON_CPAD_LEFT)
+#define BUTTON_RIGHT (BUTTON_DRIGHT | BUTTON_CPAD_RIGHT)
+
+//The back, forward and url buttons along the top, the page's links listed below them
+#define FIXED_BUTTONS 3
+#define LINK_LIST_TOP 20
+#define LINK_ROW_HEIGHT (BOTTOM_SCREEN_HEIGHT / 10)
+
+//Pages we navigated away from stay in memory up to this many bytes. Packed they
+//take a fraction of that, coming back costs a parse and layout instead of nothing.
+#define PAGE_CACHE_BUDGET (2 * 1024 * 1024)
+#define PAGE_CACHE_COMPRESS 1
+#define WELCOME_URL "about:welcome"
+
+//Prefetching is off until SELECT turns it on
+#define PREFETCH_LINKS 8
+#define PREFETCH_IN_FLIGHT 2
+#define PREFETCH_BUDGET (256 * 1024)
+
+#define PAGE_TILE_HEIGHT 128
+#define STATUS_FRAMES 120
+
+enum Action {
+    ACTION_NONE,
+    ACTION_NEW_PAGE,
+    ACTION_OPEN_LINK,
+    ACTION_PAGE_BACK,
+    ACTION_PAGE_FORW,
+    ACTION_RELOAD,
+};
+
+typedef struct {
+    int x;
+    int y;
+    int z;
+    int w;
+    int h;
+    int padding;
+    uint32_t background;
+    uint32_t border;
+    uint32_t color;
+    char text[65];
+    enum Action action;
+} UiButton;
+
+typedef struct Browser Browser;
+
+//What the browser needs from the app around it
+typedef struct {
+    void* user;
+    //Asks the user for a line of text, -1 if nothing was typed
+    int (*keyboard)(void* user, const char* prompt, char* out, size_t size);
+    //Shows an about: page other than the welcome page with browserShowText,
+    //-1 if there is no such page. reload is set when Y was pressed on it.
+    int (*about)(void* user, Browser* browser, const char* url, int reload);
+} BrowserHooks;
+
+//The page on screen, the history and caches behind it and the controls on
+//the bottom screen. The app feeds it a frame of input at a time and it only
+//draws through the renderers it was given, so the same frames run on the
+//3DS and headless on a PC. Pages load on the fetcher's worker, the browser
+//only submits jobs and picks up the results.
+struct Browser {
+    Renderer* renderer;
+    BrowserHooks hooks;
+    Fetcher* fetcher;
+    RedirectMap* redirects;     //NULL if every redirect is asked for
+    const char* redirectsFile;  //Saved to after a page comes in, NULL for never
+    const char* downloadDir;    //Anything that isn't gemtext is saved here, NULL refuses it
+
+    Document doc;
+    PageLayout layout;
+    char key[PAGE_URL_SIZE];
+    int cacheable;
+    int certChanged;    //The page on screen is the warning about a changed certificate
+    int scroll;
+    int preScroll;      //Sideways, preformatted lines only
+    unsigned int generation;
+    PageCache pages;
+    History history;
+    Prefetcher prefetcher;
+
+    FetchJob* loading;
+    int loadingLines;   //Lines of the loading page shown so far
+    int loadingStep;    //-1 or 1 when the load is a back or forward step that missed the cache
+    int leavingScroll;  //Where the page on screen was scrolled to before the preview took over
+
+    //The page is kept in tiles so scrolling only blits them. The preview of a
+    //loading page changes every few frames and is drawn directly instead.
+    TextCache text;
+    TileCache tiles;
+    int buttonTextBase;
+    int linkTextBase;
+    UiButton backButton;
+    UiButton forwardButton;
+    UiButton urlButton;
+    const UiButton* buttons[FIXED_BUTTONS];
+    LinkTable links;
+    int linkScroll;
+
+    //Status line on the bottom screen, its text gets its own small cache
+    TextCache statusCache;
+    char statusText[64];
+    char statusMessage[64];
+    int statusFrames;   //How much longer statusMessage stays on the status line
+
+    //Picked up by browserInput, carried out by browserAct
+    enum Action action;
+    int hitLink;        //Index into doc.links for ACTION_OPEN_LINK
+    uint32_t kDown;
+    char typed[1024];
+};
+
+//statusRenderer only needs a text pool of its own, it can draw to the same screen.
+//Starts on the welcome page.
+void browserInit(Browser* browser, Renderer* renderer, Renderer* statusRenderer, Fetcher* fetcher, const BrowserHooks* hooks);
+void browserShowStatus(Browser* browser, const char* message);
+//Parses text and shows it as the page at url
+void browserShowText(Browser* browser, const char* url, const char* text, int cacheable, int scroll);
+//Goes to a canonical url, about: pages go to the hook
+void browserNavigate(Browser* browser, const char* url);
+//Picks up finished pages and acts on the buttons held and the touch screen
+void browserInput(Browser* browser, const SessionInput* input);
+//The page, or the preview of the one loading, on the top screen
+void browserDrawPage(Browser* browser);
+//Links, buttons and the status line on the bottom screen
+void browserDrawControls(Browser* browser);
+//Navigation happens between frames, the keyboard can't come up mid-frame
+void browserAct(Browser* browser);
+//Cancels loading and prefetching, before the fetcher is stopped
+void browserStop(Browser* browser);
+void browserFree(Browser* browser);
+
+#endif
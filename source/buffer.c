@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "memstats.h"
+
+#define BUFFER_MIN_CAPACITY 256
+
+void bufferInit(Buffer* buffer, int account) {
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->account = account;
+}
+
+int bufferReserve(Buffer* buffer, size_t capacity) {
+    //One extra byte for the terminator
+    if (capacity + 1 <= buffer->capacity) {
+        return 0;
+    }
+    size_t grown = buffer->capacity < BUFFER_MIN_CAPACITY ? BUFFER_MIN_CAPACITY : buffer->capacity;
+    while (grown < capacity + 1) {
+        grown *= 2;
+    }
+    char* data = realloc(buffer->data, grown);
+    if (data == NULL) {
+        return -1;
+    }
+    memCharge(buffer->account, grown - buffer->capacity);
+    buffer->data = data;
+    buffer->capacity = grown;
+    buffer->data[buffer->length] = '\0';
+    return 0;
+}
+
+int bufferAppend(Buffer* buffer, const char* data, size_t len) {
+    if (bufferReserve(buffer, buffer->length + len) != 0) {
+        return -1;
+    }
+    memcpy(buffer->data + buffer->length, data, len);
+    buffer->length += len;
+    buffer->data[buffer->length] = '\0';
+    return 0;
+}
+
+int bufferSet(Buffer* buffer, const char* str) {
+    bufferClear(buffer);
+    return bufferAppend(buffer, str, strlen(str));
+}
+
+void bufferClear(Buffer* buffer) {
+    buffer->length = 0;
+    if (buffer->data != NULL) {
+        buffer->data[0] = '\0';
+    }
+}
+
+void bufferFree(Buffer* buffer) {
+    memRelease(buffer->account, buffer->capacity);
+    free(buffer->data);
+    bufferInit(buffer, buffer->account);
+}
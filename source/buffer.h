@@ -0,0 +1,21 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stddef.h>
+
+//Growable byte buffer, data is always kept null terminated
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int account;    //MemAccount the data is charged to
+} Buffer;
+
+void bufferInit(Buffer* buffer, int account);
+int bufferReserve(Buffer* buffer, size_t capacity);
+int bufferAppend(Buffer* buffer, const char* data, size_t len);
+int bufferSet(Buffer* buffer, const char* str);
+void bufferClear(Buffer* buffer);
+void bufferFree(Buffer* buffer);
+
+#endif
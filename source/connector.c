@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+
+#include "connector.h"
+#include "platform.h"
+
+//Starts a non-blocking connect, returns the socket or -1 if it failed straight away
+static int startConnect(const DnsAddress* address, int port) {
+    DnsAddress target = *address;
+    //sin_port and sin6_port sit at the same offset, this covers both families
+    ((struct sockaddr_in*)&target.addr)->sin_port = htons(port);
+
+    int fd = socket(target.addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        return -1;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&target.addr, target.length) != 0 && errno != EINPROGRESS) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int connected(int fd) {
+    int error = 0;
+    socklen_t length = sizeof error;
+    return getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+}
+
+int connectRace(const DnsAddress* addresses, int count, int port, int staggerMs, int timeoutMs,
+                const volatile int* cancel, int* fd, ConnectStats* stats) {
+    struct pollfd fds[DNS_MAX_ADDRESSES];
+    int owners[DNS_MAX_ADDRESSES];
+    int open = 0;
+    int next = 0;
+    int result = CONNECT_FAILED;
+    uint64_t start = platformTimeUs();
+    uint64_t deadline = start + (uint64_t)timeoutMs * 1000;
+    uint64_t nextStart = start;
+
+    if (count > DNS_MAX_ADDRESSES) {
+        count = DNS_MAX_ADDRESSES;
+    }
+    memset(stats, 0, sizeof *stats);
+    stats->winner = -1;
+    *fd = -1;
+
+    for (;;) {
+        uint64_t now = platformTimeUs();
+        //The next address gets its turn once the stagger is up, or right away if nothing else is still trying
+        if (next < count && (now >= nextStart || open == 0)) {
+            int attempt = startConnect(&addresses[next], port);
+            stats->attempts++;
+            if (attempt >= 0) {
+                fds[open].fd = attempt;
+                fds[open].events = POLLOUT;
+                fds[open].revents = 0;
+                owners[open++] = next;
+            } else {
+                stats->failed++;
+            }
+            next++;
+            nextStart = now + (uint64_t)staggerMs * 1000;
+            continue;
+        }
+        if (open == 0) {
+            break;
+        }
+        if (cancel != NULL && *cancel) {
+            result = CONNECT_CANCELLED;
+            break;
+        }
+        if (now >= deadline) {
+            result = CONNECT_TIMED_OUT;
+            break;
+        }
+
+        uint64_t wake = now + CONNECT_POLL_MS * 1000;
+        if (next < count && nextStart < wake) {
+            wake = nextStart;
+        }
+        if (deadline < wake) {
+            wake = deadline;
+        }
+        if (poll(fds, open, (int)((wake - now + 999) / 1000)) <= 0) {
+            continue;
+        }
+
+        //Failed attempts drop out, the first one through wins
+        for (int i = 0; i < open && *fd < 0; ) {
+            if (fds[i].revents == 0) {
+                i++;
+            } else if (connected(fds[i].fd)) {
+                *fd = fds[i].fd;
+                stats->winner = owners[i];
+                fds[i] = fds[--open];
+                owners[i] = owners[open];
+            } else {
+                close(fds[i].fd);
+                stats->failed++;
+                fds[i] = fds[--open];
+                owners[i] = owners[open];
+            }
+        }
+        if (*fd >= 0) {
+            result = CONNECT_OK;
+            break;
+        }
+    }
+
+    for (int i = 0; i < open; i++) {
+        close(fds[i].fd);
+    }
+    if (*fd >= 0) {
+        int flags = fcntl(*fd, F_GETFL, 0);
+        fcntl(*fd, F_SETFL, flags & ~O_NONBLOCK);
+    }
+    stats->us = platformTimeUs() - start;
+    return result;
+}
@@ -0,0 +1,36 @@
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include <stdint.h>
+
+#include "dnscache.h"
+
+//How long an address gets on its own before the next one is tried alongside it
+#define CONNECT_STAGGER_MS 250
+#define CONNECT_TIMEOUT_MS 10000
+//Waits wake up this often to check whether the request was cancelled
+#define CONNECT_POLL_MS 250
+
+enum ConnectResult {
+    CONNECT_OK = 0,
+    CONNECT_FAILED = -1,
+    CONNECT_TIMED_OUT = -2,
+    CONNECT_CANCELLED = -3,
+};
+
+typedef struct {
+    int attempts;   //Addresses a connect was started to
+    int failed;     //Of those, how many were refused or errored
+    int winner;     //Index of the address that connected, -1 if none did
+    uint64_t us;    //Time from the first connect to the result
+} ConnectStats;
+
+//Connects to the first of the addresses that answers, happy eyeballs style
+//(RFC 8305): the first address is tried on its own, each following one is
+//started after staggerMs, or as soon as the ones before it have all failed.
+//A dead address costs at most the stagger instead of a full TCP timeout.
+//On CONNECT_OK *fd is a connected, blocking socket and every other attempt is closed.
+int connectRace(const DnsAddress* addresses, int count, int port, int staggerMs, int timeoutMs,
+                const volatile int* cancel, int* fd, ConnectStats* stats);
+
+#endif
@@ -0,0 +1,588 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "diskcache.h"
+#include "memstats.h"
+
+#define DATA_MAGIC 0x31444347     //"GCD1"
+#define INDEX_MAGIC 0x31494347    //"GCI1"
+#define RECORD_MAGIC 0x31524347   //"GCR1"
+#define DISK_CACHE_VERSION 2
+#define DISK_CACHE_MIN_SLOTS 256
+//Compaction starts once this much of the data file is garbage and garbage outweighs live records
+#define DISK_CACHE_COMPACT_MIN (256 * 1024)
+#define CHECKSUM_INIT 2166136261u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t generation;
+    uint32_t reserved;
+} DataFileHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t generation;
+    uint32_t dataSize;  //How much of data.bin the slots below cover
+    uint32_t count;
+    uint32_t checksum;  //Of the slots
+} IndexFileHeader;
+
+//FNV-1a, only has to catch torn and corrupted writes
+static uint32_t checksumUpdate(uint32_t sum, const void* data, size_t len) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        sum = (sum ^ bytes[i]) * 16777619u;
+    }
+    return sum;
+}
+
+static uint64_t hashUrl(const char* url) {
+    uint64_t hash = 14695981039346656037ull;
+    for (; *url; url++) {
+        hash = (hash ^ (unsigned char)*url) * 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static uint32_t now() {
+    return (uint32_t)time(NULL);
+}
+
+static void cachePath(char* out, size_t size, const DiskCache* cache, const char* name) {
+    snprintf(out, size, "%s/%s", cache->dir, name);
+}
+
+static uint32_t fileLength(FILE* file) {
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+    long length = ftell(file);
+    return length > 0 ? (uint32_t)length : 0;
+}
+
+static int findSlot(const DiskCache* cache, uint64_t hash) {
+    if (cache->capacity == 0) {
+        return -1;
+    }
+    int mask = cache->capacity - 1;
+    for (int i = hash & mask; cache->slots[i].hash != 0; i = (i + 1) & mask) {
+        if (cache->slots[i].hash == hash) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//Backward shift deletion, later entries of the probe chain move into the gap
+//so lookups never have to step over tombstones
+static void removeSlot(DiskCache* cache, int i) {
+    int mask = cache->capacity - 1;
+    cache->liveBytes -= cache->slots[i].length;
+    cache->count--;
+    for (int j = (i + 1) & mask; cache->slots[j].hash != 0; j = (j + 1) & mask) {
+        int home = cache->slots[j].hash & mask;
+        //The entry at j has to stay put if its home is cyclically in (i, j]
+        int stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            cache->slots[i] = cache->slots[j];
+            i = j;
+        }
+    }
+    cache->slots[i].hash = 0;
+}
+
+static void placeSlot(DiskCacheSlot* slots, int capacity, const DiskCacheSlot* slot) {
+    int mask = capacity - 1;
+    int i = slot->hash & mask;
+    while (slots[i].hash != 0) {
+        i = (i + 1) & mask;
+    }
+    slots[i] = *slot;
+}
+
+static int growSlots(DiskCache* cache) {
+    int capacity = cache->capacity ? cache->capacity * 2 : DISK_CACHE_MIN_SLOTS;
+    DiskCacheSlot* slots = memCalloc(MEM_CACHE, capacity, sizeof *slots);
+    if (slots == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < cache->capacity; i++) {
+        if (cache->slots[i].hash != 0) {
+            placeSlot(slots, capacity, &cache->slots[i]);
+        }
+    }
+    memFree(cache->slots);
+    cache->slots = slots;
+    cache->capacity = capacity;
+    return 0;
+}
+
+//Replaces any slot with the same hash
+static int insertSlot(DiskCache* cache, const DiskCacheSlot* slot) {
+    int existing = findSlot(cache, slot->hash);
+    if (existing >= 0) {
+        removeSlot(cache, existing);
+    }
+    if ((cache->count + 1) * 4 > cache->capacity * 3 && growSlots(cache) != 0) {
+        return -1;
+    }
+    placeSlot(cache->slots, cache->capacity, slot);
+    cache->count++;
+    cache->liveBytes += slot->length;
+    return 0;
+}
+
+static void evictOldest(DiskCache* cache, uint64_t keep) {
+    while (cache->liveBytes > cache->maxBytes) {
+        int oldest = -1;
+        for (int i = 0; i < cache->capacity; i++) {
+            DiskCacheSlot* slot = &cache->slots[i];
+            if (slot->hash != 0 && slot->hash != keep && (oldest < 0 || slot->time < cache->slots[oldest].time)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) {
+            return;
+        }
+        removeSlot(cache, oldest);
+    }
+}
+
+//Reads the record at offset in one go and checks it, returns a malloc'd copy
+//(with an extra terminator after the body) or NULL if it isn't a good record
+static char* readRecord(FILE* file, uint32_t offset, uint32_t limit, uint32_t* length) {
+    DiskRecordHeader header;
+    if ((uint64_t)offset + sizeof header > limit || fseek(file, offset, SEEK_SET) != 0 || fread(&header, sizeof header, 1, file) != 1) {
+        return NULL;
+    }
+    if (header.magic != RECORD_MAGIC || header.urlLength == 0 || header.metaLength == 0) {
+        return NULL;
+    }
+    uint64_t total = sizeof header + (uint64_t)header.urlLength + header.metaLength + header.bodyLength;
+    if (offset + total > limit) {
+        return NULL;
+    }
+
+    char* record = memAlloc(MEM_NETWORK, total + 1);
+    if (record == NULL) {
+        return NULL;
+    }
+    memcpy(record, &header, sizeof header);
+    size_t offsetOfTime = offsetof(DiskRecordHeader, time);
+    char* url = record + sizeof header;
+    char* meta = url + header.urlLength;
+    if (fread(url, total - sizeof header, 1, file) != 1 ||
+        checksumUpdate(CHECKSUM_INIT, record + offsetOfTime, total - offsetOfTime) != header.checksum ||
+        url[header.urlLength - 1] != '\0' || meta[header.metaLength - 1] != '\0') {
+        memFree(record);
+        return NULL;
+    }
+    record[total] = '\0';
+    *length = total;
+    return record;
+}
+
+//Index every good record from `from` on, later records replace earlier ones for the same url
+static void scanRecords(DiskCache* cache, uint32_t from, uint32_t fileSize) {
+    uint32_t length;
+    char* record;
+    while ((record = readRecord(cache->data, from, fileSize, &length)) != NULL) {
+        DiskRecordHeader* header = (DiskRecordHeader*)record;
+        DiskCacheSlot slot = { hashUrl(record + sizeof *header), from, length, header->time, DISK_CACHE_NOT_MOVED };
+        insertSlot(cache, &slot);
+        memFree(record);
+        from += length;
+    }
+    cache->dataSize = from;
+
+    //Anything after the last good record is a torn write, cut it off so the next record goes right after
+    if (fileSize > from) {
+        fflush(cache->data);
+        ftruncate(fileno(cache->data), from);
+    }
+    evictOldest(cache, 0);
+}
+
+//Returns how much of the data file the index covered, scanning picks up from there
+static uint32_t loadIndex(DiskCache* cache, uint32_t fileSize) {
+    char path[300];
+    cachePath(path, sizeof path, cache, "index.bin");
+    uint32_t covered = sizeof(DataFileHeader);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return covered;
+    }
+
+    IndexFileHeader header;
+    DiskCacheSlot* slots = NULL;
+    if (fread(&header, sizeof header, 1, file) == 1 &&
+        header.magic == INDEX_MAGIC && header.version == DISK_CACHE_VERSION &&
+        header.generation == cache->generation &&
+        header.dataSize >= covered && header.dataSize <= fileSize &&
+        (slots = memAlloc(MEM_NETWORK, header.count * sizeof *slots + 1)) != NULL &&
+        fread(slots, sizeof *slots, header.count, file) == header.count &&
+        checksumUpdate(CHECKSUM_INIT, slots, header.count * sizeof *slots) == header.checksum) {
+        for (uint32_t i = 0; i < header.count; i++) {
+            slots[i].moved = DISK_CACHE_NOT_MOVED;
+            insertSlot(cache, &slots[i]);
+        }
+        covered = header.dataSize;
+    }
+    memFree(slots);
+    fclose(file);
+    return covered;
+}
+
+//Written next to the old index and renamed over it, so a crash leaves one or the other
+static void saveIndex(DiskCache* cache) {
+    char path[300];
+    char temp[300];
+    cachePath(path, sizeof path, cache, "index.bin");
+    cachePath(temp, sizeof temp, cache, "index.tmp");
+    FILE* file = fopen(temp, "wb");
+    if (file == NULL) {
+        return;
+    }
+
+    IndexFileHeader header = { INDEX_MAGIC, DISK_CACHE_VERSION, cache->generation, cache->dataSize, 0, CHECKSUM_INIT };
+    fwrite(&header, sizeof header, 1, file);
+    for (int i = 0; i < cache->capacity; i++) {
+        if (cache->slots[i].hash != 0) {
+            fwrite(&cache->slots[i], sizeof cache->slots[i], 1, file);
+            header.checksum = checksumUpdate(header.checksum, &cache->slots[i], sizeof cache->slots[i]);
+            header.count++;
+        }
+    }
+    rewind(file);
+    fwrite(&header, sizeof header, 1, file);
+
+    int failed = ferror(file);
+    failed |= fclose(file);
+    if (failed) {
+        remove(temp);
+        return;
+    }
+    remove(path);
+    rename(temp, path);
+}
+
+//Start over with an empty data file, used when the old one can't be trusted
+static int resetData(DiskCache* cache) {
+    char path[300];
+    cachePath(path, sizeof path, cache, "data.bin");
+    if (cache->data != NULL) {
+        fclose(cache->data);
+    }
+    if (cache->slots != NULL) {
+        memset(cache->slots, 0, cache->capacity * sizeof *cache->slots);
+    }
+    cache->count = 0;
+    cache->liveBytes = 0;
+    cache->dataSize = sizeof(DataFileHeader);
+
+    //A fresh generation keeps an index left over from an older data file from matching
+    DataFileHeader header = { DATA_MAGIC, DISK_CACHE_VERSION, now(), 0 };
+    cache->generation = header.generation;
+    cache->data = fopen(path, "w+b");
+    if (cache->data == NULL) {
+        return -1;
+    }
+    if (fwrite(&header, sizeof header, 1, cache->data) != 1 || fflush(cache->data) != 0) {
+        fclose(cache->data);
+        cache->data = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void abandonCompaction(DiskCache* cache) {
+    char path[300];
+    cachePath(path, sizeof path, cache, "data.new");
+    fclose(cache->compacted);
+    cache->compacted = NULL;
+    remove(path);
+}
+
+int diskCacheOpen(DiskCache* cache, const char* dir, uint32_t maxBytes, uint32_t maxAge, int compress) {
+    memset(cache, 0, sizeof *cache);
+    snprintf(cache->dir, sizeof cache->dir, "%s", dir);
+    cache->maxBytes = maxBytes;
+    cache->maxAge = maxAge;
+    cache->compress = compress;
+
+    char path[300];
+    char spare[300];
+    cachePath(path, sizeof path, cache, "data.bin");
+    cachePath(spare, sizeof spare, cache, "data.new");
+
+    //A crash between removing the old data file and renaming the compacted one
+    //leaves only the compacted one, otherwise it is an unfinished compaction
+    FILE* existing = fopen(path, "rb");
+    if (existing != NULL) {
+        fclose(existing);
+    } else {
+        rename(spare, path);
+    }
+    remove(spare);
+
+    DataFileHeader header;
+    cache->data = fopen(path, "r+b");
+    if (cache->data == NULL || fread(&header, sizeof header, 1, cache->data) != 1 ||
+        header.magic != DATA_MAGIC || header.version != DISK_CACHE_VERSION) {
+        return resetData(cache);
+    }
+    cache->generation = header.generation;
+
+    uint32_t fileSize = fileLength(cache->data);
+    scanRecords(cache, loadIndex(cache, fileSize), fileSize);
+    return 0;
+}
+
+int diskCacheGet(DiskCache* cache, const char* url, DiskCacheEntry* entry) {
+    memset(entry, 0, sizeof *entry);
+    int i = cache->data != NULL ? findSlot(cache, hashUrl(url)) : -1;
+    if (i < 0) {
+        cache->misses++;
+        return -1;
+    }
+    if (cache->slots[i].time + cache->maxAge < now()) {
+        removeSlot(cache, i);
+        cache->misses++;
+        return -1;
+    }
+
+    uint32_t length;
+    char* record = readRecord(cache->data, cache->slots[i].offset, cache->dataSize, &length);
+    if (record == NULL) {
+        removeSlot(cache, i);
+        cache->misses++;
+        return -1;
+    }
+    DiskRecordHeader* header = (DiskRecordHeader*)record;
+    const char* recordUrl = record + sizeof *header;
+    //Another url with the same hash
+    if (strcmp(recordUrl, url) != 0) {
+        memFree(record);
+        cache->misses++;
+        return -1;
+    }
+
+    entry->record = record;
+    entry->status = header->status;
+    entry->meta = recordUrl + header->urlLength;
+    entry->body = entry->meta + header->metaLength;
+    entry->bodyLength = header->bodyLength;
+    entry->unpackedLength = header->unpackedLength;
+    cache->hits++;
+    return 0;
+}
+
+typedef struct {
+    LzSink sink;
+    void* user;
+    size_t length;
+} Unpacking;
+
+static void countUnpacked(void* user, const char* data, size_t len) {
+    Unpacking* unpacking = user;
+    unpacking->length += len;
+    unpacking->sink(unpacking->user, data, len);
+}
+
+int diskCacheEntryRead(const DiskCacheEntry* entry, LzSink sink, void* user) {
+    if (entry->unpackedLength == 0) {
+        sink(user, entry->body, entry->bodyLength);
+        return 0;
+    }
+    //The checksum only says the record is what was written, not that it unpacks
+    Unpacking unpacking = { sink, user, 0 };
+    if (lzDecode(entry->body, entry->bodyLength, countUnpacked, &unpacking) != 0) {
+        return -1;
+    }
+    return unpacking.length == entry->unpackedLength ? 0 : -1;
+}
+
+void diskCacheEntryFree(DiskCacheEntry* entry) {
+    memFree(entry->record);
+    entry->record = NULL;
+}
+
+//Appends one record and indexes it, body is what goes on the card whether packed or not
+static int writeRecord(DiskCache* cache, const char* url, size_t urlLength, int status, const char* meta, size_t metaLength,
+                       const char* body, size_t bodyLength, size_t unpackedLength) {
+    uint64_t total = sizeof(DiskRecordHeader) + urlLength + metaLength + bodyLength;
+    if (total > cache->maxBytes || cache->dataSize + total > UINT32_MAX) {
+        return -1;
+    }
+
+    DiskRecordHeader header = { RECORD_MAGIC, 0, now(), status, urlLength, metaLength, bodyLength, unpackedLength };
+    size_t offsetOfTime = offsetof(DiskRecordHeader, time);
+    uint32_t sum = checksumUpdate(CHECKSUM_INIT, (char*)&header + offsetOfTime, sizeof header - offsetOfTime);
+    sum = checksumUpdate(sum, url, urlLength);
+    sum = checksumUpdate(sum, meta, metaLength);
+    header.checksum = checksumUpdate(sum, body, bodyLength);
+
+    if (fseek(cache->data, cache->dataSize, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof header, 1, cache->data) != 1 ||
+        fwrite(url, 1, urlLength, cache->data) != urlLength ||
+        fwrite(meta, 1, metaLength, cache->data) != metaLength ||
+        (bodyLength > 0 && fwrite(body, 1, bodyLength, cache->data) != bodyLength) ||
+        fflush(cache->data) != 0) {
+        //Don't leave half a record for the next one to be appended after
+        ftruncate(fileno(cache->data), cache->dataSize);
+        return -1;
+    }
+
+    DiskCacheSlot slot = { hashUrl(url), cache->dataSize, total, header.time, DISK_CACHE_NOT_MOVED };
+    cache->dataSize += total;
+    insertSlot(cache, &slot);
+    evictOldest(cache, slot.hash);
+    return 0;
+}
+
+int diskCachePut(DiskCache* cache, const char* url, int status, const char* meta, const char* body, size_t bodyLength) {
+    size_t urlLength = strlen(url) + 1;
+    size_t metaLength = strlen(meta) + 1;
+    if (cache->data == NULL || urlLength > UINT16_MAX) {
+        return -1;
+    }
+
+    //Kept packed only if that is actually smaller
+    Buffer packed;
+    bufferInit(&packed, MEM_NETWORK);
+    size_t unpackedLength = 0;
+    if (cache->compress && bodyLength > 0 && lzCompress(body, bodyLength, &packed) == 0 && packed.length < bodyLength) {
+        unpackedLength = bodyLength;
+        body = packed.data;
+        bodyLength = packed.length;
+    }
+    int ret = writeRecord(cache, url, urlLength, status, meta, metaLength, body, bodyLength, unpackedLength);
+    bufferFree(&packed);
+    return ret;
+}
+
+void diskCacheRemove(DiskCache* cache, const char* url) {
+    int i = findSlot(cache, hashUrl(url));
+    if (i >= 0) {
+        removeSlot(cache, i);
+    }
+}
+
+static int wantsCompaction(const DiskCache* cache) {
+    uint32_t garbage = cache->dataSize - sizeof(DataFileHeader) - cache->liveBytes;
+    return cache->data != NULL && garbage >= DISK_CACHE_COMPACT_MIN && garbage > cache->liveBytes;
+}
+
+//Offset of the first indexed record after `offset`, or the end of the data.
+//Removes the slot of any record at offset itself.
+static uint32_t nextLiveRecord(DiskCache* cache, uint32_t offset) {
+    uint32_t next = cache->dataSize;
+    for (int i = 0; i < cache->capacity; i++) {
+        if (cache->slots[i].hash != 0 && cache->slots[i].offset == offset) {
+            removeSlot(cache, i);
+            i--;
+        } else if (cache->slots[i].hash != 0 && cache->slots[i].offset > offset && cache->slots[i].offset < next) {
+            next = cache->slots[i].offset;
+        }
+    }
+    return next;
+}
+
+int diskCacheCompactStep(DiskCache* cache, uint32_t budget) {
+    char path[300];
+    char spare[300];
+    cachePath(path, sizeof path, cache, "data.bin");
+    cachePath(spare, sizeof spare, cache, "data.new");
+
+    if (cache->compacted == NULL) {
+        if (!wantsCompaction(cache)) {
+            return 0;
+        }
+        cache->compacted = fopen(spare, "w+b");
+        if (cache->compacted == NULL) {
+            return 0;
+        }
+        DataFileHeader header = { DATA_MAGIC, DISK_CACHE_VERSION, cache->generation + 1, 0 };
+        if (fwrite(&header, sizeof header, 1, cache->compacted) != 1) {
+            abandonCompaction(cache);
+            return 0;
+        }
+        cache->compactCursor = sizeof header;
+        cache->compactSize = sizeof header;
+        for (int i = 0; i < cache->capacity; i++) {
+            cache->slots[i].moved = DISK_CACHE_NOT_MOVED;
+        }
+    }
+
+    //Walk the old file in order and copy the records the index still points at.
+    //Pages stored meanwhile are appended to the old file, so the walk gets to them too.
+    uint32_t scanned = 0;
+    while (scanned < budget && cache->compactCursor < cache->dataSize) {
+        uint32_t length;
+        char* record = readRecord(cache->data, cache->compactCursor, cache->dataSize, &length);
+        if (record == NULL) {
+            //A bad record has no length to trust, drop anything indexed there and
+            //carry on from the next record that is. What's between is garbage anyway.
+            uint32_t next = nextLiveRecord(cache, cache->compactCursor);
+            scanned += next - cache->compactCursor;
+            cache->compactCursor = next;
+            continue;
+        }
+        int i = findSlot(cache, hashUrl(record + sizeof(DiskRecordHeader)));
+        if (i >= 0 && cache->slots[i].offset == cache->compactCursor) {
+            if (fseek(cache->compacted, cache->compactSize, SEEK_SET) != 0 || fwrite(record, length, 1, cache->compacted) != 1) {
+                memFree(record);
+                abandonCompaction(cache);
+                return 0;
+            }
+            cache->slots[i].moved = cache->compactSize;
+            cache->compactSize += length;
+        }
+        memFree(record);
+        cache->compactCursor += length;
+        scanned += length;
+    }
+    if (cache->compactCursor < cache->dataSize) {
+        return 1;
+    }
+
+    //Everything live has been copied, swap the new file in
+    if (fflush(cache->compacted) != 0) {
+        abandonCompaction(cache);
+        return 0;
+    }
+    fclose(cache->compacted);
+    cache->compacted = NULL;
+    fclose(cache->data);
+    cache->data = NULL;
+    remove(path);
+    if (rename(spare, path) != 0 || (cache->data = fopen(path, "r+b")) == NULL) {
+        resetData(cache);
+        return 0;
+    }
+
+    for (int i = 0; i < cache->capacity; i++) {
+        cache->slots[i].offset = cache->slots[i].moved;
+    }
+    cache->generation++;
+    cache->dataSize = cache->compactSize;
+    saveIndex(cache);
+    return 0;
+}
+
+void diskCacheClose(DiskCache* cache) {
+    if (cache->compacted != NULL) {
+        abandonCompaction(cache);
+    }
+    if (cache->data != NULL) {
+        saveIndex(cache);
+        fclose(cache->data);
+    }
+    memFree(cache->slots);
+    memset(cache, 0, sizeof *cache);
+}
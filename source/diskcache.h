@@ -0,0 +1,95 @@
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lz.h"
+
+//Responses kept on the SD card so revisiting a capsule doesn't need the network.
+//
+//data.bin is a header followed by records appended back to back:
+//    DiskRecordHeader, url\0, meta\0, body
+//Replacing or evicting a page only drops it from the index, the old record
+//stays behind as garbage until compaction copies the live records into a
+//new file. A record counts only if it is complete and its checksum matches,
+//so a write cut short by a crash or power loss is thrown away on the next open.
+//
+//index.bin is the hash table at the time the cache was last closed, plus how
+//much of data.bin it covers. Anything past that is found by scanning the
+//tail of the data file, a missing or stale index means scanning all of it.
+//Everything is stored in native byte order. With compression on, bodies are
+//stored packed (see lz.h) whenever that makes them smaller.
+
+#define DISK_CACHE_NOT_MOVED 0xFFFFFFFF
+
+typedef struct {
+    uint32_t magic;
+    uint32_t checksum;  //Over the rest of the header and the payload
+    uint32_t time;
+    uint16_t status;
+    uint16_t urlLength; //All lengths include the terminator except the body's
+    uint32_t metaLength;
+    uint32_t bodyLength;
+    uint32_t unpackedLength;    //Of a packed body, 0 for one stored as is
+} DiskRecordHeader;
+
+typedef struct {
+    uint64_t hash;      //Of the url, 0 marks an empty slot
+    uint32_t offset;
+    uint32_t length;
+    uint32_t time;
+    uint32_t moved;     //Offset in the compacted file once copied there
+} DiskCacheSlot;
+
+//Only ever used from one thread, the fetch worker once it is running
+typedef struct {
+    char dir[256];
+    FILE* data;
+    uint32_t generation;    //Bumped by every compaction, ties the index to its data file
+    uint32_t dataSize;      //End of the last good record
+    uint32_t liveBytes;     //Bytes of records still in the index
+    uint32_t maxBytes;
+    uint32_t maxAge;        //Seconds
+    int compress;           //Pack the bodies of pages put from now on
+
+    DiskCacheSlot* slots;   //Open addressing, capacity is a power of two
+    int capacity;
+    int count;
+
+    FILE* compacted;        //Non NULL while a compaction is under way
+    uint32_t compactCursor; //Next record of data.bin to look at
+    uint32_t compactSize;
+
+    unsigned long hits;
+    unsigned long misses;
+} DiskCache;
+
+//A cached response, everything points into one buffer read with a single fread
+typedef struct {
+    char* record;
+    int status;
+    const char* meta;
+    const char* body;
+    size_t bodyLength;
+    size_t unpackedLength;  //0 if the body isn't packed
+} DiskCacheEntry;
+
+//dir must already exist
+int diskCacheOpen(DiskCache* cache, const char* dir, uint32_t maxBytes, uint32_t maxAge, int compress);
+//Returns 0 and fills in entry on a hit, free it with diskCacheEntryFree
+int diskCacheGet(DiskCache* cache, const char* url, DiskCacheEntry* entry);
+//Hands the body to sink, a packed one a window at a time as it is unpacked.
+//Returns -1 if a packed body turns out to be damaged partway.
+int diskCacheEntryRead(const DiskCacheEntry* entry, LzSink sink, void* user);
+void diskCacheEntryFree(DiskCacheEntry* entry);
+int diskCachePut(DiskCache* cache, const char* url, int status, const char* meta, const char* body, size_t bodyLength);
+//Forgets url, for a page that turned out to be unusable. Its record is garbage from then on.
+void diskCacheRemove(DiskCache* cache, const char* url);
+//Does up to `budget` bytes of compaction, starting one if enough of the data file
+//is garbage. Returns 1 while there is more to do.
+int diskCacheCompactStep(DiskCache* cache, uint32_t budget);
+//Writes the index out
+void diskCacheClose(DiskCache* cache);
+
+#endif
@@ -0,0 +1,152 @@
+#include <string.h>
+#include <strings.h>
+
+#include <netdb.h>
+#include <netinet/in.h>
+
+#include "dnscache.h"
+#include "platform.h"
+
+void dnsCacheInit(DnsCache* cache, DnsResolveFn resolve, void* resolveCtx) {
+    memset(cache, 0, sizeof *cache);
+    cache->resolve = resolve != NULL ? resolve : dnsSystemResolve;
+    cache->resolveCtx = resolveCtx;
+    cache->ttlUs = (uint64_t)DNS_TTL_MS * 1000;
+    cache->negativeTtlUs = (uint64_t)DNS_NEGATIVE_TTL_MS * 1000;
+}
+
+static DnsEntry* findEntry(DnsCache* cache, const char* host) {
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        DnsEntry* entry = &cache->entries[i];
+        if (entry->valid && strcasecmp(entry->host, host) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+//An empty entry if there is one, otherwise the least recently used
+static DnsEntry* freeEntry(DnsCache* cache) {
+    DnsEntry* oldest = &cache->entries[0];
+    for (int i = 0; i < DNS_CACHE_SIZE; i++) {
+        DnsEntry* entry = &cache->entries[i];
+        if (!entry->valid) {
+            return entry;
+        }
+        if (entry->lastUsed < oldest->lastUsed) {
+            oldest = entry;
+        }
+    }
+    return oldest;
+}
+
+//IPv6 first, then IPv4, then IPv6 again and so on (RFC 8305 4)
+static void interleave(DnsAddress* addresses, int count) {
+    DnsAddress sorted[DNS_MAX_ADDRESSES];
+    int used[DNS_MAX_ADDRESSES] = { 0 };
+    int family = AF_INET6;
+    for (int n = 0; n < count; n++) {
+        int pick = -1;
+        for (int i = 0; i < count && pick < 0; i++) {
+            if (!used[i] && addresses[i].addr.ss_family == family) {
+                pick = i;
+            }
+        }
+        for (int i = 0; i < count && pick < 0; i++) {
+            if (!used[i]) {
+                pick = i;
+            }
+        }
+        used[pick] = 1;
+        sorted[n] = addresses[pick];
+        family = addresses[pick].addr.ss_family == AF_INET6 ? AF_INET : AF_INET6;
+    }
+    memcpy(addresses, sorted, count * sizeof *addresses);
+}
+
+int dnsCacheLookup(DnsCache* cache, const char* host, DnsAddress out[DNS_MAX_ADDRESSES], int* cached) {
+    uint64_t now = platformTimeUs();
+    DnsEntry* entry = findEntry(cache, host);
+    if (entry != NULL && now < entry->expires) {
+        if (entry->count == 0) {
+            cache->negativeHits++;
+        } else {
+            cache->hits++;
+        }
+        entry->lastUsed = ++cache->clock;
+        memcpy(out, entry->addresses, entry->count * sizeof *out);
+        *cached = 1;
+        return entry->count;
+    }
+
+    cache->misses++;
+    *cached = 0;
+    if (entry == NULL) {
+        if (strlen(host) >= sizeof entry->host) {
+            return 0;
+        }
+        entry = freeEntry(cache);
+    }
+    int count = cache->resolve(cache->resolveCtx, host, entry->addresses, DNS_MAX_ADDRESSES);
+    if (count < 0) {
+        count = 0;
+    } else if (count > DNS_MAX_ADDRESSES) {
+        count = DNS_MAX_ADDRESSES;
+    }
+    interleave(entry->addresses, count);
+
+    strcpy(entry->host, host);
+    entry->count = count;
+    entry->expires = platformTimeUs() + (count > 0 ? cache->ttlUs : cache->negativeTtlUs);
+    entry->lastUsed = ++cache->clock;
+    entry->valid = 1;
+    memcpy(out, entry->addresses, count * sizeof *out);
+    return count;
+}
+
+void dnsCachePrefer(DnsCache* cache, const char* host, const DnsAddress* address) {
+    DnsEntry* entry = findEntry(cache, host);
+    if (entry == NULL) {
+        return;
+    }
+    for (int i = 1; i < entry->count; i++) {
+        if (entry->addresses[i].length == address->length && memcmp(&entry->addresses[i].addr, &address->addr, address->length) == 0) {
+            DnsAddress winner = entry->addresses[i];
+            memmove(&entry->addresses[1], &entry->addresses[0], i * sizeof winner);
+            entry->addresses[0] = winner;
+            return;
+        }
+    }
+}
+
+void dnsCacheForget(DnsCache* cache, const char* host) {
+    DnsEntry* entry = findEntry(cache, host);
+    if (entry != NULL) {
+        entry->valid = 0;
+    }
+}
+
+int dnsSystemResolve(void* ctx, const char* host, DnsAddress* out, int max) {
+    struct addrinfo hints;
+    struct addrinfo* list;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    if (getaddrinfo(host, NULL, &hints, &list) != 0) {
+        return 0;
+    }
+
+    int count = 0;
+    for (struct addrinfo* info = list; info != NULL && count < max; info = info->ai_next) {
+        if (info->ai_addrlen > sizeof out[count].addr) {
+            continue;
+        }
+        memset(&out[count], 0, sizeof out[count]);
+        memcpy(&out[count].addr, info->ai_addr, info->ai_addrlen);
+        out[count].length = info->ai_addrlen;
+        count++;
+    }
+    freeaddrinfo(list);
+    return count;
+}
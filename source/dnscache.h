@@ -0,0 +1,60 @@
+#ifndef DNSCACHE_H
+#define DNSCACHE_H
+
+#include <stdint.h>
+
+#include <sys/socket.h>
+
+#define DNS_CACHE_SIZE 16
+#define DNS_MAX_ADDRESSES 4
+//getaddrinfo doesn't tell us the record's TTL so every answer gets the same one
+#define DNS_TTL_MS (5 * 60 * 1000)
+//A name that didn't resolve is only asked about again after this long
+#define DNS_NEGATIVE_TTL_MS (30 * 1000)
+
+//One resolved address, the port is filled in when connecting
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t length;
+} DnsAddress;
+
+//Fills in up to max addresses for host and returns how many, 0 if it doesn't resolve.
+//dnsSystemResolve is the real one, tests can put a stub in its place.
+typedef int (*DnsResolveFn)(void* ctx, const char* host, DnsAddress* out, int max);
+
+typedef struct {
+    char host[256];
+    DnsAddress addresses[DNS_MAX_ADDRESSES];
+    int count;          //0 for a name that didn't resolve
+    uint64_t expires;   //platformTimeUs
+    unsigned int lastUsed;
+    int valid;
+} DnsEntry;
+
+//Hostname lookups of the fetch worker, only ever used from that one thread
+typedef struct {
+    DnsEntry entries[DNS_CACHE_SIZE];
+    DnsResolveFn resolve;
+    void* resolveCtx;
+    uint64_t ttlUs;
+    uint64_t negativeTtlUs;
+    unsigned int clock;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long negativeHits;
+} DnsCache;
+
+//resolve may be NULL for dnsSystemResolve
+void dnsCacheInit(DnsCache* cache, DnsResolveFn resolve, void* resolveCtx);
+//Copies the addresses of host into out, alternating between IPv6 and IPv4 so a
+//connector trying them in order gets both families early. Returns how many,
+//0 if the host doesn't resolve. *cached says whether the resolver was skipped.
+int dnsCacheLookup(DnsCache* cache, const char* host, DnsAddress out[DNS_MAX_ADDRESSES], int* cached);
+//Moves the address that worked to the front so the next connect tries it first
+void dnsCachePrefer(DnsCache* cache, const char* host, const DnsAddress* address);
+//Drops host, for when none of its addresses could be reached
+void dnsCacheForget(DnsCache* cache, const char* host);
+
+int dnsSystemResolve(void* ctx, const char* host, DnsAddress* out, int max);
+
+#endif
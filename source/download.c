@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "download.h"
+#include "memstats.h"
+#include "url.h"
+
+#define DOWNLOAD_STACK_SIZE (16 * 1024)
+//Tried with -1 up to this before giving up on finding a free name
+#define DOWNLOAD_MAX_COPIES 99
+
+static void writer(void* arg) {
+    Download* download = arg;
+    while (1) {
+        platformEventWait(download->ready);
+        int index = __atomic_load_n(&download->pending, __ATOMIC_ACQUIRE);
+        if (index >= 0) {
+            size_t length = download->filled[index];
+            if (!download->failed && fwrite(download->buffers[index], 1, length, download->file) != length) {
+                download->failed = 1;
+            }
+            download->written += length;
+            download->filled[index] = 0;
+            __atomic_store_n(&download->pending, -1, __ATOMIC_RELEASE);
+            platformEventSignal(download->done);
+        } else if (!download->running) {
+            break;
+        }
+    }
+}
+
+static void waitIdle(Download* download) {
+    uint64_t started = platformTimeUs();
+    while (__atomic_load_n(&download->pending, __ATOMIC_ACQUIRE) >= 0) {
+        platformEventWait(download->done);
+    }
+    download->waitUs += platformTimeUs() - started;
+}
+
+//Gives the filled buffer to the writer and carries on in the other one
+static void handOff(Download* download) {
+    waitIdle(download);
+    __atomic_store_n(&download->pending, download->current, __ATOMIC_RELEASE);
+    platformEventSignal(download->ready);
+    download->current = 1 - download->current;
+}
+
+//The last part of the url's path with anything a file name shouldn't have swapped out
+static void nameOf(const char* url, char* name, size_t size) {
+    Url parsed;
+    int length = 0;
+    if (urlParse(url, strlen(url), &parsed) == 0) {
+        const char* start = parsed.path;
+        for (int i = 0; i < parsed.pathLength; i++) {
+            if (parsed.path[i] == '/') {
+                start = parsed.path + i + 1;
+            }
+        }
+        const char* end = parsed.path + parsed.pathLength;
+        for (const char* c = start; c < end && length < (int)size - 1; c++) {
+            int ok = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') ||
+                     *c == '.' || *c == '-' || *c == '_';
+            name[length++] = ok ? *c : '_';
+        }
+    }
+    name[length] = '\0';
+    if (length == 0 || strspn(name, ".") == (size_t)length) {
+        snprintf(name, size, "download");
+    }
+}
+
+static int exists(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file != NULL) {
+        fclose(file);
+    }
+    return file != NULL;
+}
+
+//Picks dir/name, or dir/name-1.ext and so on if that is taken
+static int choosePath(Download* download, const char* dir, const char* name) {
+    const char* dot = strrchr(name, '.');
+    int stem = dot != NULL && dot != name ? (int)(dot - name) : (int)strlen(name);
+    for (int copy = 0; copy <= DOWNLOAD_MAX_COPIES; copy++) {
+        int length;
+        if (copy == 0) {
+            length = snprintf(download->path, sizeof download->path, "%s/%s", dir, name);
+        } else {
+            length = snprintf(download->path, sizeof download->path, "%s/%.*s-%d%s", dir, stem, name, copy, name + stem);
+        }
+        if (length < 0 || length >= (int)sizeof download->path) {
+            return -1;
+        }
+        if (!exists(download->path)) {
+            snprintf(download->partPath, sizeof download->partPath, "%s.part", download->path);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void downloadInit(Download* download) {
+    memset(download, 0, sizeof *download);
+    download->pending = -1;
+}
+
+int downloadStart(Download* download, const char* dir, const char* url) {
+    if (download->thread == NULL) {
+        download->buffers[0] = memAlloc(MEM_NETWORK, DOWNLOAD_BUFFER_SIZE);
+        download->buffers[1] = memAlloc(MEM_NETWORK, DOWNLOAD_BUFFER_SIZE);
+        if (download->ready == NULL) {
+            download->ready = platformEventNew();
+        }
+        if (download->done == NULL) {
+            download->done = platformEventNew();
+        }
+        download->running = 1;
+        if (download->buffers[0] == NULL || download->buffers[1] == NULL || download->ready == NULL || download->done == NULL ||
+            (download->thread = platformThreadStart(writer, download, DOWNLOAD_STACK_SIZE)) == NULL) {
+            downloadFree(download);
+            return -1;
+        }
+    }
+    char name[DOWNLOAD_NAME_MAX];
+    nameOf(url, name, sizeof name);
+    //A .part left by a download that never finished is written over
+    if (choosePath(download, dir, name) != 0 || (download->file = fopen(download->partPath, "wb")) == NULL) {
+        return -1;
+    }
+    //Whole buffers are written at a time, stdio's own buffer would only add a copy
+    setvbuf(download->file, NULL, _IONBF, 0);
+    download->current = 0;
+    download->filled[0] = 0;
+    download->filled[1] = 0;
+    download->failed = 0;
+    download->written = 0;
+    download->waitUs = 0;
+    return 0;
+}
+
+int downloadWrite(Download* download, const char* data, size_t len) {
+    while (len > 0) {
+        size_t* filled = &download->filled[download->current];
+        size_t room = DOWNLOAD_BUFFER_SIZE - *filled;
+        size_t length = len < room ? len : room;
+        memcpy(download->buffers[download->current] + *filled, data, length);
+        *filled += length;
+        data += length;
+        len -= length;
+        if (*filled == DOWNLOAD_BUFFER_SIZE) {
+            handOff(download);
+        }
+    }
+    return download->failed ? -1 : 0;
+}
+
+int downloadFinish(Download* download) {
+    if (download->filled[download->current] > 0) {
+        handOff(download);
+    }
+    waitIdle(download);
+    if (fclose(download->file) != 0) {
+        download->failed = 1;
+    }
+    download->file = NULL;
+    if (download->failed || rename(download->partPath, download->path) != 0) {
+        remove(download->partPath);
+        return -1;
+    }
+    return 0;
+}
+
+void downloadAbort(Download* download) {
+    waitIdle(download);
+    if (download->file != NULL) {
+        fclose(download->file);
+        download->file = NULL;
+        remove(download->partPath);
+    }
+    download->filled[0] = 0;
+    download->filled[1] = 0;
+}
+
+void downloadFree(Download* download) {
+    if (download->file != NULL) {
+        downloadAbort(download);
+    }
+    if (download->thread != NULL) {
+        download->running = 0;
+        platformEventSignal(download->ready);
+        platformThreadJoin(download->thread);
+    }
+    if (download->ready != NULL) {
+        platformEventFree(download->ready);
+    }
+    if (download->done != NULL) {
+        platformEventFree(download->done);
+    }
+    memFree(download->buffers[0]);
+    memFree(download->buffers[1]);
+    downloadInit(download);
+}
@@ -0,0 +1,50 @@
+#ifndef DOWNLOAD_H
+#define DOWNLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "platform.h"
+
+//The body is written in pieces this big, one fills while the other is written
+#define DOWNLOAD_BUFFER_SIZE (64 * 1024)
+#define DOWNLOAD_PATH_MAX 256
+//Longest name taken from the url, before a number is added to make it unique
+#define DOWNLOAD_NAME_MAX 64
+
+//A response body on its way to a file instead of the page. The fetch worker
+//fills one buffer while a writer thread puts the other on the SD card, so
+//reading and decrypting the next records overlaps with the card being slow.
+//The file is called name.part until the whole body is in and only gets its
+//real name then, so an interrupted download never looks like a finished one.
+//The buffers and the writer are kept for the next download once they exist.
+typedef struct {
+    char path[DOWNLOAD_PATH_MAX];
+    char partPath[DOWNLOAD_PATH_MAX + 8];
+    FILE* file;
+    char* buffers[2];
+    size_t filled[2];
+    int current;            //Being filled by the worker
+    int pending;            //Handed to the writer, -1 while it is idle
+    PlatformThread* thread;
+    PlatformEvent* ready;   //Worker -> writer
+    PlatformEvent* done;    //Writer -> worker
+    volatile int running;
+    int failed;             //A write didn't go through, set by the writer
+    size_t written;
+    uint64_t waitUs;        //The worker waiting for the writer to catch up
+} Download;
+
+void downloadInit(Download* download);
+//Opens a new file in dir named after the last part of url
+int downloadStart(Download* download, const char* dir, const char* url);
+//Returns -1 once anything failed to be written
+int downloadWrite(Download* download, const char* data, size_t len);
+//Writes the rest and gives the file its name, -1 if the file isn't complete
+int downloadFinish(Download* download);
+//Stops and removes the part written so far
+void downloadAbort(Download* download);
+void downloadFree(Download* download);
+
+#endif
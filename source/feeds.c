@@ -0,0 +1,484 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "feeds.h"
+#include "memstats.h"
+
+//Where an entry sits in the merged list
+typedef struct {
+    const FeedEntry* entry;
+    int sub;
+    int index;
+} EntryRef;
+
+static uint32_t hashBytes(const char* data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static int isDate(const char* text, int length) {
+    if (length < 10) {
+        return 0;
+    }
+    for (int i = 0; i < 10; i++) {
+        int dash = i == 4 || i == 7;
+        if (dash ? text[i] != '-' : (text[i] < '0' || text[i] > '9')) {
+            return 0;
+        }
+    }
+    return length == 10 || text[10] == ' ' || text[10] == '\t' || text[10] == '-' || text[10] == ':';
+}
+
+static void clearEntries(Subscription* sub) {
+    sub->entryCount = 0;
+    bufferClear(&sub->strings);
+}
+
+static int addString(Subscription* sub, const char* text, int length) {
+    int offset = sub->strings.length;
+    if (bufferAppend(&sub->strings, text, length) != 0 || bufferAppend(&sub->strings, "", 1) != 0) {
+        return -1;
+    }
+    return offset;
+}
+
+static const char* entryString(const Subscription* sub, int offset) {
+    return sub->strings.data + offset;
+}
+
+void feedsInit(FeedReader* feeds) {
+    memset(feeds, 0, sizeof *feeds);
+}
+
+int feedsLoad(FeedReader* feeds, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char line[URL_MAX + 2];
+    while (fgets(line, sizeof line, file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && line[0] != '#') {
+            feedsAdd(feeds, line);
+        }
+    }
+    fclose(file);
+    feeds->dirty = 0;
+    return 0;
+}
+
+int feedsSave(FeedReader* feeds, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < feeds->count; i++) {
+        fprintf(file, "%s\n", feeds->subs[i].url);
+    }
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    feeds->dirty = 0;
+    return 0;
+}
+
+int feedsFind(const FeedReader* feeds, const char* url) {
+    for (int i = 0; i < feeds->count; i++) {
+        if (strcmp(feeds->subs[i].url, url) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int feedsAdd(FeedReader* feeds, const char* url) {
+    char canonical[URL_MAX];
+    Url parsed;
+    if (urlNormalize(url, canonical, sizeof canonical) < 0 ||
+        urlParse(canonical, strlen(canonical), &parsed) != 0 ||
+        !urlIsScheme(&parsed, "gemini") || parsed.hostLength == 0) {
+        return -1;
+    }
+    int existing = feedsFind(feeds, canonical);
+    if (existing >= 0) {
+        return existing;
+    }
+    if (feeds->count == FEEDS_MAX) {
+        return -1;
+    }
+
+    Subscription* sub = &feeds->subs[feeds->count];
+    memset(sub, 0, sizeof *sub);
+    //Politeness is per host, the port doesn't make it a different machine
+    const char* host = parsed.host;
+    int hostLength = parsed.hostLength;
+    if (host[0] == '[') {
+        host++;
+        hostLength -= 2;
+    }
+    if (urlCopyPart(host, hostLength, sub->host, sizeof sub->host) < 0) {
+        return -1;
+    }
+    strcpy(sub->url, canonical);
+    bufferInit(&sub->strings, MEM_FEEDS);
+    feeds->dirty = 1;
+    feeds->generation++;
+    return feeds->count++;
+}
+
+void feedsRemove(FeedReader* feeds, int index) {
+    Subscription* sub = &feeds->subs[index];
+    //The job still comes back from the worker, with nobody to claim it it is freed then
+    if (sub->state == FEED_FETCHING) {
+        fetchJobCancel(feeds->jobs[sub->worker]);
+    }
+    if (sub->state != FEED_IDLE) {
+        feeds->pending--;
+    }
+    memFree(sub->entries);
+    bufferFree(&sub->strings);
+    memmove(sub, sub + 1, (feeds->count - index - 1) * sizeof *sub);
+    feeds->count--;
+    feeds->dirty = 1;
+    feeds->generation++;
+}
+
+int feedsStart(FeedReader* feeds, int workers, const NetworkFactory* networks, RedirectMap* redirects) {
+    if (feeds->workerCount > 0) {
+        return 0;
+    }
+    if (workers > FEEDS_MAX_WORKERS) {
+        workers = FEEDS_MAX_WORKERS;
+    }
+    feeds->networks = *networks;
+    feeds->workers = memCalloc(MEM_FEEDS, workers, sizeof *feeds->workers);
+    feeds->jobs = memCalloc(MEM_FEEDS, workers, sizeof *feeds->jobs);
+    if (feeds->workers == NULL || feeds->jobs == NULL) {
+        feedsStop(feeds);
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) {
+        FetchNetwork network;
+        if (networks->make(networks->ctx, i, &network) != 0) {
+            break;
+        }
+        if (fetcherStart(&feeds->workers[i], &network, NULL, redirects) != 0) {
+            networks->release(networks->ctx, i);
+            break;
+        }
+        feeds->workerCount++;
+    }
+    if (feeds->workerCount == 0) {
+        feedsStop(feeds);
+        return -1;
+    }
+    return 0;
+}
+
+void feedsRefresh(FeedReader* feeds, int force) {
+    uint64_t now = platformTimeUs();
+    int queued = 0;
+    for (int i = 0; i < feeds->count; i++) {
+        Subscription* sub = &feeds->subs[i];
+        if (sub->state != FEED_IDLE) {
+            continue;
+        }
+        //Gemini has no conditional requests, a recent copy is the closest thing
+        if (!force && sub->fetchedUs != 0 && now - sub->fetchedUs < FEEDS_MAX_AGE_US) {
+            feeds->skipped++;
+            continue;
+        }
+        sub->state = FEED_WAITING;
+        queued++;
+    }
+    if (queued == 0) {
+        return;
+    }
+    if (feeds->pending == 0) {
+        feeds->refreshStartUs = now;
+    }
+    feeds->pending += queued;
+    feeds->generation++;
+}
+
+void feedsParse(Subscription* sub, const Document* doc, const char* url) {
+    clearEntries(sub);
+    sub->title[0] = '\0';
+    for (int i = 0; i < doc->lineCount; i++) {
+        if (doc->lines[i].type == LINE_H1) {
+            int length = doc->lines[i].length;
+            while (length > 0 && (doc->lines[i].text[length - 1] == '\r' || doc->lines[i].text[length - 1] == ' ')) {
+                length--;
+            }
+            snprintf(sub->title, sizeof sub->title, "%.*s", length, doc->lines[i].text);
+            break;
+        }
+    }
+
+    Url base;
+    if (urlParse(url, strlen(url), &base) != 0) {
+        return;
+    }
+    for (int i = 0; i < doc->linkCount; i++) {
+        const Link* link = &doc->links[i];
+        if (!isDate(link->caption, link->captionLength)) {
+            continue;
+        }
+        Url ref;
+        char url[URL_MAX];
+        if (urlParse(link->path, link->pathLength, &ref) != 0 || urlResolve(&base, &ref, url, sizeof url) < 0) {
+            continue;
+        }
+
+        //Whatever separates the date from the title isn't part of it, "2024-01-31 - Title" is common
+        const char* title = link->caption + 10;
+        const char* end = link->caption + link->captionLength;
+        while (title < end && (*title == ' ' || *title == '\t' || *title == '-' || *title == ':')) {
+            title++;
+        }
+        while (end > title && (end[-1] == '\r' || end[-1] == ' ')) {
+            end--;
+        }
+
+        if (sub->entryCount == sub->entryCapacity) {
+            int capacity = sub->entryCapacity ? sub->entryCapacity * 2 : 16;
+            FeedEntry* grown = memRealloc(MEM_FEEDS, sub->entries, capacity * sizeof *grown);
+            if (grown == NULL) {
+                return;
+            }
+            sub->entries = grown;
+            sub->entryCapacity = capacity;
+        }
+        FeedEntry* entry = &sub->entries[sub->entryCount];
+        memcpy(entry->date, link->caption, 10);
+        entry->date[10] = '\0';
+        entry->url = addString(sub, url, strlen(url));
+        entry->title = addString(sub, title, end - title);
+        if (entry->url < 0 || entry->title < 0) {
+            return;
+        }
+        sub->entryCount++;
+    }
+}
+
+static void finishFeed(FeedReader* feeds, Subscription* sub, FetchJob* job, uint64_t now) {
+    sub->state = FEED_IDLE;
+    sub->finishedUs = now;
+    sub->error = job->error;
+    sub->status = job->header.status;
+    feeds->pending--;
+
+    if (job->error != FETCH_OK || job->header.status / 10 != 2) {
+        //The entries of the last good fetch stay up
+        feeds->failed++;
+        return;
+    }
+    sub->fetchedUs = now;
+    uint32_t hash = hashBytes(job->body.data, job->body.length);
+    if (hash == sub->hash && sub->entryCount > 0) {
+        feeds->unchanged++;
+        return;
+    }
+    sub->hash = hash;
+    //Where any redirects ended up is what the links are relative to
+    feedsParse(sub, &job->doc, job->url);
+    feeds->fetched++;
+}
+
+//Only one request to a host at a time, and not straight after the last one ended
+static int hostFree(const FeedReader* feeds, const Subscription* sub, uint64_t now) {
+    for (int i = 0; i < feeds->count; i++) {
+        const Subscription* other = &feeds->subs[i];
+        if (other == sub || strcmp(other->host, sub->host) != 0) {
+            continue;
+        }
+        if (other->state == FEED_FETCHING || now - other->finishedUs < FEEDS_HOST_GAP_MS * 1000ULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static Subscription* nextWaiting(FeedReader* feeds, uint64_t now) {
+    for (int i = 0; i < feeds->count; i++) {
+        Subscription* sub = &feeds->subs[i];
+        if (sub->state == FEED_WAITING && hostFree(feeds, sub, now)) {
+            return sub;
+        }
+    }
+    return NULL;
+}
+
+int feedsStep(FeedReader* feeds) {
+    int changed = 0;
+    int wasPending = feeds->pending;
+    uint64_t now = platformTimeUs();
+
+    for (int w = 0; w < feeds->workerCount; w++) {
+        FetchJob* job;
+        while ((job = fetcherPoll(&feeds->workers[w])) != NULL) {
+            if (job == feeds->jobs[w]) {
+                feeds->jobs[w] = NULL;
+            }
+            for (int i = 0; i < feeds->count; i++) {
+                Subscription* sub = &feeds->subs[i];
+                if (sub->state == FEED_FETCHING && sub->worker == w) {
+                    finishFeed(feeds, sub, job, now);
+                    changed = 1;
+                    break;
+                }
+            }
+            fetchJobFree(job);
+        }
+    }
+
+    //Each worker gets one feed at a time, so the pool size is the connection limit
+    for (int w = 0; w < feeds->workerCount && feeds->pending > 0; w++) {
+        if (feeds->jobs[w] != NULL) {
+            continue;
+        }
+        Subscription* sub = nextWaiting(feeds, now);
+        if (sub == NULL) {
+            break;
+        }
+        FetchJob* job = fetchJobNew(sub->url);
+        if (job == NULL) {
+            break;
+        }
+        job->maxBytes = FEEDS_MAX_BYTES;
+        if (fetcherSubmit(&feeds->workers[w], job) != 0) {
+            fetchJobFree(job);
+            continue;
+        }
+        feeds->jobs[w] = job;
+        sub->state = FEED_FETCHING;
+        sub->worker = w;
+    }
+
+    if (wasPending > 0 && feeds->pending == 0) {
+        feeds->refreshUs = now - feeds->refreshStartUs;
+    }
+    if (changed) {
+        feeds->generation++;
+    }
+    return changed;
+}
+
+void feedsStop(FeedReader* feeds) {
+    for (int w = 0; w < feeds->workerCount; w++) {
+        if (feeds->jobs[w] != NULL) {
+            fetchJobCancel(feeds->jobs[w]);
+        }
+        fetcherStop(&feeds->workers[w]);
+        feeds->networks.release(feeds->networks.ctx, w);
+    }
+    //Nothing is in flight anymore, whatever was waiting starts over next refresh
+    for (int i = 0; i < feeds->count; i++) {
+        feeds->subs[i].state = FEED_IDLE;
+    }
+    feeds->pending = 0;
+    memFree(feeds->workers);
+    memFree(feeds->jobs);
+    feeds->workers = NULL;
+    feeds->jobs = NULL;
+    feeds->workerCount = 0;
+}
+
+void feedsFree(FeedReader* feeds) {
+    feedsStop(feeds);
+    for (int i = 0; i < feeds->count; i++) {
+        memFree(feeds->subs[i].entries);
+        bufferFree(&feeds->subs[i].strings);
+    }
+    feeds->count = 0;
+}
+
+//Newest first, entries of the same day keep the order of the list and the feed
+static int compareEntries(const void* a, const void* b) {
+    const EntryRef* x = a;
+    const EntryRef* y = b;
+    int order = strcmp(y->entry->date, x->entry->date);
+    if (order != 0) {
+        return order;
+    }
+    return x->sub != y->sub ? x->sub - y->sub : x->index - y->index;
+}
+
+static const char* feedTitle(const Subscription* sub) {
+    return sub->title[0] != '\0' ? sub->title : sub->host;
+}
+
+static void appendf(Buffer* out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void appendf(Buffer* out, const char* fmt, ...) {
+    char line[URL_MAX + 256];
+    va_list ap;
+    va_start(ap, fmt);
+    int length = vsnprintf(line, sizeof line, fmt, ap);
+    va_end(ap);
+    if (length > 0) {
+        bufferAppend(out, line, length < (int)sizeof line ? length : (int)sizeof line - 1);
+    }
+}
+
+void feedsPage(const FeedReader* feeds, Buffer* out) {
+    bufferClear(out);
+    appendf(out, "# Subscriptions\n");
+    if (feeds->count == 0) {
+        appendf(out, "Nothing here yet. Press X on the page of a gemlog to follow it.\n");
+        return;
+    }
+    if (feeds->pending > 0) {
+        appendf(out, "Refreshing, %d of %d to go\n", feeds->pending, feeds->count);
+    } else if (feeds->refreshUs > 0) {
+        appendf(out, "%d feeds, last refresh took %.1f s\n", feeds->count, feeds->refreshUs / 1000000.0);
+    }
+
+    int total = 0;
+    for (int i = 0; i < feeds->count; i++) {
+        total += feeds->subs[i].entryCount;
+    }
+    EntryRef* refs = total > 0 ? memAlloc(MEM_FEEDS, total * sizeof *refs) : NULL;
+    if (refs != NULL) {
+        int count = 0;
+        for (int i = 0; i < feeds->count; i++) {
+            for (int j = 0; j < feeds->subs[i].entryCount; j++) {
+                refs[count].entry = &feeds->subs[i].entries[j];
+                refs[count].sub = i;
+                refs[count].index = j;
+                count++;
+            }
+        }
+        qsort(refs, count, sizeof *refs, compareEntries);
+
+        const char* day = "";
+        for (int i = 0; i < count && i < FEEDS_PAGE_ENTRIES; i++) {
+            const Subscription* sub = &feeds->subs[refs[i].sub];
+            if (strcmp(day, refs[i].entry->date) != 0) {
+                day = refs[i].entry->date;
+                appendf(out, "## %s\n", day);
+            }
+            appendf(out, "=> %s %s: %s\n", entryString(sub, refs[i].entry->url), feedTitle(sub), entryString(sub, refs[i].entry->title));
+        }
+        memFree(refs);
+    }
+
+    appendf(out, "## Following\n");
+    for (int i = 0; i < feeds->count; i++) {
+        const Subscription* sub = &feeds->subs[i];
+        if (sub->error == FETCH_CERT_CHANGED) {
+            appendf(out, "=> %s %s (certificate changed, open it to check)\n", sub->url, feedTitle(sub));
+        } else if (sub->error != FETCH_OK) {
+            appendf(out, "=> %s %s (couldn't reach it)\n", sub->url, feedTitle(sub));
+        } else if (sub->status != 0 && sub->status / 10 != 2) {
+            appendf(out, "=> %s %s (status %d)\n", sub->url, feedTitle(sub), sub->status);
+        } else {
+            appendf(out, "=> %s %s\n", sub->url, feedTitle(sub));
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef FEEDS_H
+#define FEEDS_H
+
+#include <stdint.h>
+
+#include "buffer.h"
+#include "fetch.h"
+
+#define FEEDS_MAX 64
+#define FEEDS_MAX_WORKERS 8
+//A feed fetched more recently than this isn't asked for again unless forced
+#define FEEDS_MAX_AGE_US (15 * 60 * 1000000ULL)
+//Politeness, one request per host at a time and a pause between them
+#define FEEDS_HOST_GAP_MS 500
+#define FEEDS_MAX_BYTES (256 * 1024)
+//Newest entries shown on the aggregate page
+#define FEEDS_PAGE_ENTRIES 100
+
+enum FeedState {
+    FEED_IDLE,
+    FEED_WAITING,   //Wants fetching, waits for a worker and its host to be free
+    FEED_FETCHING,
+};
+
+//One dated link of a gemfeed, `=> url YYYY-MM-DD title`
+typedef struct {
+    char date[11];
+    int url;        //Offsets into the subscription's strings
+    int title;
+} FeedEntry;
+
+typedef struct {
+    char url[URL_MAX];      //Canonical
+    char host[256];
+    char title[64];         //The feed's first heading once fetched
+    int state;
+    int worker;             //Only while fetching
+    uint64_t fetchedUs;     //Last good response, 0 for never
+    uint64_t finishedUs;    //Last time a request for it ended either way
+    uint32_t hash;          //Of the body the entries came from
+    int error;              //FetchError of the last attempt
+    int status;             //Its status line, anything but 2x is shown as a failure
+    FeedEntry* entries;
+    int entryCount;
+    int entryCapacity;
+    Buffer strings;
+} Subscription;
+
+//Gemlogs the user follows, refreshed together by a small pool of fetch
+//workers and merged into one page. Everything but the fetching itself runs on
+//the UI thread, each worker is a Fetcher with a network of its own.
+typedef struct {
+    Subscription subs[FEEDS_MAX];
+    int count;
+    int dirty;              //The list changed since it was loaded or saved
+
+    Fetcher* workers;
+    NetworkFactory networks;    //Where the workers' networks came from
+    FetchJob** jobs;        //What each worker is on, NULL when idle
+    int workerCount;
+
+    int pending;            //Waiting or fetching
+    uint64_t refreshStartUs;
+    uint64_t refreshUs;     //Wall time of the last refresh
+    unsigned int generation;    //Moves on whenever the aggregate page would change
+
+    unsigned long fetched;
+    unsigned long unchanged;
+    unsigned long skipped;  //Fresh enough not to ask
+    unsigned long failed;
+} FeedReader;
+
+void feedsInit(FeedReader* feeds);
+//One url per line, a missing file is an empty list
+int feedsLoad(FeedReader* feeds, const char* path);
+int feedsSave(FeedReader* feeds, const char* path);
+//Index of the subscription to a canonical url, -1 if there is none
+int feedsFind(const FeedReader* feeds, const char* url);
+//Returns the new subscription's index, -1 if the list is full or url isn't gemini
+int feedsAdd(FeedReader* feeds, const char* url);
+void feedsRemove(FeedReader* feeds, int index);
+
+//Starts the workers the first time, each on a network from networks. Seeding
+//a TLS client is slow, so they stay up afterwards. Returns -1 if none could be
+//started. Permanent redirects are kept in redirects, which may be NULL.
+int feedsStart(FeedReader* feeds, int workers, const NetworkFactory* networks, RedirectMap* redirects);
+//Queues every subscription, force queues ones that are still fresh too
+void feedsRefresh(FeedReader* feeds, int force);
+//Call every frame. Picks up finished fetches and hands waiting feeds to idle
+//workers, returns 1 if the aggregate page changed.
+int feedsStep(FeedReader* feeds);
+void feedsStop(FeedReader* feeds);
+void feedsFree(FeedReader* feeds);
+
+//Reads the dated links out of a parsed gemfeed. Relative links are resolved
+//against url, where the feed was fetched from.
+void feedsParse(Subscription* sub, const Document* doc, const char* url);
+//Writes the aggregate page as gemtext, newest entries first
+void feedsPage(const FeedReader* feeds, Buffer* out);
+
+#endif
@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "connector.h"
+#include "fetch.h"
+#include "memstats.h"
+#include "trace.h"
+
+#define FETCH_STACK_SIZE (64 * 1024)
+
+//Where the body of a response goes, decided by its type once the body starts
+enum BodyMode {
+    BODY_UNDECIDED,
+    BODY_PAGE,
+    BODY_DOWNLOAD,
+    BODY_REFUSED,       //Not a page and there is nowhere to save it
+    BODY_FAILED,        //The file couldn't be created
+};
+
+void fetchJobSetPhase(FetchJob* job, int phase) {
+    __atomic_store_n(&job->phase, phase, __ATOMIC_RELEASE);
+}
+
+//Make the lines parsed so far visible to the UI
+static void publishSnapshot(FetchJob* job) {
+    layoutDocument(&job->doc, &job->layout);
+    PageSnapshot* snapshot = arenaAlloc(&job->doc.arena, sizeof *snapshot);
+    if (snapshot == NULL) {
+        return;
+    }
+    snapshot->lines = job->doc.lines;
+    snapshot->layout = job->layout;
+    __atomic_store_n(&job->snapshot, snapshot, __ATOMIC_RELEASE);
+}
+
+//Parse what arrived and make it visible to the UI
+static void feedPage(FetchJob* job, const char* data, size_t len) {
+    feedGemtext(&job->doc, data, len);
+    publishSnapshot(job);
+}
+
+//The end of the wait for the server, the response starts coming in
+static void firstByte(FetchJob* job) {
+    uint64_t now = platformTimeUs();
+    job->timings.firstByteUs += now - job->sentUs;
+    traceSpan(TRACE_FIRST_BYTE, job->sentUs, now);
+    job->firstByteAtUs = now;
+    job->sentUs = 0;
+}
+
+//Anything but gemtext streams to a file and never goes near the page
+static void startBody(FetchJob* job) {
+    if (geminiIsGemtext(job->header.meta)) {
+        job->bodyMode = BODY_PAGE;
+    } else if (job->downloadDir == NULL) {
+        job->bodyMode = BODY_REFUSED;
+        job->cancelled = 1;
+    } else if (downloadStart(job->download, job->downloadDir, job->url) != 0) {
+        job->bodyMode = BODY_FAILED;
+        job->cancelled = 1;
+    } else {
+        job->bodyMode = BODY_DOWNLOAD;
+        fetchJobSetPhase(job, FETCH_SAVING);
+    }
+}
+
+static void jobBody(void* user, const char* data, size_t len) {
+    FetchJob* job = user;
+    if (job->sentUs != 0) {
+        firstByte(job);
+    }
+    if (job->bodyMode == BODY_UNDECIDED) {
+        startBody(job);
+    }
+    __atomic_store_n(&job->bytes, job->bytes + len, __ATOMIC_RELEASE);
+    traceCount(TRACE_BYTES, job->bytes);
+    if (job->bodyMode == BODY_DOWNLOAD) {
+        if (downloadWrite(job->download, data, len) != 0) {
+            job->cancelled = 1;
+        }
+        return;
+    }
+    if (job->bodyMode != BODY_PAGE) {
+        return;
+    }
+    bufferAppend(&job->body, data, len);
+    feedPage(job, data, len);
+    if (job->maxBytes != 0 && job->bytes > job->maxBytes) {
+        job->cancelled = 1;
+    }
+}
+
+//Messages of our own only go on the page, the body stays what the server sent
+static void jobText(FetchJob* job, const char* text) {
+    feedPage(job, text, strlen(text));
+}
+
+//The file gets its name once the whole body is in, a download cut short
+//leaves nothing behind. Returns -1 if the file couldn't be written.
+static int endDownload(FetchJob* job, int ret) {
+    Download* download = job->download;
+    if (ret != RESPONSE_OK || job->cancelled) {
+        downloadAbort(download);
+        return download->failed ? -1 : 0;
+    }
+    if (downloadFinish(download) != 0) {
+        return -1;
+    }
+    snprintf(job->savedAs, sizeof job->savedAs, "%s", download->path);
+    char message[DOWNLOAD_PATH_MAX + GEMINI_META_MAX + 64];
+    snprintf(message, sizeof message, "# Saved\n%s\n%u KB of %s\n", download->path, (unsigned int)(download->written / 1024), job->header.meta);
+    jobText(job, message);
+    return 0;
+}
+
+//Like jobBody for a page coming off the SD card, but nothing is shown until
+//all of it has been unpacked. The text only goes into the page, the body is
+//kept for writing to the disk cache and this one is already there.
+static void diskBody(void* user, const char* data, size_t len) {
+    FetchJob* job = user;
+    __atomic_store_n(&job->bytes, job->bytes + len, __ATOMIC_RELEASE);
+    feedGemtext(&job->doc, data, len);
+    if (job->maxBytes != 0 && job->bytes > job->maxBytes) {
+        job->cancelled = 1;
+    }
+}
+
+//Serve the page from the SD card if a fresh enough copy is there
+static int loadCached(Fetcher* fetcher, FetchJob* job, const char* key) {
+    DiskCacheEntry entry;
+    if (fetcher->disk == NULL || job->reload || diskCacheGet(fetcher->disk, key, &entry) != 0) {
+        return -1;
+    }
+    //Files are saved from the server, copies of them kept from before aren't used
+    if (!geminiIsGemtext(entry.meta)) {
+        diskCacheEntryFree(&entry);
+        return -1;
+    }
+    job->header.status = entry.status;
+    snprintf(job->header.meta, sizeof job->header.meta, "%s", entry.meta);
+    job->bodyMode = BODY_PAGE;
+    fetchJobSetPhase(job, FETCH_READING);
+    //A packed body goes from the decoder into the page without being put back together first
+    int ret = diskCacheEntryRead(&entry, diskBody, job);
+    diskCacheEntryFree(&entry);
+    if (ret != 0) {
+        //Nothing of it was shown yet, so it can be thrown away and fetched again
+        diskCacheRemove(fetcher->disk, key);
+        freeDocument(&job->doc);
+        beginDocument(&job->doc, 0);
+        resetLayout(&job->layout);
+        __atomic_store_n(&job->bytes, 0, __ATOMIC_RELEASE);
+        memset(&job->header, 0, sizeof job->header);
+        job->bodyMode = BODY_UNDECIDED;
+        return -1;
+    }
+    job->fromDisk = 1;
+    publishSnapshot(job);
+    return 0;
+}
+
+//What the page says when the server couldn't be reached
+static void networkFailed(FetchJob* job, const char* request) {
+    char message[URL_MAX + 64];
+    switch (job->error) {
+    case FETCH_RESOLVE_FAILED:
+        snprintf(message, sizeof message, "Couldn't find %s", job->host);
+        break;
+    case FETCH_CONNECT_FAILED:
+        snprintf(message, sizeof message, "%s", job->detail == CONNECT_TIMED_OUT ? "Timed out connecting!" : "Failed to connect!");
+        break;
+    case FETCH_CERT_CHANGED:
+        snprintf(message, sizeof message, "The certificate of %s has changed since the last visit. "
+                 "Someone may be in the middle, press Y if you know the change is genuine.", job->host);
+        break;
+    case FETCH_SETUP_FAILED:
+        snprintf(message, sizeof message, "Failed to set hostname");
+        break;
+    case FETCH_HANDSHAKE_FAILED:
+        snprintf(message, sizeof message, "Failed to shake hands! Error: %d", job->detail);
+        break;
+    case FETCH_SEND_FAILED:
+        snprintf(message, sizeof message, "Failed to send request\n%s", request);
+        break;
+    default:
+        return;
+    }
+    jobText(job, message);
+}
+
+//One request and response over the network
+static void request(Fetcher* fetcher, FetchJob* job) {
+    int ret;
+    char message[GEMINI_META_MAX + DOWNLOAD_PATH_MAX + 64];
+
+    char request[URL_MAX + 2];
+    snprintf(request, sizeof(request), "%s\r\n", job->url);
+    Transport transport;
+    void* conn = NULL;
+    ret = fetcher->network.open(fetcher->network.ctx, job, request, &transport, &conn);
+    if (ret != FETCH_OK) {
+        job->error = ret;
+        networkFailed(job, request);
+        goto cleanup;
+    }
+
+    //The body streams straight into the page as records arrive
+    fetchJobSetPhase(job, FETCH_READING);
+    job->sentUs = platformTimeUs();
+    ret = readGeminiResponse(&transport, &job->header, jobBody, job);
+    //A response without a body ends with its header
+    if (job->sentUs != 0) {
+        firstByte(job);
+    }
+    uint64_t finished = platformTimeUs();
+    job->timings.readUs += finished - job->firstByteAtUs;
+    traceSpan(TRACE_READ, job->firstByteAtUs, finished);
+    //An empty body still says what it would have been
+    if (job->bodyMode == BODY_UNDECIDED && ret == RESPONSE_OK && job->header.status / 10 == 2) {
+        startBody(job);
+    }
+    if (job->bodyMode == BODY_DOWNLOAD && endDownload(job, ret) != 0) {
+        job->bodyMode = BODY_FAILED;
+    }
+    if (job->bodyMode == BODY_REFUSED) {
+        job->error = FETCH_NOT_PAGE;
+        snprintf(message, sizeof message, "Not a page, this is %s\n", job->header.meta);
+        jobText(job, message);
+    } else if (job->bodyMode == BODY_FAILED) {
+        job->error = FETCH_SAVE_FAILED;
+        snprintf(message, sizeof message, "Couldn't save the %s to %s\n", job->header.meta, job->downloadDir);
+        jobText(job, message);
+    } else if (job->cancelled) {
+        job->error = FETCH_CANCELLED;
+    } else if (ret == RESPONSE_BAD_HEADER || (ret != RESPONSE_OK && job->header.status == 0)) {
+        job->error = FETCH_BAD_RESPONSE;
+        jobText(job, "Invalid response from server");
+    } else if (ret != RESPONSE_OK) {
+        //Keep whatever arrived before the connection dropped
+        job->error = FETCH_RECV_FAILED;
+    } else if (job->header.status / 10 == 2 && job->bodyMode == BODY_PAGE && fetcher->disk != NULL) {
+        diskCachePut(fetcher->disk, job->url, job->header.status, job->header.meta, job->body.data, job->body.length);
+    } else if (job->header.status / 10 > 3) {
+        //Prompts are left to the UI and redirects to runJob, failures get a page saying what went wrong
+        snprintf(message, sizeof message, "# %s\n%d %s\n", geminiStatusName(job->header.status), job->header.status, job->header.meta);
+        jobText(job, message);
+    }
+
+cleanup:
+    if (conn != NULL) {
+        fetcher->network.close(fetcher->network.ctx, conn);
+    }
+}
+
+//Points the job at a url, -1 unless it is an absolute gemini:// url with a host
+static int setUrl(FetchJob* job, const char* url) {
+    char canonical[URL_MAX];
+    Url parsed;
+    if (urlNormalize(url, canonical, sizeof canonical) < 0 ||
+        urlParse(canonical, strlen(canonical), &parsed) != 0 ||
+        !urlIsScheme(&parsed, "gemini") || parsed.hostLength == 0) {
+        return -1;
+    }
+    const char* host = parsed.host;
+    int hostLength = parsed.hostLength;
+    if (host[0] == '[') {
+        host++;
+        hostLength -= 2;
+    }
+    char hostCopy[sizeof job->host];
+    if (urlCopyPart(host, hostLength, hostCopy, sizeof hostCopy) < 0) {
+        return -1;
+    }
+    strcpy(job->host, hostCopy);
+    if (parsed.portLength > 0) {
+        urlCopyPart(parsed.port, parsed.portLength, job->port, sizeof job->port);
+    } else {
+        strcpy(job->port, "1965");
+    }
+    strcpy(job->url, canonical);
+    return 0;
+}
+
+static void addHop(FetchJob* job, int status, int remembered) {
+    if (job->hopCount < REDIRECTS_MAX_HOPS) {
+        FetchHop* hop = &job->hops[job->hopCount++];
+        strcpy(hop->url, job->url);
+        hop->status = status;
+        hop->remembered = remembered;
+    }
+}
+
+//Points the job at where a 3x response sent it. Returns 1 if there is somewhere
+//to go, otherwise the page says why not.
+static int followRedirect(Fetcher* fetcher, FetchJob* job) {
+    int status = job->header.status;
+    if (job->error != FETCH_OK || status / 10 != 3) {
+        return 0;
+    }
+
+    char target[URL_MAX];
+    char message[URL_MAX + GEMINI_META_MAX + 64];
+    Url base, ref, parsed;
+    if (urlParse(job->url, strlen(job->url), &base) != 0 ||
+        urlParse(job->header.meta, strlen(job->header.meta), &ref) != 0 ||
+        urlResolve(&base, &ref, target, sizeof target) < 0) {
+        job->error = FETCH_BAD_REDIRECT;
+        snprintf(message, sizeof message, "Redirected to an invalid url\n%s", job->header.meta);
+        jobText(job, message);
+        return 0;
+    }
+    //Other schemes are left for the user to follow by hand
+    if (urlParse(target, strlen(target), &parsed) != 0 || !urlIsScheme(&parsed, "gemini") || parsed.hostLength == 0) {
+        job->error = FETCH_BAD_REDIRECT;
+        snprintf(message, sizeof message, "Redirected somewhere that can't be opened here\n=> %s\n", target);
+        jobText(job, message);
+        return 0;
+    }
+
+    //Going back to a url already on the chain would never end
+    int loop = strcmp(target, job->url) == 0;
+    for (int i = 0; i < job->hopCount && !loop; i++) {
+        loop = strcmp(target, job->hops[i].url) == 0;
+    }
+    if (loop) {
+        //A stored redirect may be what closes the loop, the server gets asked again next time
+        for (int i = 0; i < job->hopCount && fetcher->redirects != NULL; i++) {
+            if (job->hops[i].remembered) {
+                redirectsForget(fetcher->redirects, job->hops[i].url);
+            }
+        }
+        job->error = FETCH_REDIRECT_LOOP;
+        snprintf(message, sizeof message, "Redirect loop, %s leads back to %s", job->url, target);
+        jobText(job, message);
+        return 0;
+    }
+    if (job->hopCount == REDIRECTS_MAX_HOPS) {
+        job->error = FETCH_TOO_MANY_REDIRECTS;
+        snprintf(message, sizeof message, "Too many redirects, the last one went to\n=> %s\n", target);
+        jobText(job, message);
+        return 0;
+    }
+
+    if (status == 31 && fetcher->redirects != NULL) {
+        redirectsAdd(fetcher->redirects, job->url, target);
+    }
+    addHop(job, status, 0);
+    if (setUrl(job, target) != 0) {
+        job->error = FETCH_BAD_REDIRECT;
+        jobText(job, "Redirected to a url that can't be opened here");
+        return 0;
+    }
+    return 1;
+}
+
+//Redirects are followed here on the worker, only the final page goes back to the UI
+static void runJob(Fetcher* fetcher, FetchJob* job) {
+    job->download = &fetcher->download;
+    beginDocument(&job->doc, 0);
+    resetLayout(&job->layout);
+
+    //A permanent redirect seen before is taken without asking the server again
+    char target[URL_MAX];
+    if (fetcher->redirects != NULL && redirectsLookup(fetcher->redirects, job->url, target) == 0) {
+        addHop(job, 31, 1);
+        if (setUrl(job, target) != 0) {
+            job->hopCount = 0;
+        }
+    }
+
+    do {
+        if (job->cancelled) {
+            job->error = FETCH_CANCELLED;
+            break;
+        }
+        if (loadCached(fetcher, job, job->url) != 0) {
+            request(fetcher, job);
+        }
+    } while (followRedirect(fetcher, job));
+
+    endDocument(&job->doc);
+    layoutDocument(&job->doc, &job->layout);
+}
+
+static void fetchThread(void* arg) {
+    Fetcher* fetcher = arg;
+    while (fetcher->running) {
+        //Background jobs go one at a time so a new request waits for at most one of them
+        FetchJob* job = spscPop(&fetcher->requests);
+        if (job == NULL) {
+            job = spscPop(&fetcher->background);
+        }
+        if (job != NULL) {
+            if (!job->cancelled) {
+                runJob(fetcher, job);
+            } else {
+                job->error = FETCH_CANCELLED;
+            }
+            fetchJobSetPhase(job, FETCH_DONE);
+            //The UI drains completions every frame so this only spins if it has stalled
+            while (spscPush(&fetcher->completions, job) != 0) {
+                platformSleepMs(16);
+            }
+            continue;
+        }
+        //Compaction runs a slice at a time while there is nothing else to do
+        if (fetcher->disk != NULL && diskCacheCompactStep(fetcher->disk, FETCH_COMPACT_STEP)) {
+            continue;
+        }
+        platformEventWait(fetcher->wake);
+    }
+}
+
+int fetcherStart(Fetcher* fetcher, const FetchNetwork* network, DiskCache* disk, RedirectMap* redirects) {
+    memset(fetcher, 0, sizeof *fetcher);
+    fetcher->network = *network;
+    fetcher->disk = disk;
+    fetcher->redirects = redirects;
+    downloadInit(&fetcher->download);
+    fetcher->running = 1;
+    if (spscInit(&fetcher->requests, FETCH_QUEUE_SIZE) != 0 ||
+        spscInit(&fetcher->background, FETCH_QUEUE_SIZE) != 0 ||
+        spscInit(&fetcher->completions, FETCH_QUEUE_SIZE) != 0 ||
+        (fetcher->wake = platformEventNew()) == NULL ||
+        (fetcher->thread = platformThreadStart(fetchThread, fetcher, FETCH_STACK_SIZE)) == NULL) {
+        fetcherStop(fetcher);
+        return -1;
+    }
+    return 0;
+}
+
+void fetcherStop(Fetcher* fetcher) {
+    fetcher->running = 0;
+    if (fetcher->thread != NULL) {
+        platformEventSignal(fetcher->wake);
+        platformThreadJoin(fetcher->thread);
+        fetcher->thread = NULL;
+    }
+    //With the worker gone it is safe to drain both ends from here
+    FetchJob* job;
+    if (fetcher->requests.slots != NULL) {
+        while ((job = spscPop(&fetcher->requests)) != NULL) {
+            fetchJobFree(job);
+        }
+    }
+    if (fetcher->background.slots != NULL) {
+        while ((job = spscPop(&fetcher->background)) != NULL) {
+            fetchJobFree(job);
+        }
+    }
+    if (fetcher->completions.slots != NULL) {
+        while ((job = spscPop(&fetcher->completions)) != NULL) {
+            fetchJobFree(job);
+        }
+    }
+    if (fetcher->wake != NULL) {
+        platformEventFree(fetcher->wake);
+        fetcher->wake = NULL;
+    }
+    spscFree(&fetcher->requests);
+    spscFree(&fetcher->background);
+    spscFree(&fetcher->completions);
+    downloadFree(&fetcher->download);
+}
+
+int fetcherSubmit(Fetcher* fetcher, FetchJob* job) {
+    if (spscPush(&fetcher->requests, job) != 0) {
+        return -1;
+    }
+    platformEventSignal(fetcher->wake);
+    return 0;
+}
+
+int fetcherSubmitBackground(Fetcher* fetcher, FetchJob* job) {
+    if (spscPush(&fetcher->background, job) != 0) {
+        return -1;
+    }
+    platformEventSignal(fetcher->wake);
+    return 0;
+}
+
+FetchJob* fetcherPoll(Fetcher* fetcher) {
+    return spscPop(&fetcher->completions);
+}
+
+FetchJob* fetchJobNew(const char* url) {
+    FetchJob* job = memCalloc(MEM_NETWORK, 1, sizeof *job);
+    if (job == NULL) {
+        return NULL;
+    }
+    if (setUrl(job, url) != 0) {
+        memFree(job);
+        return NULL;
+    }
+    strcpy(job->requested, job->url);
+    job->trust = -1;
+    bufferInit(&job->body, MEM_NETWORK);
+    fetchJobSetPhase(job, FETCH_QUEUED);
+    return job;
+}
+
+void fetchJobCancel(FetchJob* job) {
+    job->cancelled = 1;
+}
+
+int fetchJobPhase(const FetchJob* job) {
+    return __atomic_load_n(&job->phase, __ATOMIC_ACQUIRE);
+}
+
+size_t fetchJobBytes(const FetchJob* job) {
+    return __atomic_load_n(&job->bytes, __ATOMIC_ACQUIRE);
+}
+
+const PageSnapshot* fetchJobSnapshot(const FetchJob* job) {
+    return __atomic_load_n(&job->snapshot, __ATOMIC_ACQUIRE);
+}
+
+void fetchJobFree(FetchJob* job) {
+    bufferFree(&job->body);
+    freeDocument(&job->doc);
+    memFree(job);
+}
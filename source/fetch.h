@@ -0,0 +1,168 @@
+#ifndef FETCH_H
+#define FETCH_H
+
+#include "buffer.h"
+#include "diskcache.h"
+#include "download.h"
+#include "gemtext.h"
+#include "layout.h"
+#include "platform.h"
+#include "redirects.h"
+#include "response.h"
+#include "spsc.h"
+#include "url.h"
+
+#define FETCH_QUEUE_SIZE 16
+//Bytes of disk cache compaction the worker does between checks for new requests
+#define FETCH_COMPACT_STEP (64 * 1024)
+
+enum FetchPhase {
+    FETCH_QUEUED,
+    FETCH_RESOLVING,
+    FETCH_CONNECTING,
+    FETCH_HANDSHAKE,
+    FETCH_READING,
+    FETCH_SAVING,       //The body is going to a file
+    FETCH_DONE,
+};
+
+enum FetchError {
+    FETCH_OK = 0,
+    FETCH_CANCELLED,
+    FETCH_RESOLVE_FAILED,
+    FETCH_CONNECT_FAILED,
+    FETCH_SETUP_FAILED,
+    FETCH_HANDSHAKE_FAILED,
+    FETCH_CERT_CHANGED,
+    FETCH_SEND_FAILED,
+    FETCH_BAD_RESPONSE,
+    FETCH_RECV_FAILED,
+    FETCH_REDIRECT_LOOP,
+    FETCH_TOO_MANY_REDIRECTS,
+    FETCH_BAD_REDIRECT,     //To something that isn't a gemini url
+    FETCH_NOT_PAGE,         //Not gemtext and the job doesn't save files
+    FETCH_SAVE_FAILED,
+};
+
+//What the UI may look at while a page is still loading. Everything it points
+//at is in the page's arena and is never modified once published.
+typedef struct {
+    const Line* lines;
+    PageLayout layout;
+} PageSnapshot;
+
+//How long each step of a network fetch took, summed over any redirects. All
+//zero for a page from the disk cache.
+typedef struct {
+    uint64_t resolveUs;
+    uint64_t connectUs;
+    uint64_t handshakeUs;
+    uint64_t firstByteUs;   //Request sent to the first byte of the response
+    uint64_t readUs;        //First byte to the last
+    int dnsCached;
+    int connectAttempts;    //Addresses raced before one answered
+} FetchTimings;
+
+//A url that sent the job on somewhere else
+typedef struct {
+    char url[URL_MAX];
+    int status;         //30 or 31
+    int remembered;     //Taken from the redirect map without asking the server
+} FetchHop;
+
+//One request. The UI creates it for a url and submits it, the worker owns
+//it until it comes back through fetcherPoll, then the UI frees it.
+typedef struct {
+    char url[URL_MAX];  //Canonical, sent as is and used as the cache key. Moves on with redirects.
+    char requested[URL_MAX];    //The url the job was made for
+    char host[256];     //Without the brackets of an IPv6 literal
+    char port[6];
+    int reload;     //Skip the disk cache and ask the server
+    size_t maxBytes;    //Give up once the body gets bigger than this, 0 for no limit
+    int trustNewCert;   //Accept a certificate that changed since the last visit
+    const char* downloadDir;    //Bodies that aren't gemtext are saved in here, NULL to turn them away
+
+    //Results, only valid once the job is done
+    int error;
+    int detail;
+    GeminiHeader header;    //Of the last response, the body only ever holds what a 2x sent
+    FetchHop hops[REDIRECTS_MAX_HOPS];
+    int hopCount;
+    int fromDisk;
+    int trust;          //KnownHostResult of the server's certificate, -1 if it wasn't checked
+    char savedAs[DOWNLOAD_PATH_MAX];    //Where the body went if it wasn't gemtext, empty otherwise
+    FetchTimings timings;
+    Buffer body;        //As it came from the server, empty for a page off the disk cache
+    Document doc;
+    PageLayout layout;
+
+    //Only touched by the worker
+    uint64_t sentUs;        //For firstByteUs and readUs
+    uint64_t firstByteAtUs;
+    int bodyMode;
+    Download* download;     //The fetcher's, used when the body goes to a file
+
+    //Progress, written by the worker and read by the UI at any time
+    int phase;
+    size_t bytes;
+    const PageSnapshot* snapshot;
+    //Written by the UI, polled by the worker
+    volatile int cancelled;
+} FetchJob;
+
+//How a fetcher gets a request to a server and a response back.
+//networkInitTls (network_tls.h) is the real one, anything that can hand back
+//a Transport can stand in for it, a local server or a recorded session.
+typedef struct {
+    void* ctx;
+    //Reaches job->host and job->port and sends request, moving the job's phase
+    //and timings along. Returns FETCH_OK with the response ready to be read
+    //from *transport, otherwise a FetchError with job->detail filled in where
+    //there is one. Whatever it puts in *conn goes to close afterwards.
+    int (*open)(void* ctx, FetchJob* job, const char* request, Transport* transport, void** conn);
+    void (*close)(void* ctx, void* conn);
+} FetchNetwork;
+
+//Hands each fetcher of a pool a network of its own, for networks that can't be
+//shared between workers. make runs for a worker before it starts and release
+//once it has stopped, both on the thread that runs the pool.
+typedef struct {
+    void* ctx;
+    int (*make)(void* ctx, int worker, FetchNetwork* network);
+    void (*release)(void* ctx, int worker);
+} NetworkFactory;
+
+typedef struct {
+    FetchNetwork network;   //Only used from the worker
+    DiskCache* disk;        //May be NULL, only touched by the worker
+    RedirectMap* redirects; //May be NULL, can be shared with other fetchers
+    Download download;      //Only used by the worker
+    SpscQueue requests;     //UI -> worker
+    SpscQueue background;   //UI -> worker, only run while requests is empty
+    SpscQueue completions;  //worker -> UI
+    PlatformEvent* wake;
+    PlatformThread* thread;
+    volatile int running;
+} Fetcher;
+
+int fetcherStart(Fetcher* fetcher, const FetchNetwork* network, DiskCache* disk, RedirectMap* redirects);
+void fetcherStop(Fetcher* fetcher);
+//Returns -1 if the queue is full, the job still belongs to the caller then
+int fetcherSubmit(Fetcher* fetcher, FetchJob* job);
+//Same, for work nobody is waiting on. It never holds up a normal request for
+//longer than it takes to notice a cancel.
+int fetcherSubmitBackground(Fetcher* fetcher, FetchJob* job);
+//Next finished (or cancelled) job, NULL if none
+FetchJob* fetcherPoll(Fetcher* fetcher);
+
+//NULL unless url is an absolute gemini:// url with a host
+FetchJob* fetchJobNew(const char* url);
+void fetchJobCancel(FetchJob* job);
+int fetchJobPhase(const FetchJob* job);
+size_t fetchJobBytes(const FetchJob* job);
+const PageSnapshot* fetchJobSnapshot(const FetchJob* job);
+//For networks, on the worker
+void fetchJobSetPhase(FetchJob* job, int phase);
+void fetchJobFree(FetchJob* job);
+
+#endif
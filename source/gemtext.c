@@ -0,0 +1,267 @@
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "gemtext.h"
+#include "memstats.h"
+#include "trace.h"
+
+#define DOCUMENT_MIN_ARENA (16 * 1024)
+#define DOCUMENT_MIN_LINES 64
+
+static const char* skipSpace(const char* str, const char* end) {
+    while (str < end && isspace((unsigned char)*str)) {
+        str++;
+    }
+    return str;
+}
+
+//Tables double inside the arena, the old copy is left behind until the page is freed
+static void* growTable(Arena* arena, void* table, int* capacity, size_t entrySize) {
+    int grown = *capacity < DOCUMENT_MIN_LINES ? DOCUMENT_MIN_LINES : *capacity * 2;
+    void* resized = arenaGrow(arena, table, *capacity * entrySize, grown * entrySize);
+    if (resized != NULL) {
+        *capacity = grown;
+    }
+    return resized;
+}
+
+static void parseLink(Document* doc, const char* start, const char* end) {
+    const char* url = start;
+    const char* urlEnd = url;
+    while (urlEnd < end && !isspace((unsigned char)*urlEnd)) {
+        urlEnd++;
+    }
+
+    const char* caption = skipSpace(urlEnd, end);
+    bool hasCaption = false;
+    for (const char* c = caption; c < end; c++) {
+        if (isalnum((unsigned char)*c)) {
+            hasCaption = true;
+            break;
+        }
+    }
+
+    if (doc->linkCount == doc->linkCapacity) {
+        Link* links = growTable(&doc->arena, doc->links, &doc->linkCapacity, sizeof(Link));
+        if (links == NULL) {
+            return;
+        }
+        doc->links = links;
+    }
+    Link* link = &doc->links[doc->linkCount++];
+    link->path = url;
+    link->pathLength = urlEnd - url;
+    link->caption = hasCaption ? caption : url;
+    link->captionLength = hasCaption ? end - caption : link->pathLength;
+}
+
+//The line type only depends on the first few bytes, so look at those once
+static enum LineType classifyLine(const char* str, const char* end, int* prefixLength) {
+    if (str < end && *str == '#') {
+        int level = 1;
+        while (level < 3 && str + level < end && str[level] == '#') {
+            level++;
+        }
+        *prefixLength = level;
+        return level == 1 ? LINE_H1 : level == 2 ? LINE_H2 : LINE_H3;
+    }
+    if (end - str >= 2 && str[0] == '=' && str[1] == '>') {
+        *prefixLength = 2;
+        return LINE_LINK;
+    }
+    *prefixLength = 0;
+    return LINE_PLAIN;
+}
+
+//Room for one more line, NULL if the arena is out of memory
+static Line* newLine(Document* doc) {
+    if (doc->lineCount == doc->lineCapacity) {
+        Line* lines = growTable(&doc->arena, doc->lines, &doc->lineCapacity, sizeof(Line));
+        if (lines == NULL) {
+            return NULL;
+        }
+        doc->lines = lines;
+    }
+    return &doc->lines[doc->lineCount];
+}
+
+//lineStart..lineEnd must stay where it is for as long as the document lives
+static void parseLine(Document* doc, const char* lineStart, const char* lineEnd) {
+    //CRLF pages are common, the CR isn't part of any kind of line
+    if (lineEnd > lineStart && lineEnd[-1] == '\r') {
+        lineEnd--;
+    }
+
+    //``` turns preformatted mode on and off, the toggle line (alt text and all) isn't shown
+    if (lineEnd - lineStart >= 3 && memcmp(lineStart, "```", 3) == 0) {
+        doc->preformatted = !doc->preformatted;
+        return;
+    }
+
+    //Preformatted text is kept exactly as it is, blank lines and all
+    if (doc->preformatted) {
+        Line* line = newLine(doc);
+        if (line != NULL) {
+            line->text = lineStart;
+            line->length = lineEnd - lineStart;
+            line->type = LINE_PRE;
+            doc->lineCount++;
+        }
+        return;
+    }
+
+    //Blank lines are skipped, same as the old strtok based parser
+    if (lineEnd == lineStart) {
+        return;
+    }
+    Line* line = newLine(doc);
+    if (line == NULL) {
+        return;
+    }
+
+    //Remove preceding whitespace, I dont think this is necessary but hey
+    const char* textline = skipSpace(lineStart, lineEnd);
+    int prefixLength;
+    enum LineType type = classifyLine(textline, lineEnd, &prefixLength);
+
+    //Remove any spaces after declaration of special functions
+    textline = skipSpace(textline + prefixLength, lineEnd);
+
+    if (type == LINE_LINK) {
+        parseLink(doc, textline, lineEnd);
+    }
+
+    line->text = textline;
+    line->length = lineEnd - textline;
+    line->type = type;
+    doc->lineCount++;
+}
+
+void beginDocument(Document* doc, size_t sizeHint) {
+    memset(doc, 0, sizeof *doc);
+    //The text itself plus room for the line and link tables
+    arenaInit(&doc->arena, sizeHint ? sizeHint + sizeHint / 4 + 1024 : DOCUMENT_MIN_ARENA, MEM_DOCUMENT);
+    //Rows and offsets take a few bytes for every line
+    arenaInit(&doc->layoutArena, sizeHint ? sizeHint / 4 + 1024 : DOCUMENT_MIN_ARENA / 4, MEM_LAYOUT);
+    bufferInit(&doc->partial, MEM_DOCUMENT);
+}
+
+//The line carried over from the last chunk gets its own copy, it is the only one that needs it
+static void finishPartial(Document* doc) {
+    char* line = arenaStrndup(&doc->arena, doc->partial.data, doc->partial.length);
+    if (line != NULL) {
+        parseLine(doc, line, line + doc->partial.length);
+    }
+    bufferClear(&doc->partial);
+}
+
+static void feedChunk(Document* doc, const char* data, size_t len) {
+    const char* end = data + len;
+    if (doc->partial.length > 0) {
+        const char* lineEnd = memchr(data, '\n', len);
+        if (lineEnd == NULL) {
+            bufferAppend(&doc->partial, data, len);
+            return;
+        }
+        bufferAppend(&doc->partial, data, lineEnd - data);
+        finishPartial(doc);
+        data = lineEnd + 1;
+    }
+
+    //Everything up to the last newline is copied over in one go and scanned in place,
+    //whatever follows it waits for the next chunk
+    const char* last = end;
+    while (last > data && last[-1] != '\n') {
+        last--;
+    }
+    if (last < end) {
+        bufferAppend(&doc->partial, last, end - last);
+    }
+    if (last == data) {
+        return;
+    }
+
+    char* text = arenaAlloc(&doc->arena, last - data);
+    if (text == NULL) {
+        return;
+    }
+    memcpy(text, data, last - data);
+    const char* textEnd = text + (last - data);
+    for (const char* line = text; line < textEnd; ) {
+        //memchr goes a word at a time (or wider) in both newlib and glibc
+        const char* lineEnd = memchr(line, '\n', textEnd - line);
+        parseLine(doc, line, lineEnd);
+        line = lineEnd + 1;
+    }
+}
+
+void feedGemtext(Document* doc, const char* data, size_t len) {
+    uint64_t started = traceStart();
+    feedChunk(doc, data, len);
+    traceEnd(TRACE_PARSE, started);
+}
+
+void endDocument(Document* doc) {
+    if (doc->partial.length > 0) {
+        finishPartial(doc);
+    }
+    bufferFree(&doc->partial);
+}
+
+void parseGemtext(const char* text, Document* doc) {
+    size_t length = strlen(text);
+    beginDocument(doc, length);
+    feedGemtext(doc, text, length);
+    endDocument(doc);
+}
+
+//Blank lines and the alt text of ``` toggles are gone, everything that is
+//shown comes back the same
+int writeGemtext(const Document* doc, Buffer* out) {
+    static const char* prefixes[] = {
+        [LINE_PLAIN] = "",
+        [LINE_H1] = "# ",
+        [LINE_H2] = "## ",
+        [LINE_H3] = "### ",
+        [LINE_LINK] = "=> ",
+        [LINE_PRE] = "",
+    };
+    int failed = 0;
+    int preformatted = 0;
+    for (int i = 0; i < doc->lineCount; i++) {
+        const Line* line = &doc->lines[i];
+        if ((line->type == LINE_PRE) != preformatted) {
+            preformatted = !preformatted;
+            failed |= bufferAppend(out, "```\n", 4);
+        }
+        const char* prefix = prefixes[line->type];
+        //A plain line that is empty or starts with ``` only stays one behind a space
+        if (line->type == LINE_PLAIN && (line->length == 0 || (line->length >= 3 && memcmp(line->text, "```", 3) == 0))) {
+            prefix = " ";
+        }
+        failed |= bufferAppend(out, prefix, strlen(prefix));
+        failed |= bufferAppend(out, line->text, line->length);
+        failed |= bufferAppend(out, "\n", 1);
+    }
+    return failed ? -1 : 0;
+}
+
+void freeDocument(Document* doc) {
+    arenaFree(&doc->arena);
+    arenaFree(&doc->layoutArena);
+    bufferFree(&doc->partial);
+    doc->lines = NULL;
+    doc->lineCount = 0;
+    doc->lineCapacity = 0;
+    doc->links = NULL;
+    doc->linkCount = 0;
+    doc->linkCapacity = 0;
+}
+
+void documentSetAccounts(Document* doc, int account, int layoutAccount) {
+    arenaSetAccount(&doc->arena, account);
+    arenaSetAccount(&doc->layoutArena, layoutAccount);
+    memMove(doc->partial.account, account, doc->partial.capacity);
+    doc->partial.account = account;
+}
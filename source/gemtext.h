@@ -0,0 +1,61 @@
+#ifndef GEMTEXT_H
+#define GEMTEXT_H
+
+#include <stddef.h>
+
+#include "arena.h"
+#include "buffer.h"
+
+enum LineType {
+    LINE_PLAIN,
+    LINE_H1,
+    LINE_H2,
+    LINE_H3,
+    LINE_LINK,
+    LINE_PRE,   //Between ``` toggles, shown as is and never wrapped
+};
+
+//Lines and links are views into the page text, they are not null terminated
+typedef struct {
+    const char* path;
+    int pathLength;
+    const char* caption;
+    int captionLength;
+} Link;
+
+typedef struct {
+    const char* text;
+    int length;
+    enum LineType type;
+} Line;
+
+//A parsed page. Built once per navigation, everything lives in the arena and
+//its layout (see layoutDocument) in a second one, so the two are counted apart.
+//Can be fed a chunk at a time while the body is still arriving. Each chunk is
+//copied into the arena once and scanned in place, only a line split across
+//two chunks gets a copy of its own.
+typedef struct {
+    Arena arena;
+    Arena layoutArena;
+    Line* lines;
+    int lineCount;
+    int lineCapacity;
+    Link* links;
+    int linkCount;
+    int linkCapacity;
+    Buffer partial;     //Unfinished last line of the chunks fed so far
+    int preformatted;   //Inside a ``` block
+} Document;
+
+//sizeHint is the expected body length if known, 0 otherwise
+void beginDocument(Document* doc, size_t sizeHint);
+void feedGemtext(Document* doc, const char* data, size_t len);
+void endDocument(Document* doc);
+void parseGemtext(const char* text, Document* doc);
+//The document as gemtext again, parsing it gives back the same lines and links
+int writeGemtext(const Document* doc, Buffer* out);
+void freeDocument(Document* doc);
+//Charges the document to other MemAccounts, for a page moving in or out of a cache
+void documentSetAccounts(Document* doc, int account, int layoutAccount);
+
+#endif
@@ -0,0 +1,42 @@
+#include <stdlib.h>
+
+#include "glyphs.h"
+#include "memstats.h"
+
+static uint16_t toUnits(float advance) {
+    float units = advance * GLYPH_UNIT + 0.5f;
+    return units < 0 ? 0 : units > UINT16_MAX ? UINT16_MAX : (uint16_t)units;
+}
+
+int glyphTableInit(GlyphTable* table, float fallback, float lineFeed) {
+    table->advances = memAlloc(MEM_UI, GLYPH_TABLE_SIZE * sizeof *table->advances);
+    if (table->advances == NULL) {
+        return -1;
+    }
+    table->fallback = toUnits(fallback);
+    table->lineFeed = lineFeed;
+    for (int i = 0; i < GLYPH_TABLE_SIZE; i++) {
+        table->advances[i] = table->fallback;
+    }
+    return 0;
+}
+
+void glyphTableSet(GlyphTable* table, uint32_t codepoint, float advance) {
+    if (codepoint < GLYPH_TABLE_SIZE) {
+        table->advances[codepoint] = toUnits(advance);
+    }
+}
+
+void glyphTableFree(GlyphTable* table) {
+    memFree(table->advances);
+    table->advances = NULL;
+}
+
+float glyphMeasure(const GlyphTable* table, const char* text, int length, float scale) {
+    int width = 0;
+    int size;
+    for (int i = 0; i < length; i += size) {
+        width += glyphAdvance(table, text + i, length - i, &size);
+    }
+    return width * scale / GLYPH_UNIT;
+}
@@ -0,0 +1,52 @@
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <stdint.h>
+
+//Covers the whole Basic Multilingual Plane, anything past it gets the fallback
+#define GLYPH_TABLE_SIZE 0x10000
+//Advances are stored in 1/64ths of a pixel
+#define GLYPH_UNIT 64
+
+//How far the pen moves for every character of the font at scale 1, filled in
+//once when the font is loaded so layout never has to ask the font.
+typedef struct {
+    uint16_t* advances;
+    uint16_t fallback;  //For characters the font doesn't have, and invalid UTF-8
+    float lineFeed;     //Pixels between rows at scale 1
+} GlyphTable;
+
+//Every character starts out with the fallback advance (in pixels)
+int glyphTableInit(GlyphTable* table, float fallback, float lineFeed);
+void glyphTableSet(GlyphTable* table, uint32_t codepoint, float advance);
+void glyphTableFree(GlyphTable* table);
+
+//Decodes the character at text and returns its advance in GLYPH_UNITs at
+//scale 1, *size gets its length in bytes (at least 1)
+static inline int glyphAdvance(const GlyphTable* table, const char* text, int length, int* size) {
+    unsigned char c = text[0];
+    if (c < 0x80) {
+        *size = 1;
+        return table->advances[c];
+    }
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    if (extra == 0 || extra >= length) {
+        *size = 1;
+        return table->fallback;
+    }
+    uint32_t codepoint = c & (0x3F >> extra);
+    for (int i = 1; i <= extra; i++) {
+        if (((unsigned char)text[i] & 0xC0) != 0x80) {
+            *size = i;
+            return table->fallback;
+        }
+        codepoint = (codepoint << 6) | ((unsigned char)text[i] & 0x3F);
+    }
+    *size = extra + 1;
+    return codepoint < GLYPH_TABLE_SIZE ? table->advances[codepoint] : table->fallback;
+}
+
+//Width of a run of text in pixels
+float glyphMeasure(const GlyphTable* table, const char* text, int length, float scale);
+
+#endif
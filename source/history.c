@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "history.h"
+
+void historyInit(History* history) {
+    history->count = 0;
+    history->current = -1;
+}
+
+void historyVisit(History* history, const char* url) {
+    //Reloading the page we are on doesn't add an entry, or lose the ones after it
+    if (history->current >= 0 && strcmp(history->urls[history->current], url) == 0) {
+        return;
+    }
+
+    history->count = history->current + 1;
+    if (history->count == HISTORY_MAX) {
+        memmove(history->urls[0], history->urls[1], (HISTORY_MAX - 1) * PAGE_URL_SIZE);
+        history->count--;
+    }
+    snprintf(history->urls[history->count], PAGE_URL_SIZE, "%s", url);
+    history->current = history->count++;
+}
+
+const char* historyBack(History* history) {
+    if (history->current <= 0) {
+        return NULL;
+    }
+    return history->urls[--history->current];
+}
+
+const char* historyForward(History* history) {
+    if (history->current + 1 >= history->count) {
+        return NULL;
+    }
+    return history->urls[++history->current];
+}
+
+const char* historyCurrent(const History* history) {
+    return history->current >= 0 ? history->urls[history->current] : NULL;
+}
@@ -0,0 +1,23 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "pagecache.h"
+
+#define HISTORY_MAX 64
+
+//Back/forward stack of visited urls. Entries after `current` are the forward
+//history, visiting a new page throws them away.
+typedef struct {
+    char urls[HISTORY_MAX][PAGE_URL_SIZE];
+    int count;
+    int current;
+} History;
+
+void historyInit(History* history);
+void historyVisit(History* history, const char* url);
+//Move back or forward, returns the url to show or NULL at either end
+const char* historyBack(History* history);
+const char* historyForward(History* history);
+const char* historyCurrent(const History* history);
+
+#endif
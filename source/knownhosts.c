@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "knownhosts.h"
+#include "memstats.h"
+
+#define KNOWN_HOSTS_MAGIC 0x31484B47    //"GKH1"
+#define KNOWN_HOSTS_VERSION 1
+#define KNOWN_HOSTS_MIN_SLOTS 256
+//Slots read per fread while walking a probe run, most lookups need only the first
+#define KNOWN_HOSTS_READ_SLOTS 4
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t count;
+} KnownHostsHeader;
+
+static uint64_t hashKey(const char* host, const char* port) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* c = host; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    hash = (hash ^ ':') * 1099511628211ull;
+    for (const char* c = port; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ull;
+    }
+    return hash != 0 ? hash : 1;
+}
+
+static long slotOffset(uint32_t index) {
+    return (long)(sizeof(KnownHostsHeader) + (size_t)index * sizeof(KnownHostSlot));
+}
+
+static int writeHeader(FILE* file, uint32_t capacity, uint32_t count) {
+    KnownHostsHeader header = { KNOWN_HOSTS_MAGIC, KNOWN_HOSTS_VERSION, capacity, count };
+    return fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, file) == 1 ? 0 : -1;
+}
+
+//An empty table of the given size, written to path in one go
+static FILE* createFile(const char* path, const KnownHostSlot* slots, uint32_t capacity, uint32_t count) {
+    FILE* file = fopen(path, "w+b");
+    if (file == NULL) {
+        return NULL;
+    }
+    KnownHostSlot* empty = NULL;
+    if (slots == NULL) {
+        slots = empty = memCalloc(MEM_NETWORK, capacity, sizeof *empty);
+    }
+    int failed = slots == NULL || writeHeader(file, capacity, count) != 0 ||
+                 fwrite(slots, sizeof *slots, capacity, file) != capacity || fflush(file) != 0;
+    memFree(empty);
+    if (failed) {
+        fclose(file);
+        remove(path);
+        return NULL;
+    }
+    return file;
+}
+
+//Walks the probe run of hash, returns the index of its slot or of the empty
+//slot ending the run, -1 if the file couldn't be read
+static int64_t probe(KnownHosts* hosts, uint64_t hash, KnownHostSlot* found) {
+    uint32_t mask = hosts->capacity - 1;
+    uint32_t index = hash & mask;
+    KnownHostSlot slots[KNOWN_HOSTS_READ_SLOTS];
+    for (uint32_t seen = 0; seen < hosts->capacity;) {
+        //Reads stop at the end of the table, the run carries on from slot 0
+        uint32_t want = hosts->capacity - index < KNOWN_HOSTS_READ_SLOTS ? hosts->capacity - index : KNOWN_HOSTS_READ_SLOTS;
+        if (fseek(hosts->file, slotOffset(index), SEEK_SET) != 0 ||
+            fread(slots, sizeof *slots, want, hosts->file) != want) {
+            return -1;
+        }
+        hosts->slotReads++;
+        for (uint32_t i = 0; i < want; i++, seen++) {
+            if (slots[i].hash == hash || slots[i].hash == 0) {
+                *found = slots[i];
+                return index + i;
+            }
+        }
+        index = (index + want) & mask;
+    }
+    return -1;
+}
+
+static int writeSlot(KnownHosts* hosts, uint32_t index, const KnownHostSlot* slot) {
+    if (fseek(hosts->file, slotOffset(index), SEEK_SET) != 0 || fwrite(slot, sizeof *slot, 1, hosts->file) != 1) {
+        return -1;
+    }
+    return fflush(hosts->file) == 0 ? 0 : -1;
+}
+
+//Opens path if it holds a whole table, NULL otherwise
+static FILE* openTable(const char* path, KnownHostsHeader* header) {
+    FILE* file = fopen(path, "r+b");
+    if (file == NULL) {
+        return NULL;
+    }
+    int valid = fread(header, sizeof *header, 1, file) == 1 &&
+                header->magic == KNOWN_HOSTS_MAGIC && header->version == KNOWN_HOSTS_VERSION &&
+                header->capacity >= KNOWN_HOSTS_MIN_SLOTS && (header->capacity & (header->capacity - 1)) == 0 &&
+                header->count < header->capacity &&
+                fseek(file, 0, SEEK_END) == 0 && ftell(file) == slotOffset(header->capacity);
+    if (!valid) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+//Doubles the table. The new one is written to path.new and renamed over the
+//old, until that has gone through the old table stays open and in use. FAT
+//won't rename over a file so the old one has to be removed first there, a
+//crash in between leaves only path.new and knownHostsOpen picks it up.
+static int grow(KnownHosts* hosts) {
+    uint32_t capacity = hosts->capacity * 2;
+    KnownHostSlot* old = memAlloc(MEM_NETWORK, hosts->capacity * sizeof *old);
+    KnownHostSlot* slots = memCalloc(MEM_NETWORK, capacity, sizeof *slots);
+    if (old == NULL || slots == NULL ||
+        fseek(hosts->file, slotOffset(0), SEEK_SET) != 0 ||
+        fread(old, sizeof *old, hosts->capacity, hosts->file) != hosts->capacity) {
+        memFree(old);
+        memFree(slots);
+        return -1;
+    }
+    for (uint32_t i = 0; i < hosts->capacity; i++) {
+        if (old[i].hash != 0) {
+            uint32_t index = old[i].hash & (capacity - 1);
+            while (slots[index].hash != 0) {
+                index = (index + 1) & (capacity - 1);
+            }
+            slots[index] = old[i];
+        }
+    }
+    memFree(old);
+
+    char temp[sizeof hosts->path + 4];
+    snprintf(temp, sizeof temp, "%s.new", hosts->path);
+    FILE* file = createFile(temp, slots, capacity, hosts->count);
+    memFree(slots);
+    if (file == NULL) {
+        return -1;
+    }
+    fclose(file);
+
+    if (rename(temp, hosts->path) != 0) {
+        fclose(hosts->file);
+        if (remove(hosts->path) != 0) {
+            //Still there and still whole, carry on with it
+            remove(temp);
+            hosts->file = fopen(hosts->path, "r+b");
+            return -1;
+        }
+        if (rename(temp, hosts->path) != 0) {
+            //Only path.new is left, keep using it from there
+            hosts->file = fopen(temp, "r+b");
+            if (hosts->file == NULL) {
+                return -1;
+            }
+            hosts->capacity = capacity;
+            return 0;
+        }
+        hosts->file = NULL;
+    }
+
+    file = fopen(hosts->path, "r+b");
+    if (file == NULL) {
+        return -1;
+    }
+    if (hosts->file != NULL) {
+        fclose(hosts->file);
+    }
+    hosts->file = file;
+    hosts->capacity = capacity;
+    return 0;
+}
+
+int knownHostsOpen(KnownHosts* hosts, const char* path) {
+    memset(hosts, 0, sizeof *hosts);
+    snprintf(hosts->path, sizeof hosts->path, "%s", path);
+    hosts->lock = platformMutexNew();
+    if (hosts->lock == NULL) {
+        return -1;
+    }
+
+    //Only the header is read, the table stays on the card. Without a good
+    //table at path a grow was cut short and path.new has the whole one.
+    char spare[sizeof hosts->path + 4];
+    snprintf(spare, sizeof spare, "%s.new", path);
+    KnownHostsHeader header;
+    hosts->file = openTable(path, &header);
+    if (hosts->file == NULL && (hosts->file = openTable(spare, &header)) != NULL) {
+        fclose(hosts->file);
+        remove(path);
+        hosts->file = rename(spare, path) == 0 ? openTable(path, &header) : openTable(spare, &header);
+    } else {
+        remove(spare);
+    }
+    if (hosts->file != NULL) {
+        hosts->capacity = header.capacity;
+        hosts->count = header.count;
+        return 0;
+    }
+
+    hosts->file = createFile(path, NULL, KNOWN_HOSTS_MIN_SLOTS, 0);
+    if (hosts->file == NULL) {
+        knownHostsClose(hosts);
+        return -1;
+    }
+    hosts->capacity = KNOWN_HOSTS_MIN_SLOTS;
+    return 0;
+}
+
+void knownHostsClose(KnownHosts* hosts) {
+    if (hosts->file != NULL) {
+        fclose(hosts->file);
+        hosts->file = NULL;
+    }
+    if (hosts->lock != NULL) {
+        platformMutexFree(hosts->lock);
+        hosts->lock = NULL;
+    }
+}
+
+int knownHostsCheck(KnownHosts* hosts, const char* host, const char* port, const uint8_t fingerprint[KNOWN_HOST_FINGERPRINT_SIZE], int replace) {
+    uint64_t hash = hashKey(host, port);
+    int result = KNOWN_HOST_NEW;
+    platformMutexLock(hosts->lock);
+    hosts->lookups++;
+
+    KnownHostSlot slot;
+    int64_t index = hosts->file != NULL ? probe(hosts, hash, &slot) : -1;
+    if (index < 0) {
+        //Without the store every server looks new, better than refusing them all
+        platformMutexUnlock(hosts->lock);
+        return KNOWN_HOST_NEW;
+    }
+
+    uint32_t now = (uint32_t)time(NULL);
+    if (slot.hash == hash) {
+        if (memcmp(slot.fingerprint, fingerprint, KNOWN_HOST_FINGERPRINT_SIZE) == 0) {
+            result = KNOWN_HOST_MATCH;
+        } else if (replace) {
+            memcpy(slot.fingerprint, fingerprint, KNOWN_HOST_FINGERPRINT_SIZE);
+            slot.trusted = now;
+            writeSlot(hosts, index, &slot);
+            result = KNOWN_HOST_REPLACED;
+        } else {
+            result = KNOWN_HOST_CHANGED;
+        }
+    } else {
+        //Kept under three quarters full so probe runs stay short
+        if ((hosts->count + 1) * 4 > hosts->capacity * 3) {
+            if (grow(hosts) != 0 || (index = probe(hosts, hash, &slot)) < 0) {
+                platformMutexUnlock(hosts->lock);
+                return KNOWN_HOST_NEW;
+            }
+        }
+        slot.hash = hash;
+        memcpy(slot.fingerprint, fingerprint, KNOWN_HOST_FINGERPRINT_SIZE);
+        slot.firstSeen = now;
+        slot.trusted = now;
+        if (writeSlot(hosts, index, &slot) == 0) {
+            hosts->count++;
+            writeHeader(hosts->file, hosts->capacity, hosts->count);
+            fflush(hosts->file);
+        }
+    }
+    platformMutexUnlock(hosts->lock);
+    return result;
+}
@@ -0,0 +1,52 @@
+#ifndef KNOWNHOSTS_H
+#define KNOWNHOSTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "platform.h"
+
+//Trust on first use. The first certificate a server shows is remembered and
+//every later visit has to show the same one.
+//
+//known_hosts.bin is a header followed by an open addressing hash table of
+//slots, keyed by a 64 bit hash of host:port. Nothing is loaded up front, a
+//lookup reads the few slots of its probe run straight from the file, so it
+//costs the same with ten hosts or ten thousand. Everything is stored in
+//native byte order.
+
+#define KNOWN_HOST_FINGERPRINT_SIZE 32  //SHA-256 of the DER certificate
+
+enum KnownHostResult {
+    KNOWN_HOST_NEW,         //Never seen, it is trusted from now on
+    KNOWN_HOST_MATCH,
+    KNOWN_HOST_CHANGED,     //Shows a different certificate than last time
+    KNOWN_HOST_REPLACED,    //Changed, and the new certificate was trusted as asked
+};
+
+typedef struct {
+    uint64_t hash;      //0 marks an empty slot
+    uint8_t fingerprint[KNOWN_HOST_FINGERPRINT_SIZE];
+    uint32_t firstSeen;
+    uint32_t trusted;   //When the current fingerprint was first seen
+} KnownHostSlot;
+
+//Shared by every fetch worker, the lock keeps their reads and writes apart
+typedef struct {
+    char path[256];
+    FILE* file;
+    uint32_t capacity;  //Power of two
+    uint32_t count;
+    PlatformMutex* lock;
+    unsigned long lookups;
+    unsigned long slotReads;
+} KnownHosts;
+
+//A missing or damaged file starts an empty store
+int knownHostsOpen(KnownHosts* hosts, const char* path);
+void knownHostsClose(KnownHosts* hosts);
+//Compares a server's fingerprint with the one on record and records it if the
+//server is new. With replace set a changed fingerprint replaces the old one.
+int knownHostsCheck(KnownHosts* hosts, const char* host, const char* port, const uint8_t fingerprint[KNOWN_HOST_FINGERPRINT_SIZE], int replace);
+
+#endif
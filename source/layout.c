@@ -0,0 +1,226 @@
+#include <ctype.h>
+#include <math.h>
+
+#include "layout.h"
+#include "trace.h"
+
+//Without a glyph table every character is this wide at scale 1, about what the old
+//fixed characters-per-line guess came to
+#define FALLBACK_ADVANCE (12 * GLYPH_UNIT)
+#define FALLBACK_LINE_FEED 30
+#define MIN_ROWS 64
+
+//Good offsets, they look nice and group wrapped lines together
+static const LineStyle lineStyles[] = {
+    [LINE_PLAIN] = { .6, 0, 4, 1 },
+    [LINE_H1]    = { 1,  0, 6, 1 },
+    [LINE_H2]    = { .8, 0, 4, 1 },
+    [LINE_H3]    = { .7, 0, 5, 1 },
+    [LINE_LINK]  = { .6, 6, 0, 1 },
+    [LINE_PRE]   = { .5, 0, 0, 0 },
+};
+
+#define STYLE_COUNT (int)(sizeof lineStyles / sizeof lineStyles[0])
+
+static const GlyphTable* fontGlyphs = NULL;
+static int wrapWidth = 388;
+static int rowHeights[STYLE_COUNT];
+
+void layoutSetFont(const GlyphTable* glyphs, int width) {
+    fontGlyphs = glyphs;
+    wrapWidth = width;
+    float lineFeed = glyphs != NULL ? glyphs->lineFeed : FALLBACK_LINE_FEED;
+    for (int i = 0; i < STYLE_COUNT; i++) {
+        rowHeights[i] = ceilf(lineFeed * lineStyles[i].scale);
+    }
+}
+
+const LineStyle* lineStyle(enum LineType type) {
+    return &lineStyles[type];
+}
+
+int rowHeight(enum LineType type) {
+    if (rowHeights[type] == 0) {
+        layoutSetFont(fontGlyphs, wrapWidth);
+    }
+    return rowHeights[type];
+}
+
+static int advance(const char* text, int length, int* size) {
+    if (fontGlyphs == NULL) {
+        *size = 1;
+        return FALLBACK_ADVANCE;
+    }
+    return glyphAdvance(fontGlyphs, text, length, size);
+}
+
+void resetLayout(PageLayout* layout) {
+    layout->offsets = NULL;
+    layout->firstRows = NULL;
+    layout->lineCount = 0;
+    layout->capacity = 0;
+    layout->rows = NULL;
+    layout->rowCount = 0;
+    layout->rowCapacity = 0;
+    layout->preWidth = 0;
+}
+
+static int addRow(Document* doc, PageLayout* layout, int start, int length) {
+    if (layout->rowCount == layout->rowCapacity) {
+        int capacity = layout->rowCapacity < MIN_ROWS ? MIN_ROWS : layout->rowCapacity * 2;
+        LayoutRow* rows = arenaGrow(&doc->layoutArena, layout->rows, layout->rowCapacity * sizeof(LayoutRow), capacity * sizeof(LayoutRow));
+        if (rows == NULL) {
+            return -1;
+        }
+        layout->rows = rows;
+        layout->rowCapacity = capacity;
+    }
+    LayoutRow* row = &layout->rows[layout->rowCount++];
+    row->start = start;
+    row->length = length;
+    return 0;
+}
+
+//Breaks a line into rows at the last space that fits, a word wider than a
+//whole row is cut where it runs out of room. Widths are kept in GLYPH_UNITs at
+//scale 1 so each character costs one table lookup and an add.
+static int wrapLine(Document* doc, PageLayout* layout, const Line* line) {
+    const LineStyle* style = lineStyle(line->type);
+    const char* text = line->text;
+    int length = line->length;
+    int size;
+
+    if (!style->wrap) {
+        int width = 0;
+        for (int i = 0; i < length; i += size) {
+            width += advance(text + i, length - i, &size);
+        }
+        width = ceilf(width * style->scale / GLYPH_UNIT);
+        if (width > layout->preWidth) {
+            layout->preWidth = width;
+        }
+        return addRow(doc, layout, 0, length);
+    }
+
+    int limit = wrapWidth * GLYPH_UNIT / style->scale;
+    int start = 0;          //Of the row being filled
+    int width = 0;          //From start up to i
+    int breakAt = -1;       //End of the last word on the row, it can end there
+    int resumeAt = 0;       //Past the spaces after breakAt, where the next row would start
+    int resumeWidth = 0;    //From start up to resumeAt
+    int i = 0;
+    while (i < length) {
+        int glyph = advance(text + i, length - i, &size);
+        if (isspace((unsigned char)text[i])) {
+            if (i > start && !isspace((unsigned char)text[i - 1])) {
+                breakAt = i;
+            }
+            width += glyph;
+            i += size;
+            resumeAt = i;
+            resumeWidth = width;
+            continue;
+        }
+        //Spaces may hang off the end of a row, anything else starts a new one
+        if (width + glyph > limit && i > start) {
+            if (breakAt > start) {
+                if (addRow(doc, layout, start, breakAt - start) != 0) {
+                    return -1;
+                }
+                start = resumeAt;
+                width -= resumeWidth;
+            } else {
+                if (addRow(doc, layout, start, i - start) != 0) {
+                    return -1;
+                }
+                start = i;
+                width = 0;
+            }
+            breakAt = -1;
+            continue;
+        }
+        width += glyph;
+        i += size;
+    }
+
+    int end = length;
+    while (end > start && isspace((unsigned char)text[end - 1])) {
+        end--;
+    }
+    //Every line gets at least one row, even an empty one
+    if (end > start || layout->rowCount == layout->firstRows[layout->lineCount]) {
+        return addRow(doc, layout, start, end - start);
+    }
+    return 0;
+}
+
+static void layoutLines(Document* doc, PageLayout* layout) {
+    if (doc->lineCount + 1 > layout->capacity) {
+        int capacity = doc->lineCapacity + 1;
+        int* offsets = arenaGrow(&doc->layoutArena, layout->offsets, layout->capacity * sizeof(int), capacity * sizeof(int));
+        int* firstRows = offsets != NULL ? arenaGrow(&doc->layoutArena, layout->firstRows, layout->capacity * sizeof(int), capacity * sizeof(int)) : NULL;
+        if (offsets == NULL || firstRows == NULL) {
+            return;
+        }
+        if (layout->offsets == NULL) {
+            offsets[0] = 0;
+            firstRows[0] = 0;
+        }
+        layout->offsets = offsets;
+        layout->firstRows = firstRows;
+        layout->capacity = capacity;
+    }
+
+    int offset = layout->offsets[layout->lineCount];
+    while (layout->lineCount < doc->lineCount) {
+        const Line* line = &doc->lines[layout->lineCount];
+        const LineStyle* style = lineStyle(line->type);
+        int firstRow = layout->rowCount;
+        layout->offsets[layout->lineCount] = offset;
+        layout->firstRows[layout->lineCount] = firstRow;
+        //Out of memory, leave the line for the next call
+        if (wrapLine(doc, layout, line) != 0) {
+            layout->rowCount = firstRow;
+            break;
+        }
+        offset += style->top + (layout->rowCount - firstRow) * rowHeight(line->type) + style->bottom;
+        layout->lineCount++;
+    }
+    layout->offsets[layout->lineCount] = offset;
+    layout->firstRows[layout->lineCount] = layout->rowCount;
+}
+
+void layoutDocument(Document* doc, PageLayout* layout) {
+    uint64_t started = traceStart();
+    layoutLines(doc, layout);
+    traceEnd(TRACE_LAYOUT, started);
+}
+
+int layoutHeight(const PageLayout* layout) {
+    return layout->offsets != NULL ? layout->offsets[layout->lineCount] : 0;
+}
+
+int layoutVisibleLines(const PageLayout* layout, int top, int bottom, int* end) {
+    if (layout->offsets == NULL) {
+        *end = 0;
+        return 0;
+    }
+    //First line whose bottom edge is below the top of the view
+    int low = 0;
+    int high = layout->lineCount;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (layout->offsets[mid + 1] <= top) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    int last = low;
+    while (last < layout->lineCount && layout->offsets[last] < bottom) {
+        last++;
+    }
+    *end = last;
+    return low;
+}
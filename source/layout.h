@@ -0,0 +1,48 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "gemtext.h"
+#include "glyphs.h"
+
+//One row of a wrapped line, a view into the line's text
+typedef struct {
+    int start;      //Byte offset into the line's text
+    int length;
+} LayoutRow;
+
+//Where every line of a document goes, built once per page.
+//offsets[i] is the top of line i, offsets[lineCount] is the page height.
+//The rows of line i are rows[firstRows[i]] up to rows[firstRows[i + 1]].
+typedef struct {
+    int* offsets;
+    int* firstRows;
+    int lineCount;
+    int capacity;
+    LayoutRow* rows;
+    int rowCount;
+    int rowCapacity;
+    int preWidth;   //Widest preformatted line in pixels, how far the page scrolls sideways
+} PageLayout;
+
+typedef struct {
+    float scale;
+    int top;        //Space above the first row
+    int bottom;     //Space below the last row
+    int wrap;       //0 for lines that run off the side instead
+} LineStyle;
+
+//Metrics every layout is done with. Call before laying anything out, without
+//it every character counts as the same width.
+void layoutSetFont(const GlyphTable* glyphs, int wrapWidth);
+const LineStyle* lineStyle(enum LineType type);
+//Distance between the rows of a wrapped line
+int rowHeight(enum LineType type);
+void resetLayout(PageLayout* layout);
+//Lays out any lines added since the last call in one pass over their text.
+//Everything comes out of the document's arena so it goes away with it.
+void layoutDocument(Document* doc, PageLayout* layout);
+int layoutHeight(const PageLayout* layout);
+//Range of lines overlapping [top, bottom), returns the first and sets *end past the last
+int layoutVisibleLines(const PageLayout* layout, int top, int bottom, int* end);
+
+#endif
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+
+#include "linktable.h"
+#include "memstats.h"
+
+//First slot whose bottom edge is below y
+static int firstEndingAfter(const LinkTable* table, int y) {
+    int low = 0;
+    int high = table->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (table->slots[mid].y + table->slots[mid].height <= y) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+void linkTableInit(LinkTable* table) {
+    table->slots = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->height = 0;
+}
+
+int linkTableBuild(LinkTable* table, const Document* doc, int rowHeight) {
+    table->count = 0;
+    table->height = 0;
+    if (doc->linkCount > table->capacity) {
+        LinkSlot* slots = memRealloc(MEM_UI, table->slots, doc->linkCount * sizeof(LinkSlot));
+        if (slots == NULL) {
+            return -1;
+        }
+        table->slots = slots;
+        table->capacity = doc->linkCount;
+    }
+
+    for (int i = 0; i < doc->linkCount; i++) {
+        LinkSlot* slot = &table->slots[table->count++];
+        slot->link = i;
+        slot->y = table->height;
+        slot->height = rowHeight;
+        table->height += rowHeight;
+    }
+    return 0;
+}
+
+int linkTableHit(const LinkTable* table, int y) {
+    int i = firstEndingAfter(table, y);
+    if (i < table->count && table->slots[i].y <= y) {
+        return i;
+    }
+    return -1;
+}
+
+int linkTableVisible(const LinkTable* table, int top, int bottom, int* end) {
+    int first = firstEndingAfter(table, top);
+    int last = first;
+    while (last < table->count && table->slots[last].y < bottom) {
+        last++;
+    }
+    *end = last;
+    return first;
+}
+
+void linkTableFree(LinkTable* table) {
+    memFree(table->slots);
+    linkTableInit(table);
+}
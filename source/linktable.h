@@ -0,0 +1,32 @@
+#ifndef LINKTABLE_H
+#define LINKTABLE_H
+
+#include "gemtext.h"
+
+//Where a link's button sits in the link list
+typedef struct {
+    int link;   //Index into the document's links
+    int y;
+    int height;
+} LinkSlot;
+
+//The link list of the current page. Url and caption stay in the document,
+//this only adds geometry. Slots are sorted by y and don't overlap so finding
+//the one under a touch is a binary search.
+typedef struct {
+    LinkSlot* slots;
+    int count;
+    int capacity;
+    int height;     //Of the whole list
+} LinkTable;
+
+void linkTableInit(LinkTable* table);
+//One row of rowHeight per link, returns -1 if out of memory
+int linkTableBuild(LinkTable* table, const Document* doc, int rowHeight);
+//Slot at list position y, -1 if none
+int linkTableHit(const LinkTable* table, int y);
+//Range of slots overlapping [top, bottom), returns the first and sets *end past the last
+int linkTableVisible(const LinkTable* table, int top, int bottom, int* end);
+void linkTableFree(LinkTable* table);
+
+#endif
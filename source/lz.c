@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+#include "memstats.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+//Matches stop short of the end, the last few bytes always go out as literals
+#define LZ_END_LITERALS 5
+#define LZ_DECODE_SIZE (LZ_WINDOW + LZ_CHUNK)
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof value);
+    return value;
+}
+
+static uint32_t hash4(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned char* putLength(unsigned char* out, size_t length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = length;
+    return out;
+}
+
+//A match length of 0 is the last sequence, literals only
+static unsigned char* putSequence(unsigned char* out, const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength) {
+    unsigned char* token = out++;
+    *token = (literalLength < 15 ? literalLength : 15) << 4;
+    if (literalLength >= 15) {
+        out = putLength(out, literalLength - 15);
+    }
+    memcpy(out, literals, literalLength);
+    out += literalLength;
+    if (matchLength > 0) {
+        size_t extra = matchLength - LZ_MIN_MATCH;
+        *token |= extra < 15 ? extra : 15;
+        *out++ = offset & 0xFF;
+        *out++ = offset >> 8;
+        if (extra >= 15) {
+            out = putLength(out, extra - 15);
+        }
+    }
+    return out;
+}
+
+size_t lzBound(size_t len) {
+    return len + len / 255 + 16;
+}
+
+int lzCompress(const char* data, size_t len, Buffer* buffer) {
+    uint32_t* table = memCalloc(buffer->account, 1 << LZ_HASH_BITS, sizeof *table);
+    if (table == NULL || bufferReserve(buffer, buffer->length + lzBound(len)) != 0) {
+        memFree(table);
+        return -1;
+    }
+
+    const unsigned char* in = (const unsigned char*)data;
+    unsigned char* out = (unsigned char*)buffer->data + buffer->length;
+    size_t anchor = 0;
+    size_t i = 0;
+    size_t limit = len > LZ_END_LITERALS ? len - LZ_END_LITERALS : 0;
+    while (i + LZ_MIN_MATCH <= limit) {
+        uint32_t value = read32(in + i);
+        uint32_t* slot = &table[hash4(value)];
+        size_t candidate = *slot;
+        *slot = i;
+        if (candidate >= i || i - candidate > LZ_MAX_OFFSET || read32(in + candidate) != value) {
+            //Step faster the longer nothing matches, data that doesn't compress goes by quickly
+            i += 1 + ((i - anchor) >> 6);
+            continue;
+        }
+        size_t length = LZ_MIN_MATCH;
+        while (i + length < limit && in[candidate + length] == in[i + length]) {
+            length++;
+        }
+        while (i > anchor && candidate > 0 && in[i - 1] == in[candidate - 1]) {
+            i--;
+            candidate--;
+            length++;
+        }
+        out = putSequence(out, in + anchor, i - anchor, i - candidate, length);
+        i += length;
+        anchor = i;
+    }
+    out = putSequence(out, in + anchor, len - anchor, 0, 0);
+
+    buffer->length = (char*)out - buffer->data;
+    buffer->data[buffer->length] = '\0';
+    memFree(table);
+    return 0;
+}
+
+typedef struct {
+    char* window;
+    size_t pos;
+    size_t flushed;     //Everything before this has gone to the sink
+    size_t total;       //Decoded so far, matches can't reach back past the start
+    LzSink sink;
+    void* user;
+} LzOutput;
+
+static void flush(LzOutput* out) {
+    if (out->pos > out->flushed) {
+        out->sink(out->user, out->window + out->flushed, out->pos - out->flushed);
+    }
+    out->flushed = out->pos;
+}
+
+//A full window passes its text on and keeps the last LZ_WINDOW bytes for matches to copy from
+static void slide(LzOutput* out) {
+    flush(out);
+    memmove(out->window, out->window + out->pos - LZ_WINDOW, LZ_WINDOW);
+    out->pos = LZ_WINDOW;
+    out->flushed = LZ_WINDOW;
+}
+
+static int readLength(const unsigned char** in, const unsigned char* end, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*in == end) {
+            return -1;
+        }
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+int lzDecode(const char* data, size_t len, LzSink sink, void* user) {
+    LzOutput out = { memAlloc(MEM_OTHER, LZ_DECODE_SIZE), 0, 0, 0, sink, user };
+    if (out.window == NULL) {
+        return -1;
+    }
+
+    const unsigned char* in = (const unsigned char*)data;
+    const unsigned char* end = in + len;
+    int ret = -1;
+    while (in < end) {
+        unsigned int token = *in++;
+        size_t literals = token >> 4;
+        if ((literals == 15 && readLength(&in, end, &literals) != 0) || literals > (size_t)(end - in)) {
+            break;
+        }
+        while (literals > 0) {
+            if (out.pos == LZ_DECODE_SIZE) {
+                slide(&out);
+            }
+            size_t length = LZ_DECODE_SIZE - out.pos < literals ? LZ_DECODE_SIZE - out.pos : literals;
+            memcpy(out.window + out.pos, in, length);
+            out.pos += length;
+            out.total += length;
+            in += length;
+            literals -= length;
+        }
+        if (in == end) {
+            ret = 0;
+            break;
+        }
+
+        if (end - in < 2) {
+            break;
+        }
+        size_t offset = in[0] | in[1] << 8;
+        in += 2;
+        size_t match = (token & 15) + LZ_MIN_MATCH;
+        if (((token & 15) == 15 && readLength(&in, end, &match) != 0) || offset == 0 || offset > out.total) {
+            break;
+        }
+        while (match > 0) {
+            if (out.pos == LZ_DECODE_SIZE) {
+                slide(&out);
+            }
+            size_t length = LZ_DECODE_SIZE - out.pos < match ? LZ_DECODE_SIZE - out.pos : match;
+            char* to = out.window + out.pos;
+            const char* from = to - offset;
+            //Overlapping copies repeat the last offset bytes, those go a byte at a time
+            if (offset >= length) {
+                memcpy(to, from, length);
+            } else {
+                for (size_t i = 0; i < length; i++) {
+                    to[i] = from[i];
+                }
+            }
+            out.pos += length;
+            out.total += length;
+            match -= length;
+        }
+    }
+
+    if (ret == 0) {
+        flush(&out);
+    }
+    memFree(out.window);
+    return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+#include "buffer.h"
+
+//Small LZ77 codec in the style of LZ4 for keeping pages packed. Every
+//sequence is a token byte, the literals and then a 2 byte offset back to
+//where the match is copied from:
+//    token: high nibble literal count, low nibble match length - 4,
+//           15 in either means more length bytes follow (255 = keep going)
+//The last sequence is literals only and ends the input. Gemtext usually
+//comes out at around half its size.
+
+//Matches reach at most this far back, it is all the decoder has to keep
+#define LZ_WINDOW (64 * 1024)
+//Decoded text is handed on in pieces of about this size
+#define LZ_CHUNK (16 * 1024)
+
+typedef void (*LzSink)(void* user, const char* data, size_t len);
+
+//Most a compressed len bytes can come to
+size_t lzBound(size_t len);
+//Appends the compressed data to out, -1 if memory ran out
+int lzCompress(const char* data, size_t len, Buffer* out);
+//Decodes into a window of LZ_WINDOW + LZ_CHUNK bytes and passes it on as it
+//fills, so the whole text never has to exist in one piece. Returns -1 if the
+//data is corrupt, whatever was passed on before that stays passed on.
+int lzDecode(const char* data, size_t len, LzSink sink, void* user);
+
+#endif
@@ -0,0 +1,176 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstats.h"
+
+//Room for the size in front of every memAlloc block, keeps the data 8 byte aligned
+#define MEM_HEADER 16
+
+typedef struct {
+    size_t size;
+    int account;
+} MemHeader;
+
+static MemStats accounts[MEM_ACCOUNTS] = {
+    [MEM_OTHER] = { .name = "other" },
+    [MEM_NETWORK] = { .name = "network" },
+    [MEM_DOCUMENT] = { .name = "document" },
+    [MEM_LAYOUT] = { .name = "layout" },
+    [MEM_CACHE] = { .name = "cache" },
+    [MEM_FEEDS] = { .name = "feeds" },
+    [MEM_UI] = { .name = "ui" },
+};
+
+static MemStats* account(int index) {
+    return &accounts[index >= 0 && index < MEM_ACCOUNTS ? index : MEM_OTHER];
+}
+
+//Moves the count up, noting a new peak and a crossing of the budget
+static void add(MemStats* stats, size_t bytes) {
+    size_t current = __atomic_add_fetch(&stats->current, bytes, __ATOMIC_RELAXED);
+    size_t peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+    while (current > peak && !__atomic_compare_exchange_n(&stats->peak, &peak, current, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    if (stats->budget != 0 && current > stats->budget && current - bytes <= stats->budget) {
+        __atomic_add_fetch(&stats->overBudget, 1, __ATOMIC_RELAXED);
+    }
+}
+
+void memCharge(int index, size_t bytes) {
+    MemStats* stats = account(index);
+    __atomic_add_fetch(&stats->allocations, 1, __ATOMIC_RELAXED);
+    add(stats, bytes);
+}
+
+void memRelease(int index, size_t bytes) {
+    __atomic_sub_fetch(&account(index)->current, bytes, __ATOMIC_RELAXED);
+}
+
+void memMove(int from, int to, size_t bytes) {
+    if (from != to) {
+        memRelease(from, bytes);
+        add(account(to), bytes);
+    }
+}
+
+void memSetBudget(int index, size_t budget) {
+    account(index)->budget = budget;
+}
+
+int memOverBudget(int index) {
+    const MemStats* stats = account(index);
+    return stats->budget != 0 && __atomic_load_n(&stats->current, __ATOMIC_RELAXED) > stats->budget;
+}
+
+void memStats(int index, MemStats* out) {
+    const MemStats* stats = account(index);
+    out->name = stats->name;
+    out->current = __atomic_load_n(&stats->current, __ATOMIC_RELAXED);
+    out->peak = __atomic_load_n(&stats->peak, __ATOMIC_RELAXED);
+    out->budget = stats->budget;
+    out->allocations = __atomic_load_n(&stats->allocations, __ATOMIC_RELAXED);
+    out->overBudget = __atomic_load_n(&stats->overBudget, __ATOMIC_RELAXED);
+}
+
+void memResetPeaks(void) {
+    for (int i = 0; i < MEM_ACCOUNTS; i++) {
+        __atomic_store_n(&accounts[i].peak, __atomic_load_n(&accounts[i].current, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    }
+}
+
+void* memAlloc(int index, size_t size) {
+    MemHeader* header = malloc(MEM_HEADER + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+    header->account = index;
+    memCharge(index, MEM_HEADER + size);
+    return (char*)header + MEM_HEADER;
+}
+
+void* memCalloc(int index, size_t count, size_t size) {
+    if (size != 0 && count > ((size_t)-1 - MEM_HEADER) / size) {
+        return NULL;
+    }
+    void* data = memAlloc(index, count * size);
+    if (data != NULL) {
+        memset(data, 0, count * size);
+    }
+    return data;
+}
+
+//A block keeps the account it was first allocated for
+void* memRealloc(int index, void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return memAlloc(index, size);
+    }
+    MemHeader* header = (MemHeader*)((char*)ptr - MEM_HEADER);
+    size_t oldSize = header->size;
+    header = realloc(header, MEM_HEADER + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+    if (size > oldSize) {
+        memCharge(header->account, size - oldSize);
+    } else {
+        memRelease(header->account, oldSize - size);
+    }
+    return (char*)header + MEM_HEADER;
+}
+
+void memFree(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    MemHeader* header = (MemHeader*)((char*)ptr - MEM_HEADER);
+    memRelease(header->account, MEM_HEADER + header->size);
+    free(header);
+}
+
+typedef void (*Emit)(void* out, const char* text);
+
+static void emitBuffer(void* out, const char* text) {
+    bufferAppend(out, text, strlen(text));
+}
+
+static void emitFile(void* out, const char* text) {
+    fputs(text, out);
+}
+
+//One table for both the page and the log, sizes in KB
+static void writeTable(Emit emit, void* out) {
+    char row[128];
+    size_t current = 0;
+    size_t peak = 0;
+    emit(out, "account       KB   peak budget  allocs  over\n");
+    for (int i = 0; i < MEM_ACCOUNTS; i++) {
+        MemStats stats;
+        memStats(i, &stats);
+        current += stats.current;
+        peak += stats.peak;
+        char budget[16] = "-";
+        if (stats.budget != 0) {
+            snprintf(budget, sizeof budget, "%u", (unsigned int)(stats.budget / 1024));
+        }
+        snprintf(row, sizeof row, "%-9s %6u %6u %6s %7lu %5lu%s\n", stats.name, (unsigned int)(stats.current / 1024),
+            (unsigned int)(stats.peak / 1024), budget, stats.allocations, stats.overBudget,
+            stats.budget != 0 && stats.current > stats.budget ? " !" : "");
+        emit(out, row);
+    }
+    //Accounts peak at different times, the sum of the peaks is an upper bound
+    snprintf(row, sizeof row, "%-9s %6u %6u\n", "total", (unsigned int)(current / 1024), (unsigned int)(peak / 1024));
+    emit(out, row);
+}
+
+void memReport(Buffer* out) {
+    bufferSet(out, "# Memory\n```\n");
+    writeTable(emitBuffer, out);
+    bufferAppend(out, "```\n", 4);
+}
+
+void memDump(FILE* out) {
+    writeTable(emitFile, out);
+    fflush(out);
+}
@@ -0,0 +1,54 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "buffer.h"
+
+//What the heap is being spent on. Arenas and buffers are charged to one of
+//these when they are made, everything else goes through memAlloc.
+enum MemAccount {
+    MEM_OTHER,
+    MEM_NETWORK,    //Socket buffer, response bodies and records, disk cache reads, redirects
+    MEM_DOCUMENT,   //Lines and links of the page on screen and pages loading
+    MEM_LAYOUT,     //Rows and offsets of those pages
+    MEM_CACHE,      //Pages kept for back and forward, the disk cache index. Nothing
+                    //passing through goes here, the page cache evicts when it's over budget.
+    MEM_FEEDS,
+    MEM_UI,         //Font metrics, prepared text, the link list
+    MEM_ACCOUNTS,
+};
+
+typedef struct {
+    const char* name;
+    size_t current;
+    size_t peak;
+    size_t budget;              //0 for no budget
+    unsigned long allocations;
+    unsigned long overBudget;   //Allocations that took it past the budget
+} MemStats;
+
+//Counts are kept with atomics, fetch workers allocate too
+void memCharge(int account, size_t bytes);
+void memRelease(int account, size_t bytes);
+//Hands bytes already charged over to another account, the page cache takes
+//documents over this way
+void memMove(int from, int to, size_t bytes);
+void memSetBudget(int account, size_t budget);
+int memOverBudget(int account);
+void memStats(int account, MemStats* out);
+//Peaks start again from the current numbers
+void memResetPeaks(void);
+
+//malloc and friends with the size remembered, so memFree can release it
+void* memAlloc(int account, size_t size);
+void* memCalloc(int account, size_t count, size_t size);
+void* memRealloc(int account, void* ptr, size_t size);
+void memFree(void* ptr);
+
+//A table of every account as a gemtext page
+void memReport(Buffer* out);
+void memDump(FILE* out);
+
+#endif
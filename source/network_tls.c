@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "connector.h"
+#include "memstats.h"
+#include "network_tls.h"
+#include "trace.h"
+
+static int openTls(void* ctx, FetchJob* job, const char* request, Transport* transport, void** out) {
+    TlsNetwork* net = ctx;
+    TlsConnection* conn = &net->conn;
+    tlsInit(conn, &job->cancelled);
+    conn->replaceCert = job->trustNewCert;
+    *out = conn;
+
+    fetchJobSetPhase(job, FETCH_RESOLVING);
+    DnsAddress addresses[DNS_MAX_ADDRESSES];
+    uint64_t started = platformTimeUs();
+    int count = dnsCacheLookup(&net->dns, job->host, addresses, &job->timings.dnsCached);
+    uint64_t finished = platformTimeUs();
+    job->timings.resolveUs += finished - started;
+    traceSpan(TRACE_RESOLVE, started, finished);
+    if (count == 0) {
+        return FETCH_RESOLVE_FAILED;
+    }
+
+    //A dead address only holds things up for the stagger, not a whole TCP timeout
+    fetchJobSetPhase(job, FETCH_CONNECTING);
+    int fd;
+    ConnectStats stats;
+    started = platformTimeUs();
+    int ret = connectRace(addresses, count, atoi(job->port), CONNECT_STAGGER_MS, CONNECT_TIMEOUT_MS, &job->cancelled, &fd, &stats);
+    job->timings.connectUs += stats.us;
+    traceSpan(TRACE_CONNECT, started, started + stats.us);
+    job->timings.connectAttempts += stats.attempts;
+    if (ret == CONNECT_CANCELLED) {
+        return FETCH_CANCELLED;
+    }
+    if (ret != CONNECT_OK) {
+        //The addresses may have moved, look them up again next time
+        dnsCacheForget(&net->dns, job->host);
+        job->detail = ret;
+        return FETCH_CONNECT_FAILED;
+    }
+    dnsCachePrefer(&net->dns, job->host, &addresses[stats.winner]);
+    tlsAttach(conn, fd);
+
+    fetchJobSetPhase(job, FETCH_HANDSHAKE);
+    started = platformTimeUs();
+    ret = tlsHandshake(net->tls, conn, job->host, job->port, &job->detail);
+    finished = platformTimeUs();
+    job->timings.handshakeUs += finished - started;
+    traceSpan(TRACE_HANDSHAKE, started, finished);
+    job->trust = conn->trust;
+    if (ret == TLS_CANCELLED) {
+        return FETCH_CANCELLED;
+    } else if (ret == TLS_CERT_CHANGED) {
+        return FETCH_CERT_CHANGED;
+    } else if (ret == TLS_SETUP_FAILED) {
+        return FETCH_SETUP_FAILED;
+    } else if (ret != TLS_OK) {
+        return FETCH_HANDSHAKE_FAILED;
+    }
+
+    if (tlsWrite(conn, request, strlen(request)) != 0) {
+        return FETCH_SEND_FAILED;
+    }
+    *transport = tlsTransport(conn);
+    return FETCH_OK;
+}
+
+static void closeTls(void* ctx, void* conn) {
+    tlsClose(conn);
+}
+
+void networkInitTls(FetchNetwork* network, TlsNetwork* net, TlsClient* tls) {
+    memset(net, 0, sizeof *net);
+    net->tls = tls;
+    dnsCacheInit(&net->dns, NULL, NULL);
+    network->ctx = net;
+    network->open = openTls;
+    network->close = closeTls;
+}
+
+static int makeTls(void* ctx, int worker, FetchNetwork* network) {
+    TlsPool* pool = ctx;
+    if (worker >= TLS_POOL_MAX) {
+        return -1;
+    }
+    TlsWorker* made = memCalloc(pool->account, 1, sizeof *made);
+    if (made == NULL) {
+        return -1;
+    }
+    if (tlsClientInit(&made->tls, pool->knownHosts) != 0) {
+        tlsClientFree(&made->tls);
+        memFree(made);
+        return -1;
+    }
+    networkInitTls(network, &made->net, &made->tls);
+    pool->workers[worker] = made;
+    return 0;
+}
+
+static void releaseTls(void* ctx, int worker) {
+    TlsPool* pool = ctx;
+    TlsWorker* made = pool->workers[worker];
+    if (made != NULL) {
+        tlsClientFree(&made->tls);
+        memFree(made);
+        pool->workers[worker] = NULL;
+    }
+}
+
+void networkFactoryInitTls(NetworkFactory* factory, TlsPool* pool, KnownHosts* knownHosts, int account) {
+    memset(pool, 0, sizeof *pool);
+    pool->knownHosts = knownHosts;
+    pool->account = account;
+    factory->ctx = pool;
+    factory->make = makeTls;
+    factory->release = releaseTls;
+}
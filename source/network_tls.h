@@ -0,0 +1,35 @@
+#ifndef NETWORK_TLS_H
+#define NETWORK_TLS_H
+
+#include "dnscache.h"
+#include "fetch.h"
+#include "tls.h"
+
+//The real network: names through a DNS cache, a connect race over the
+//addresses, then TLS. One per fetcher as it is only used from that worker,
+//which is also why the one connection can live in here.
+typedef struct {
+    TlsClient* tls;
+    DnsCache dns;
+    TlsConnection conn;
+} TlsNetwork;
+
+#define TLS_POOL_MAX 8
+
+typedef struct {
+    TlsClient tls;
+    TlsNetwork net;
+} TlsWorker;
+
+//Networks for a pool of fetchers, a client each since mbedtls isn't built
+//thread safe. They are only allocated as the workers start.
+typedef struct {
+    KnownHosts* knownHosts;     //May be NULL, certificates go unchecked then
+    int account;                //MemAccount the workers are charged to
+    TlsWorker* workers[TLS_POOL_MAX];
+} TlsPool;
+
+void networkInitTls(FetchNetwork* network, TlsNetwork* net, TlsClient* tls);
+void networkFactoryInitTls(NetworkFactory* factory, TlsPool* pool, KnownHosts* knownHosts, int account);
+
+#endif
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz.h"
+#include "memstats.h"
+#include "pagecache.h"
+
+//Roughly what a page costs, the arenas hold the lines, links and layout
+static size_t pageBytes(const Document* doc) {
+    return sizeof(CachedPage) + doc->arena.reserved + doc->layoutArena.reserved;
+}
+
+static void freePage(CachedPage* page) {
+    if (page->packed != NULL) {
+        memFree(page->packed);
+        page->packed = NULL;
+    } else {
+        freeDocument(&page->doc);
+    }
+}
+
+//Writes the page out as gemtext and compresses that, the document goes once it
+//has worked. Returns -1 and leaves the page parsed if memory ran out.
+static int packPage(CachedPage* page) {
+    Buffer text;
+    Buffer packed;
+    bufferInit(&text, MEM_CACHE);
+    bufferInit(&packed, MEM_CACHE);
+    int ret = -1;
+    if (writeGemtext(&page->doc, &text) == 0 && lzCompress(text.data, text.length, &packed) == 0 &&
+        (page->packed = memAlloc(MEM_CACHE, packed.length)) != NULL) {
+        memcpy(page->packed, packed.data, packed.length);
+        page->packedLength = packed.length;
+        page->textLength = text.length;
+        freeDocument(&page->doc);
+        resetLayout(&page->layout);
+        ret = 0;
+    }
+    bufferFree(&text);
+    bufferFree(&packed);
+    return ret;
+}
+
+typedef struct {
+    Document* doc;
+    size_t length;
+} Unpacking;
+
+static void feedUnpacked(void* user, const char* data, size_t len) {
+    Unpacking* unpacking = user;
+    unpacking->length += len;
+    feedGemtext(unpacking->doc, data, len);
+}
+
+//The text goes from the decoder's window straight into the parser. Returns -1
+//with nothing left to free if the packed text is damaged.
+static int unpackPage(const CachedPage* page, Document* doc, PageLayout* layout) {
+    Unpacking unpacking = { doc, 0 };
+    beginDocument(doc, page->textLength);
+    if (lzDecode(page->packed, page->packedLength, feedUnpacked, &unpacking) != 0 || unpacking.length != page->textLength) {
+        freeDocument(doc);
+        return -1;
+    }
+    endDocument(doc);
+    resetLayout(layout);
+    layoutDocument(doc, layout);
+    return 0;
+}
+
+static int findPage(const PageCache* cache, const char* url) {
+    for (int i = 0; i < cache->count; i++) {
+        if (strcmp(cache->pages[i].url, url) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//Order doesn't matter so the last page fills the gap
+static void removePage(PageCache* cache, int index) {
+    if (cache->pages[index].prefetched) {
+        cache->prefetchWasted += cache->pages[index].bytes;
+    }
+    cache->bytes -= cache->pages[index].bytes;
+    cache->pages[index] = cache->pages[--cache->count];
+}
+
+//The cache account's budget counts too, it is what gives way when memory runs short
+static void evictPages(PageCache* cache) {
+    while ((cache->bytes > cache->budget || memOverBudget(MEM_CACHE)) && cache->count > 0) {
+        int oldest = 0;
+        for (int i = 1; i < cache->count; i++) {
+            if (cache->pages[i].lastUsed < cache->pages[oldest].lastUsed) {
+                oldest = i;
+            }
+        }
+        freePage(&cache->pages[oldest]);
+        removePage(cache, oldest);
+        cache->evictions++;
+    }
+}
+
+//Packs the least recently used parsed pages until only PAGE_CACHE_PARSED are left
+static void packOlderPages(PageCache* cache) {
+    for (;;) {
+        int oldest = -1;
+        int parsed = 0;
+        for (int i = 0; i < cache->count; i++) {
+            if (cache->pages[i].packed == NULL) {
+                parsed++;
+                if (oldest < 0 || cache->pages[i].lastUsed < cache->pages[oldest].lastUsed) {
+                    oldest = i;
+                }
+            }
+        }
+        if (parsed <= PAGE_CACHE_PARSED || packPage(&cache->pages[oldest]) != 0) {
+            return;
+        }
+        CachedPage* page = &cache->pages[oldest];
+        cache->bytes -= page->bytes;
+        page->bytes = sizeof(CachedPage) + page->packedLength;
+        cache->bytes += page->bytes;
+    }
+}
+
+void pageCacheInit(PageCache* cache, size_t budget, int compress) {
+    memset(cache, 0, sizeof *cache);
+    cache->budget = budget;
+    cache->compress = compress;
+}
+
+void pageCachePut(PageCache* cache, const char* url, Document* doc, const PageLayout* layout, int scroll, int prefetched) {
+    int existing = findPage(cache, url);
+    if (existing >= 0) {
+        freePage(&cache->pages[existing]);
+        removePage(cache, existing);
+    }
+
+    size_t bytes = pageBytes(doc);
+    //Never worth keeping, and it would flush everything else out. Packed it might still fit.
+    if (bytes > cache->budget && !cache->compress) {
+        if (prefetched) {
+            cache->prefetchWasted += bytes;
+        }
+        freeDocument(doc);
+        return;
+    }
+
+    if (cache->count == cache->capacity) {
+        int grown = cache->capacity ? cache->capacity * 2 : 8;
+        CachedPage* pages = memRealloc(MEM_CACHE, cache->pages, grown * sizeof(CachedPage));
+        if (pages == NULL) {
+            if (prefetched) {
+                cache->prefetchWasted += bytes;
+            }
+            freeDocument(doc);
+            return;
+        }
+        cache->pages = pages;
+        cache->capacity = grown;
+    }
+
+    CachedPage* page = &cache->pages[cache->count++];
+    snprintf(page->url, sizeof page->url, "%s", url);
+    page->doc = *doc;
+    documentSetAccounts(&page->doc, MEM_CACHE, MEM_CACHE);
+    page->layout = *layout;
+    page->packed = NULL;
+    page->scroll = scroll;
+    page->lastUsed = ++cache->clock;
+    page->prefetched = prefetched;
+    memset(doc, 0, sizeof *doc);
+    if (bytes > cache->budget && cache->compress && packPage(page) == 0) {
+        bytes = sizeof(CachedPage) + page->packedLength;
+    }
+    if (bytes > cache->budget) {
+        if (prefetched) {
+            cache->prefetchWasted += bytes;
+        }
+        freePage(page);
+        cache->count--;
+        return;
+    }
+    page->bytes = bytes;
+    cache->bytes += bytes;
+
+    if (cache->compress) {
+        packOlderPages(cache);
+    }
+    evictPages(cache);
+}
+
+int pageCacheTake(PageCache* cache, const char* url, Document* doc, PageLayout* layout, int* scroll) {
+    int index = findPage(cache, url);
+    if (index < 0) {
+        cache->misses++;
+        return -1;
+    }
+    CachedPage* page = &cache->pages[index];
+    if (page->packed != NULL) {
+        //One that won't unpack is gone either way, and it's as if it never was here
+        int ret = unpackPage(page, doc, layout);
+        memFree(page->packed);
+        if (ret != 0) {
+            page->prefetched = 0;
+            removePage(cache, index);
+            cache->misses++;
+            return -1;
+        }
+    } else {
+        *doc = page->doc;
+        documentSetAccounts(doc, MEM_DOCUMENT, MEM_LAYOUT);
+        *layout = page->layout;
+    }
+    cache->hits++;
+    if (page->prefetched) {
+        cache->prefetchHits++;
+        page->prefetched = 0;
+    }
+    *scroll = page->scroll;
+    removePage(cache, index);
+    return 0;
+}
+
+int pageCacheContains(const PageCache* cache, const char* url) {
+    return findPage(cache, url) >= 0;
+}
+
+void pageCacheFree(PageCache* cache) {
+    for (int i = 0; i < cache->count; i++) {
+        freePage(&cache->pages[i]);
+    }
+    memFree(cache->pages);
+    memset(cache, 0, sizeof *cache);
+}
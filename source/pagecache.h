@@ -0,0 +1,59 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <stddef.h>
+
+#include "gemtext.h"
+#include "layout.h"
+#include "url.h"
+
+#define PAGE_URL_SIZE URL_MAX
+
+//With compression on, this many of the most recently used pages stay parsed
+//and only the ones before them are packed, so going back a page or two is
+//still instant
+#define PAGE_CACHE_PARSED 4
+
+//A page we navigated away from, kept parsed and laid out so coming back to it
+//is instant, or packed as compressed gemtext and parsed again when it's taken
+typedef struct {
+    char url[PAGE_URL_SIZE];
+    Document doc;
+    PageLayout layout;
+    char* packed;       //NULL for a page kept parsed
+    size_t packedLength;
+    size_t textLength;  //Of the gemtext once unpacked
+    int scroll;
+    size_t bytes;
+    unsigned int lastUsed;
+    int prefetched;     //Put here by the prefetcher and not looked at yet
+} CachedPage;
+
+//Pages keyed by canonical URL (see urlFormat). Once the pages add up to more than the
+//budget, or the MEM_CACHE account goes over its own, the least recently used ones are dropped.
+//Packed pages take a fraction of the memory but cost a parse and layout to take back.
+typedef struct {
+    CachedPage* pages;
+    int count;
+    int capacity;
+    size_t budget;
+    int compress;
+    size_t bytes;
+    unsigned int clock;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long prefetchHits;
+    size_t prefetchWasted;  //Bytes of prefetched pages dropped without being shown
+} PageCache;
+
+void pageCacheInit(PageCache* cache, size_t budget, int compress);
+//Hands the document over to the cache, replacing any page with the same url
+void pageCachePut(PageCache* cache, const char* url, Document* doc, const PageLayout* layout, int scroll, int prefetched);
+int pageCacheContains(const PageCache* cache, const char* url);
+//Takes a page back out of the cache. Returns 0 and fills in doc, layout and
+//scroll on a hit, the caller owns the document again then.
+int pageCacheTake(PageCache* cache, const char* url, Document* doc, PageLayout* layout, int* scroll);
+void pageCacheFree(PageCache* cache);
+
+#endif
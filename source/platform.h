@@ -0,0 +1,31 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//The little bit of OS we need outside of drawing. platform_3ds.c backs this
+//with libctru, platform_posix.c with pthreads for the host build.
+typedef struct PlatformThread PlatformThread;
+typedef struct PlatformEvent PlatformEvent;
+typedef struct PlatformMutex PlatformMutex;
+
+//The new thread runs at a lower priority than the caller
+PlatformThread* platformThreadStart(void (*entry)(void*), void* arg, size_t stackSize);
+void platformThreadJoin(PlatformThread* thread);
+
+//Auto-resetting event, a signal with nobody waiting wakes the next wait
+PlatformEvent* platformEventNew(void);
+void platformEventWait(PlatformEvent* event);
+void platformEventSignal(PlatformEvent* event);
+void platformEventFree(PlatformEvent* event);
+
+PlatformMutex* platformMutexNew(void);
+void platformMutexLock(PlatformMutex* mutex);
+void platformMutexUnlock(PlatformMutex* mutex);
+void platformMutexFree(PlatformMutex* mutex);
+
+uint64_t platformTimeUs(void);
+void platformSleepMs(int ms);
+
+#endif
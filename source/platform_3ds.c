@@ -0,0 +1,91 @@
+#ifdef __3DS__
+
+#include <stdlib.h>
+
+#include <3ds.h>
+
+#include "platform.h"
+
+struct PlatformThread {
+    Thread thread;
+};
+
+struct PlatformEvent {
+    LightEvent event;
+};
+
+struct PlatformMutex {
+    LightLock lock;
+};
+
+PlatformThread* platformThreadStart(void (*entry)(void*), void* arg, size_t stackSize) {
+    PlatformThread* thread = malloc(sizeof *thread);
+    if (thread == NULL) {
+        return NULL;
+    }
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+    //Higher number is lower priority, the UI thread should always win
+    thread->thread = threadCreate(entry, arg, stackSize, priority + 1, -1, false);
+    if (thread->thread == NULL) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platformThreadJoin(PlatformThread* thread) {
+    threadJoin(thread->thread, U64_MAX);
+    threadFree(thread->thread);
+    free(thread);
+}
+
+PlatformEvent* platformEventNew(void) {
+    PlatformEvent* event = malloc(sizeof *event);
+    if (event != NULL) {
+        LightEvent_Init(&event->event, RESET_ONESHOT);
+    }
+    return event;
+}
+
+void platformEventWait(PlatformEvent* event) {
+    LightEvent_Wait(&event->event);
+}
+
+void platformEventSignal(PlatformEvent* event) {
+    LightEvent_Signal(&event->event);
+}
+
+void platformEventFree(PlatformEvent* event) {
+    free(event);
+}
+
+PlatformMutex* platformMutexNew(void) {
+    PlatformMutex* mutex = malloc(sizeof *mutex);
+    if (mutex != NULL) {
+        LightLock_Init(&mutex->lock);
+    }
+    return mutex;
+}
+
+void platformMutexLock(PlatformMutex* mutex) {
+    LightLock_Lock(&mutex->lock);
+}
+
+void platformMutexUnlock(PlatformMutex* mutex) {
+    LightLock_Unlock(&mutex->lock);
+}
+
+void platformMutexFree(PlatformMutex* mutex) {
+    free(mutex);
+}
+
+uint64_t platformTimeUs(void) {
+    return svcGetSystemTick() / (SYSCLOCK_ARM11 / 1000000);
+}
+
+void platformSleepMs(int ms) {
+    svcSleepThread((s64)ms * 1000000);
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef __3DS__
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "platform.h"
+
+struct PlatformThread {
+    pthread_t thread;
+    void (*entry)(void*);
+    void* arg;
+};
+
+struct PlatformEvent {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int signalled;
+};
+
+struct PlatformMutex {
+    pthread_mutex_t mutex;
+};
+
+static void* threadMain(void* arg) {
+    PlatformThread* thread = arg;
+    thread->entry(thread->arg);
+    return NULL;
+}
+
+PlatformThread* platformThreadStart(void (*entry)(void*), void* arg, size_t stackSize) {
+    PlatformThread* thread = malloc(sizeof *thread);
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->entry = entry;
+    thread->arg = arg;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stackSize < 65536 ? 65536 : stackSize);
+    int ret = pthread_create(&thread->thread, &attr, threadMain, thread);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void platformThreadJoin(PlatformThread* thread) {
+    pthread_join(thread->thread, NULL);
+    free(thread);
+}
+
+PlatformEvent* platformEventNew(void) {
+    PlatformEvent* event = malloc(sizeof *event);
+    if (event != NULL) {
+        pthread_mutex_init(&event->mutex, NULL);
+        pthread_cond_init(&event->cond, NULL);
+        event->signalled = 0;
+    }
+    return event;
+}
+
+void platformEventWait(PlatformEvent* event) {
+    pthread_mutex_lock(&event->mutex);
+    while (!event->signalled) {
+        pthread_cond_wait(&event->cond, &event->mutex);
+    }
+    event->signalled = 0;
+    pthread_mutex_unlock(&event->mutex);
+}
+
+void platformEventSignal(PlatformEvent* event) {
+    pthread_mutex_lock(&event->mutex);
+    event->signalled = 1;
+    pthread_cond_signal(&event->cond);
+    pthread_mutex_unlock(&event->mutex);
+}
+
+void platformEventFree(PlatformEvent* event) {
+    pthread_cond_destroy(&event->cond);
+    pthread_mutex_destroy(&event->mutex);
+    free(event);
+}
+
+PlatformMutex* platformMutexNew(void) {
+    PlatformMutex* mutex = malloc(sizeof *mutex);
+    if (mutex != NULL) {
+        pthread_mutex_init(&mutex->mutex, NULL);
+    }
+    return mutex;
+}
+
+void platformMutexLock(PlatformMutex* mutex) {
+    pthread_mutex_lock(&mutex->mutex);
+}
+
+void platformMutexUnlock(PlatformMutex* mutex) {
+    pthread_mutex_unlock(&mutex->mutex);
+}
+
+void platformMutexFree(PlatformMutex* mutex) {
+    pthread_mutex_destroy(&mutex->mutex);
+    free(mutex);
+}
+
+uint64_t platformTimeUs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void platformSleepMs(int ms) {
+    struct timespec duration = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&duration, NULL);
+}
+
+#endif
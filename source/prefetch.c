@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "prefetch.h"
+
+//Only links on the same server are worth it, the connection setup is the slow part.
+//Fills in the canonical url of the link if it is one.
+static int sameOrigin(const Prefetcher* prefetcher, const Url* base, const Link* link, char url[PAGE_URL_SIZE]) {
+    Url ref;
+    if (urlParse(link->path, link->pathLength, &ref) != 0 || urlResolve(base, &ref, url, PAGE_URL_SIZE) < 0) {
+        return 0;
+    }
+    return strncmp(url, prefetcher->origin, strlen(prefetcher->origin)) == 0;
+}
+
+void prefetchInit(Prefetcher* prefetcher, Fetcher* fetcher, PageCache* pages, int maxLinks, int maxInFlight, size_t byteBudget) {
+    memset(prefetcher, 0, sizeof *prefetcher);
+    prefetcher->fetcher = fetcher;
+    prefetcher->pages = pages;
+    prefetcher->maxLinks = maxLinks < PREFETCH_MAX_LINKS ? maxLinks : PREFETCH_MAX_LINKS;
+    prefetcher->maxInFlight = maxInFlight < PREFETCH_MAX_JOBS ? maxInFlight : PREFETCH_MAX_JOBS;
+    prefetcher->byteBudget = byteBudget;
+}
+
+void prefetchPage(Prefetcher* prefetcher, const char* url, const Document* doc) {
+    prefetchCancel(prefetcher);
+    prefetcher->bytesUsed = 0;
+
+    //The origin is the url with the path and query taken off, gemini://host[:port]/
+    Url base;
+    if (urlParse(url, strlen(url), &base) != 0 || !urlIsScheme(&base, "gemini") || !base.hasAuthority) {
+        return;
+    }
+    Url origin = base;
+    origin.pathLength = 0;
+    origin.hasQuery = 0;
+    if (urlFormat(&origin, prefetcher->origin, sizeof prefetcher->origin) < 0) {
+        return;
+    }
+
+    for (int i = 0; i < doc->linkCount && prefetcher->urlCount < prefetcher->maxLinks; i++) {
+        char linkUrl[PAGE_URL_SIZE];
+        if (!sameOrigin(prefetcher, &base, &doc->links[i], linkUrl) || strcmp(linkUrl, url) == 0) {
+            continue;
+        }
+        int duplicate = 0;
+        for (int j = 0; j < prefetcher->urlCount && !duplicate; j++) {
+            duplicate = strcmp(prefetcher->urls[j], linkUrl) == 0;
+        }
+        if (!duplicate) {
+            strcpy(prefetcher->urls[prefetcher->urlCount++], linkUrl);
+        }
+    }
+}
+
+void prefetchIdle(Prefetcher* prefetcher) {
+    if (!prefetcher->enabled) {
+        return;
+    }
+    while (prefetcher->jobCount < prefetcher->maxInFlight &&
+           prefetcher->nextUrl < prefetcher->urlCount &&
+           prefetcher->bytesUsed < prefetcher->byteBudget) {
+        const char* url = prefetcher->urls[prefetcher->nextUrl++];
+        //A link that moved for good is in the cache under where it went
+        char moved[URL_MAX];
+        RedirectMap* redirects = prefetcher->fetcher->redirects;
+        if (redirects != NULL && redirectsLookup(redirects, url, moved) == 0) {
+            url = moved;
+        }
+        if (pageCacheContains(prefetcher->pages, url)) {
+            continue;
+        }
+
+        FetchJob* job = fetchJobNew(url);
+        if (job == NULL) {
+            return;
+        }
+        job->maxBytes = prefetcher->byteBudget - prefetcher->bytesUsed;
+        if (fetcherSubmitBackground(prefetcher->fetcher, job) != 0) {
+            fetchJobFree(job);
+            prefetcher->nextUrl--;
+            return;
+        }
+        prefetcher->jobs[prefetcher->jobCount++] = job;
+        prefetcher->issued++;
+    }
+}
+
+void prefetchCancel(Prefetcher* prefetcher) {
+    for (int i = 0; i < prefetcher->jobCount; i++) {
+        fetchJobCancel(prefetcher->jobs[i]);
+    }
+    prefetcher->urlCount = 0;
+    prefetcher->nextUrl = 0;
+}
+
+int prefetchFinish(Prefetcher* prefetcher, FetchJob* job) {
+    int index = -1;
+    for (int i = 0; i < prefetcher->jobCount; i++) {
+        if (prefetcher->jobs[i] == job) {
+            index = i;
+        }
+    }
+    if (index < 0) {
+        return 0;
+    }
+    prefetcher->jobs[index] = prefetcher->jobs[--prefetcher->jobCount];
+
+    size_t bytes = fetchJobBytes(job);
+    prefetcher->fetchedBytes += bytes;
+    prefetcher->bytesUsed += bytes;
+    if (!job->cancelled && job->error == FETCH_OK && job->header.status / 10 == 2) {
+        pageCachePut(prefetcher->pages, job->url, &job->doc, &job->layout, 0, 1);
+        prefetcher->stored++;
+    } else {
+        prefetcher->wastedBytes += bytes;
+    }
+    fetchJobFree(job);
+    return 1;
+}
@@ -0,0 +1,51 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include <stddef.h>
+
+#include "fetch.h"
+#include "pagecache.h"
+
+#define PREFETCH_MAX_LINKS 32
+#define PREFETCH_MAX_JOBS 4
+
+//Fetches the first few same-host links of the page on screen while the
+//network is otherwise idle, so following one of them comes straight out of
+//the page cache. Everything here runs on the UI thread, the fetching itself
+//goes through the fetcher's background queue.
+typedef struct {
+    Fetcher* fetcher;
+    PageCache* pages;
+    int enabled;
+    int maxLinks;
+    int maxInFlight;
+    size_t byteBudget;  //Per page, a job is cut off once it would go over
+
+    //Links of the current page still to fetch
+    char origin[PAGE_URL_SIZE];     //gemini://host[:port]/ of the page
+    char urls[PREFETCH_MAX_LINKS][PAGE_URL_SIZE];
+    int urlCount;
+    int nextUrl;
+    size_t bytesUsed;
+
+    //Jobs handed to the fetcher, cancelled ones stay here until they come back
+    FetchJob* jobs[PREFETCH_MAX_JOBS];
+    int jobCount;
+
+    unsigned long issued;
+    unsigned long stored;
+    size_t fetchedBytes;
+    size_t wastedBytes;     //Fetched for nothing, cancelled or failed. Pages evicted unseen are counted by the page cache.
+} Prefetcher;
+
+void prefetchInit(Prefetcher* prefetcher, Fetcher* fetcher, PageCache* pages, int maxLinks, int maxInFlight, size_t byteBudget);
+//Forget the old page and collect the candidates of a new one, url is the
+//page's canonical url
+void prefetchPage(Prefetcher* prefetcher, const char* url, const Document* doc);
+//Call on frames where nothing else is loading, starts jobs while there is room
+void prefetchIdle(Prefetcher* prefetcher);
+void prefetchCancel(Prefetcher* prefetcher);
+//Returns 1 if the job was a prefetch, the page is in the cache and the job freed then
+int prefetchFinish(Prefetcher* prefetcher, FetchJob* job);
+
+#endif
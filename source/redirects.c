@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "redirects.h"
+
+static uint32_t hashUrl(const char* url) {
+    uint32_t hash = 2166136261u;
+    for (; *url != '\0'; url++) {
+        hash = (hash ^ (unsigned char)*url) * 16777619u;
+    }
+    return hash;
+}
+
+static char* copyString(const char* str) {
+    size_t length = strlen(str) + 1;
+    char* copy = memAlloc(MEM_NETWORK, length);
+    if (copy != NULL) {
+        memcpy(copy, str, length);
+    }
+    return copy;
+}
+
+static Redirect* findEntry(RedirectMap* map, const char* from) {
+    uint32_t hash = hashUrl(from);
+    for (int i = 0; i < map->count; i++) {
+        if (map->entries[i].hash == hash && strcmp(map->entries[i].from, from) == 0) {
+            return &map->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static void removeEntry(RedirectMap* map, Redirect* entry) {
+    memFree(entry->from);
+    memFree(entry->to);
+    *entry = map->entries[--map->count];
+}
+
+int redirectsInit(RedirectMap* map) {
+    memset(map, 0, sizeof *map);
+    map->lock = platformMutexNew();
+    return map->lock != NULL ? 0 : -1;
+}
+
+int redirectsLoad(RedirectMap* map, const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char line[URL_MAX * 2 + 2];
+    while (fgets(line, sizeof line, file) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* to = strchr(line, '\t');
+        if (to != NULL) {
+            *to++ = '\0';
+            redirectsAdd(map, line, to);
+        }
+    }
+    fclose(file);
+    map->dirty = 0;
+    return 0;
+}
+
+int redirectsSave(RedirectMap* map, const char* path) {
+    platformMutexLock(map->lock);
+    int ret = 0;
+    if (map->dirty) {
+        FILE* file = fopen(path, "w");
+        if (file == NULL) {
+            ret = -1;
+        } else {
+            //Oldest first so loading gives them back their order
+            unsigned int written = 0;
+            for (int n = 0; n < map->count; n++) {
+                const Redirect* next = NULL;
+                for (int i = 0; i < map->count; i++) {
+                    const Redirect* entry = &map->entries[i];
+                    if (entry->lastUsed > written && (next == NULL || entry->lastUsed < next->lastUsed)) {
+                        next = entry;
+                    }
+                }
+                fprintf(file, "%s\t%s\n", next->from, next->to);
+                written = next->lastUsed;
+            }
+            ret = fclose(file) == 0 ? 0 : -1;
+            map->dirty = ret != 0;
+        }
+    }
+    platformMutexUnlock(map->lock);
+    return ret;
+}
+
+int redirectsLookup(RedirectMap* map, const char* url, char out[URL_MAX]) {
+    platformMutexLock(map->lock);
+    const char* at = url;
+    int hops = 0;
+    Redirect* entry;
+    while ((entry = findEntry(map, at)) != NULL && hops <= REDIRECTS_MAX_HOPS) {
+        entry->lastUsed = ++map->clock;
+        at = entry->to;
+        hops++;
+    }
+    //A chain that long has gone round in a circle somewhere
+    int found = hops > 0 && hops <= REDIRECTS_MAX_HOPS;
+    if (found) {
+        snprintf(out, URL_MAX, "%s", at);
+        map->hits++;
+    } else {
+        map->misses++;
+    }
+    platformMutexUnlock(map->lock);
+    return found ? 0 : -1;
+}
+
+void redirectsAdd(RedirectMap* map, const char* from, const char* to) {
+    if (strcmp(from, to) == 0) {
+        return;
+    }
+    platformMutexLock(map->lock);
+    Redirect* entry = findEntry(map, from);
+    if (entry != NULL) {
+        removeEntry(map, entry);
+    } else if (map->count == REDIRECTS_MAX) {
+        Redirect* oldest = &map->entries[0];
+        for (int i = 1; i < map->count; i++) {
+            if (map->entries[i].lastUsed < oldest->lastUsed) {
+                oldest = &map->entries[i];
+            }
+        }
+        removeEntry(map, oldest);
+    }
+    entry = &map->entries[map->count];
+    entry->from = copyString(from);
+    entry->to = copyString(to);
+    if (entry->from != NULL && entry->to != NULL) {
+        entry->hash = hashUrl(from);
+        entry->lastUsed = ++map->clock;
+        map->count++;
+        map->dirty = 1;
+    } else {
+        memFree(entry->from);
+        memFree(entry->to);
+    }
+    platformMutexUnlock(map->lock);
+}
+
+void redirectsForget(RedirectMap* map, const char* from) {
+    platformMutexLock(map->lock);
+    Redirect* entry = findEntry(map, from);
+    if (entry != NULL) {
+        removeEntry(map, entry);
+        map->dirty = 1;
+    }
+    platformMutexUnlock(map->lock);
+}
+
+void redirectsFree(RedirectMap* map) {
+    for (int i = 0; i < map->count; i++) {
+        memFree(map->entries[i].from);
+        memFree(map->entries[i].to);
+    }
+    if (map->lock != NULL) {
+        platformMutexFree(map->lock);
+    }
+    memset(map, 0, sizeof *map);
+}
@@ -0,0 +1,47 @@
+#ifndef REDIRECTS_H
+#define REDIRECTS_H
+
+#include <stdint.h>
+
+#include "platform.h"
+#include "url.h"
+
+#define REDIRECTS_MAX 128
+//Longest chain followed, for stored redirects and live ones alike
+#define REDIRECTS_MAX_HOPS 5
+
+typedef struct {
+    uint32_t hash;      //Of from, checked before the strings are
+    char* from;         //Canonical urls
+    char* to;
+    unsigned int lastUsed;
+} Redirect;
+
+//Permanent (31) redirects seen so far, so later requests for the old url go
+//straight to the new one without a round trip and a handshake to be told
+//again. Shared by the fetch workers and the UI, hence the lock. Kept on the
+//SD card as one tab separated pair per line, the least recently used pair
+//makes room once it is full.
+typedef struct {
+    Redirect entries[REDIRECTS_MAX];
+    int count;
+    unsigned int clock;
+    int dirty;          //Changed since it was loaded or saved
+    PlatformMutex* lock;
+    unsigned long hits;
+    unsigned long misses;
+} RedirectMap;
+
+int redirectsInit(RedirectMap* map);
+//A missing file is an empty map
+int redirectsLoad(RedirectMap* map, const char* path);
+//Only writes the file if something changed
+int redirectsSave(RedirectMap* map, const char* path);
+//Where url permanently leads, following stored chains. Returns 0 and fills
+//in out if it is redirected, -1 if it isn't or the chain goes round in a loop.
+int redirectsLookup(RedirectMap* map, const char* url, char out[URL_MAX]);
+void redirectsAdd(RedirectMap* map, const char* from, const char* to);
+void redirectsForget(RedirectMap* map, const char* from);
+void redirectsFree(RedirectMap* map);
+
+#endif
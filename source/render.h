@@ -0,0 +1,49 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Colors are packed like C2D_Color32 makes them, red in the low byte
+static inline uint32_t renderColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    return r | (g << 8) | (b << 16) | ((uint32_t)a << 24);
+}
+
+//Small drawing interface so page code doesn't talk to citro2d directly.
+//Text is prepared once into a pool owned by the backend and drawn by handle.
+typedef struct {
+    void* ctx;
+    //Drop every prepared text and make room for `texts` strings holding `glyphs` glyphs
+    void (*textReset)(void* ctx, int texts, size_t glyphs);
+    //Parse a string into the pool, returns a handle or -1 if it didn't fit
+    int (*textPrepare)(void* ctx, const char* text, size_t len);
+    //wrapWidth <= 0 draws on a single line
+    void (*drawText)(void* ctx, int handle, float x, float y, float z, float scale, uint32_t color, float wrapWidth);
+    void (*drawRect)(void* ctx, float x, float y, float z, float w, float h, uint32_t color);
+
+    //Off-screen surfaces the tile cache keeps finished parts of the page in.
+    //surfaceNew returns a handle or -1 if there is no memory for another.
+    int (*surfaceNew)(void* ctx, int width, int height);
+    void (*surfaceFree)(void* ctx, int surface);
+    //Draws go to the surface, cleared to color first, until surfaceEnd
+    void (*surfaceBegin)(void* ctx, int surface, uint32_t color);
+    void (*surfaceEnd)(void* ctx);
+    void (*drawSurface)(void* ctx, int surface, float x, float y, float z);
+} Renderer;
+
+//Headless backend, does no drawing but counts what would have been drawn
+typedef struct {
+    int prepared;
+    int texts;
+    size_t glyphs;
+    unsigned long allocations;
+    unsigned long textDraws;
+    unsigned long rectDraws;
+    int surfaces;
+    unsigned long surfacePaints;
+    unsigned long surfaceDraws;
+} StubRenderer;
+
+void rendererInitStub(Renderer* renderer, StubRenderer* stub);
+
+#endif
@@ -0,0 +1,194 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "render_c2d.h"
+
+static void c2dTextReset(void* ctx, int texts, size_t glyphs) {
+    C2DRenderer* c2d = ctx;
+    //Only touch the heap when the page needs a bigger pool than the last one
+    if (glyphs > c2d->bufGlyphs || c2d->buf == NULL) {
+        if (c2d->buf != NULL) {
+            C2D_TextBufDelete(c2d->buf);
+        }
+        c2d->bufGlyphs = glyphs > 4096 ? glyphs : 4096;
+        c2d->buf = C2D_TextBufNew(c2d->bufGlyphs);
+    }
+    if (texts > c2d->capacity) {
+        C2D_Text* grown = memRealloc(MEM_UI, c2d->texts, texts * sizeof(C2D_Text));
+        if (grown != NULL) {
+            c2d->texts = grown;
+            c2d->capacity = texts;
+        }
+    }
+    C2D_TextBufClear(c2d->buf);
+    c2d->count = 0;
+}
+
+static int c2dTextPrepare(void* ctx, const char* text, size_t len) {
+    C2DRenderer* c2d = ctx;
+    if (c2d->buf == NULL || c2d->count >= c2d->capacity) {
+        return -1;
+    }
+
+    //citro2d wants a terminated string and page text comes as views into the
+    //body, so it goes through the scratch buffer. Tabs, CRs and the like become
+    //plain spaces on the way, the font has nothing sensible for them.
+    if (len + 1 > c2d->scratchSize) {
+        char* grown = memRealloc(MEM_UI, c2d->scratch, len + 1);
+        if (grown == NULL) {
+            return -1;
+        }
+        c2d->scratch = grown;
+        c2d->scratchSize = len + 1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        c2d->scratch[i] = isspace((unsigned char)text[i]) ? ' ' : text[i];
+    }
+    c2d->scratch[len] = '\0';
+
+    C2D_Text* drawText = &c2d->texts[c2d->count];
+    C2D_TextFontParse(drawText, c2d->font, c2d->buf, c2d->scratch);
+    C2D_TextOptimize(drawText);
+    return c2d->count++;
+}
+
+static void c2dDrawText(void* ctx, int handle, float x, float y, float z, float scale, uint32_t color, float wrapWidth) {
+    C2DRenderer* c2d = ctx;
+    if (handle < 0 || handle >= c2d->count) {
+        return;
+    }
+    if (wrapWidth > 0) {
+        C2D_DrawText(&c2d->texts[handle], C2D_WithColor | C2D_WordWrap, x, y, z, scale, scale, color, wrapWidth);
+    } else {
+        C2D_DrawText(&c2d->texts[handle], C2D_WithColor, x, y, z, scale, scale, color);
+    }
+}
+
+static void c2dDrawRect(void* ctx, float x, float y, float z, float w, float h, uint32_t color) {
+    C2D_DrawRectangle(x, y, z, w, h, color, color, color, color);
+}
+
+static int powerOfTwo(int size) {
+    int texSize = 8;
+    while (texSize < size) {
+        texSize *= 2;
+    }
+    return texSize;
+}
+
+static int c2dSurfaceNew(void* ctx, int width, int height) {
+    C2DRenderer* c2d = ctx;
+    int handle = 0;
+    while (handle < C2D_MAX_SURFACES && c2d->surfaces[handle].used) {
+        handle++;
+    }
+    if (handle == C2D_MAX_SURFACES || width > 1024 || height > 1024) {
+        return -1;
+    }
+
+    //Textures have to be a power of two on each side, the surface is the corner of one.
+    //VRAM is quickest to render into, linear memory will do when it runs out.
+    C2DSurface* surface = &c2d->surfaces[handle];
+    int texWidth = powerOfTwo(width);
+    int texHeight = powerOfTwo(height);
+    if (!C3D_TexInitVRAM(&surface->tex, texWidth, texHeight, GPU_RGBA8) &&
+        !C3D_TexInit(&surface->tex, texWidth, texHeight, GPU_RGBA8)) {
+        return -1;
+    }
+    surface->target = C3D_RenderTargetCreateFromTex(&surface->tex, GPU_TEXFACE_2D, 0, -1);
+    if (surface->target == NULL) {
+        C3D_TexDelete(&surface->tex);
+        return -1;
+    }
+    //Blitted 1:1, filtering would only blur it
+    C3D_TexSetFilter(&surface->tex, GPU_NEAREST, GPU_NEAREST);
+    //Render targets come out upside down in the texture, so the subtexture runs from the top
+    surface->subtex.width = width;
+    surface->subtex.height = height;
+    surface->subtex.left = 0.0f;
+    surface->subtex.top = 1.0f;
+    surface->subtex.right = (float)width / texWidth;
+    surface->subtex.bottom = 1.0f - (float)height / texHeight;
+    surface->used = 1;
+    return handle;
+}
+
+static void c2dSurfaceFree(void* ctx, int handle) {
+    C2DRenderer* c2d = ctx;
+    if (handle < 0 || handle >= C2D_MAX_SURFACES || !c2d->surfaces[handle].used) {
+        return;
+    }
+    C3D_RenderTargetDelete(c2d->surfaces[handle].target);
+    C3D_TexDelete(&c2d->surfaces[handle].tex);
+    c2d->surfaces[handle].used = 0;
+}
+
+static void c2dSurfaceBegin(void* ctx, int handle, uint32_t color) {
+    C2DRenderer* c2d = ctx;
+    C2D_TargetClear(c2d->surfaces[handle].target, color);
+    C2D_SceneBegin(c2d->surfaces[handle].target);
+}
+
+static void c2dSurfaceEnd(void* ctx) {
+    C2DRenderer* c2d = ctx;
+    C2D_SceneBegin(c2d->screen);
+}
+
+static void c2dDrawSurface(void* ctx, int handle, float x, float y, float z) {
+    C2DRenderer* c2d = ctx;
+    if (handle < 0 || handle >= C2D_MAX_SURFACES || !c2d->surfaces[handle].used) {
+        return;
+    }
+    C2D_Image image = { &c2d->surfaces[handle].tex, &c2d->surfaces[handle].subtex };
+    C2D_DrawImageAt(image, x, y, z, NULL, 1.0f, 1.0f);
+}
+
+void rendererInitC2D(Renderer* renderer, C2DRenderer* c2d, C2D_Font font) {
+    memset(c2d, 0, sizeof *c2d);
+    c2d->font = font;
+    renderer->ctx = c2d;
+    renderer->textReset = c2dTextReset;
+    renderer->textPrepare = c2dTextPrepare;
+    renderer->drawText = c2dDrawText;
+    renderer->drawRect = c2dDrawRect;
+    renderer->surfaceNew = c2dSurfaceNew;
+    renderer->surfaceFree = c2dSurfaceFree;
+    renderer->surfaceBegin = c2dSurfaceBegin;
+    renderer->surfaceEnd = c2dSurfaceEnd;
+    renderer->drawSurface = c2dDrawSurface;
+}
+
+void rendererFreeC2D(C2DRenderer* c2d) {
+    if (c2d->buf != NULL) {
+        C2D_TextBufDelete(c2d->buf);
+    }
+    for (int i = 0; i < C2D_MAX_SURFACES; i++) {
+        c2dSurfaceFree(c2d, i);
+    }
+    memFree(c2d->texts);
+    memFree(c2d->scratch);
+    memset(c2d, 0, sizeof *c2d);
+}
+
+int glyphTableLoadC2D(GlyphTable* table, C2D_Font font) {
+    FINF_s* info = C2D_FontGetInfo(font);
+    //citro2d scales a loaded font so its cells come out 30px tall at scale 1
+    float textScale = font != NULL ? 30.0f / info->tglp->cellHeight : 1.0f;
+    float fallback = C2D_FontGetCharWidthInfo(font, info->alterCharIndex)->charWidth * textScale;
+    if (glyphTableInit(table, fallback, info->lineFeed * textScale) != 0) {
+        return -1;
+    }
+    //Characters the font lacks map to its replacement glyph, same as when drawing
+    for (int c = 0; c < GLYPH_TABLE_SIZE; c++) {
+        int glyph = C2D_FontGlyphIndexFromCodePoint(font, c);
+        glyphTableSet(table, c, C2D_FontGetCharWidthInfo(font, glyph)->charWidth * textScale);
+    }
+    //c2dTextPrepare turns every kind of whitespace into a space
+    float space = (float)table->advances[' '] / GLYPH_UNIT;
+    for (const char* c = "\t\n\v\f\r"; *c; c++) {
+        glyphTableSet(table, *c, space);
+    }
+    return 0;
+}
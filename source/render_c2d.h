@@ -0,0 +1,38 @@
+#ifndef RENDER_C2D_H
+#define RENDER_C2D_H
+
+#include <citro2d.h>
+
+#include "glyphs.h"
+#include "render.h"
+
+#define C2D_MAX_SURFACES 8
+
+//A texture that can be drawn into
+typedef struct {
+    C3D_Tex tex;
+    C3D_RenderTarget* target;
+    Tex3DS_SubTexture subtex;
+    int used;
+} C2DSurface;
+
+//citro2d backend, one glyph buffer shared by every prepared text
+typedef struct {
+    C2D_Font font;
+    C2D_TextBuf buf;
+    size_t bufGlyphs;
+    C2D_Text* texts;
+    int count;
+    int capacity;
+    char* scratch;
+    size_t scratchSize;
+    C2DSurface surfaces[C2D_MAX_SURFACES];
+    C3D_RenderTarget* screen;   //Where drawing goes back to after a surface, set by the app
+} C2DRenderer;
+
+void rendererInitC2D(Renderer* renderer, C2DRenderer* c2d, C2D_Font font);
+void rendererFreeC2D(C2DRenderer* c2d);
+//Reads the advance of every character in the BMP out of the font, once
+int glyphTableLoadC2D(GlyphTable* table, C2D_Font font);
+
+#endif
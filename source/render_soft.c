@@ -0,0 +1,329 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "render_soft.h"
+
+#define FONT_WIDTH 8
+#define FONT_HEIGHT 18
+//The bitmaps are the size text comes out at this scale
+#define FONT_SCALE 0.6f
+
+//Printable ASCII rasterized from gfx/ffbold.ttf at 18px, one byte per row with
+//the leftmost pixel in the top bit. Anything else is drawn as '?'.
+static const uint8_t softFont[95][FONT_HEIGHT] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // ' '
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },   // '!'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '"'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x28, 0x7C, 0x7C, 0x28, 0x7C, 0x28, 0x28, 0x28, 0x00, 0x00, 0x00 },   // '#'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x3C, 0x64, 0x38, 0x0C, 0x44, 0x7C, 0x10, 0x10, 0x00, 0x00, 0x00 },   // '$'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x50, 0x50, 0x2C, 0x70, 0x14, 0x14, 0x18, 0x00, 0x00, 0x00, 0x00 },   // '%'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x28, 0x20, 0x74, 0x5C, 0x48, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // '&'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // "'"
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x08, 0x08, 0x18, 0x10, 0x10, 0x18, 0x08, 0x0C, 0x00, 0x00, 0x00 },   // '('
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x20, 0x30, 0x10, 0x10, 0x10, 0x30, 0x20, 0x20, 0x00, 0x00, 0x00 },   // ')'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x7C, 0x38, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '*'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x7E, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },   // '+'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x20, 0x20, 0x00, 0x00, 0x00 },   // ','
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '-'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },   // '.'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x08, 0x08, 0x18, 0x10, 0x30, 0x20, 0x60, 0x40, 0x00, 0x00, 0x00 },   // '/'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x6C, 0x44, 0x44, 0x44, 0x44, 0x6C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // '0'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x70, 0x10, 0x10, 0x10, 0x10, 0x3C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '1'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x6C, 0x44, 0x0C, 0x18, 0x30, 0x7C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // '2'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x6C, 0x04, 0x18, 0x0C, 0x04, 0x4C, 0x78, 0x00, 0x00, 0x00, 0x00 },   // '3'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x18, 0x38, 0x28, 0x68, 0x7C, 0x18, 0x1C, 0x00, 0x00, 0x00, 0x00 },   // '4'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x60, 0x60, 0x7C, 0x04, 0x04, 0x4C, 0x78, 0x00, 0x00, 0x00, 0x00 },   // '5'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x30, 0x20, 0x78, 0x64, 0x64, 0x24, 0x18, 0x00, 0x00, 0x00, 0x00 },   // '6'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x44, 0x0C, 0x08, 0x08, 0x18, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },   // '7'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x6C, 0x44, 0x38, 0x7C, 0x44, 0x6C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // '8'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x6C, 0x44, 0x6C, 0x3C, 0x04, 0x18, 0x70, 0x00, 0x00, 0x00, 0x00 },   // '9'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },   // ':'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x30, 0x20, 0x20, 0x00, 0x00, 0x00 },   // ';'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x38, 0x60, 0x18, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '<'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x00, 0xFE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '='
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x38, 0x0C, 0x30, 0x40, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '>'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x44, 0x0C, 0x18, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00 },   // '?'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x2C, 0x44, 0x5C, 0x54, 0x54, 0x5C, 0x40, 0x2C, 0x00, 0x00, 0x00 },   // '@'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x28, 0x28, 0x6C, 0x7C, 0xC6, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'A'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFC, 0x44, 0x4C, 0x7C, 0x46, 0x7E, 0xFC, 0x00, 0x00, 0x00, 0x00 },   // 'B'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x46, 0xC0, 0xC0, 0xC0, 0x66, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'C'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF8, 0x44, 0x44, 0x46, 0x44, 0x7C, 0xF8, 0x00, 0x00, 0x00, 0x00 },   // 'D'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFC, 0x44, 0x50, 0x70, 0x54, 0x7E, 0xFE, 0x00, 0x00, 0x00, 0x00 },   // 'E'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0x46, 0x50, 0x70, 0x50, 0x70, 0xF0, 0x00, 0x00, 0x00, 0x00 },   // 'F'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x46, 0xC0, 0xCE, 0xCE, 0x66, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'G'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6E, 0x44, 0x44, 0x7C, 0x44, 0x6C, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'H'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x10, 0x10, 0x10, 0x10, 0x3C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'I'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x04, 0x04, 0x44, 0x44, 0x4C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // 'J'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x48, 0x50, 0x78, 0x48, 0x66, 0xE6, 0x00, 0x00, 0x00, 0x00 },   // 'K'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x20, 0x20, 0x20, 0x22, 0x7E, 0x7E, 0x00, 0x00, 0x00, 0x00 },   // 'L'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0xEE, 0xEE, 0xFE, 0xD6, 0xC6, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'M'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x64, 0x74, 0x5C, 0x4C, 0x6C, 0xE4, 0x00, 0x00, 0x00, 0x00 },   // 'N'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x44, 0xC2, 0x82, 0xC6, 0x6C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // 'O'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFC, 0x44, 0x44, 0x7C, 0x40, 0x70, 0xF0, 0x00, 0x00, 0x00, 0x00 },   // 'P'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x44, 0xC2, 0x82, 0xC6, 0x6C, 0x38, 0x7E, 0x00, 0x00, 0x00 },   // 'Q'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFC, 0x44, 0x44, 0x78, 0x4C, 0x66, 0xE2, 0x00, 0x00, 0x00, 0x00 },   // 'R'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x44, 0x60, 0x3C, 0x44, 0x6C, 0x78, 0x00, 0x00, 0x00, 0x00 },   // 'S'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0xD6, 0x56, 0x10, 0x10, 0x38, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'T'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x44, 0x44, 0x44, 0x44, 0x6C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // 'U'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x44, 0x64, 0x28, 0x28, 0x38, 0x10, 0x00, 0x00, 0x00, 0x00 },   // 'V'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0xC6, 0x5C, 0x7C, 0x6C, 0x6C, 0x64, 0x00, 0x00, 0x00, 0x00 },   // 'W'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x6C, 0x38, 0x38, 0x28, 0x44, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'X'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x6C, 0x38, 0x10, 0x10, 0x38, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'Y'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x4C, 0x58, 0x30, 0x24, 0x7C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'Z'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1C, 0x00, 0x00, 0x00 },   // '['
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x40, 0x20, 0x20, 0x10, 0x10, 0x08, 0x08, 0x0C, 0x04, 0x00, 0x00, 0x00 },   // '\\'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x30, 0x00, 0x00, 0x00 },   // ']'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x38, 0x6C, 0x44, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '^'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFE, 0x00, 0x00 },   // '_'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '`'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x7C, 0x3C, 0x44, 0x4C, 0x76, 0x00, 0x00, 0x00, 0x00 },   // 'a'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x40, 0x58, 0x7C, 0x46, 0x42, 0xE4, 0xF8, 0x00, 0x00, 0x00, 0x00 },   // 'b'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x7C, 0x44, 0x40, 0x66, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'c'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x34, 0x7C, 0xC4, 0xC4, 0x6E, 0x3E, 0x00, 0x00, 0x00, 0x00 },   // 'd'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x7C, 0xC4, 0xFE, 0x64, 0x3C, 0x00, 0x00, 0x00, 0x00 },   // 'e'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x36, 0x30, 0x7C, 0x30, 0x30, 0x78, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'f'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x7E, 0xC4, 0xC4, 0x4C, 0x34, 0x04, 0x38, 0x00, 0x00 },   // 'g'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x40, 0x58, 0x7C, 0x44, 0x44, 0x64, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'h'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x00, 0x70, 0x10, 0x10, 0x7C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'i'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 0x3C, 0x04, 0x04, 0x04, 0x04, 0x0C, 0x78, 0x00, 0x00 },   // 'j'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x60, 0x60, 0x7C, 0x70, 0x70, 0x6C, 0x6E, 0x00, 0x00, 0x00, 0x00 },   // 'k'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'l'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2C, 0xFE, 0xD6, 0xD6, 0xD6, 0xDE, 0x00, 0x00, 0x00, 0x00 },   // 'm'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x7C, 0x44, 0x44, 0x64, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'n'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x7C, 0x46, 0x46, 0x6C, 0x38, 0x00, 0x00, 0x00, 0x00 },   // 'o'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0xFC, 0x46, 0x46, 0x7C, 0x58, 0x40, 0xF0, 0x00, 0x00 },   // 'p'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0x7E, 0xC4, 0xC4, 0x7C, 0x14, 0x04, 0x0E, 0x00, 0x00 },   // 'q'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x7E, 0x30, 0x20, 0x78, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'r'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x7C, 0x70, 0x1C, 0x64, 0x78, 0x00, 0x00, 0x00, 0x00 },   // 's'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x60, 0x60, 0xF8, 0x60, 0x60, 0x64, 0x38, 0x00, 0x00, 0x00, 0x00 },   // 't'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xCC, 0x44, 0x44, 0x6C, 0x36, 0x00, 0x00, 0x00, 0x00 },   // 'u'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x6C, 0x28, 0x38, 0x10, 0x00, 0x00, 0x00, 0x00 },   // 'v'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0x54, 0x7C, 0x6C, 0x2C, 0x00, 0x00, 0x00, 0x00 },   // 'w'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6C, 0x38, 0x38, 0x6C, 0xEE, 0x00, 0x00, 0x00, 0x00 },   // 'x'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xEE, 0x64, 0x28, 0x38, 0x10, 0x30, 0xF0, 0x00, 0x00 },   // 'y'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x58, 0x30, 0x7C, 0x7C, 0x00, 0x00, 0x00, 0x00 },   // 'z'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x10, 0x10, 0x10, 0x30, 0x10, 0x10, 0x10, 0x18, 0x00, 0x00, 0x00 },   // '{'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 },   // '|'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x10, 0x10, 0x10, 0x18, 0x18, 0x10, 0x10, 0x30, 0x00, 0x00, 0x00 },   // '}'
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x34, 0x5C, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },   // '~'
+};
+
+static void softTextReset(void* ctx, int texts, size_t glyphs) {
+    SoftRenderer* soft = ctx;
+    //glyphs is the byte count from the text cache, a byte per glyph at most
+    if (texts > soft->capacity) {
+        SoftText* grown = memRealloc(MEM_UI, soft->texts, texts * sizeof *grown);
+        if (grown != NULL) {
+            soft->texts = grown;
+            soft->capacity = texts;
+        }
+    }
+    if (glyphs > soft->byteCapacity) {
+        char* grown = memRealloc(MEM_UI, soft->bytes, glyphs);
+        if (grown != NULL) {
+            soft->bytes = grown;
+            soft->byteCapacity = glyphs;
+        }
+    }
+    soft->count = 0;
+    soft->used = 0;
+}
+
+static int softTextPrepare(void* ctx, const char* text, size_t len) {
+    SoftRenderer* soft = ctx;
+    if (soft->count >= soft->capacity || len > soft->byteCapacity - soft->used) {
+        return -1;
+    }
+    memcpy(soft->bytes + soft->used, text, len);
+    soft->texts[soft->count].start = soft->used;
+    soft->texts[soft->count].length = len;
+    soft->used += len;
+    return soft->count++;
+}
+
+//Nearest pixel, rounding the same way on both sides of 0 so tiles line up
+static int roundPixel(float coordinate) {
+    return (int)floorf(coordinate + 0.5f);
+}
+
+static void fill(SoftSurface* surface, int x, int y, int w, int h, uint32_t color) {
+    int x1 = x + w > surface->width ? surface->width : x + w;
+    int y1 = y + h > surface->height ? surface->height : y + h;
+    x = x < 0 ? 0 : x;
+    y = y < 0 ? 0 : y;
+    for (int row = y; row < y1; row++) {
+        uint32_t* pixel = surface->pixels + (size_t)row * surface->width;
+        for (int col = x; col < x1; col++) {
+            pixel[col] = color;
+        }
+    }
+}
+
+//Nearest neighbour scaling of one bitmap, clipped to the surface
+static void drawGlyph(SoftSurface* surface, const uint8_t* bitmap, int x, int y, float factor, uint32_t color) {
+    int w = (int)(FONT_WIDTH * factor + 0.5f);
+    int h = (int)(FONT_HEIGHT * factor + 0.5f);
+    for (int dy = 0; dy < h; dy++) {
+        int py = y + dy;
+        if (py < 0 || py >= surface->height) {
+            continue;
+        }
+        int bits = bitmap[(int)(dy / factor)];
+        if (bits == 0) {
+            continue;
+        }
+        uint32_t* pixel = surface->pixels + (size_t)py * surface->width;
+        for (int dx = 0; dx < w; dx++) {
+            int px = x + dx;
+            if (px >= 0 && px < surface->width && (bits & (0x80 >> (int)(dx / factor)))) {
+                pixel[px] = color;
+            }
+        }
+    }
+}
+
+static void softDrawText(void* ctx, int handle, float x, float y, float z, float scale, uint32_t color, float wrapWidth) {
+    SoftRenderer* soft = ctx;
+    if (handle < 0 || handle >= soft->count) {
+        return;
+    }
+    SoftSurface* surface = &soft->surfaces[soft->target];
+    const char* text = soft->bytes + soft->texts[handle].start;
+    int length = soft->texts[handle].length;
+    float factor = scale / FONT_SCALE;
+    float lineFeed = soft->glyphs != NULL ? soft->glyphs->lineFeed * scale : FONT_HEIGHT * factor;
+    float penX = x;
+    float penY = y;
+    int size;
+    for (int i = 0; i < length; i += size) {
+        unsigned char c = text[i];
+        float advance;
+        if (soft->glyphs != NULL) {
+            advance = (float)glyphAdvance(soft->glyphs, text + i, length - i, &size) * scale / GLYPH_UNIT;
+        } else {
+            size = c < 0x80 ? 1 : c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+            advance = FONT_WIDTH * factor;
+        }
+        if (c == '\n' || (wrapWidth > 0 && penX + advance > x + wrapWidth && penX > x)) {
+            penX = x;
+            penY += lineFeed;
+            if (c == '\n') {
+                continue;
+            }
+        }
+        if (c != ' ') {
+            int index = c >= 0x20 && c < 0x7F ? c - 0x20 : '?' - 0x20;
+            drawGlyph(surface, softFont[index], roundPixel(penX), roundPixel(penY), factor, color);
+            soft->glyphDraws++;
+        }
+        penX += advance;
+    }
+}
+
+//No depth buffer, everything the app draws is opaque and later draws go over earlier ones
+static void softDrawRect(void* ctx, float x, float y, float z, float w, float h, uint32_t color) {
+    SoftRenderer* soft = ctx;
+    fill(&soft->surfaces[soft->target], roundPixel(x), roundPixel(y), roundPixel(w), roundPixel(h), color);
+    soft->rectDraws++;
+}
+
+static int softSurfaceNew(void* ctx, int width, int height) {
+    SoftRenderer* soft = ctx;
+    int handle = 1;
+    while (handle < SOFT_MAX_SURFACES && soft->surfaces[handle].pixels != NULL) {
+        handle++;
+    }
+    if (handle == SOFT_MAX_SURFACES) {
+        return -1;
+    }
+    soft->surfaces[handle].pixels = memAlloc(MEM_UI, (size_t)width * height * sizeof(uint32_t));
+    if (soft->surfaces[handle].pixels == NULL) {
+        return -1;
+    }
+    soft->surfaces[handle].width = width;
+    soft->surfaces[handle].height = height;
+    return handle;
+}
+
+static void softSurfaceFree(void* ctx, int handle) {
+    SoftRenderer* soft = ctx;
+    if (handle > 0 && handle < SOFT_MAX_SURFACES) {
+        memFree(soft->surfaces[handle].pixels);
+        soft->surfaces[handle].pixels = NULL;
+    }
+}
+
+static void softSurfaceBegin(void* ctx, int handle, uint32_t color) {
+    SoftRenderer* soft = ctx;
+    soft->target = handle;
+    SoftSurface* surface = &soft->surfaces[handle];
+    fill(surface, 0, 0, surface->width, surface->height, color);
+}
+
+static void softSurfaceEnd(void* ctx) {
+    SoftRenderer* soft = ctx;
+    soft->target = 0;
+}
+
+//Whole rows at a time, surfaces are only ever drawn 1:1
+static void softDrawSurface(void* ctx, int handle, float x, float y, float z) {
+    SoftRenderer* soft = ctx;
+    if (handle <= 0 || handle >= SOFT_MAX_SURFACES || soft->surfaces[handle].pixels == NULL) {
+        return;
+    }
+    const SoftSurface* from = &soft->surfaces[handle];
+    SoftSurface* to = &soft->surfaces[soft->target];
+    int left = roundPixel(x);
+    int top = roundPixel(y);
+    int skip = left < 0 ? -left : 0;
+    int width = (left + from->width > to->width ? to->width - left : from->width) - skip;
+    if (width <= 0) {
+        return;
+    }
+    for (int row = top < 0 ? -top : 0; row < from->height && top + row < to->height; row++) {
+        memcpy(to->pixels + (size_t)(top + row) * to->width + left + skip,
+               from->pixels + (size_t)row * from->width + skip,
+               width * sizeof(uint32_t));
+    }
+    soft->blits++;
+}
+
+int rendererInitSoft(Renderer* renderer, SoftRenderer* soft, int width, int height, const GlyphTable* glyphs) {
+    memset(soft, 0, sizeof *soft);
+    soft->glyphs = glyphs;
+    soft->surfaces[0].pixels = memCalloc(MEM_UI, (size_t)width * height, sizeof(uint32_t));
+    if (soft->surfaces[0].pixels == NULL) {
+        return -1;
+    }
+    soft->surfaces[0].width = width;
+    soft->surfaces[0].height = height;
+
+    renderer->ctx = soft;
+    renderer->textReset = softTextReset;
+    renderer->textPrepare = softTextPrepare;
+    renderer->drawText = softDrawText;
+    renderer->drawRect = softDrawRect;
+    renderer->surfaceNew = softSurfaceNew;
+    renderer->surfaceFree = softSurfaceFree;
+    renderer->surfaceBegin = softSurfaceBegin;
+    renderer->surfaceEnd = softSurfaceEnd;
+    renderer->drawSurface = softDrawSurface;
+    return 0;
+}
+
+void rendererFreeSoft(SoftRenderer* soft) {
+    for (int i = 0; i < SOFT_MAX_SURFACES; i++) {
+        memFree(soft->surfaces[i].pixels);
+        soft->surfaces[i].pixels = NULL;
+    }
+    memFree(soft->bytes);
+    memFree(soft->texts);
+    soft->bytes = NULL;
+    soft->texts = NULL;
+}
+
+void softClear(SoftRenderer* soft, uint32_t color) {
+    fill(&soft->surfaces[0], 0, 0, soft->surfaces[0].width, soft->surfaces[0].height, color);
+}
@@ -0,0 +1,49 @@
+#ifndef RENDER_SOFT_H
+#define RENDER_SOFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "glyphs.h"
+#include "render.h"
+
+//Surface 0 is the screen, the rest are handed out by surfaceNew
+#define SOFT_MAX_SURFACES 16
+
+//Pixels are 32 bit colors as made by C2D_Color32, rows are width apart
+typedef struct {
+    uint32_t* pixels;
+    int width;
+    int height;
+} SoftSurface;
+
+typedef struct {
+    size_t start;   //Into the renderer's byte pool
+    size_t length;
+} SoftText;
+
+//CPU backend drawing into memory, for running the page code on a machine
+//without a GPU. Text uses a small built-in bitmap font, spaced with the
+//glyph table so rows land where layout put them.
+typedef struct {
+    const GlyphTable* glyphs;
+    SoftSurface surfaces[SOFT_MAX_SURFACES];
+    int target;
+    char* bytes;
+    size_t used;
+    size_t byteCapacity;
+    SoftText* texts;
+    int count;
+    int capacity;
+    unsigned long glyphDraws;
+    unsigned long rectDraws;
+    unsigned long blits;
+} SoftRenderer;
+
+//glyphs may be NULL, every character is then the width of the bitmap font
+int rendererInitSoft(Renderer* renderer, SoftRenderer* soft, int width, int height, const GlyphTable* glyphs);
+void rendererFreeSoft(SoftRenderer* soft);
+//Fills the screen, the software side of C2D_TargetClear
+void softClear(SoftRenderer* soft, uint32_t color);
+
+#endif
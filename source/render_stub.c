@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "render.h"
+
+static void stubTextReset(void* ctx, int texts, size_t glyphs) {
+    StubRenderer* stub = ctx;
+    //The citro2d backend only allocates when the pool has to grow, mirror that
+    if (glyphs > stub->glyphs) {
+        stub->glyphs = glyphs;
+        stub->allocations++;
+    }
+    if (texts > stub->texts) {
+        stub->texts = texts;
+        stub->allocations++;
+    }
+    stub->prepared = 0;
+}
+
+static int stubTextPrepare(void* ctx, const char* text, size_t len) {
+    StubRenderer* stub = ctx;
+    return stub->prepared++;
+}
+
+static void stubDrawText(void* ctx, int handle, float x, float y, float z, float scale, uint32_t color, float wrapWidth) {
+    StubRenderer* stub = ctx;
+    stub->textDraws++;
+}
+
+static void stubDrawRect(void* ctx, float x, float y, float z, float w, float h, uint32_t color) {
+    StubRenderer* stub = ctx;
+    stub->rectDraws++;
+}
+
+static int stubSurfaceNew(void* ctx, int width, int height) {
+    StubRenderer* stub = ctx;
+    stub->allocations++;
+    return stub->surfaces++;
+}
+
+static void stubSurfaceFree(void* ctx, int surface) {
+}
+
+static void stubSurfaceBegin(void* ctx, int surface, uint32_t color) {
+    StubRenderer* stub = ctx;
+    stub->surfacePaints++;
+}
+
+static void stubSurfaceEnd(void* ctx) {
+}
+
+static void stubDrawSurface(void* ctx, int surface, float x, float y, float z) {
+    StubRenderer* stub = ctx;
+    stub->surfaceDraws++;
+}
+
+void rendererInitStub(Renderer* renderer, StubRenderer* stub) {
+    memset(stub, 0, sizeof *stub);
+    renderer->ctx = stub;
+    renderer->textReset = stubTextReset;
+    renderer->textPrepare = stubTextPrepare;
+    renderer->drawText = stubDrawText;
+    renderer->drawRect = stubDrawRect;
+    renderer->surfaceNew = stubSurfaceNew;
+    renderer->surfaceFree = stubSurfaceFree;
+    renderer->surfaceBegin = stubSurfaceBegin;
+    renderer->surfaceEnd = stubSurfaceEnd;
+    renderer->drawSurface = stubDrawSurface;
+}
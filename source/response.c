@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "memstats.h"
+#include "response.h"
+
+int parseGeminiHeader(const char* data, size_t len, GeminiHeader* header) {
+    const char* lineEnd = memchr(data, '\n', len);
+    if (lineEnd == NULL) {
+        return len >= GEMINI_HEADER_MAX ? RESPONSE_BAD_HEADER : 0;
+    }
+    size_t headerLength = lineEnd - data + 1;
+    if (headerLength > GEMINI_HEADER_MAX) {
+        return RESPONSE_BAD_HEADER;
+    }
+
+    if (headerLength < 3 || !isdigit((unsigned char)data[0]) || !isdigit((unsigned char)data[1])) {
+        return RESPONSE_BAD_HEADER;
+    }
+    header->status = (data[0] - '0') * 10 + (data[1] - '0');
+
+    //Be lenient, some servers send a bare LF or leave out the space before an empty meta
+    const char* meta = data + 2;
+    const char* metaEnd = lineEnd;
+    if (metaEnd > meta && metaEnd[-1] == '\r') {
+        metaEnd--;
+    }
+    if (meta < metaEnd && *meta == ' ') {
+        meta++;
+    } else if (meta < metaEnd) {
+        return RESPONSE_BAD_HEADER;
+    }
+    //Without the space a bare LF header can carry one byte more than meta holds
+    if (metaEnd - meta > GEMINI_META_MAX) {
+        return RESPONSE_BAD_HEADER;
+    }
+    memcpy(header->meta, meta, metaEnd - meta);
+    header->meta[metaEnd - meta] = '\0';
+    return headerLength;
+}
+
+int readGeminiResponse(Transport* transport, GeminiHeader* header, BodyCallback onBody, void* user) {
+    memset(header, 0, sizeof *header);
+    unsigned char* record = memAlloc(MEM_NETWORK, RESPONSE_RECORD_SIZE);
+    if (record == NULL) {
+        return RESPONSE_NO_MEMORY;
+    }
+
+    //Keep reading until the header is complete, it can arrive split across records
+    size_t filled = 0;
+    int headerLength = 0;
+    while (headerLength == 0) {
+        int ret = transport->recv(transport->ctx, record + filled, RESPONSE_RECORD_SIZE - filled);
+        if (ret <= 0) {
+            memFree(record);
+            return filled == 0 && ret < 0 ? RESPONSE_RECV_FAILED : RESPONSE_BAD_HEADER;
+        }
+        filled += ret;
+        headerLength = parseGeminiHeader((const char*)record, filled, header);
+        if (headerLength < 0) {
+            memFree(record);
+            return RESPONSE_BAD_HEADER;
+        }
+    }
+
+    if (header->status / 10 != 2) {
+        memFree(record);
+        return RESPONSE_OK;
+    }
+    if (filled > (size_t)headerLength) {
+        onBody(user, (const char*)record + headerLength, filled - headerLength);
+    }
+
+    int result = RESPONSE_OK;
+    while (1) {
+        int ret = transport->recv(transport->ctx, record, RESPONSE_RECORD_SIZE);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0) {
+            result = RESPONSE_RECV_FAILED;
+            break;
+        }
+        onBody(user, (const char*)record, ret);
+    }
+
+    memFree(record);
+    return result;
+}
+
+const char* geminiStatusName(int status) {
+    switch (status) {
+    case 40: return "Temporary failure";
+    case 41: return "Server unavailable";
+    case 42: return "CGI error";
+    case 43: return "Proxy error";
+    case 44: return "Slow down";
+    case 50: return "Permanent failure";
+    case 51: return "Not found";
+    case 52: return "Gone";
+    case 53: return "Proxy request refused";
+    case 59: return "Bad request";
+    case 60: return "Client certificate required";
+    case 61: return "Certificate not authorised";
+    case 62: return "Certificate not valid";
+    }
+    switch (status / 10) {
+    case 1: return "Input";
+    case 2: return "Success";
+    case 3: return "Redirect";
+    case 4: return "Temporary failure";
+    case 5: return "Permanent failure";
+    case 6: return "Client certificate required";
+    }
+    return "Unexpected status";
+}
+
+int geminiIsGemtext(const char* meta) {
+    while (*meta == ' ') {
+        meta++;
+    }
+    //An empty meta means text/gemini
+    if (*meta == '\0' || *meta == ';') {
+        return 1;
+    }
+    size_t length = strcspn(meta, "; ");
+    return length == 11 && strncasecmp(meta, "text/gemini", 11) == 0;
+}
@@ -0,0 +1,45 @@
+#ifndef RESPONSE_H
+#define RESPONSE_H
+
+#include <stddef.h>
+
+#define GEMINI_META_MAX 1024
+//Two digit status, a space, the meta and CRLF
+#define GEMINI_HEADER_MAX (GEMINI_META_MAX + 5)
+//Largest TLS record, no point reading more than this at a time
+#define RESPONSE_RECORD_SIZE (16 * 1024)
+
+enum ResponseResult {
+    RESPONSE_OK = 0,
+    RESPONSE_NO_MEMORY = -1,
+    RESPONSE_BAD_HEADER = -2,
+    RESPONSE_RECV_FAILED = -3,
+};
+
+//Anything we can read a response from, usually a TLS session
+typedef struct {
+    void* ctx;
+    //Returns bytes read, 0 at the end of the stream or a negative error
+    int (*recv)(void* ctx, unsigned char* buf, size_t len);
+} Transport;
+
+typedef struct {
+    int status;
+    char meta[GEMINI_META_MAX + 1];
+} GeminiHeader;
+
+//Called with each piece of the body as it arrives
+typedef void (*BodyCallback)(void* user, const char* data, size_t len);
+
+//Returns the header length once a full header is in data, 0 if more bytes are needed
+//and RESPONSE_BAD_HEADER if it can't be a gemini header
+int parseGeminiHeader(const char* data, size_t len, GeminiHeader* header);
+//Reads the header, then streams the body to onBody one record at a time.
+//Only a 2x response has a body, reading stops after the header of any other.
+int readGeminiResponse(Transport* transport, GeminiHeader* header, BodyCallback onBody, void* user);
+//What a status means in a few words, by its first digit if it isn't one we know
+const char* geminiStatusName(int status);
+//Whether the meta of a 2x response says the body is gemtext, parameters aside
+int geminiIsGemtext(const char* meta);
+
+#endif
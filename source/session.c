@@ -0,0 +1,414 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "memstats.h"
+#include "session.h"
+
+#define SESSION_MAGIC 0x31535347    //"GSS1"
+#define SESSION_VERSION 1
+//How often a worker waiting for its frame to come round looks again
+#define SESSION_WAIT_MS 2
+
+enum SessionRecordType {
+    SESSION_FRAMES = 1,
+    SESSION_TEXT,
+    SESSION_RESPONSE,
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} SessionFileHeader;
+
+typedef struct {
+    uint32_t type;
+    uint32_t length;    //Of what follows
+} SessionRecordHeader;
+
+//Followed by the url and then the response
+typedef struct {
+    uint32_t frame;
+    int32_t error;
+    int32_t detail;
+    uint32_t urlLength;
+} SessionResponseHeader;
+
+//Caller holds the lock
+static void writeRecord(SessionRecorder* rec, int type, const void* head, size_t headLength, const void* data, size_t length) {
+    SessionRecordHeader header = { type, headLength + length };
+    if (fwrite(&header, sizeof header, 1, rec->file) != 1 ||
+        (headLength > 0 && fwrite(head, headLength, 1, rec->file) != 1) ||
+        (length > 0 && fwrite(data, length, 1, rec->file) != 1)) {
+        rec->failed = 1;
+    }
+}
+
+static void flushFrames(SessionRecorder* rec) {
+    if (rec->repeats > 0) {
+        SessionFrames run = { rec->frame - rec->repeats, rec->repeats, rec->last };
+        writeRecord(rec, SESSION_FRAMES, &run, sizeof run, NULL, 0);
+        rec->repeats = 0;
+    }
+}
+
+int sessionRecordStart(SessionRecorder* rec, const char* path, const FetchNetwork* inner) {
+    memset(rec, 0, sizeof *rec);
+    rec->inner = *inner;
+    rec->lock = platformMutexNew();
+    rec->file = fopen(path, "wb");
+    SessionFileHeader header = { SESSION_MAGIC, SESSION_VERSION };
+    if (rec->lock == NULL || rec->file == NULL || fwrite(&header, sizeof header, 1, rec->file) != 1) {
+        sessionRecordStop(rec);
+        return -1;
+    }
+    return 0;
+}
+
+void sessionRecordFrame(SessionRecorder* rec, const SessionInput* input) {
+    platformMutexLock(rec->lock);
+    if (rec->repeats > 0 && memcmp(input, &rec->last, sizeof *input) != 0) {
+        flushFrames(rec);
+    }
+    rec->last = *input;
+    rec->repeats++;
+    rec->frame++;
+    platformMutexUnlock(rec->lock);
+}
+
+void sessionRecordText(SessionRecorder* rec, const char* text) {
+    platformMutexLock(rec->lock);
+    writeRecord(rec, SESSION_TEXT, NULL, 0, text, strlen(text));
+    platformMutexUnlock(rec->lock);
+}
+
+int sessionRecordStop(SessionRecorder* rec) {
+    if (rec->file != NULL) {
+        platformMutexLock(rec->lock);
+        flushFrames(rec);
+        platformMutexUnlock(rec->lock);
+        if (fclose(rec->file) != 0) {
+            rec->failed = 1;
+        }
+        rec->file = NULL;
+    }
+    if (rec->lock != NULL) {
+        platformMutexFree(rec->lock);
+        rec->lock = NULL;
+    }
+    return rec->failed ? -1 : 0;
+}
+
+//A connection of the inner network with everything read from it kept aside
+typedef struct {
+    SessionRecorder* rec;
+    void* inner;
+    Transport transport;
+    Buffer data;
+    SessionResponseHeader header;
+    char url[URL_MAX];
+} RecordingConn;
+
+static int recordingRecv(void* ctx, unsigned char* buf, size_t len) {
+    RecordingConn* conn = ctx;
+    int ret = conn->transport.recv(conn->transport.ctx, buf, len);
+    if (ret > 0 && bufferAppend(&conn->data, (const char*)buf, ret) != 0) {
+        conn->rec->failed = 1;
+    }
+    return ret;
+}
+
+static int openRecording(void* ctx, FetchJob* job, const char* request, Transport* transport, void** out) {
+    SessionRecorder* rec = ctx;
+    RecordingConn* conn = memCalloc(MEM_NETWORK, 1, sizeof *conn);
+    if (conn == NULL) {
+        return FETCH_SETUP_FAILED;
+    }
+    *out = conn;
+    conn->rec = rec;
+    bufferInit(&conn->data, MEM_NETWORK);
+    snprintf(conn->url, sizeof conn->url, "%s", job->url);
+    platformMutexLock(rec->lock);
+    conn->header.frame = rec->frame;
+    platformMutexUnlock(rec->lock);
+
+    int ret = rec->inner.open(rec->inner.ctx, job, request, &conn->transport, &conn->inner);
+    conn->header.error = ret;
+    conn->header.detail = job->detail;
+    if (ret == FETCH_OK) {
+        transport->ctx = conn;
+        transport->recv = recordingRecv;
+    }
+    return ret;
+}
+
+static void closeRecording(void* ctx, void* out) {
+    SessionRecorder* rec = ctx;
+    RecordingConn* conn = out;
+    if (conn->inner != NULL) {
+        rec->inner.close(rec->inner.ctx, conn->inner);
+    }
+    //The url goes in front of the response, both in one record
+    conn->header.urlLength = strlen(conn->url);
+    size_t headLength = sizeof conn->header + conn->header.urlLength;
+    char head[sizeof conn->header + URL_MAX];
+    memcpy(head, &conn->header, sizeof conn->header);
+    memcpy(head + sizeof conn->header, conn->url, conn->header.urlLength);
+    platformMutexLock(rec->lock);
+    writeRecord(rec, SESSION_RESPONSE, head, headLength, conn->data.data, conn->data.length);
+    rec->responses++;
+    platformMutexUnlock(rec->lock);
+    bufferFree(&conn->data);
+    memFree(conn);
+}
+
+void networkInitRecording(FetchNetwork* network, SessionRecorder* rec) {
+    network->ctx = rec;
+    network->open = openRecording;
+    network->close = closeRecording;
+}
+
+//Walks the records, filling in the tables if they are there. Returns -1 if the file is cut short.
+static int readRecords(SessionReplay* replay, size_t size) {
+    int runs = 0;
+    int texts = 0;
+    int responses = 0;
+    size_t at = sizeof(SessionFileHeader);
+    while (at < size) {
+        SessionRecordHeader header;
+        if (size - at < sizeof header) {
+            return -1;
+        }
+        memcpy(&header, replay->file + at, sizeof header);
+        at += sizeof header;
+        if (size - at < header.length) {
+            return -1;
+        }
+        const char* data = replay->file + at;
+        if (header.type == SESSION_FRAMES && header.length == sizeof(SessionFrames)) {
+            if (replay->frames != NULL) {
+                memcpy(&replay->frames[runs], data, sizeof(SessionFrames));
+            }
+            runs++;
+        } else if (header.type == SESSION_TEXT) {
+            if (replay->texts != NULL) {
+                replay->texts[texts].text = data;
+                replay->texts[texts].length = header.length;
+            }
+            texts++;
+        } else if (header.type == SESSION_RESPONSE && header.length >= sizeof(SessionResponseHeader)) {
+            SessionResponseHeader head;
+            memcpy(&head, data, sizeof head);
+            if (head.urlLength > header.length - sizeof head) {
+                return -1;
+            }
+            if (replay->responses != NULL) {
+                SessionResponse* response = &replay->responses[responses];
+                response->frame = head.frame;
+                response->error = head.error;
+                response->detail = head.detail;
+                response->url = data + sizeof head;
+                response->urlLength = head.urlLength;
+                response->data = response->url + head.urlLength;
+                response->length = header.length - sizeof head - head.urlLength;
+            }
+            responses++;
+        }
+        at += header.length;
+    }
+    replay->runCount = runs;
+    replay->textCount = texts;
+    replay->responseCount = responses;
+    return 0;
+}
+
+static int compareRuns(const void* a, const void* b) {
+    const SessionFrames* x = a;
+    const SessionFrames* y = b;
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+int sessionReplayOpen(SessionReplay* replay, const char* path) {
+    memset(replay, 0, sizeof *replay);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    SessionFileHeader header;
+    int ret = -1;
+    if (size >= (long)sizeof header && fseek(file, 0, SEEK_SET) == 0 &&
+        (replay->file = memAlloc(MEM_OTHER, size)) != NULL &&
+        fread(replay->file, size, 1, file) == 1) {
+        memcpy(&header, replay->file, sizeof header);
+        //Counted first, then read into tables of the right size
+        if (header.magic == SESSION_MAGIC && header.version == SESSION_VERSION && readRecords(replay, size) == 0) {
+            replay->frames = memCalloc(MEM_OTHER, replay->runCount + 1, sizeof *replay->frames);
+            replay->texts = memCalloc(MEM_OTHER, replay->textCount + 1, sizeof *replay->texts);
+            replay->responses = memCalloc(MEM_OTHER, replay->responseCount + 1, sizeof *replay->responses);
+            replay->lock = platformMutexNew();
+            if (replay->frames != NULL && replay->texts != NULL && replay->responses != NULL && replay->lock != NULL) {
+                ret = readRecords(replay, size);
+            }
+        }
+    }
+    fclose(file);
+    if (ret != 0) {
+        sessionReplayFree(replay);
+        return -1;
+    }
+    //Runs are written when they end, a response can come in between
+    qsort(replay->frames, replay->runCount, sizeof *replay->frames, compareRuns);
+    for (int i = 0; i < replay->runCount; i++) {
+        replay->frameCount += replay->frames[i].count;
+    }
+    replay->frameUs = memCalloc(MEM_OTHER, replay->frameCount + 1, sizeof *replay->frameUs);
+    if (replay->frameUs == NULL) {
+        sessionReplayFree(replay);
+        return -1;
+    }
+    return 0;
+}
+
+int sessionReplayFrame(SessionReplay* replay, SessionInput* out) {
+    unsigned int frame = replay->frame;
+    while (replay->run < replay->runCount && frame >= replay->frames[replay->run].first + replay->frames[replay->run].count) {
+        replay->run++;
+    }
+    if (replay->run == replay->runCount) {
+        return -1;
+    }
+    *out = replay->frames[replay->run].input;
+    uint64_t now = platformTimeUs();
+    if (frame > 0) {
+        uint64_t us = now - replay->lastUs;
+        replay->frameUs[frame - 1] = us > UINT32_MAX ? UINT32_MAX : us;
+    }
+    replay->lastUs = now;
+    __atomic_store_n(&replay->frame, frame + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int sessionReplayText(SessionReplay* replay, char* out, size_t size) {
+    if (replay->nextText == replay->textCount) {
+        return -1;
+    }
+    const SessionText* text = &replay->texts[replay->nextText++];
+    size_t length = text->length < size - 1 ? text->length : size - 1;
+    memcpy(out, text->text, length);
+    out[length] = '\0';
+    return 0;
+}
+
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t at;
+} ReplayConn;
+
+static int replayRecv(void* ctx, unsigned char* buf, size_t len) {
+    ReplayConn* conn = ctx;
+    size_t left = conn->length - conn->at;
+    if (len > left) {
+        len = left;
+    }
+    if (len > RESPONSE_RECORD_SIZE) {
+        len = RESPONSE_RECORD_SIZE;
+    }
+    memcpy(buf, conn->data + conn->at, len);
+    conn->at += len;
+    return len;
+}
+
+static int openReplay(void* ctx, FetchJob* job, const char* request, Transport* transport, void** out) {
+    SessionReplay* replay = ctx;
+    size_t urlLength = strlen(job->url);
+    SessionResponse* response = NULL;
+    platformMutexLock(replay->lock);
+    for (int i = 0; i < replay->responseCount && response == NULL; i++) {
+        SessionResponse* candidate = &replay->responses[i];
+        if (!candidate->used && candidate->urlLength == urlLength && memcmp(candidate->url, job->url, urlLength) == 0) {
+            response = candidate;
+            response->used = 1;
+        }
+    }
+    if (response != NULL) {
+        replay->served++;
+    } else {
+        replay->missing++;
+    }
+    platformMutexUnlock(replay->lock);
+    if (response == NULL) {
+        return FETCH_CONNECT_FAILED;
+    }
+
+    //Asked for early, the UI hasn't caught up with where it was asked for
+    while (__atomic_load_n(&replay->frame, __ATOMIC_ACQUIRE) < response->frame) {
+        if (job->cancelled) {
+            return FETCH_CANCELLED;
+        }
+        platformSleepMs(SESSION_WAIT_MS);
+    }
+    if (response->error != FETCH_OK) {
+        job->detail = response->detail;
+        return response->error;
+    }
+    ReplayConn* conn = memCalloc(MEM_NETWORK, 1, sizeof *conn);
+    if (conn == NULL) {
+        return FETCH_SETUP_FAILED;
+    }
+    conn->data = response->data;
+    conn->length = response->length;
+    *out = conn;
+    transport->ctx = conn;
+    transport->recv = replayRecv;
+    return FETCH_OK;
+}
+
+static void closeReplay(void* ctx, void* conn) {
+    memFree(conn);
+}
+
+void networkInitReplay(FetchNetwork* network, SessionReplay* replay) {
+    network->ctx = replay;
+    network->open = openReplay;
+    network->close = closeReplay;
+}
+
+static int compareTimes(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+void sessionReplayReport(SessionReplay* replay, FILE* out) {
+    //The last frame played has no end yet
+    uint32_t timed = replay->frame > 0 ? replay->frame - 1 : 0;
+    fprintf(out, "%u of %u frames, %lu responses served, %lu not in the recording\n",
+        (unsigned int)replay->frame, (unsigned int)replay->frameCount, replay->served, replay->missing);
+    if (timed == 0) {
+        return;
+    }
+    qsort(replay->frameUs, timed, sizeof *replay->frameUs, compareTimes);
+    uint64_t total = 0;
+    uint32_t slow = 0;
+    for (uint32_t i = 0; i < timed; i++) {
+        total += replay->frameUs[i];
+        slow += replay->frameUs[i] > 17000;
+    }
+    fprintf(out, "frame ms: mean %.2f, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f, %u over 17 ms\n",
+        total / 1000.0 / timed, replay->frameUs[timed / 2] / 1000.0, replay->frameUs[timed * 95 / 100] / 1000.0,
+        replay->frameUs[timed * 99 / 100] / 1000.0, replay->frameUs[timed - 1] / 1000.0, (unsigned int)slow);
+}
+
+void sessionReplayFree(SessionReplay* replay) {
+    memFree(replay->file);
+    memFree(replay->frameUs);
+    memFree(replay->frames);
+    memFree(replay->texts);
+    memFree(replay->responses);
+    if (replay->lock != NULL) {
+        platformMutexFree(replay->lock);
+    }
+    memset(replay, 0, sizeof *replay);
+}
@@ -0,0 +1,102 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fetch.h"
+#include "platform.h"
+
+//The buttons and touch of one frame, as hid reports them
+typedef struct {
+    uint32_t kDown;
+    uint32_t kHeld;
+    uint16_t touchX;
+    uint16_t touchY;
+} SessionInput;
+
+//Writes a run of the app down: the input of every frame, what was typed on
+//the keyboard and every response the page fetcher got along with the frame
+//it was asked for on. A run of identical frames is stored once with a count,
+//so a minute of reading costs a few bytes. The UI and the fetch worker both
+//write to it.
+typedef struct {
+    FILE* file;
+    PlatformMutex* lock;
+    FetchNetwork inner;     //Where requests really go
+    unsigned int frame;     //Frames recorded so far
+    SessionInput last;      //Written once the input changes, with how often it repeated
+    uint32_t repeats;
+    unsigned long responses;
+    int failed;             //A write went wrong, the file is incomplete
+} SessionRecorder;
+
+int sessionRecordStart(SessionRecorder* rec, const char* path, const FetchNetwork* inner);
+void sessionRecordFrame(SessionRecorder* rec, const SessionInput* input);
+void sessionRecordText(SessionRecorder* rec, const char* text);
+//Returns -1 if anything couldn't be written
+int sessionRecordStop(SessionRecorder* rec);
+//Passes requests on to rec->inner and writes down what came back
+void networkInitRecording(FetchNetwork* network, SessionRecorder* rec);
+
+//Everything below points into the file, which is read in whole
+typedef struct {
+    uint32_t first;     //Frame the run starts on
+    uint32_t count;
+    SessionInput input;
+} SessionFrames;
+
+typedef struct {
+    uint32_t frame;     //Asked for on this frame
+    int error;          //FetchError of the request, the detail goes with it
+    int detail;
+    const char* url;
+    size_t urlLength;
+    const char* data;   //Header and body as the server sent them
+    size_t length;
+    int used;
+} SessionResponse;
+
+typedef struct {
+    const char* text;
+    size_t length;
+} SessionText;
+
+//A recorded session played back. The app takes its input from here instead
+//of hid and fetches pages through networkInitReplay, so the same run can be
+//timed again and again without the network getting in the way.
+typedef struct {
+    char* file;
+    SessionFrames* frames;
+    int runCount;
+    int run;            //Being played
+    uint32_t frameCount;
+    SessionText* texts;
+    int textCount;
+    int nextText;
+    SessionResponse* responses;
+    int responseCount;
+    unsigned int frame; //Frames played so far, the worker waits on it
+    uint32_t* frameUs;  //From the start of each frame to the next
+    uint64_t lastUs;
+    PlatformMutex* lock;
+    unsigned long served;
+    unsigned long missing;  //Asked for but not in the recording
+} SessionReplay;
+
+int sessionReplayOpen(SessionReplay* replay, const char* path);
+//The input of the next frame, -1 once the recording is over. Called once at
+//the start of every frame, which is also how the frames get timed.
+int sessionReplayFrame(SessionReplay* replay, SessionInput* out);
+//The next thing typed on the keyboard, -1 if the recording has no more
+int sessionReplayText(SessionReplay* replay, char* out, size_t size);
+//Serves recorded responses to the urls they were for, in the order they were
+//asked for and never before the frame they were asked for on. Anything not
+//in the recording fails to connect.
+void networkInitReplay(FetchNetwork* network, SessionReplay* replay);
+//Frame times and how the responses went, for the end of a replay
+void sessionReplayReport(SessionReplay* replay, FILE* out);
+void sessionReplayFree(SessionReplay* replay);
+
+#endif
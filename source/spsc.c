@@ -0,0 +1,44 @@
+#include <stdlib.h>
+
+#include "memstats.h"
+#include "spsc.h"
+
+int spscInit(SpscQueue* queue, unsigned int capacity) {
+    unsigned int size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+    queue->slots = memCalloc(MEM_OTHER, size, sizeof(void*));
+    queue->capacity = size;
+    queue->head = 0;
+    queue->tail = 0;
+    return queue->slots != NULL ? 0 : -1;
+}
+
+int spscPush(SpscQueue* queue, void* item) {
+    unsigned int tail = queue->tail;
+    unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (tail - head == queue->capacity) {
+        return -1;
+    }
+    queue->slots[tail & (queue->capacity - 1)] = item;
+    //Publish the slot before the consumer can see the new tail
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void* spscPop(SpscQueue* queue) {
+    unsigned int head = queue->head;
+    unsigned int tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return NULL;
+    }
+    void* item = queue->slots[head & (queue->capacity - 1)];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+void spscFree(SpscQueue* queue) {
+    memFree(queue->slots);
+    queue->slots = NULL;
+}
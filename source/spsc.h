@@ -0,0 +1,19 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+//Lock-free ring of pointers between exactly one producer thread and one consumer thread
+typedef struct {
+    void** slots;
+    unsigned int capacity;  //Power of two
+    unsigned int head;      //Next slot to pop, only written by the consumer
+    unsigned int tail;      //Next slot to push, only written by the producer
+} SpscQueue;
+
+int spscInit(SpscQueue* queue, unsigned int capacity);
+//Returns -1 when the queue is full
+int spscPush(SpscQueue* queue, void* item);
+//Returns NULL when the queue is empty
+void* spscPop(SpscQueue* queue);
+void spscFree(SpscQueue* queue);
+
+#endif
@@ -0,0 +1,49 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "textcache.h"
+
+void textCacheInit(TextCache* cache, Renderer* renderer) {
+    memset(cache, 0, sizeof *cache);
+    cache->renderer = renderer;
+}
+
+void textCacheReset(TextCache* cache, unsigned int generation, int texts, size_t bytes) {
+    if (texts > cache->capacity) {
+        int* grown = memRealloc(MEM_UI, cache->handles, texts * sizeof(int));
+        if (grown != NULL) {
+            cache->handles = grown;
+            cache->capacity = texts;
+        }
+    }
+    cache->count = 0;
+    cache->generation = generation;
+    cache->builds++;
+    //UTF-8 never has more glyphs than bytes so this is always enough
+    cache->renderer->textReset(cache->renderer->ctx, texts, bytes);
+}
+
+int textCacheAdd(TextCache* cache, const char* text, size_t len) {
+    if (cache->count >= cache->capacity) {
+        return -1;
+    }
+    cache->handles[cache->count] = cache->renderer->textPrepare(cache->renderer->ctx, text, len);
+    return cache->count++;
+}
+
+void textCacheDraw(TextCache* cache, int slot, float x, float y, float z, float scale, uint32_t color, float wrapWidth) {
+    if (slot < 0 || slot >= cache->count || cache->handles[slot] < 0) {
+        cache->misses++;
+        return;
+    }
+    cache->hits++;
+    cache->renderer->drawText(cache->renderer->ctx, cache->handles[slot], x, y, z, scale, color, wrapWidth);
+}
+
+void textCacheFree(TextCache* cache) {
+    memFree(cache->handles);
+    cache->handles = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "render.h"
+
+//Prepared text for everything on screen, rebuilt only when its generation changes
+//(new page, new font, new scale, relabelled buttons). Drawing a frame is then
+//just draw calls against the renderer's pool.
+typedef struct {
+    Renderer* renderer;
+    unsigned int generation;
+    int* handles;
+    int count;
+    int capacity;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long builds;
+} TextCache;
+
+void textCacheInit(TextCache* cache, Renderer* renderer);
+//Drop everything and make room for `texts` strings totalling `bytes` bytes
+void textCacheReset(TextCache* cache, unsigned int generation, int texts, size_t bytes);
+//Prepare a string, returns its slot in the cache
+int textCacheAdd(TextCache* cache, const char* text, size_t len);
+void textCacheDraw(TextCache* cache, int slot, float x, float y, float z, float scale, uint32_t color, float wrapWidth);
+void textCacheFree(TextCache* cache);
+
+#endif
@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "tilecache.h"
+
+void tileCacheInit(TileCache* cache, Renderer* renderer, int width, int tileHeight, uint32_t background) {
+    memset(cache, 0, sizeof *cache);
+    cache->renderer = renderer;
+    cache->width = width;
+    cache->tileHeight = tileHeight;
+    cache->background = background;
+    for (int i = 0; i < TILE_CACHE_SIZE; i++) {
+        cache->tiles[i].surface = -1;
+        cache->tiles[i].index = -1;
+    }
+}
+
+void tileCacheInvalidate(TileCache* cache) {
+    for (int i = 0; i < TILE_CACHE_SIZE; i++) {
+        cache->tiles[i].index = -1;
+    }
+}
+
+static Tile* findTile(TileCache* cache, int index) {
+    for (int i = 0; i < TILE_CACHE_SIZE; i++) {
+        if (cache->tiles[i].index == index) {
+            return &cache->tiles[i];
+        }
+    }
+    return NULL;
+}
+
+//An unused tile if there is one, otherwise the least recently drawn that isn't on screen now
+static Tile* evictTile(TileCache* cache, int first, int last) {
+    Tile* victim = NULL;
+    for (int i = 0; i < TILE_CACHE_SIZE; i++) {
+        Tile* tile = &cache->tiles[i];
+        if (tile->index >= first && tile->index <= last) {
+            continue;
+        }
+        if (victim == NULL || tile->index < 0 || (victim->index >= 0 && tile->lastUsed < victim->lastUsed)) {
+            victim = tile;
+        }
+    }
+    return victim;
+}
+
+int tileCacheDraw(TileCache* cache, unsigned int generation, int pageY, int height, TilePaint paint, void* user) {
+    Renderer* renderer = cache->renderer;
+    if (generation != cache->generation) {
+        tileCacheInvalidate(cache);
+        cache->generation = generation;
+    }
+    //Bands above the page start are never visible, clamping keeps the division simple
+    int first = (pageY < 0 ? 0 : pageY) / cache->tileHeight;
+    int last = (pageY + height - 1) / cache->tileHeight;
+    if (last < first) {
+        return 0;
+    }
+    if (last - first >= TILE_CACHE_SIZE) {
+        return -1;
+    }
+    cache->clock++;
+
+    //Everything missing is painted first, switching targets mid-scene is the expensive part
+    for (int index = first; index <= last; index++) {
+        Tile* tile = findTile(cache, index);
+        if (tile != NULL) {
+            cache->hits++;
+            tile->lastUsed = cache->clock;
+            continue;
+        }
+        cache->misses++;
+        tile = evictTile(cache, first, last);
+        if (tile->surface < 0) {
+            tile->surface = renderer->surfaceNew(renderer->ctx, cache->width, cache->tileHeight);
+            if (tile->surface < 0) {
+                return -1;
+            }
+        }
+        int top = index * cache->tileHeight;
+        renderer->surfaceBegin(renderer->ctx, tile->surface, cache->background);
+        paint(user, top, top + cache->tileHeight);
+        renderer->surfaceEnd(renderer->ctx);
+        tile->index = index;
+        tile->lastUsed = cache->clock;
+    }
+
+    for (int index = first; index <= last; index++) {
+        Tile* tile = findTile(cache, index);
+        renderer->drawSurface(renderer->ctx, tile->surface, 0, index * cache->tileHeight - pageY, 0);
+    }
+    return 0;
+}
+
+void tileCacheFree(TileCache* cache) {
+    for (int i = 0; i < TILE_CACHE_SIZE; i++) {
+        if (cache->tiles[i].surface >= 0) {
+            cache->renderer->surfaceFree(cache->renderer->ctx, cache->tiles[i].surface);
+        }
+        cache->tiles[i].surface = -1;
+        cache->tiles[i].index = -1;
+    }
+}
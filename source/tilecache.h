@@ -0,0 +1,41 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "render.h"
+
+//Enough to cover the top screen at any scroll with a tile to spare either side
+#define TILE_CACHE_SIZE 6
+
+typedef struct {
+    int surface;    //-1 until the tile is first used
+    int index;      //Which band of the page it holds, -1 for none
+    unsigned int lastUsed;
+} Tile;
+
+//Draws the page into fixed height bands once and then only blits them, so a
+//frame that just scrolls doesn't draw any text. Anything that changes what
+//the page looks like has to come with a new generation.
+typedef struct {
+    Renderer* renderer;
+    int width;
+    int tileHeight;
+    uint32_t background;
+    unsigned int generation;
+    Tile tiles[TILE_CACHE_SIZE];
+    unsigned int clock;
+    unsigned long hits;
+    unsigned long misses;
+} TileCache;
+
+//Draws the page rows in [top, bottom) with top at y = 0
+typedef void (*TilePaint)(void* user, int top, int bottom);
+
+void tileCacheInit(TileCache* cache, Renderer* renderer, int width, int tileHeight, uint32_t background);
+//Draws the part of the page from pageY down, height pixels of it, at the top of
+//the current target. Returns -1 if there weren't surfaces for every tile, the
+//caller should draw the page directly then.
+int tileCacheDraw(TileCache* cache, unsigned int generation, int pageY, int height, TilePaint paint, void* user);
+void tileCacheInvalidate(TileCache* cache);
+void tileCacheFree(TileCache* cache);
+
+#endif
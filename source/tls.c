@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <mbedtls/debug.h>
+#include <mbedtls/sha256.h>
+
+#include "tls.h"
+
+static void my_debug( void *ctx, int level, const char *file, int line, const char *str )
+{
+    printf( "%s", str );
+}
+
+static void sessionKey(char key[TLS_SESSION_KEY_SIZE], const char* hostname, const char* port) {
+    snprintf(key, TLS_SESSION_KEY_SIZE, "%s:%s", hostname, port);
+}
+
+static TlsSessionEntry* findSession(TlsClient* client, const char* key) {
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+        TlsSessionEntry* entry = &client->sessions[i];
+        if (entry->valid && strcmp(entry->key, key) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void dropSession(TlsSessionEntry* entry) {
+    mbedtls_ssl_session_free( &entry->session );
+    mbedtls_ssl_session_init( &entry->session );
+    entry->valid = 0;
+}
+
+//Reuse the entry for this server if there is one, otherwise the least recently used
+static void saveSession(TlsClient* client, const char* key, mbedtls_ssl_context* ssl) {
+    TlsSessionEntry* entry = findSession(client, key);
+    if (entry == NULL) {
+        entry = &client->sessions[0];
+        for (int i = 1; i < TLS_SESSION_CACHE_SIZE && entry->valid; i++) {
+            if (!client->sessions[i].valid || client->sessions[i].lastUsed < entry->lastUsed) {
+                entry = &client->sessions[i];
+            }
+        }
+    }
+
+    dropSession(entry);
+    if (mbedtls_ssl_get_session( ssl, &entry->session ) != 0) {
+        dropSession(entry);
+        return;
+    }
+    strcpy(entry->key, key);
+    entry->lastUsed = ++client->sessionClock;
+    entry->valid = 1;
+}
+
+//Runs for every certificate of the chain, the server's own comes last at depth 0.
+//Capsules mostly sign their own certificates so the chain isn't judged, what
+//counts is that the server shows the certificate it showed the first time.
+static int verifyCertificate(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+    TlsConnection* conn = ctx;
+    *flags = 0;
+    if (depth != 0) {
+        return 0;
+    }
+    uint8_t fingerprint[KNOWN_HOST_FINGERPRINT_SIZE];
+    if (mbedtls_sha256_ret( crt->raw.p, crt->raw.len, fingerprint, 0 ) != 0) {
+        return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+    }
+    conn->trust = knownHostsCheck(conn->knownHosts, conn->host, conn->port, fingerprint, conn->replaceCert);
+    //Failing here ends the handshake before anything is sent to the impostor
+    return conn->trust == KNOWN_HOST_CHANGED ? MBEDTLS_ERR_X509_CERT_VERIFY_FAILED : 0;
+}
+
+static int cancelled(TlsConnection* conn) {
+    return conn->cancel != NULL && *conn->cancel;
+}
+
+int tlsClientInit(TlsClient* client, KnownHosts* knownHosts) {
+    int ret;
+
+    memset(client->sessions, 0, sizeof client->sessions);
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+        mbedtls_ssl_session_init( &client->sessions[i].session );
+    }
+    client->sessionClock = 0;
+    client->sessionHits = 0;
+    client->sessionMisses = 0;
+    client->knownHosts = knownHosts;
+
+    mbedtls_debug_set_threshold( 1 );
+
+    mbedtls_x509_crt_init( &client->cacert );
+    mbedtls_ssl_config_init( &client->conf );
+    mbedtls_ctr_drbg_init( &client->ctr_drbg );
+    mbedtls_entropy_init( &client->entropy );
+
+    if( ( ret = mbedtls_ctr_drbg_seed( &client->ctr_drbg, mbedtls_entropy_func, &client->entropy, NULL, 0 ) ) != 0 ) {
+        return ret;
+    }
+
+    if( ( ret = mbedtls_ssl_config_defaults( &client->conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT ) ) != 0 ) {
+        return ret;
+    }
+
+    mbedtls_ssl_conf_ca_chain( &client->conf, &client->cacert, NULL );
+    //Optional so the empty CA chain doesn't fail every handshake, the verify callback does the real check
+    mbedtls_ssl_conf_authmode( &client->conf, knownHosts != NULL ? MBEDTLS_SSL_VERIFY_OPTIONAL : MBEDTLS_SSL_VERIFY_NONE );
+    mbedtls_ssl_conf_rng( &client->conf, mbedtls_ctr_drbg_random, &client->ctr_drbg );
+    mbedtls_ssl_conf_dbg( &client->conf, my_debug, stdout );
+    mbedtls_ssl_conf_handshake_timeout( &client->conf, 1000, 7000 );
+    mbedtls_ssl_conf_read_timeout( &client->conf, TLS_POLL_MS );
+    return 0;
+}
+
+void tlsClientFree(TlsClient* client) {
+    for (int i = 0; i < TLS_SESSION_CACHE_SIZE; i++) {
+        dropSession(&client->sessions[i]);
+    }
+    mbedtls_x509_crt_free( &client->cacert );
+    mbedtls_ssl_config_free( &client->conf );
+    mbedtls_ctr_drbg_free( &client->ctr_drbg );
+    mbedtls_entropy_free( &client->entropy );
+}
+
+void tlsInit(TlsConnection* conn, const volatile int* cancel) {
+    mbedtls_net_init( &conn->server_fd );
+    mbedtls_ssl_init( &conn->ssl );
+    conn->offered = 0;
+    conn->resumed = 0;
+    conn->cancel = cancel;
+    conn->knownHosts = NULL;
+    conn->replaceCert = 0;
+    conn->trust = -1;
+}
+
+void tlsAttach(TlsConnection* conn, int fd) {
+    conn->server_fd.fd = fd;
+}
+
+int tlsHandshake(TlsClient* client, TlsConnection* conn, const char* hostname, const char* port, int* detail) {
+    int ret;
+    char key[TLS_SESSION_KEY_SIZE];
+
+    if( ( ret = mbedtls_ssl_setup( &conn->ssl, &client->conf ) ) != 0 ||
+        ( ret = mbedtls_ssl_set_hostname( &conn->ssl, hostname ) ) != 0 ) {
+        *detail = ret;
+        return TLS_SETUP_FAILED;
+    }
+    if (client->knownHosts != NULL) {
+        conn->knownHosts = client->knownHosts;
+        conn->host = hostname;
+        conn->port = port;
+        mbedtls_ssl_set_verify( &conn->ssl, verifyCertificate, conn );
+    }
+
+    //Most navigation stays on one capsule, offering the last session lets the server skip the full handshake
+    sessionKey(key, hostname, port);
+    TlsSessionEntry* cached = findSession(client, key);
+    if (cached != NULL && mbedtls_ssl_set_session( &conn->ssl, &cached->session ) == 0) {
+        cached->lastUsed = ++client->sessionClock;
+        conn->offered = 1;
+    }
+
+    if (cancelled(conn)) {
+        return TLS_CANCELLED;
+    }
+
+    mbedtls_ssl_set_bio( &conn->ssl, &conn->server_fd, mbedtls_net_send, mbedtls_net_recv, mbedtls_net_recv_timeout );
+    int waited = 0;
+    while ( ( ret = mbedtls_ssl_handshake( &conn->ssl ) ) != 0 ) {
+        if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+            if (cancelled(conn)) {
+                return TLS_CANCELLED;
+            }
+            waited += TLS_POLL_MS;
+            if (waited < TLS_HANDSHAKE_TIMEOUT_MS) {
+                continue;
+            }
+        }
+        if( ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE ) {
+            //Don't keep offering a session that ended in a failed handshake
+            if (cached != NULL) {
+                dropSession(cached);
+            }
+            *detail = ret;
+            return conn->trust == KNOWN_HOST_CHANGED ? TLS_CERT_CHANGED : TLS_HANDSHAKE_FAILED;
+        }
+    }
+
+    //Offering a session doesn't mean the server took it, only then does it
+    //answer with the same session id (a ticket is sent with a fresh one the
+    //server echoes back if it accepts the ticket)
+    const mbedtls_ssl_session* session = conn->ssl.session;
+    conn->resumed = conn->offered && session != NULL && session->id_len > 0 &&
+                    session->id_len == cached->session.id_len &&
+                    memcmp(session->id, cached->session.id, session->id_len) == 0;
+    if (conn->resumed) {
+        client->sessionHits++;
+    } else {
+        client->sessionMisses++;
+    }
+    saveSession(client, key, &conn->ssl);
+    return TLS_OK;
+}
+
+int tlsWrite(TlsConnection* conn, const char* data, size_t len) {
+    while (len > 0) {
+        int ret = mbedtls_ssl_write( &conn->ssl, (const unsigned char*)data, len );
+        if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+            continue;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int tlsRecv(void* ctx, unsigned char* buf, size_t len) {
+    TlsConnection* conn = ctx;
+    int ret;
+    int waited = 0;
+    do {
+        ret = mbedtls_ssl_read( &conn->ssl, buf, len );
+        if (ret == MBEDTLS_ERR_SSL_TIMEOUT) {
+            if (cancelled(conn)) {
+                return TLS_CANCELLED;
+            }
+            waited += TLS_POLL_MS;
+            if (waited >= TLS_READ_TIMEOUT_MS) {
+                return TLS_TIMED_OUT;
+            }
+        }
+    } while (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE || ret == MBEDTLS_ERR_SSL_TIMEOUT);
+    if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return 0;
+    }
+    return ret;
+}
+
+Transport tlsTransport(TlsConnection* conn) {
+    Transport transport = { conn, tlsRecv };
+    return transport;
+}
+
+void tlsClose(TlsConnection* conn) {
+    mbedtls_ssl_close_notify( &conn->ssl );
+    mbedtls_ssl_free( &conn->ssl );
+    mbedtls_net_free( &conn->server_fd );
+}
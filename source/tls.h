@@ -0,0 +1,80 @@
+#ifndef TLS_H
+#define TLS_H
+
+#include <mbedtls/net.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+
+#include "knownhosts.h"
+#include "response.h"
+
+enum TlsResult {
+    TLS_OK = 0,
+    TLS_SETUP_FAILED = -2,
+    TLS_HANDSHAKE_FAILED = -3,
+    TLS_CANCELLED = -4,
+    TLS_TIMED_OUT = -5,
+    TLS_CERT_CHANGED = -6,  //The server's certificate isn't the one it showed before
+};
+
+//Reads wake up this often to check whether the request was cancelled
+#define TLS_POLL_MS 250
+#define TLS_HANDSHAKE_TIMEOUT_MS 7000
+#define TLS_READ_TIMEOUT_MS 30000
+
+#define TLS_SESSION_CACHE_SIZE 8
+#define TLS_SESSION_KEY_SIZE 264
+
+//A session saved after a full handshake, offered again on the next connect to the same server
+typedef struct {
+    char key[TLS_SESSION_KEY_SIZE];     //host:port
+    mbedtls_ssl_session session;
+    unsigned int lastUsed;
+    int valid;
+} TlsSessionEntry;
+
+//Everything that can be shared between requests. Seeding the DRBG and
+//building the config is slow on the 3DS so it is done once at startup.
+typedef struct {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    mbedtls_ssl_config conf;
+    mbedtls_x509_crt cacert;
+    KnownHosts* knownHosts; //NULL to take any certificate
+    TlsSessionEntry sessions[TLS_SESSION_CACHE_SIZE];
+    unsigned int sessionClock;
+    unsigned long sessionHits;      //Handshakes the server resumed a session for
+    unsigned long sessionMisses;    //and ones it didn't, offered one or not
+} TlsClient;
+
+//One request's worth of state
+typedef struct {
+    mbedtls_net_context server_fd;
+    mbedtls_ssl_context ssl;
+    int offered;    //A cached session was offered for this connection
+    int resumed;    //and the server took it up
+    const volatile int* cancel;
+    //Certificate check, done in the handshake against the known hosts
+    KnownHosts* knownHosts;
+    const char* host;
+    const char* port;
+    int replaceCert;    //Set before the handshake to trust a changed certificate
+    int trust;          //KnownHostResult, -1 if no certificate was checked
+} TlsConnection;
+
+//knownHosts may be shared between clients on different threads
+int tlsClientInit(TlsClient* client, KnownHosts* knownHosts);
+void tlsClientFree(TlsClient* client);
+
+//Readies a connection, tlsClose is safe from here on. Setting *cancel from
+//another thread makes the connection give up at the next poll.
+void tlsInit(TlsConnection* conn, const volatile int* cancel);
+//Hands over a connected socket (see connectRace), the connection closes it
+void tlsAttach(TlsConnection* conn, int fd);
+int tlsHandshake(TlsClient* client, TlsConnection* conn, const char* hostname, const char* port, int* detail);
+int tlsWrite(TlsConnection* conn, const char* data, size_t len);
+Transport tlsTransport(TlsConnection* conn);
+void tlsClose(TlsConnection* conn);
+
+#endif
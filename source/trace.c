@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define TRACE_MASK (TRACE_RING_SIZE - 1)
+
+typedef struct {
+    unsigned int sequence;  //Index in the ring + 1 once written, 0 while it is being written
+    uint8_t name;
+    uint8_t thread;
+    uint8_t counter;
+    uint32_t value;         //Duration of a span, the value of a counter
+    uint64_t startUs;
+} TraceEvent;
+
+static const char* names[TRACE_NAMES] = {
+    [TRACE_FRAME] = "frame",
+    [TRACE_INPUT] = "input",
+    [TRACE_DRAW] = "draw",
+    [TRACE_PRESENT] = "present",
+    [TRACE_TEXT] = "text",
+    [TRACE_PARSE] = "parse",
+    [TRACE_LAYOUT] = "layout",
+    [TRACE_RESOLVE] = "resolve",
+    [TRACE_CONNECT] = "connect",
+    [TRACE_HANDSHAKE] = "handshake",
+    [TRACE_FIRST_BYTE] = "first byte",
+    [TRACE_READ] = "read",
+    [TRACE_BYTES] = "bytes",
+};
+
+int traceEnabled = 0;
+static TraceEvent ring[TRACE_RING_SIZE];
+static unsigned int head;       //Next index to write
+static unsigned int cleared;    //Events before this were cleared
+static unsigned int threads;
+static __thread int threadId;   //Small number for the thread, given out on its first event
+
+//Writers claim a slot with one atomic add, readers skip slots that are mid write
+static void record(int name, int counter, uint64_t startUs, uint32_t value) {
+    if (threadId == 0) {
+        threadId = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+    }
+    unsigned int index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    TraceEvent* event = &ring[index & TRACE_MASK];
+    __atomic_store_n(&event->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event->name = name;
+    event->thread = threadId;
+    event->counter = counter;
+    event->value = value;
+    event->startUs = startUs;
+    __atomic_store_n(&event->sequence, index + 1, __ATOMIC_RELEASE);
+}
+
+void traceSpan(int name, uint64_t startUs, uint64_t endUs) {
+    if (traceEnabled) {
+        uint64_t duration = endUs - startUs;
+        record(name, 0, startUs, duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration);
+    }
+}
+
+void traceCount(int name, uint32_t value) {
+    if (traceEnabled) {
+        record(name, 1, platformTimeUs(), value);
+    }
+}
+
+//Copies an event out, -1 if it was overwritten or is being written
+static int readEvent(unsigned int index, TraceEvent* out) {
+    const TraceEvent* event = &ring[index & TRACE_MASK];
+    if (__atomic_load_n(&event->sequence, __ATOMIC_ACQUIRE) != index + 1) {
+        return -1;
+    }
+    *out = *event;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&event->sequence, __ATOMIC_RELAXED) == index + 1 ? 0 : -1;
+}
+
+//First index still worth reading, and sets *end past the last
+static unsigned int readable(unsigned int* end) {
+    *end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+    unsigned int start = __atomic_load_n(&cleared, __ATOMIC_RELAXED);
+    if (*end - start > TRACE_RING_SIZE) {
+        start = *end - TRACE_RING_SIZE;
+    }
+    return start;
+}
+
+const char* traceNameOf(int name) {
+    return name >= 0 && name < TRACE_NAMES ? names[name] : "?";
+}
+
+void traceSetEnabled(int enabled) {
+    if (enabled && !traceEnabled) {
+        traceClear();
+    }
+    traceEnabled = enabled;
+}
+
+void traceClear(void) {
+    __atomic_store_n(&cleared, __atomic_load_n(&head, __ATOMIC_ACQUIRE), __ATOMIC_RELAXED);
+}
+
+static int compareValues(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+//Only ever summarized from the UI thread, so the scratch space can be static
+static uint32_t values[TRACE_RING_SIZE];
+
+void traceSummarize(int name, TraceSummary* out) {
+    memset(out, 0, sizeof *out);
+    unsigned int end;
+    TraceEvent event;
+    for (unsigned int i = readable(&end); i != end; i++) {
+        if (readEvent(i, &event) == 0 && event.name == name) {
+            values[out->count++] = event.value;
+        }
+    }
+    if (out->count == 0) {
+        return;
+    }
+    qsort(values, out->count, sizeof *values, compareValues);
+    out->p50 = values[out->count / 2];
+    out->p95 = values[out->count * 95 / 100];
+    out->max = values[out->count - 1];
+}
+
+int traceExport(FILE* out) {
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+    unsigned int end;
+    TraceEvent event;
+    int first = 1;
+    for (unsigned int i = readable(&end); i != end; i++) {
+        if (readEvent(i, &event) != 0) {
+            continue;
+        }
+        const char* name = traceNameOf(event.name);
+        if (event.counter) {
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%llu,\"pid\":1,\"tid\":%d,\"args\":{\"%s\":%u}}",
+                first ? "" : ",\n", name, (unsigned long long)event.startUs, event.thread, name, (unsigned int)event.value);
+        } else {
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":%d}",
+                first ? "" : ",\n", name, (unsigned long long)event.startUs, (unsigned int)event.value, event.thread);
+        }
+        first = 0;
+    }
+    fputs("\n]}\n", out);
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "platform.h"
+
+//Events kept, the oldest are overwritten. A power of two.
+#define TRACE_RING_SIZE 4096
+
+enum TraceName {
+    //Frame phases, on the UI thread
+    TRACE_FRAME,
+    TRACE_INPUT,        //Input and everything the frame does before drawing
+    TRACE_DRAW,
+    TRACE_PRESENT,
+    TRACE_TEXT,         //Rebuilding the text cache
+    //Wherever pages are made
+    TRACE_PARSE,        //One chunk of gemtext
+    TRACE_LAYOUT,
+    //Fetch phases, on the workers
+    TRACE_RESOLVE,
+    TRACE_CONNECT,
+    TRACE_HANDSHAKE,
+    TRACE_FIRST_BYTE,   //Request sent to the first byte of the response
+    TRACE_READ,         //First byte to the last
+    TRACE_BYTES,        //Counter, bytes of the response so far
+    TRACE_NAMES,
+};
+
+//Spans and counters go into one ring that any thread can write to without a
+//lock. While tracing is off a span costs a load and a branch.
+extern int traceEnabled;
+
+void traceSpan(int name, uint64_t startUs, uint64_t endUs);
+void traceCount(int name, uint32_t value);
+
+//Timing a piece of code is traceEnd(name, traceStart()) around it
+static inline uint64_t traceStart(void) {
+    return traceEnabled ? platformTimeUs() : 0;
+}
+
+static inline void traceEnd(int name, uint64_t startUs) {
+    if (startUs != 0) {
+        traceSpan(name, startUs, platformTimeUs());
+    }
+}
+
+typedef struct {
+    unsigned int count;
+    uint32_t p50;       //Microseconds for spans, the value for counters
+    uint32_t p95;
+    uint32_t max;
+} TraceSummary;
+
+const char* traceNameOf(int name);
+void traceSetEnabled(int enabled);
+void traceClear(void);
+//Percentiles over the events of one name still in the ring
+void traceSummarize(int name, TraceSummary* out);
+//Everything in the ring as Chrome trace events (chrome://tracing, Perfetto)
+int traceExport(FILE* out);
+
+#endif
@@ -0,0 +1,371 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "url.h"
+
+//Output that stops writing, but keeps counting, once it runs out of room
+typedef struct {
+    char* out;
+    size_t size;
+    size_t length;
+} Writer;
+
+static void put(Writer* writer, char c) {
+    if (writer->length + 1 < writer->size) {
+        writer->out[writer->length] = c;
+    }
+    writer->length++;
+}
+
+static void putSpan(Writer* writer, const char* str, int len) {
+    for (int i = 0; i < len; i++) {
+        put(writer, str[i]);
+    }
+}
+
+static void putLower(Writer* writer, const char* str, int len) {
+    for (int i = 0; i < len; i++) {
+        put(writer, tolower((unsigned char)str[i]));
+    }
+}
+
+static int finish(Writer* writer) {
+    if (writer->size == 0) {
+        return -1;
+    }
+    if (writer->length >= writer->size) {
+        writer->out[writer->size - 1] = '\0';
+        return -1;
+    }
+    writer->out[writer->length] = '\0';
+    return writer->length;
+}
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = tolower((unsigned char)c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static int isUnreserved(unsigned char c) {
+    return isalnum(c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+//Everything that can appear unescaped in a path or query
+static int isAllowed(unsigned char c) {
+    return isUnreserved(c) || (c != '\0' && strchr("!$&'()*+,;=:@/?%", c) != NULL);
+}
+
+//Escapes what has to be, unescapes what never needed to be and uppercases the rest
+static void putEncoded(Writer* writer, const char* str, int len) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (int i = 0; i < len; i++) {
+        unsigned char c = str[i];
+        if (c == '%' && i + 2 < len && hexValue(str[i + 1]) >= 0 && hexValue(str[i + 2]) >= 0) {
+            unsigned char decoded = hexValue(str[i + 1]) * 16 + hexValue(str[i + 2]);
+            if (isUnreserved(decoded)) {
+                put(writer, decoded);
+            } else {
+                put(writer, '%');
+                put(writer, hex[decoded >> 4]);
+                put(writer, hex[decoded & 15]);
+            }
+            i += 2;
+        } else if (isAllowed(c) && c != '%') {
+            put(writer, c);
+        } else {
+            put(writer, '%');
+            put(writer, hex[c >> 4]);
+            put(writer, hex[c & 15]);
+        }
+    }
+}
+
+//Drops the last segment written, along with the slash before it
+static void popSegment(Writer* writer) {
+    size_t length = writer->length < writer->size ? writer->length : writer->size - 1;
+    while (length > 0 && writer->out[length - 1] != '/') {
+        length--;
+    }
+    if (length > 0) {
+        length--;
+    }
+    writer->length = length;
+}
+
+//remove_dot_segments from RFC 3986 5.2.4
+static void putPath(Writer* writer, const char* in, int len) {
+    size_t start = writer->length;
+    int i = 0;
+    while (i < len) {
+        const char* s = in + i;
+        int n = len - i;
+        if (n >= 3 && memcmp(s, "../", 3) == 0) {
+            i += 3;
+        } else if (n >= 2 && memcmp(s, "./", 2) == 0) {
+            i += 2;
+        } else if (n >= 3 && memcmp(s, "/./", 3) == 0) {
+            i += 2;
+        } else if (n == 2 && memcmp(s, "/.", 2) == 0) {
+            i += 2;
+            put(writer, '/');
+        } else if (n >= 4 && memcmp(s, "/../", 4) == 0) {
+            i += 3;
+            if (writer->length > start) {
+                popSegment(writer);
+            }
+        } else if (n == 3 && memcmp(s, "/..", 3) == 0) {
+            i += 3;
+            if (writer->length > start) {
+                popSegment(writer);
+            }
+            put(writer, '/');
+        } else if ((n == 1 && s[0] == '.') || (n == 2 && memcmp(s, "..", 2) == 0)) {
+            i = len;
+        } else {
+            int j = i + (s[0] == '/' ? 1 : 0);
+            while (j < len && in[j] != '/') {
+                j++;
+            }
+            putEncoded(writer, s, j - i);
+            i = j;
+        }
+        //popSegment can't see past what was cut off, give up rather than guess
+        if (writer->length >= writer->size) {
+            return;
+        }
+    }
+}
+
+int urlParse(const char* str, size_t len, Url* url) {
+    memset(url, 0, sizeof *url);
+    const char* end = str + len;
+    for (const char* c = str; c < end; c++) {
+        if ((unsigned char)*c < ' ' || *c == 0x7F) {
+            return -1;
+        }
+    }
+
+    //Fragments never go to the server
+    const char* hash = memchr(str, '#', len);
+    if (hash != NULL) {
+        end = hash;
+    }
+
+    const char* c = str;
+    if (c < end && isalpha((unsigned char)*c)) {
+        const char* s = c + 1;
+        while (s < end && (isalnum((unsigned char)*s) || *s == '+' || *s == '-' || *s == '.')) {
+            s++;
+        }
+        if (s < end && *s == ':') {
+            url->hasScheme = 1;
+            url->scheme = c;
+            url->schemeLength = s - c;
+            c = s + 1;
+        }
+    }
+
+    if (end - c >= 2 && c[0] == '/' && c[1] == '/') {
+        url->hasAuthority = 1;
+        c += 2;
+        const char* authorityEnd = c;
+        while (authorityEnd < end && *authorityEnd != '/' && *authorityEnd != '?') {
+            authorityEnd++;
+        }
+        //User info isn't used by gemini, skip it
+        for (const char* at = authorityEnd; at > c; at--) {
+            if (at[-1] == '@') {
+                c = at;
+                break;
+            }
+        }
+        const char* hostEnd = c;
+        if (c < authorityEnd && *c == '[') {
+            while (hostEnd < authorityEnd && *hostEnd != ']') {
+                hostEnd++;
+            }
+            if (hostEnd == authorityEnd) {
+                return -1;
+            }
+            hostEnd++;
+        } else {
+            while (hostEnd < authorityEnd && *hostEnd != ':') {
+                hostEnd++;
+            }
+        }
+        url->host = c;
+        url->hostLength = hostEnd - c;
+        if (hostEnd < authorityEnd) {
+            if (*hostEnd != ':') {
+                return -1;
+            }
+            url->port = hostEnd + 1;
+            url->portLength = authorityEnd - url->port;
+            if (url->portLength > 5) {
+                return -1;
+            }
+            long port = 0;
+            for (int i = 0; i < url->portLength; i++) {
+                if (!isdigit((unsigned char)url->port[i])) {
+                    return -1;
+                }
+                port = port * 10 + url->port[i] - '0';
+            }
+            if (port > 65535) {
+                return -1;
+            }
+        }
+        c = authorityEnd;
+    }
+
+    const char* question = memchr(c, '?', end - c);
+    const char* pathEnd = question != NULL ? question : end;
+    url->path = c;
+    url->pathLength = pathEnd - c;
+    if (question != NULL) {
+        url->hasQuery = 1;
+        url->query = question + 1;
+        url->queryLength = end - url->query;
+    }
+    return 0;
+}
+
+int urlEscape(const char* str, char* out, size_t size) {
+    static const char hex[] = "0123456789ABCDEF";
+    Writer writer = { out, size, 0 };
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (isUnreserved(c)) {
+            put(&writer, c);
+        } else {
+            put(&writer, '%');
+            put(&writer, hex[c >> 4]);
+            put(&writer, hex[c & 15]);
+        }
+    }
+    return finish(&writer);
+}
+
+int urlIsScheme(const Url* url, const char* scheme) {
+    return url->hasScheme && (int)strlen(scheme) == url->schemeLength && strncasecmp(url->scheme, scheme, url->schemeLength) == 0;
+}
+
+static int isDefaultPort(const Url* url) {
+    if (url->portLength == 0) {
+        return 1;
+    }
+    return urlIsScheme(url, "gemini") && url->portLength == 4 && memcmp(url->port, "1965", 4) == 0;
+}
+
+int urlFormat(const Url* url, char* out, size_t size) {
+    Writer writer = { out, size, 0 };
+    if (url->hasScheme) {
+        putLower(&writer, url->scheme, url->schemeLength);
+        put(&writer, ':');
+    }
+    if (url->hasAuthority) {
+        putSpan(&writer, "//", 2);
+        putLower(&writer, url->host, url->hostLength);
+        if (!isDefaultPort(url)) {
+            put(&writer, ':');
+            putSpan(&writer, url->port, url->portLength);
+        }
+        if (url->pathLength == 0) {
+            put(&writer, '/');
+        }
+    }
+    if (url->hasAuthority) {
+        putPath(&writer, url->path, url->pathLength);
+    } else {
+        //Without an authority a path starting with // would read back as one,
+        //RFC 3986 5.3 keeps it apart with a leading /.
+        char path[URL_MAX];
+        Writer pathWriter = { path, sizeof path, 0 };
+        putPath(&pathWriter, url->path, url->pathLength);
+        if (finish(&pathWriter) < 0) {
+            return -1;
+        }
+        if (pathWriter.length >= 2 && path[0] == '/' && path[1] == '/') {
+            putSpan(&writer, "/.", 2);
+        }
+        putSpan(&writer, path, pathWriter.length);
+    }
+    if (url->hasQuery) {
+        put(&writer, '?');
+        putEncoded(&writer, url->query, url->queryLength);
+    }
+    return finish(&writer);
+}
+
+//RFC 3986 5.2.2, with the merged path built on the stack
+int urlResolve(const Url* base, const Url* ref, char* out, size_t size) {
+    if (ref->hasScheme) {
+        return urlFormat(ref, out, size);
+    }
+
+    Url target = *ref;
+    target.hasScheme = base->hasScheme;
+    target.scheme = base->scheme;
+    target.schemeLength = base->schemeLength;
+    if (ref->hasAuthority) {
+        return urlFormat(&target, out, size);
+    }
+
+    target.hasAuthority = base->hasAuthority;
+    target.host = base->host;
+    target.hostLength = base->hostLength;
+    target.port = base->port;
+    target.portLength = base->portLength;
+
+    char merged[URL_MAX];
+    if (ref->pathLength == 0) {
+        target.path = base->path;
+        target.pathLength = base->pathLength;
+        if (!ref->hasQuery) {
+            target.hasQuery = base->hasQuery;
+            target.query = base->query;
+            target.queryLength = base->queryLength;
+        }
+    } else if (ref->path[0] != '/') {
+        //Relative path, it replaces the last segment of the base
+        Writer writer = { merged, sizeof merged, 0 };
+        if (base->hasAuthority && base->pathLength == 0) {
+            put(&writer, '/');
+        } else {
+            int directory = base->pathLength;
+            while (directory > 0 && base->path[directory - 1] != '/') {
+                directory--;
+            }
+            putSpan(&writer, base->path, directory);
+        }
+        putSpan(&writer, ref->path, ref->pathLength);
+        if (finish(&writer) < 0) {
+            return -1;
+        }
+        target.path = merged;
+        target.pathLength = writer.length;
+    }
+    return urlFormat(&target, out, size);
+}
+
+int urlNormalize(const char* str, char* out, size_t size) {
+    Url url;
+    if (urlParse(str, strlen(str), &url) != 0) {
+        return -1;
+    }
+    return urlFormat(&url, out, size);
+}
+
+int urlCopyPart(const char* part, int length, char* out, size_t size) {
+    if ((size_t)length >= size) {
+        return -1;
+    }
+    memcpy(out, part, length);
+    out[length] = '\0';
+    return length;
+}
@@ -0,0 +1,50 @@
+#ifndef URL_H
+#define URL_H
+
+#include <stddef.h>
+
+//Longest url we deal with, the gemini spec caps requests at 1024 bytes
+#define URL_MAX 1024
+
+//A url split into its RFC 3986 parts. Every part is a view into the string
+//that was parsed, nothing is copied or allocated.
+typedef struct {
+    const char* scheme;
+    int schemeLength;
+    const char* host;
+    int hostLength;
+    const char* port;
+    int portLength;
+    const char* path;
+    int pathLength;
+    const char* query;  //Without the '?'
+    int queryLength;
+    int hasScheme;
+    int hasAuthority;
+    int hasQuery;
+} Url;
+
+//Returns 0, or -1 if str isn't a url (bad port, control characters and the like).
+//A fragment is accepted and ignored.
+int urlParse(const char* str, size_t len, Url* url);
+//Writes the canonical form of url to out: lowercase scheme and host, no default
+//port, no dot segments, "/" for an empty path, percent-encoding only where it
+//is needed and in uppercase, no fragment. Two urls naming the same resource
+//come out the same so it makes a good cache key.
+//Returns the length, -1 if it doesn't fit.
+int urlFormat(const Url* url, char* out, size_t size);
+//Resolves a reference (relative or not) against an absolute base url and
+//writes the canonical result to out. Returns the length or -1.
+int urlResolve(const Url* base, const Url* ref, char* out, size_t size);
+//urlParse and urlFormat in one
+int urlNormalize(const char* str, char* out, size_t size);
+
+//Percent-encodes everything but the unreserved characters, for text going
+//into a query. Returns the length, -1 if it doesn't fit.
+int urlEscape(const char* str, char* out, size_t size);
+
+int urlIsScheme(const Url* url, const char* scheme);
+//Copies a part into a terminated buffer, -1 if it doesn't fit
+int urlCopyPart(const char* part, int length, char* out, size_t size);
+
+#endif
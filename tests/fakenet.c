@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "fakenet.h"
+#include "memstats.h"
+#include "platform.h"
+
+typedef struct {
+    FakeNetwork* net;
+    const FakeResponse* response;
+    size_t sent;
+    const volatile int* cancelled;
+} FakeConnection;
+
+void fakeNetworkInit(FakeNetwork* net) {
+    memset(net, 0, sizeof *net);
+}
+
+void fakeNetworkAdd(FakeNetwork* net, const char* url, const char* data, size_t length) {
+    if (net->count == FAKE_MAX_RESPONSES) {
+        return;
+    }
+    FakeResponse* response = &net->responses[net->count++];
+    snprintf(response->url, sizeof response->url, "%s", url);
+    response->data = data;
+    response->length = length;
+    response->error = FETCH_OK;
+}
+
+void fakeNetworkAddText(FakeNetwork* net, const char* url, const char* response) {
+    fakeNetworkAdd(net, url, response, strlen(response));
+}
+
+void fakeNetworkAddError(FakeNetwork* net, const char* url, int error) {
+    fakeNetworkAdd(net, url, NULL, 0);
+    net->responses[net->count - 1].error = error;
+}
+
+//A cancelled job makes the read fail, the way the TLS transport does at its next poll
+static int fakeRecv(void* ctx, unsigned char* buf, size_t len) {
+    FakeConnection* conn = ctx;
+    int delayMs = conn->net->delayMs + conn->response->delayMs;
+    if (delayMs > 0) {
+        platformSleepMs(delayMs);
+    }
+    if (*conn->cancelled) {
+        return -1;
+    }
+    size_t left = conn->response->length - conn->sent;
+    size_t record = conn->net->recordSize ? conn->net->recordSize : RESPONSE_RECORD_SIZE;
+    size_t length = left < len ? left : len;
+    length = length < record ? length : record;
+    memcpy(buf, conn->response->data + conn->sent, length);
+    conn->sent += length;
+    return length;
+}
+
+static int openFake(void* ctx, FetchJob* job, const char* request, Transport* transport, void** conn) {
+    FakeNetwork* net = ctx;
+    __atomic_add_fetch(&net->opens, 1, __ATOMIC_RELAXED);
+    size_t urlLength = strcspn(request, "\r");
+    for (int i = 0; i < net->count; i++) {
+        const FakeResponse* response = &net->responses[i];
+        if (strlen(response->url) != urlLength || memcmp(response->url, request, urlLength) != 0) {
+            continue;
+        }
+        if (response->error != FETCH_OK) {
+            return response->error;
+        }
+        FakeConnection* fake = memCalloc(MEM_NETWORK, 1, sizeof *fake);
+        if (fake == NULL) {
+            return FETCH_SETUP_FAILED;
+        }
+        fake->net = net;
+        fake->response = response;
+        fake->cancelled = &job->cancelled;
+        *conn = fake;
+        transport->ctx = fake;
+        transport->recv = fakeRecv;
+        __atomic_add_fetch(&net->answered, 1, __ATOMIC_RELAXED);
+        int connected = __atomic_add_fetch(&net->connected, 1, __ATOMIC_RELAXED);
+        int most = __atomic_load_n(&net->mostConnected, __ATOMIC_RELAXED);
+        while (connected > most &&
+               !__atomic_compare_exchange_n(&net->mostConnected, &most, connected, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+        return FETCH_OK;
+    }
+    return FETCH_CONNECT_FAILED;
+}
+
+static void closeFake(void* ctx, void* conn) {
+    FakeNetwork* net = ctx;
+    __atomic_sub_fetch(&net->connected, 1, __ATOMIC_RELAXED);
+    memFree(conn);
+}
+
+void networkInitFake(FetchNetwork* network, FakeNetwork* net) {
+    network->ctx = net;
+    network->open = openFake;
+    network->close = closeFake;
+}
+
+static int makeFake(void* ctx, int worker, FetchNetwork* network) {
+    (void)worker;
+    networkInitFake(network, ctx);
+    return 0;
+}
+
+static void releaseFake(void* ctx, int worker) {
+    (void)ctx;
+    (void)worker;
+}
+
+void networkFactoryInitFake(NetworkFactory* factory, FakeNetwork* net) {
+    factory->ctx = net;
+    factory->make = makeFake;
+    factory->release = releaseFake;
+}
+
+FetchJob* fakeWait(Fetcher* fetcher) {
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS; waited++) {
+        FetchJob* job = fetcherPoll(fetcher);
+        if (job != NULL) {
+            return job;
+        }
+        platformSleepMs(1);
+    }
+    return NULL;
+}
+
+FetchJob* fakeFetch(Fetcher* fetcher, const char* url) {
+    FetchJob* job = fetchJobNew(url);
+    if (job == NULL || fetcherSubmit(fetcher, job) != 0) {
+        fetchJobFree(job);
+        return NULL;
+    }
+    return fakeWait(fetcher);
+}
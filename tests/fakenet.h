@@ -0,0 +1,48 @@
+#ifndef FAKENET_H
+#define FAKENET_H
+
+#include <stddef.h>
+
+#include "fetch.h"
+
+#define FAKE_MAX_RESPONSES 64
+//How long fakeFetch waits for a job before giving up on it
+#define FAKE_FETCH_TIMEOUT_MS 10000
+
+//A canned answer to one url, header and body exactly as a server sends them
+typedef struct {
+    char url[URL_MAX];
+    const char* data;   //Not copied, has to outlive the network
+    size_t length;
+    int error;          //FetchError to fail the connect with instead, FETCH_OK to answer
+    int delayMs;        //Before every read on top of the network's, a host further away
+} FakeResponse;
+
+//A FetchNetwork that never leaves the process. Urls without a response fail
+//to connect like an unreachable host. Only the tests' thread adds responses,
+//and only before the fetcher is started. Any number of workers can share one.
+typedef struct {
+    FakeResponse responses[FAKE_MAX_RESPONSES];
+    int count;
+    size_t recordSize;  //Most handed out per read, 0 for whole TLS records
+    int delayMs;        //Before every read, a slow server
+    int opens;          //Connections asked for, updated by the fetch worker
+    int answered;       //Of those, how many had a response
+    int connected;      //Open right now
+    int mostConnected;  //Most ever open at once
+} FakeNetwork;
+
+void fakeNetworkInit(FakeNetwork* net);
+void fakeNetworkAdd(FakeNetwork* net, const char* url, const char* data, size_t length);
+//A terminated response, the usual case
+void fakeNetworkAddText(FakeNetwork* net, const char* url, const char* response);
+void fakeNetworkAddError(FakeNetwork* net, const char* url, int error);
+void networkInitFake(FetchNetwork* network, FakeNetwork* net);
+//Every worker gets a network on net
+void networkFactoryInitFake(NetworkFactory* factory, FakeNetwork* net);
+
+//Submits a job and waits for it to come back, NULL if it didn't in time
+FetchJob* fakeFetch(Fetcher* fetcher, const char* url);
+FetchJob* fakeWait(Fetcher* fetcher);
+
+#endif
@@ -0,0 +1,130 @@
+#define _XOPEN_SOURCE 700
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memstats.h"
+#include "test.h"
+
+//    build-host/tests/run            every case
+//    build-host/tests/run url        one suite
+//    build-host/tests/run url/parts  one case
+
+#define TEST_MAX_DIRS 256
+
+typedef struct {
+    const char* name;
+    const TestCase* cases;
+} TestSuite;
+
+static const TestSuite suites[] = {
+    { "gemtext", gemtextTests },
+    { "url", urlTests },
+    { "layout", layoutTests },
+    { "response", responseTests },
+    { "history", historyTests },
+    { "diskcache", diskCacheTests },
+    { "knownhosts", knownHostsTests },
+    { "lz", lzTests },
+    { "memstats", memStatsTests },
+    { "session", sessionTests },
+    { "download", downloadTests },
+    { "trace", traceTests },
+    { "connect", connectTests },
+    { "linktable", linkTableTests },
+    { "prefetch", prefetchTests },
+    { "fetch", fetchTests },
+    { "render", renderTests },
+    { "redirects", redirectsTests },
+    { "feeds", feedsTests },
+};
+
+static int failures;
+static char* tempDirs[TEST_MAX_DIRS];
+static int tempDirCount;
+
+void testFailed(const char* file, int line, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("    %s:%d: ", file, line);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    failures++;
+}
+
+void testTempDir(char* out, size_t size) {
+    snprintf(out, size, "/tmp/gemini-test-XXXXXX");
+    if (mkdtemp(out) == NULL) {
+        perror("mkdtemp");
+        exit(2);
+    }
+    if (tempDirCount < TEST_MAX_DIRS) {
+        tempDirs[tempDirCount++] = strdup(out);
+    }
+}
+
+static int removeEntry(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    (void)st;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static size_t charged(void) {
+    size_t total = 0;
+    for (int i = 0; i < MEM_ACCOUNTS; i++) {
+        MemStats stats;
+        memStats(i, &stats);
+        total += stats.current;
+    }
+    return total;
+}
+
+static int selected(const char* filter, const char* suite, const char* name) {
+    if (filter == NULL) {
+        return 1;
+    }
+    size_t length = strlen(suite);
+    if (strncmp(filter, suite, length) != 0) {
+        return 0;
+    }
+    return filter[length] == '\0' || (filter[length] == '/' && strcmp(filter + length + 1, name) == 0);
+}
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : NULL;
+    int run = 0;
+    int failed = 0;
+    setvbuf(stdout, NULL, _IONBF, 0);
+    for (size_t s = 0; s < sizeof suites / sizeof suites[0]; s++) {
+        for (const TestCase* test = suites[s].cases; test->name != NULL; test++) {
+            if (!selected(filter, suites[s].name, test->name)) {
+                continue;
+            }
+            int before = failures;
+            size_t memory = charged();
+            test->run();
+            size_t left = charged();
+            if (left != memory) {
+                testFailed(__FILE__, __LINE__, "%lld bytes still charged to the memory accounts", (long long)left - (long long)memory);
+            }
+            run++;
+            if (failures != before) {
+                failed++;
+                printf("FAIL %s/%s\n", suites[s].name, test->name);
+            } else {
+                printf("ok   %s/%s\n", suites[s].name, test->name);
+            }
+        }
+    }
+
+    for (int i = 0; i < tempDirCount; i++) {
+        nftw(tempDirs[i], removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+        free(tempDirs[i]);
+    }
+    printf("%d of %d cases failed\n", failed, run);
+    return run == 0 || failed != 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pages.h"
+
+static const char* words[] = {
+    "gemini", "capsule", "the", "a", "of", "and", "protocol", "small", "web", "client", "server",
+    "to", "is", "in", "that", "it", "with", "for", "on", "page", "link", "text", "reading",
+    "slow", "quiet", "minimal", "écrit", "日本語", "über", "tilde", "gemlog", "post", "2023",
+    "markup", "line", "simple", "privacy", "TLS", "certificate", "request", "response",
+};
+
+#define WORD_COUNT (sizeof words / sizeof words[0])
+
+static unsigned int next(unsigned int* seed) {
+    *seed = *seed * 1103515245u + 12345u;
+    return (*seed >> 16) & 0x7FFF;
+}
+
+static void sentence(Buffer* out, unsigned int* seed, int count) {
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            bufferAppend(out, " ", 1);
+        }
+        const char* word = words[next(seed) % WORD_COUNT];
+        bufferAppend(out, word, strlen(word));
+    }
+}
+
+static void link(Buffer* out, unsigned int* seed) {
+    char url[96];
+    switch (next(seed) % 4) {
+    case 0:
+        snprintf(url, sizeof url, "=> gemini://example.org/%u/%u.gmi ", next(seed) % 100, next(seed));
+        break;
+    case 1:
+        snprintf(url, sizeof url, "=> /posts/%u.gmi ", next(seed));
+        break;
+    case 2:
+        snprintf(url, sizeof url, "=> ../%u/ ", next(seed) % 50);
+        break;
+    default:
+        snprintf(url, sizeof url, "=> https://example.com/?q=%u\t", next(seed));
+        break;
+    }
+    bufferAppend(out, url, strlen(url));
+    sentence(out, seed, 1 + next(seed) % 6);
+    bufferAppend(out, "\n", 1);
+}
+
+void pageMake(Buffer* out, size_t size, unsigned int seed) {
+    size_t start = out->length;
+    bufferAppend(out, "# ", 2);
+    sentence(out, &seed, 4);
+    bufferAppend(out, "\n\n", 2);
+    while (out->length - start < size) {
+        unsigned int kind = next(&seed) % 16;
+        if (kind < 6) {
+            sentence(out, &seed, 5 + next(&seed) % 60);
+            bufferAppend(out, "\n\n", 2);
+        } else if (kind < 9) {
+            int count = 1 + next(&seed) % 8;
+            for (int i = 0; i < count; i++) {
+                link(out, &seed);
+            }
+        } else if (kind < 11) {
+            const char* heading = next(&seed) % 2 ? "## " : "### ";
+            bufferAppend(out, heading, strlen(heading));
+            sentence(out, &seed, 2 + next(&seed) % 5);
+            bufferAppend(out, "\n", 1);
+        } else if (kind < 13) {
+            int count = 2 + next(&seed) % 5;
+            for (int i = 0; i < count; i++) {
+                bufferAppend(out, "* ", 2);
+                sentence(out, &seed, 3 + next(&seed) % 10);
+                bufferAppend(out, "\n", 1);
+            }
+        } else if (kind < 14) {
+            bufferAppend(out, "> ", 2);
+            sentence(out, &seed, 10 + next(&seed) % 20);
+            bufferAppend(out, "\r\n", 2);
+        } else {
+            bufferAppend(out, "```ascii art\n", 13);
+            int rows = 3 + next(&seed) % 10;
+            for (int i = 0; i < rows; i++) {
+                int width = next(&seed) % 90;
+                for (int x = 0; x < width; x++) {
+                    bufferAppend(out, &"  /\\_|-+*o#"[next(&seed) % 11], 1);
+                }
+                bufferAppend(out, "\n", 1);
+            }
+            bufferAppend(out, "```\n", 4);
+        }
+    }
+}
+
+void pageMakeLinks(Buffer* out, int links, unsigned int seed) {
+    bufferAppend(out, "# Index\n", 8);
+    for (int i = 0; i < links; i++) {
+        link(out, &seed);
+    }
+}
+
+static int sameView(const char* a, int aLength, const char* b, int bLength) {
+    return aLength == bLength && memcmp(a, b, aLength) == 0;
+}
+
+int pageSameDocument(const Document* a, const Document* b) {
+    if (a->lineCount != b->lineCount || a->linkCount != b->linkCount) {
+        return 0;
+    }
+    for (int i = 0; i < a->lineCount; i++) {
+        if (a->lines[i].type != b->lines[i].type ||
+            !sameView(a->lines[i].text, a->lines[i].length, b->lines[i].text, b->lines[i].length)) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < a->linkCount; i++) {
+        if (!sameView(a->links[i].path, a->links[i].pathLength, b->links[i].path, b->links[i].pathLength) ||
+            !sameView(a->links[i].caption, a->links[i].captionLength, b->links[i].caption, b->links[i].captionLength)) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,18 @@
+#ifndef PAGES_H
+#define PAGES_H
+
+#include <stddef.h>
+
+#include "buffer.h"
+#include "gemtext.h"
+
+//Made up gemtext shaped like a capsule's pages: headings, paragraphs of
+//varied length, lists, quotes, link runs and preformatted blocks. The same
+//seed always gives the same page. Appends about size bytes to out.
+void pageMake(Buffer* out, size_t size, unsigned int seed);
+//A directory listing, nothing but link lines
+void pageMakeLinks(Buffer* out, int links, unsigned int seed);
+//1 if the two documents have the same lines and links
+int pageSameDocument(const Document* a, const Document* b);
+
+#endif
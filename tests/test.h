@@ -0,0 +1,68 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stddef.h>
+#include <string.h>
+
+//Host unit tests, run by `make host-test`. Each file fills in a table of
+//cases ending with { NULL, NULL } and main.c lists the tables. A check that
+//fails reports itself and the case carries on, REQUIRE returns from the case
+//instead for checks the rest of it depends on. Every case has to give back
+//all the memory it charged to the accounts, the runner fails it otherwise.
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} TestCase;
+
+void testFailed(const char* file, int line, const char* format, ...) __attribute__((format(printf, 3, 4)));
+//A fresh empty directory, removed with everything in it once the run is over
+void testTempDir(char* out, size_t size);
+
+#define CHECK(cond) do { \
+    if (!(cond)) testFailed(__FILE__, __LINE__, "%s", #cond); \
+} while (0)
+
+#define REQUIRE(cond) do { \
+    if (!(cond)) { testFailed(__FILE__, __LINE__, "%s", #cond); return; } \
+} while (0)
+
+#define CHECK_INT(actual, expected) do { \
+    long long actual_ = (actual), expected_ = (expected); \
+    if (actual_ != expected_) testFailed(__FILE__, __LINE__, "%s is %lld, expected %lld", #actual, actual_, expected_); \
+} while (0)
+
+#define CHECK_STR(actual, expected) do { \
+    const char* actual_ = (actual); const char* expected_ = (expected); \
+    if (actual_ == NULL || strcmp(actual_, expected_) != 0) \
+        testFailed(__FILE__, __LINE__, "%s is \"%s\", expected \"%s\"", #actual, actual_ ? actual_ : "(null)", expected_); \
+} while (0)
+
+//For the views into a page that aren't terminated
+#define CHECK_VIEW(text, length, expected) do { \
+    const char* expected_ = (expected); int length_ = (length); \
+    if (length_ != (int)strlen(expected_) || memcmp((text), expected_, length_) != 0) \
+        testFailed(__FILE__, __LINE__, "%s is \"%.*s\", expected \"%s\"", #text, length_ < 0 ? 0 : length_, (text), expected_); \
+} while (0)
+
+extern const TestCase gemtextTests[];
+extern const TestCase urlTests[];
+extern const TestCase layoutTests[];
+extern const TestCase responseTests[];
+extern const TestCase historyTests[];
+extern const TestCase diskCacheTests[];
+extern const TestCase knownHostsTests[];
+extern const TestCase lzTests[];
+extern const TestCase memStatsTests[];
+extern const TestCase sessionTests[];
+extern const TestCase downloadTests[];
+extern const TestCase traceTests[];
+extern const TestCase connectTests[];
+extern const TestCase linkTableTests[];
+extern const TestCase prefetchTests[];
+extern const TestCase fetchTests[];
+extern const TestCase renderTests[];
+extern const TestCase redirectsTests[];
+extern const TestCase feedsTests[];
+
+#endif
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "connector.h"
+#include "dnscache.h"
+#include "platform.h"
+#include "test.h"
+
+//A resolver that answers from a list and counts how often it was asked
+typedef struct {
+    const char* addresses[DNS_MAX_ADDRESSES + 1];
+    int calls;
+} StubResolver;
+
+static void makeAddress(const char* text, int port, DnsAddress* out) {
+    memset(out, 0, sizeof *out);
+    if (strchr(text, ':') != NULL) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&out->addr;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        inet_pton(AF_INET6, text, &in6->sin6_addr);
+        out->length = sizeof *in6;
+    } else {
+        struct sockaddr_in* in = (struct sockaddr_in*)&out->addr;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        inet_pton(AF_INET, text, &in->sin_addr);
+        out->length = sizeof *in;
+    }
+}
+
+static int stubResolve(void* ctx, const char* host, DnsAddress* out, int max) {
+    StubResolver* stub = ctx;
+    stub->calls++;
+    int count = 0;
+    while (count < max && stub->addresses[count] != NULL) {
+        makeAddress(stub->addresses[count], 0, &out[count]);
+        count++;
+    }
+    (void)host;
+    return count;
+}
+
+static int sameAddress(const DnsAddress* address, const char* text) {
+    DnsAddress expected;
+    makeAddress(text, 0, &expected);
+    return address->length == expected.length && memcmp(&address->addr, &expected.addr, expected.length) == 0;
+}
+
+//A second lookup skips the resolver, whatever the case of the name, and the
+//answer alternates between the families
+static void dnsHit(void) {
+    StubResolver stub = { { "192.0.2.1", "192.0.2.2", "2001:db8::1", NULL }, 0 };
+    DnsCache cache;
+    dnsCacheInit(&cache, stubResolve, &stub);
+    DnsAddress out[DNS_MAX_ADDRESSES];
+    int cached;
+    REQUIRE(dnsCacheLookup(&cache, "capsule.example", out, &cached) == 3);
+    CHECK_INT(cached, 0);
+    CHECK(sameAddress(&out[0], "2001:db8::1"));
+    CHECK(sameAddress(&out[1], "192.0.2.1"));
+    CHECK(sameAddress(&out[2], "192.0.2.2"));
+
+    memset(out, 0, sizeof out);
+    REQUIRE(dnsCacheLookup(&cache, "Capsule.EXAMPLE", out, &cached) == 3);
+    CHECK_INT(cached, 1);
+    CHECK(sameAddress(&out[0], "2001:db8::1"));
+    CHECK_INT(stub.calls, 1);
+    CHECK_INT(cache.hits, 1);
+    CHECK_INT(cache.misses, 1);
+}
+
+//Answers are kept for the TTL, names that didn't resolve for the shorter negative one
+static void dnsExpiry(void) {
+    StubResolver stub = { { NULL }, 0 };
+    DnsCache cache;
+    dnsCacheInit(&cache, stubResolve, &stub);
+    DnsAddress out[DNS_MAX_ADDRESSES];
+    int cached;
+    CHECK_INT(dnsCacheLookup(&cache, "nowhere.example", out, &cached), 0);
+    CHECK_INT(dnsCacheLookup(&cache, "nowhere.example", out, &cached), 0);
+    CHECK_INT(cached, 1);
+    CHECK_INT(cache.negativeHits, 1);
+    CHECK_INT(stub.calls, 1);
+
+    //The TTLs apply to answers from then on
+    cache.negativeTtlUs = 1000;
+    CHECK_INT(dnsCacheLookup(&cache, "later.example", out, &cached), 0);
+    platformSleepMs(2);
+    stub.addresses[0] = "192.0.2.7";
+    CHECK_INT(dnsCacheLookup(&cache, "later.example", out, &cached), 1);
+    CHECK_INT(cached, 0);
+    CHECK_INT(stub.calls, 3);
+    CHECK(sameAddress(&out[0], "192.0.2.7"));
+
+    cache.ttlUs = 1000;
+    CHECK_INT(dnsCacheLookup(&cache, "other.example", out, &cached), 1);
+    platformSleepMs(2);
+    CHECK_INT(dnsCacheLookup(&cache, "other.example", out, &cached), 1);
+    CHECK_INT(cached, 0);
+    CHECK_INT(stub.calls, 5);
+    //The first answer is still good
+    CHECK_INT(dnsCacheLookup(&cache, "nowhere.example", out, &cached), 0);
+    CHECK_INT(cached, 1);
+}
+
+//The address that worked goes first next time, a host none of whose
+//addresses answered is looked up again, and a full cache drops the least
+//recently used name
+static void dnsPrefer(void) {
+    StubResolver stub = { { "192.0.2.1", "2001:db8::1", "192.0.2.2", NULL }, 0 };
+    DnsCache cache;
+    dnsCacheInit(&cache, stubResolve, &stub);
+    DnsAddress out[DNS_MAX_ADDRESSES];
+    int cached;
+    REQUIRE(dnsCacheLookup(&cache, "capsule.example", out, &cached) == 3);
+    DnsAddress winner = out[2];
+    dnsCachePrefer(&cache, "capsule.example", &winner);
+    REQUIRE(dnsCacheLookup(&cache, "capsule.example", out, &cached) == 3);
+    CHECK(sameAddress(&out[0], "192.0.2.2"));
+    CHECK(sameAddress(&out[1], "2001:db8::1"));
+    CHECK(sameAddress(&out[2], "192.0.2.1"));
+
+    dnsCacheForget(&cache, "capsule.example");
+    dnsCacheLookup(&cache, "capsule.example", out, &cached);
+    CHECK_INT(cached, 0);
+    CHECK_INT(stub.calls, 2);
+
+    char host[32];
+    for (int i = 1; i < DNS_CACHE_SIZE; i++) {
+        snprintf(host, sizeof host, "host%d.example", i);
+        dnsCacheLookup(&cache, host, out, &cached);
+    }
+    dnsCacheLookup(&cache, "capsule.example", out, &cached);
+    CHECK_INT(cached, 1);
+    dnsCacheLookup(&cache, "one.too.many", out, &cached);
+    dnsCacheLookup(&cache, "capsule.example", out, &cached);
+    CHECK_INT(cached, 1);
+    dnsCacheLookup(&cache, "host1.example", out, &cached);
+    CHECK_INT(cached, 0);
+}
+
+//Loopback sockets on the same port of different 127/8 addresses: one that
+//accepts, one that isn't listening and refuses, and one whose backlog is
+//full so connects to it hang like a dead host's
+typedef struct {
+    int port;
+    int good;
+    int refusing;
+    int stalled;
+    int filler;
+} Listeners;
+
+static int bindTo(const char* ip, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    DnsAddress address;
+    makeAddress(ip, port, &address);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&address.addr, address.length) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static int listenersStart(Listeners* l) {
+    l->refusing = l->stalled = l->filler = -1;
+    l->good = bindTo("127.0.0.1", 0);
+    struct sockaddr_in bound;
+    socklen_t length = sizeof bound;
+    if (l->good < 0 || listen(l->good, 8) != 0 || getsockname(l->good, (struct sockaddr*)&bound, &length) != 0) {
+        return -1;
+    }
+    l->port = ntohs(bound.sin_port);
+    l->refusing = bindTo("127.0.0.2", l->port);
+    l->stalled = bindTo("127.0.0.3", l->port);
+    if (l->refusing < 0 || l->stalled < 0 || listen(l->stalled, 0) != 0) {
+        return -1;
+    }
+    //Takes the one place in the backlog, nothing is ever accepted
+    l->filler = socket(AF_INET, SOCK_STREAM, 0);
+    DnsAddress address;
+    makeAddress("127.0.0.3", l->port, &address);
+    return connect(l->filler, (struct sockaddr*)&address.addr, address.length);
+}
+
+static void listenersStop(Listeners* l) {
+    int fds[] = { l->good, l->refusing, l->stalled, l->filler };
+    for (int i = 0; i < 4; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+}
+
+static int race(const Listeners* l, const char* const* ips, int count, int staggerMs, int timeoutMs,
+                const volatile int* cancel, ConnectStats* stats) {
+    DnsAddress addresses[DNS_MAX_ADDRESSES];
+    for (int i = 0; i < count; i++) {
+        makeAddress(ips[i], 0, &addresses[i]);
+    }
+    int fd;
+    int result = connectRace(addresses, count, l->port, staggerMs, timeoutMs, cancel, &fd, stats);
+    if (result == CONNECT_OK) {
+        close(fd);
+    } else {
+        CHECK_INT(fd, -1);
+    }
+    return result;
+}
+
+//A refused address hands over to the next at once, without waiting out the stagger
+static void refused(void) {
+    Listeners l;
+    REQUIRE(listenersStart(&l) == 0);
+    ConnectStats stats;
+    const char* ips[] = { "127.0.0.2", "127.0.0.1" };
+    CHECK_INT(race(&l, ips, 2, 5000, CONNECT_TIMEOUT_MS, NULL, &stats), CONNECT_OK);
+    CHECK_INT(stats.winner, 1);
+    CHECK_INT(stats.attempts, 2);
+    CHECK_INT(stats.failed, 1);
+    CHECK(stats.us < 1000 * 1000);
+
+    CHECK_INT(race(&l, ips, 1, 5000, CONNECT_TIMEOUT_MS, NULL, &stats), CONNECT_FAILED);
+    CHECK_INT(stats.winner, -1);
+    listenersStop(&l);
+}
+
+//A host that never answers costs the stagger, not the timeout
+static void stalled(void) {
+    Listeners l;
+    REQUIRE(listenersStart(&l) == 0);
+    ConnectStats stats;
+    const char* ips[] = { "127.0.0.3", "127.0.0.2", "127.0.0.1" };
+    CHECK_INT(race(&l, ips, 3, 100, CONNECT_TIMEOUT_MS, NULL, &stats), CONNECT_OK);
+    CHECK_INT(stats.winner, 2);
+    CHECK_INT(stats.attempts, 3);
+    CHECK(stats.us >= 100 * 1000 && stats.us < 2000 * 1000);
+
+    CHECK_INT(race(&l, ips, 1, 100, 200, NULL, &stats), CONNECT_TIMED_OUT);
+    CHECK(stats.us >= 200 * 1000);
+    listenersStop(&l);
+}
+
+//A cancelled job stops waiting within a poll interval
+static void cancelled(void) {
+    Listeners l;
+    REQUIRE(listenersStart(&l) == 0);
+    ConnectStats stats;
+    const char* ips[] = { "127.0.0.3" };
+    volatile int cancel = 1;
+    CHECK_INT(race(&l, ips, 1, 100, CONNECT_TIMEOUT_MS, &cancel, &stats), CONNECT_CANCELLED);
+    CHECK(stats.us < CONNECT_POLL_MS * 1000 * 2);
+    listenersStop(&l);
+}
+
+const TestCase connectTests[] = {
+    { "dns-hit", dnsHit },
+    { "dns-expiry", dnsExpiry },
+    { "dns-prefer", dnsPrefer },
+    { "refused", refused },
+    { "stalled", stalled },
+    { "cancelled", cancelled },
+    { NULL, NULL },
+};
@@ -0,0 +1,301 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "diskcache.h"
+#include "memstats.h"
+#include "test.h"
+
+#define MAX_BYTES (16 * 1024 * 1024)
+#define MAX_AGE (24 * 3600)
+
+static void collect(void* user, const char* data, size_t len) {
+    bufferAppend(user, data, len);
+}
+
+//1 if url is cached with exactly this body
+static int cachedAs(DiskCache* cache, const char* url, const char* body, size_t length) {
+    DiskCacheEntry entry;
+    if (diskCacheGet(cache, url, &entry) != 0) {
+        return 0;
+    }
+    Buffer read;
+    bufferInit(&read, MEM_OTHER);
+    int same = diskCacheEntryRead(&entry, collect, &read) == 0 && read.length == length &&
+        (length == 0 || memcmp(read.data, body, length) == 0);
+    bufferFree(&read);
+    diskCacheEntryFree(&entry);
+    return same;
+}
+
+static void dataPath(char* out, size_t size, const char* dir) {
+    snprintf(out, size, "%s/data.bin", dir);
+}
+
+static long dataLength(const char* dir) {
+    char path[300];
+    dataPath(path, sizeof path, dir);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fclose(file);
+    return length;
+}
+
+//Flips a byte of the first place needle shows up in data.bin
+static int corrupt(const char* dir, const char* needle) {
+    char path[300];
+    dataPath(path, sizeof path, dir);
+    FILE* file = fopen(path, "r+b");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    char* data = malloc(length);
+    rewind(file);
+    int ret = -1;
+    char* found;
+    if (data != NULL && fread(data, length, 1, file) == 1 && (found = memmem(data, length, needle, strlen(needle))) != NULL) {
+        fseek(file, found - data, SEEK_SET);
+        fputc(*found ^ 0x20, file);
+        ret = 0;
+    }
+    free(data);
+    fclose(file);
+    return ret;
+}
+
+static void roundTrip(void) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    DiskCache cache;
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    CHECK_INT(diskCachePut(&cache, "gemini://a/", 20, "text/gemini", "# A\n", 4), 0);
+    CHECK_INT(diskCachePut(&cache, "gemini://b/", 51, "Not found", "", 0), 0);
+    CHECK(cachedAs(&cache, "gemini://a/", "# A\n", 4));
+
+    DiskCacheEntry entry;
+    REQUIRE(diskCacheGet(&cache, "gemini://b/", &entry) == 0);
+    CHECK_INT(entry.status, 51);
+    CHECK_STR(entry.meta, "Not found");
+    CHECK_INT(entry.bodyLength, 0);
+    diskCacheEntryFree(&entry);
+    CHECK(diskCacheGet(&cache, "gemini://c/", &entry) != 0);
+
+    //A newer copy replaces the old one
+    CHECK_INT(diskCachePut(&cache, "gemini://a/", 20, "text/gemini", "# A again\n", 10), 0);
+    CHECK(cachedAs(&cache, "gemini://a/", "# A again\n", 10));
+    CHECK_INT(cache.count, 2);
+    diskCacheClose(&cache);
+}
+
+//Pages survive a close and open, from the index or, without one, from a scan
+static void reopen(void) {
+    char dir[256];
+    char path[300];
+    testTempDir(dir, sizeof dir);
+    DiskCache cache;
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    diskCachePut(&cache, "gemini://a/", 20, "text/gemini", "first", 5);
+    diskCacheClose(&cache);
+
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    CHECK(cachedAs(&cache, "gemini://a/", "first", 5));
+    diskCachePut(&cache, "gemini://b/", 20, "text/gemini", "second", 6);
+    diskCacheClose(&cache);
+
+    snprintf(path, sizeof path, "%s/index.bin", dir);
+    CHECK_INT(remove(path), 0);
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    CHECK(cachedAs(&cache, "gemini://a/", "first", 5));
+    CHECK(cachedAs(&cache, "gemini://b/", "second", 6));
+    diskCacheClose(&cache);
+}
+
+//A write cut short at any byte loses that record and nothing before it, and
+//the next record goes right after the last good one
+static void truncated(void) {
+    char dir[256];
+    char path[300];
+    testTempDir(dir, sizeof dir);
+    dataPath(path, sizeof path, dir);
+    DiskCache cache;
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    diskCachePut(&cache, "gemini://a/", 20, "text/gemini", "kept body", 9);
+    long good = dataLength(dir);
+    diskCachePut(&cache, "gemini://b/", 20, "text/gemini", "torn body", 9);
+    long full = dataLength(dir);
+    //Closing would write an index covering the torn record, a crash doesn't
+    fclose(cache.data);
+    cache.data = NULL;
+    diskCacheClose(&cache);
+
+    char* data = malloc(full);
+    FILE* file = fopen(path, "rb");
+    REQUIRE(data != NULL && file != NULL);
+    CHECK_INT(fread(data, full, 1, file), 1);
+    fclose(file);
+    for (long cut = good; cut < full; cut++) {
+        file = fopen(path, "wb");
+        REQUIRE(file != NULL);
+        fwrite(data, cut, 1, file);
+        fclose(file);
+        REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+        CHECK(cachedAs(&cache, "gemini://a/", "kept body", 9));
+        CHECK(!cachedAs(&cache, "gemini://b/", "torn body", 9));
+        CHECK_INT(dataLength(dir), good);
+        if (cut == full - 1) {
+            diskCachePut(&cache, "gemini://c/", 20, "text/gemini", "after", 5);
+            diskCacheClose(&cache);
+        } else {
+            fclose(cache.data);
+            cache.data = NULL;
+            diskCacheClose(&cache);
+        }
+    }
+    free(data);
+
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    CHECK(cachedAs(&cache, "gemini://a/", "kept body", 9));
+    CHECK(cachedAs(&cache, "gemini://c/", "after", 5));
+    diskCacheClose(&cache);
+}
+
+//A record whose checksum no longer matches is a miss, and is dropped from the index
+static void corrupted(void) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    DiskCache cache;
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    diskCachePut(&cache, "gemini://a/", 20, "text/gemini", "alpha body", 10);
+    diskCachePut(&cache, "gemini://b/", 20, "text/gemini", "bravo body", 10);
+    REQUIRE(corrupt(dir, "alpha") == 0);
+    CHECK(!cachedAs(&cache, "gemini://a/", "alpha body", 10));
+    CHECK(cachedAs(&cache, "gemini://b/", "bravo body", 10));
+    CHECK_INT(cache.count, 1);
+    diskCacheClose(&cache);
+
+    //The data file header itself, everything starts over
+    REQUIRE(corrupt(dir, "GCD1") == 0);
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    CHECK_INT(cache.count, 0);
+    CHECK(!cachedAs(&cache, "gemini://b/", "bravo body", 10));
+    diskCachePut(&cache, "gemini://b/", 20, "text/gemini", "bravo body", 10);
+    CHECK(cachedAs(&cache, "gemini://b/", "bravo body", 10));
+    diskCacheClose(&cache);
+}
+
+static void makeBody(char* body, size_t length, int seed) {
+    for (size_t i = 0; i < length; i++) {
+        body[i] = 'a' + (i * 7 + seed) % 26;
+    }
+}
+
+//Compaction copies the live records over, a bad one on the way is dropped
+//rather than holding the whole compaction up
+static void compaction(void) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    DiskCache cache;
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    size_t length = 64 * 1024;
+    char* body = malloc(length);
+    REQUIRE(body != NULL);
+    makeBody(body, length, 0);
+    for (int i = 0; i < 6; i++) {
+        diskCachePut(&cache, "gemini://big/", 20, "text/gemini", body, length);
+    }
+    diskCachePut(&cache, "gemini://doomed/", 20, "text/gemini", "doomed body", 11);
+    diskCachePut(&cache, "gemini://kept/", 20, "text/gemini", "kept body", 9);
+    REQUIRE(corrupt(dir, "doomed body") == 0);
+    long before = dataLength(dir);
+
+    int steps = 0;
+    while (diskCacheCompactStep(&cache, 16 * 1024) && steps < 1000) {
+        steps++;
+    }
+    CHECK(steps < 1000);
+    CHECK(cache.compacted == NULL);
+    CHECK(dataLength(dir) < before / 4);
+    CHECK(cachedAs(&cache, "gemini://big/", body, length));
+    CHECK(cachedAs(&cache, "gemini://kept/", "kept body", 9));
+    CHECK(!cachedAs(&cache, "gemini://doomed/", "doomed body", 11));
+    CHECK_INT(diskCacheCompactStep(&cache, 16 * 1024), 0);
+    diskCacheClose(&cache);
+
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    CHECK(cachedAs(&cache, "gemini://big/", body, length));
+    CHECK(cachedAs(&cache, "gemini://kept/", "kept body", 9));
+    diskCacheClose(&cache);
+    free(body);
+}
+
+//Over maxBytes the oldest pages go, past maxAge a page is a miss
+static void limits(void) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    DiskCache cache;
+    char body[1000];
+    char url[64];
+    makeBody(body, sizeof body, 1);
+    REQUIRE(diskCacheOpen(&cache, dir, 8 * 1024, MAX_AGE, 0) == 0);
+    for (int i = 0; i < 20; i++) {
+        snprintf(url, sizeof url, "gemini://host/%d", i);
+        diskCachePut(&cache, url, 20, "text/gemini", body, sizeof body);
+    }
+    CHECK(cache.liveBytes <= 8 * 1024);
+    CHECK(cachedAs(&cache, "gemini://host/19", body, sizeof body));
+    diskCacheClose(&cache);
+
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, 0, 0) == 0);
+    for (int i = 0; i < cache.capacity; i++) {
+        cache.slots[i].time -= 10;
+    }
+    CHECK(!cachedAs(&cache, "gemini://host/19", body, sizeof body));
+    diskCacheClose(&cache);
+}
+
+//10k pages, every one found again and none mixed up, before and after a reopen
+static void manyEntries(void) {
+    char dir[256];
+    char url[64];
+    char body[32];
+    testTempDir(dir, sizeof dir);
+    DiskCache cache;
+    REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    for (int i = 0; i < 10000; i++) {
+        snprintf(url, sizeof url, "gemini://host%d.example/page", i);
+        int length = snprintf(body, sizeof body, "body %d", i);
+        REQUIRE(diskCachePut(&cache, url, 20, "text/gemini", body, length) == 0);
+    }
+    CHECK_INT(cache.count, 10000);
+    for (int pass = 0; pass < 2; pass++) {
+        int found = 0;
+        for (int i = 0; i < 10000; i++) {
+            snprintf(url, sizeof url, "gemini://host%d.example/page", i);
+            int length = snprintf(body, sizeof body, "body %d", i);
+            found += cachedAs(&cache, url, body, length);
+        }
+        CHECK_INT(found, 10000);
+        diskCacheClose(&cache);
+        REQUIRE(diskCacheOpen(&cache, dir, MAX_BYTES, MAX_AGE, 0) == 0);
+    }
+    diskCacheClose(&cache);
+}
+
+const TestCase diskCacheTests[] = {
+    { "round-trip", roundTrip },
+    { "reopen", reopen },
+    { "truncated", truncated },
+    { "corrupted", corrupted },
+    { "compaction", compaction },
+    { "limits", limits },
+    { "10k-entries", manyEntries },
+    { NULL, NULL },
+};
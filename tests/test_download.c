@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "download.h"
+#include "fakenet.h"
+#include "memstats.h"
+#include "platform.h"
+#include "test.h"
+
+//Bytes that aren't text and differ from one position to the next
+static void makeBinary(char* out, size_t length, unsigned int seed) {
+    uint32_t state = seed * 2654435761u + 1;
+    for (size_t i = 0; i < length; i++) {
+        state = state * 1664525u + 1013904223u;
+        out[i] = state >> 24;
+    }
+}
+
+//1 if the file at path holds exactly data
+static int fileHolds(const char* path, const char* data, size_t length) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    char chunk[4096];
+    size_t at = 0;
+    size_t read;
+    int same = 1;
+    while (same && (read = fread(chunk, 1, sizeof chunk, file)) > 0) {
+        same = at + read <= length && memcmp(chunk, data + at, read) == 0;
+        at += read;
+    }
+    fclose(file);
+    return same && at == length;
+}
+
+static int exists(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file != NULL) {
+        fclose(file);
+    }
+    return file != NULL;
+}
+
+//Pieces of any size end up in the file in order, across both buffers many
+//times over, and the file only gets its name at the end
+static void pieces(void) {
+    static Download download;
+    char dir[64];
+    char path[128];
+    testTempDir(dir, sizeof dir);
+    size_t length = DOWNLOAD_BUFFER_SIZE * 5 + 12345;
+    char* data = malloc(length);
+    REQUIRE(data != NULL);
+    makeBinary(data, length, 1);
+
+    downloadInit(&download);
+    REQUIRE(downloadStart(&download, dir, "gemini://host.example/files/song.ogg") == 0);
+    snprintf(path, sizeof path, "%s/song.ogg", dir);
+    CHECK_STR(download.path, path);
+    for (size_t at = 0; at < length; at += 7777) {
+        CHECK_INT(downloadWrite(&download, data + at, length - at < 7777 ? length - at : 7777), 0);
+    }
+    CHECK(!exists(path));
+    REQUIRE(downloadFinish(&download) == 0);
+    CHECK_INT(download.written, length);
+    CHECK(fileHolds(path, data, length));
+    CHECK(!exists(download.partPath));
+
+    //The buffers and the writer are kept for the next one
+    MemStats before;
+    memStats(MEM_NETWORK, &before);
+    REQUIRE(downloadStart(&download, dir, "gemini://host.example/other/song.ogg") == 0);
+    snprintf(path, sizeof path, "%s/song-1.ogg", dir);
+    CHECK_STR(download.path, path);
+    CHECK_INT(downloadWrite(&download, data, 100), 0);
+    REQUIRE(downloadFinish(&download) == 0);
+    CHECK(fileHolds(path, data, 100));
+    MemStats after;
+    memStats(MEM_NETWORK, &after);
+    CHECK_INT(after.allocations, before.allocations);
+
+    downloadFree(&download);
+    free(data);
+}
+
+//Names come from the last part of the path, made safe for the card
+static void names(void) {
+    static Download download;
+    char dir[64];
+    char path[128];
+    testTempDir(dir, sizeof dir);
+    downloadInit(&download);
+    const char* cases[][2] = {
+        { "gemini://host.example/", "download" },
+        { "gemini://host.example/a%20b:c.tar.gz", "a_20b_c.tar.gz" },
+        { "gemini://host.example/dir/..", "download" },
+        { "gemini://host.example/noext?query", "noext" },
+    };
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+        REQUIRE(downloadStart(&download, dir, cases[i][0]) == 0);
+        snprintf(path, sizeof path, "%s/%s", dir, cases[i][1]);
+        CHECK_STR(download.path, path);
+        downloadAbort(&download);
+    }
+    downloadFree(&download);
+}
+
+//Stopping part way leaves nothing behind, under either name
+static void abortPart(void) {
+    static Download download;
+    char dir[64];
+    testTempDir(dir, sizeof dir);
+    size_t length = DOWNLOAD_BUFFER_SIZE * 2 + 10;
+    char* data = malloc(length);
+    REQUIRE(data != NULL);
+    makeBinary(data, length, 2);
+    downloadInit(&download);
+    REQUIRE(downloadStart(&download, dir, "gemini://host.example/big.zip") == 0);
+    CHECK_INT(downloadWrite(&download, data, length), 0);
+    CHECK(exists(download.partPath));
+    downloadAbort(&download);
+    CHECK(!exists(download.partPath));
+    CHECK(!exists(download.path));
+    downloadFree(&download);
+    free(data);
+}
+
+typedef struct {
+    FakeNetwork net;
+    FetchNetwork network;
+    Fetcher fetcher;
+    char* response;
+    size_t length;
+} FileServer;
+
+//Serves a binary body of length bytes at gemini://files.example/blob.bin,
+//recordSize and delayMs as in FakeNetwork
+static int fileServerStart(FileServer* s, size_t length, size_t recordSize, int delayMs) {
+    const char* header = "20 application/octet-stream\r\n";
+    size_t headerLength = strlen(header);
+    s->length = headerLength + length;
+    s->response = malloc(s->length);
+    if (s->response == NULL) {
+        return -1;
+    }
+    memcpy(s->response, header, headerLength);
+    makeBinary(s->response + headerLength, length, 3);
+    fakeNetworkInit(&s->net);
+    fakeNetworkAdd(&s->net, "gemini://files.example/blob.bin", s->response, s->length);
+    s->net.recordSize = recordSize;
+    s->net.delayMs = delayMs;
+    networkInitFake(&s->network, &s->net);
+    return fetcherStart(&s->fetcher, &s->network, NULL, NULL);
+}
+
+static void fileServerStop(FileServer* s) {
+    fetcherStop(&s->fetcher);
+    free(s->response);
+}
+
+//A body that isn't gemtext goes to a file through the fetcher, never into
+//the job's body, and is turned away when there is nowhere to put it
+static void fetchFile(void) {
+    static FileServer s;
+    char dir[64];
+    char path[128];
+    testTempDir(dir, sizeof dir);
+    size_t length = 3 * 1024 * 1024 + 17;
+    REQUIRE(fileServerStart(&s, length, 0, 0) == 0);
+    const char* body = s.response + s.length - length;
+
+    FetchJob* job = fetchJobNew("gemini://files.example/blob.bin");
+    REQUIRE(job != NULL);
+    job->downloadDir = dir;
+    REQUIRE(fetcherSubmit(&s.fetcher, job) == 0);
+    CHECK(fakeWait(&s.fetcher) == job);
+    CHECK_INT(job->error, FETCH_OK);
+    snprintf(path, sizeof path, "%s/blob.bin", dir);
+    CHECK_STR(job->savedAs, path);
+    CHECK_INT(fetchJobBytes(job), length);
+    CHECK_INT(job->body.length, 0);
+    CHECK(fileHolds(path, body, length));
+    CHECK(job->doc.lineCount > 0);
+    fetchJobFree(job);
+
+    job = fakeFetch(&s.fetcher, "gemini://files.example/blob.bin");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_NOT_PAGE);
+    CHECK_STR(job->savedAs, "");
+    fetchJobFree(job);
+    fileServerStop(&s);
+}
+
+//A download cancelled on its way leaves no file, finished or part
+static void fetchCancel(void) {
+    static FileServer s;
+    char dir[64];
+    char path[128];
+    testTempDir(dir, sizeof dir);
+    REQUIRE(fileServerStart(&s, 2 * 1024 * 1024, 16 * 1024, 2) == 0);
+
+    FetchJob* job = fetchJobNew("gemini://files.example/blob.bin");
+    REQUIRE(job != NULL);
+    job->downloadDir = dir;
+    REQUIRE(fetcherSubmit(&s.fetcher, job) == 0);
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS && fetchJobBytes(job) < 3 * DOWNLOAD_BUFFER_SIZE; waited++) {
+        platformSleepMs(1);
+    }
+    CHECK_INT(fetchJobPhase(job), FETCH_SAVING);
+    fetchJobCancel(job);
+    CHECK(fakeWait(&s.fetcher) == job);
+    CHECK_INT(job->error, FETCH_CANCELLED);
+    CHECK_STR(job->savedAs, "");
+    snprintf(path, sizeof path, "%s/blob.bin", dir);
+    CHECK(!exists(path));
+    snprintf(path, sizeof path, "%s/blob.bin.part", dir);
+    CHECK(!exists(path));
+    fetchJobFree(job);
+    fileServerStop(&s);
+}
+
+const TestCase downloadTests[] = {
+    { "pieces", pieces },
+    { "names", names },
+    { "abort", abortPart },
+    { "fetch-file", fetchFile },
+    { "fetch-cancel", fetchCancel },
+    { NULL, NULL },
+};
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "fakenet.h"
+#include "feeds.h"
+#include "memstats.h"
+#include "platform.h"
+#include "test.h"
+
+static const char* gemlog =
+    "# Notes from the burrow\n"
+    "Some words about the log.\n"
+    "=> 2024-03-02-rabbits.gmi 2024-03-02 - On rabbits\n"
+    "=> /about.gmi About me\n"
+    "=> 2024-01-15.gmi 2024-01-15: Winter\n"
+    "=> gemini://elsewhere.example/post 2024-02-29 Leap day, elsewhere\n"
+    "=> 2024-13.gmi 2024-1-15 Not a date\n"
+    "=> 2023-12-31.gmi 2023-12-31\n";
+
+//Subscriptions are kept by canonical url, only gemini ones, once each
+static void subscribe(void) {
+    static FeedReader feeds;
+    feedsInit(&feeds);
+    CHECK_INT(feedsAdd(&feeds, "gemini://Burrow.example:1965/log/"), 0);
+    CHECK_STR(feeds.subs[0].url, "gemini://burrow.example/log/");
+    CHECK_STR(feeds.subs[0].host, "burrow.example");
+    CHECK_INT(feedsAdd(&feeds, "gemini://burrow.example/log/"), 0);
+    CHECK_INT(feedsAdd(&feeds, "gemini://[::1]:1966/feed.gmi"), 1);
+    CHECK_STR(feeds.subs[1].host, "::1");
+    CHECK_INT(feedsAdd(&feeds, "https://burrow.example/"), -1);
+    CHECK_INT(feedsAdd(&feeds, "not a url"), -1);
+    CHECK_INT(feedsFind(&feeds, "gemini://burrow.example/log/"), 0);
+    CHECK_INT(feedsFind(&feeds, "gemini://nowhere.example/"), -1);
+    CHECK(feeds.dirty);
+
+    char url[64];
+    for (int i = feeds.count; i < FEEDS_MAX; i++) {
+        snprintf(url, sizeof url, "gemini://host%d.example/", i);
+        CHECK_INT(feedsAdd(&feeds, url), i);
+    }
+    CHECK_INT(feedsAdd(&feeds, "gemini://one.too.many/"), -1);
+
+    feedsRemove(&feeds, 0);
+    CHECK_INT(feeds.count, FEEDS_MAX - 1);
+    CHECK_INT(feedsFind(&feeds, "gemini://burrow.example/log/"), -1);
+    CHECK_INT(feedsFind(&feeds, "gemini://[::1]:1966/feed.gmi"), 0);
+    feedsFree(&feeds);
+}
+
+//The list goes to a file a url a line and comes back the same
+static void saveLoad(void) {
+    static FeedReader feeds;
+    static FeedReader loaded;
+    char dir[64];
+    char path[96];
+    testTempDir(dir, sizeof dir);
+    snprintf(path, sizeof path, "%s/feeds.txt", dir);
+
+    feedsInit(&feeds);
+    CHECK_INT(feedsLoad(&feeds, path), 0);
+    CHECK_INT(feeds.count, 0);
+    feedsAdd(&feeds, "gemini://burrow.example/log/");
+    feedsAdd(&feeds, "gemini://warren.example/gemlog/");
+    REQUIRE(feedsSave(&feeds, path) == 0);
+    CHECK(!feeds.dirty);
+
+    feedsInit(&loaded);
+    REQUIRE(feedsLoad(&loaded, path) == 0);
+    REQUIRE(loaded.count == 2);
+    CHECK_STR(loaded.subs[0].url, "gemini://burrow.example/log/");
+    CHECK_STR(loaded.subs[1].url, "gemini://warren.example/gemlog/");
+    CHECK(!loaded.dirty);
+    feedsFree(&loaded);
+    feedsFree(&feeds);
+}
+
+//Only links captioned with a date are entries, relative ones are resolved
+//against where the feed came from and the separator after the date is dropped
+static void parse(void) {
+    static FeedReader feeds;
+    feedsInit(&feeds);
+    REQUIRE(feedsAdd(&feeds, "gemini://burrow.example/log/") == 0);
+    Subscription* sub = &feeds.subs[0];
+    Document doc;
+    parseGemtext(gemlog, &doc);
+    feedsParse(sub, &doc, "gemini://burrow.example/log/");
+    freeDocument(&doc);
+
+    CHECK_STR(sub->title, "Notes from the burrow");
+    REQUIRE(sub->entryCount == 4);
+    const char* strings = sub->strings.data;
+    CHECK_STR(sub->entries[0].date, "2024-03-02");
+    CHECK_STR(strings + sub->entries[0].url, "gemini://burrow.example/log/2024-03-02-rabbits.gmi");
+    CHECK_STR(strings + sub->entries[0].title, "On rabbits");
+    CHECK_STR(strings + sub->entries[1].title, "Winter");
+    CHECK_STR(strings + sub->entries[2].url, "gemini://elsewhere.example/post");
+    CHECK_STR(strings + sub->entries[2].title, "Leap day, elsewhere");
+    CHECK_STR(sub->entries[3].date, "2023-12-31");
+    CHECK_STR(strings + sub->entries[3].title, "");
+
+    //Parsing again replaces the entries
+    parseGemtext("=> one.gmi 2025-01-01 One\n", &doc);
+    feedsParse(sub, &doc, "gemini://burrow.example/log/");
+    freeDocument(&doc);
+    CHECK_INT(sub->entryCount, 1);
+    CHECK_STR(sub->title, "");
+    feedsFree(&feeds);
+}
+
+//The aggregate page lists every feed's entries newest first under a heading
+//per day, ties keep the order of the list, and the feeds follow with their state
+static void page(void) {
+    static FeedReader feeds;
+    feedsInit(&feeds);
+    Buffer out;
+    bufferInit(&out, MEM_OTHER);
+    feedsPage(&feeds, &out);
+    CHECK(strstr(out.data, "Nothing here yet") != NULL);
+
+    feedsAdd(&feeds, "gemini://burrow.example/log/");
+    feedsAdd(&feeds, "gemini://warren.example/");
+    Document doc;
+    parseGemtext(gemlog, &doc);
+    feedsParse(&feeds.subs[0], &doc, feeds.subs[0].url);
+    freeDocument(&doc);
+    parseGemtext("=> a.gmi 2024-03-02 Same day\n=> b.gmi 2024-03-05 Newest\n", &doc);
+    feedsParse(&feeds.subs[1], &doc, feeds.subs[1].url);
+    freeDocument(&doc);
+    feeds.subs[1].error = FETCH_CONNECT_FAILED;
+
+    feedsPage(&feeds, &out);
+    const char* expected =
+        "# Subscriptions\n"
+        "## 2024-03-05\n"
+        "=> gemini://warren.example/b.gmi warren.example: Newest\n"
+        "## 2024-03-02\n"
+        "=> gemini://burrow.example/log/2024-03-02-rabbits.gmi Notes from the burrow: On rabbits\n"
+        "=> gemini://warren.example/a.gmi warren.example: Same day\n"
+        "## 2024-02-29\n"
+        "=> gemini://elsewhere.example/post Notes from the burrow: Leap day, elsewhere\n"
+        "## 2024-01-15\n"
+        "=> gemini://burrow.example/log/2024-01-15.gmi Notes from the burrow: Winter\n"
+        "## 2023-12-31\n"
+        "=> gemini://burrow.example/log/2023-12-31.gmi Notes from the burrow: \n"
+        "## Following\n"
+        "=> gemini://burrow.example/log/ Notes from the burrow\n"
+        "=> gemini://warren.example/ warren.example (couldn't reach it)\n";
+    CHECK_VIEW(out.data, (int)out.length, expected);
+    bufferFree(&out);
+    feedsFree(&feeds);
+}
+
+static const char* feedResponse =
+    "20 text/gemini\r\n"
+    "# A log\n"
+    "=> 2024-03-02.gmi 2024-03-02 A post\n";
+
+//Subscribes to a feed on the fake network, served after delayMs a read
+static void addFeed(FeedReader* feeds, FakeNetwork* net, const char* url, int delayMs) {
+    fakeNetworkAddText(net, url, feedResponse);
+    net->responses[net->count - 1].delayMs = delayMs;
+    feedsAdd(feeds, url);
+}
+
+//Steps the reader a frame at a time like the app does until the refresh is
+//done, noting the most feeds of one host that were ever fetched at once
+static int refreshAll(FeedReader* feeds, int* mostPerHost) {
+    feedsRefresh(feeds, 1);
+    *mostPerHost = 0;
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS; waited++) {
+        feedsStep(feeds);
+        for (int i = 0; i < feeds->count; i++) {
+            int fetching = 0;
+            for (int j = 0; j < feeds->count; j++) {
+                fetching += feeds->subs[j].state == FEED_FETCHING && strcmp(feeds->subs[i].host, feeds->subs[j].host) == 0;
+            }
+            *mostPerHost = fetching > *mostPerHost ? fetching : *mostPerHost;
+        }
+        if (feeds->pending == 0) {
+            return 0;
+        }
+        platformSleepMs(1);
+    }
+    return -1;
+}
+
+//Every worker gets a network of its own and they all fetch at once, as many
+//as were asked for up to the limit
+static void workers(void) {
+    static FakeNetwork net;
+    static FeedReader feeds;
+    fakeNetworkInit(&net);
+    feedsInit(&feeds);
+    char url[64];
+    for (int i = 0; i < 4; i++) {
+        snprintf(url, sizeof url, "gemini://host%d.example/log/", i);
+        addFeed(&feeds, &net, url, 50);
+    }
+    NetworkFactory networks;
+    networkFactoryInitFake(&networks, &net);
+    REQUIRE(feedsStart(&feeds, 4, &networks, NULL) == 0);
+    CHECK_INT(feeds.workerCount, 4);
+    int mostPerHost;
+    REQUIRE(refreshAll(&feeds, &mostPerHost) == 0);
+    CHECK_INT(feeds.fetched, 4);
+    CHECK_INT(net.mostConnected, 4);
+    CHECK_INT(net.connected, 0);
+    CHECK_STR(feeds.subs[3].title, "A log");
+    feedsStop(&feeds);
+
+    //One worker takes them one after the other
+    net.mostConnected = 0;
+    REQUIRE(feedsStart(&feeds, 1, &networks, NULL) == 0);
+    REQUIRE(refreshAll(&feeds, &mostPerHost) == 0);
+    CHECK_INT(net.mostConnected, 1);
+    CHECK_INT(feeds.unchanged, 4);
+    feedsStop(&feeds);
+
+    REQUIRE(feedsStart(&feeds, 100, &networks, NULL) == 0);
+    CHECK_INT(feeds.workerCount, FEEDS_MAX_WORKERS);
+    feedsFree(&feeds);
+}
+
+//Feeds on the same host wait for each other with a gap between, however many
+//workers are idle, while another host's feed goes ahead
+static void politeness(void) {
+    static FakeNetwork net;
+    static FeedReader feeds;
+    fakeNetworkInit(&net);
+    feedsInit(&feeds);
+    addFeed(&feeds, &net, "gemini://burrow.example/a/", 20);
+    addFeed(&feeds, &net, "gemini://burrow.example/b/", 20);
+    addFeed(&feeds, &net, "gemini://burrow.example/c/", 20);
+    addFeed(&feeds, &net, "gemini://warren.example/", 20);
+    NetworkFactory networks;
+    networkFactoryInitFake(&networks, &net);
+    REQUIRE(feedsStart(&feeds, 4, &networks, NULL) == 0);
+    int mostPerHost;
+    REQUIRE(refreshAll(&feeds, &mostPerHost) == 0);
+    CHECK_INT(feeds.fetched, 4);
+    CHECK_INT(mostPerHost, 1);
+    CHECK_INT(net.mostConnected, 2);
+    CHECK(feeds.refreshUs >= 2 * FEEDS_HOST_GAP_MS * 1000ULL);
+    CHECK(feeds.subs[3].finishedUs < feeds.subs[1].finishedUs);
+    feedsFree(&feeds);
+}
+
+//A slow host holds up one worker, the fast ones are all done on the other
+//before it answers
+static void slowHost(void) {
+    static FakeNetwork net;
+    static FeedReader feeds;
+    fakeNetworkInit(&net);
+    feedsInit(&feeds);
+    addFeed(&feeds, &net, "gemini://slow.example/", 300);
+    char url[64];
+    for (int i = 0; i < 3; i++) {
+        snprintf(url, sizeof url, "gemini://fast%d.example/", i);
+        addFeed(&feeds, &net, url, 5);
+    }
+    NetworkFactory networks;
+    networkFactoryInitFake(&networks, &net);
+    REQUIRE(feedsStart(&feeds, 2, &networks, NULL) == 0);
+    int mostPerHost;
+    REQUIRE(refreshAll(&feeds, &mostPerHost) == 0);
+    CHECK_INT(feeds.fetched, 4);
+    CHECK_INT(net.mostConnected, 2);
+    for (int i = 1; i < 4; i++) {
+        CHECK(feeds.subs[i].finishedUs < feeds.subs[0].finishedUs);
+    }
+    feedsFree(&feeds);
+}
+
+const TestCase feedsTests[] = {
+    { "subscribe", subscribe },
+    { "save-load", saveLoad },
+    { "parse", parse },
+    { "page", page },
+    { "workers", workers },
+    { "politeness", politeness },
+    { "slow-host", slowHost },
+    { NULL, NULL },
+};
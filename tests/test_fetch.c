@@ -0,0 +1,201 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fakenet.h"
+#include "memstats.h"
+#include "pages.h"
+#include "platform.h"
+#include "spsc.h"
+#include "test.h"
+
+#define URL "gemini://slow.example/"
+
+//Pops come out in the order they were pushed, across the wrap, and a full ring refuses more
+static void spscRing(void) {
+    SpscQueue queue;
+    REQUIRE(spscInit(&queue, 4) == 0);
+    CHECK(spscPop(&queue) == NULL);
+    for (uintptr_t round = 0; round < 3; round++) {
+        for (uintptr_t i = 1; i <= 4; i++) {
+            CHECK_INT(spscPush(&queue, (void*)(round * 10 + i)), 0);
+        }
+        CHECK_INT(spscPush(&queue, (void*)99), -1);
+        for (uintptr_t i = 1; i <= 4; i++) {
+            CHECK_INT((uintptr_t)spscPop(&queue), round * 10 + i);
+        }
+        CHECK(spscPop(&queue) == NULL);
+    }
+    spscFree(&queue);
+}
+
+#define SPSC_ITEMS 200000
+
+static void produce(void* arg) {
+    SpscQueue* queue = arg;
+    for (uintptr_t i = 1; i <= SPSC_ITEMS; i++) {
+        while (spscPush(queue, (void*)i) != 0) {
+        }
+    }
+}
+
+//One thread pushing and one popping, nothing lost, doubled or reordered
+static void spscThreads(void) {
+    SpscQueue queue;
+    REQUIRE(spscInit(&queue, 16) == 0);
+    PlatformThread* thread = platformThreadStart(produce, &queue, 64 * 1024);
+    REQUIRE(thread != NULL);
+    uintptr_t expected = 1;
+    int inOrder = 1;
+    while (expected <= SPSC_ITEMS) {
+        void* item = spscPop(&queue);
+        if (item != NULL) {
+            inOrder &= (uintptr_t)item == expected;
+            expected++;
+        }
+    }
+    platformThreadJoin(thread);
+    CHECK(inOrder);
+    CHECK(spscPop(&queue) == NULL);
+    spscFree(&queue);
+}
+
+typedef struct {
+    FakeNetwork net;
+    FetchNetwork network;
+    Fetcher fetcher;
+    Buffer response;
+} SlowServer;
+
+//A 64 KB page served recordSize bytes at a time, delayMs before each
+static int slowStart(SlowServer* s, size_t recordSize, int delayMs) {
+    bufferInit(&s->response, MEM_OTHER);
+    bufferAppend(&s->response, "20 text/gemini\r\n", 16);
+    pageMake(&s->response, 64 * 1024, 6);
+    fakeNetworkInit(&s->net);
+    fakeNetworkAdd(&s->net, URL, s->response.data, s->response.length);
+    s->net.recordSize = recordSize;
+    s->net.delayMs = delayMs;
+    networkInitFake(&s->network, &s->net);
+    return fetcherStart(&s->fetcher, &s->network, NULL, NULL);
+}
+
+static void slowStop(SlowServer* s) {
+    fetcherStop(&s->fetcher);
+    bufferFree(&s->response);
+}
+
+//The UI sees the phase and byte count move forward while the page comes in
+static void progress(void) {
+    static SlowServer s;
+    REQUIRE(slowStart(&s, 1024, 1) == 0);
+    FetchJob* job = fetchJobNew(URL);
+    REQUIRE(job != NULL);
+    REQUIRE(fetcherSubmit(&s.fetcher, job) == 0);
+    int lastPhase = FETCH_QUEUED;
+    size_t lastBytes = 0;
+    int backwards = 0;
+    int sawReading = 0;
+    int polls = 0;
+    FetchJob* done = NULL;
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS && done == NULL; waited++) {
+        int phase = fetchJobPhase(job);
+        size_t bytes = fetchJobBytes(job);
+        backwards += phase < lastPhase || bytes < lastBytes;
+        sawReading |= phase == FETCH_READING && bytes > 0 && bytes < s.response.length - 16;
+        lastPhase = phase;
+        lastBytes = bytes;
+        polls++;
+        done = fetcherPoll(&s.fetcher);
+        if (done == NULL) {
+            platformSleepMs(1);
+        }
+    }
+    REQUIRE(done == job);
+    CHECK_INT(backwards, 0);
+    CHECK(sawReading);
+    //The UI kept running the whole time
+    CHECK(polls > 10);
+    CHECK_INT(fetchJobPhase(job), FETCH_DONE);
+    CHECK_INT(job->error, FETCH_OK);
+    CHECK_INT(fetchJobBytes(job), s.response.length - 16);
+    fetchJobFree(job);
+    slowStop(&s);
+}
+
+//Cancelling mid-page brings the job back at the next read, not once the page is in
+static void cancel(void) {
+    static SlowServer s;
+    //Whole, the page would take over 2 seconds
+    REQUIRE(slowStart(&s, 256, 10) == 0);
+    FetchJob* job = fetchJobNew(URL);
+    REQUIRE(job != NULL);
+    REQUIRE(fetcherSubmit(&s.fetcher, job) == 0);
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS && fetchJobBytes(job) == 0; waited++) {
+        platformSleepMs(1);
+    }
+    REQUIRE(fetchJobBytes(job) > 0);
+    uint64_t cancelled = platformTimeUs();
+    fetchJobCancel(job);
+    FetchJob* done = fakeWait(&s.fetcher);
+    uint64_t back = platformTimeUs();
+    REQUIRE(done == job);
+    CHECK_INT(job->error, FETCH_CANCELLED);
+    CHECK(fetchJobBytes(job) < s.response.length / 2);
+    CHECK(back - cancelled < 500 * 1000);
+    fetchJobFree(job);
+    slowStop(&s);
+}
+
+//A job cancelled while it waits behind another never reaches the network
+static void cancelQueued(void) {
+    static SlowServer s;
+    REQUIRE(slowStart(&s, 4096, 5) == 0);
+    FetchJob* first = fetchJobNew(URL);
+    FetchJob* second = fetchJobNew(URL "second");
+    REQUIRE(first != NULL && second != NULL);
+    REQUIRE(fetcherSubmit(&s.fetcher, first) == 0);
+    REQUIRE(fetcherSubmit(&s.fetcher, second) == 0);
+    fetchJobCancel(second);
+    CHECK(fakeWait(&s.fetcher) == first);
+    CHECK(fakeWait(&s.fetcher) == second);
+    CHECK_INT(first->error, FETCH_OK);
+    CHECK_INT(second->error, FETCH_CANCELLED);
+    CHECK_INT(s.net.opens, 1);
+    fetchJobFree(first);
+    fetchJobFree(second);
+    slowStop(&s);
+}
+
+//A full queue of requests all come back, in the order they went in
+static void queue(void) {
+    static SlowServer s;
+    REQUIRE(slowStart(&s, 0, 0) == 0);
+    FetchJob* jobs[FETCH_QUEUE_SIZE];
+    for (int i = 0; i < FETCH_QUEUE_SIZE; i++) {
+        jobs[i] = fetchJobNew(URL);
+        REQUIRE(jobs[i] != NULL);
+        REQUIRE(fetcherSubmit(&s.fetcher, jobs[i]) == 0);
+    }
+    for (int i = 0; i < FETCH_QUEUE_SIZE; i++) {
+        FetchJob* done = fakeWait(&s.fetcher);
+        CHECK(done == jobs[i]);
+        if (done != NULL) {
+            CHECK_INT(done->error, FETCH_OK);
+        }
+    }
+    for (int i = 0; i < FETCH_QUEUE_SIZE; i++) {
+        fetchJobFree(jobs[i]);
+    }
+    CHECK_INT(s.net.opens, FETCH_QUEUE_SIZE);
+    slowStop(&s);
+}
+
+const TestCase fetchTests[] = {
+    { "spsc-ring", spscRing },
+    { "spsc-threads", spscThreads },
+    { "progress", progress },
+    { "cancel", cancel },
+    { "cancel-queued", cancelQueued },
+    { "queue", queue },
+    { NULL, NULL },
+};
@@ -0,0 +1,344 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "gemtext.h"
+#include "memstats.h"
+#include "pages.h"
+#include "test.h"
+
+static const char* sample =
+    "# Title\n"
+    "\n"
+    "Plain text\r\n"
+    "   indented\n"
+    "## Second\n"
+    "###Third\n"
+    "####Fourth\n"
+    "=> gemini://example.org/ Example\n"
+    "=>/relative\n"
+    "=> /no-caption   ---\n"
+    "```alt text\n"
+    "  keep   this  \r\n"
+    "\n"
+    "# not a heading\n"
+    "```\n"
+    "* item\n"
+    "> quote";
+
+static void types(void) {
+    Document doc;
+    parseGemtext(sample, &doc);
+    REQUIRE(doc.lineCount == 14);
+    static const struct {
+        enum LineType type;
+        const char* text;
+    } expected[] = {
+        { LINE_H1, "Title" },
+        { LINE_PLAIN, "Plain text" },
+        { LINE_PLAIN, "indented" },
+        { LINE_H2, "Second" },
+        { LINE_H3, "Third" },
+        { LINE_H3, "#Fourth" },
+        { LINE_LINK, "gemini://example.org/ Example" },
+        { LINE_LINK, "/relative" },
+        { LINE_LINK, "/no-caption   ---" },
+        { LINE_PRE, "  keep   this  " },
+        { LINE_PRE, "" },
+        { LINE_PRE, "# not a heading" },
+        { LINE_PLAIN, "* item" },
+        { LINE_PLAIN, "> quote" },
+    };
+    for (int i = 0; i < doc.lineCount; i++) {
+        CHECK_INT(doc.lines[i].type, expected[i].type);
+        CHECK_VIEW(doc.lines[i].text, doc.lines[i].length, expected[i].text);
+    }
+    freeDocument(&doc);
+}
+
+static void links(void) {
+    Document doc;
+    parseGemtext(sample, &doc);
+    REQUIRE(doc.linkCount == 3);
+    CHECK_VIEW(doc.links[0].path, doc.links[0].pathLength, "gemini://example.org/");
+    CHECK_VIEW(doc.links[0].caption, doc.links[0].captionLength, "Example");
+    //Without a caption, or one with nothing readable in it, the url is shown
+    CHECK_VIEW(doc.links[1].caption, doc.links[1].captionLength, "/relative");
+    CHECK_VIEW(doc.links[2].caption, doc.links[2].captionLength, "/no-caption");
+    freeDocument(&doc);
+}
+
+static void empty(void) {
+    Document doc;
+    parseGemtext("", &doc);
+    CHECK_INT(doc.lineCount, 0);
+    CHECK_INT(doc.linkCount, 0);
+    freeDocument(&doc);
+    parseGemtext("\n\n\r\n", &doc);
+    CHECK_INT(doc.lineCount, 0);
+    freeDocument(&doc);
+}
+
+//However the body is split up on its way in, the page comes out the same
+static void chunked(void) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, 64 * 1024, 1);
+    Document whole;
+    parseGemtext(text.data, &whole);
+    static const size_t sizes[] = { 1, 2, 7, 100, 4093, 16384 };
+    for (size_t s = 0; s < sizeof sizes / sizeof sizes[0]; s++) {
+        Document doc;
+        beginDocument(&doc, 0);
+        for (size_t at = 0; at < text.length; at += sizes[s]) {
+            size_t length = text.length - at < sizes[s] ? text.length - at : sizes[s];
+            feedGemtext(&doc, text.data + at, length);
+        }
+        endDocument(&doc);
+        CHECK(pageSameDocument(&doc, &whole));
+        freeDocument(&doc);
+    }
+    CHECK(whole.lineCount > 500);
+    CHECK(whole.linkCount > 100);
+    freeDocument(&whole);
+    bufferFree(&text);
+}
+
+//The last line doesn't need a newline, and one cut by a chunk boundary is kept whole
+static void unterminated(void) {
+    Document doc;
+    beginDocument(&doc, 0);
+    feedGemtext(&doc, "=> /a lo", 8);
+    feedGemtext(&doc, "ng caption", 10);
+    endDocument(&doc);
+    REQUIRE(doc.lineCount == 1 && doc.linkCount == 1);
+    CHECK_VIEW(doc.links[0].caption, doc.links[0].captionLength, "long caption");
+    freeDocument(&doc);
+}
+
+//The strtok parser sockets.c had before gemtext.c, with the buttons it made
+//swapped for a list of links. The only other change is that a link's url
+//stops at the end of the line, the old loop ran on into the next one.
+typedef struct {
+    char* text;
+    enum LineType type;
+} OldLine;
+
+typedef struct {
+    char meta[1024];
+    char preview[1024];
+} OldLink;
+
+static OldLine* oldParseGemtext(const char* text, int* total, OldLink* links, int* linkCount) {
+    OldLine* lines = NULL;
+    const char* delimiter = "\n";
+    char* text_copy = strdup(text); //Make a copy of the input text
+
+    char *textline = strtok(text_copy, delimiter);
+    while (textline != NULL) {
+        int type = LINE_PLAIN;
+        //Replace unconventional whitespace with normal spaces
+        for (int i = 0; textline[i]; i++) {
+            if (isspace((unsigned char)textline[i]) && textline[i] != '\n') {
+                textline[i] = ' ';
+            }
+        }
+
+        const char* h1_token = "#";
+        const char* h2_token = "##";
+        const char* h3_token = "###";
+        const char* link_token = "=>";
+
+        //Remove preceding whitespace, I dont think this is necessary but hey
+        while (isspace(*textline)) {
+            textline++;
+        }
+
+        if (strncmp(textline, h3_token, strlen(h3_token)) == 0) {
+            type = LINE_H3;
+            textline += strlen(h3_token);
+        } else if (strncmp(textline, h2_token, strlen(h2_token)) == 0) {
+            type = LINE_H2;
+            textline += strlen(h2_token);
+        } else if (strncmp(textline, h1_token, strlen(h1_token)) == 0) {
+            type = LINE_H1;
+            textline += strlen(h1_token);
+        } else if (strncmp(textline, link_token, strlen(link_token)) == 0) {
+            type = LINE_LINK;
+            textline += strlen(link_token);
+            while (isspace(*textline)) {
+                textline++;
+            }
+            int i = 0;
+            char meta[1024];
+            memset(meta, 0, sizeof meta);
+            while ( !isspace(textline[i]) && textline[i] != '\n' && textline[i] != '\0' ) {
+                meta[i] = textline[i];
+                i++;
+            }
+            i++;
+            char preview[1024];
+            memset(preview, 0, sizeof preview);
+            bool hasCaption = false;
+            while ( i < strlen(textline) ) {
+                if(isalnum(textline[i])) {
+                    hasCaption = true;
+                }
+                preview[i - strlen(meta) - 1] = textline[i];
+                i++;
+            }
+            if(!hasCaption) {
+                memcpy(preview, meta, sizeof meta);
+            }
+            memcpy(links[*linkCount].meta, meta, sizeof meta);
+            memcpy(links[*linkCount].preview, preview, sizeof preview);
+            (*linkCount)++;
+        }
+
+        //Remove any spaces after declaration of special functions
+        while (isspace(*textline)) {
+            textline++;
+        }
+
+        lines = realloc(lines, (*total + 1) * sizeof(OldLine));
+        lines[*total].text = strdup(textline);
+        lines[*total].type = type;
+        (*total)++;
+
+        textline = strtok(NULL, delimiter);
+    }
+
+    free(text_copy);
+    return lines;
+}
+
+//The new text with the old parser's whitespace, which turned every kind into a space
+static int sameText(const char* text, int length, const char* old) {
+    if ((int)strlen(old) != length) {
+        return 0;
+    }
+    for (int i = 0; i < length; i++) {
+        char c = isspace((unsigned char)text[i]) ? ' ' : text[i];
+        if (c != old[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//Copies text with its CRLF line ends made LF, the old parser kept the CR
+static char* withoutCr(const char* text) {
+    char* copy = strdup(text);
+    char* out = copy;
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c != '\r' || c[1] != '\n') {
+            *out++ = *c;
+        }
+    }
+    *out = '\0';
+    return copy;
+}
+
+//1 if both parsers read text the same way. Besides the whitespace and the CRs,
+//the old one kept the spaces in front of a caption after the first.
+static int agreesWithOld(const char* text) {
+    static OldLink oldLinks[512];
+    int oldCount = 0;
+    int oldLinkCount = 0;
+    char* lf = withoutCr(text);
+    OldLine* old = oldParseGemtext(lf, &oldCount, oldLinks, &oldLinkCount);
+    free(lf);
+    Document doc;
+    parseGemtext(text, &doc);
+    int same = doc.lineCount == oldCount && doc.linkCount == oldLinkCount;
+    for (int i = 0; same && i < oldCount; i++) {
+        same = doc.lines[i].type == old[i].type && sameText(doc.lines[i].text, doc.lines[i].length, old[i].text);
+    }
+    for (int i = 0; same && i < oldLinkCount; i++) {
+        const char* caption = oldLinks[i].preview;
+        while (*caption == ' ') {
+            caption++;
+        }
+        same = sameText(doc.links[i].path, doc.links[i].pathLength, oldLinks[i].meta) &&
+            sameText(doc.links[i].caption, doc.links[i].captionLength, caption);
+    }
+    for (int i = 0; i < oldCount; i++) {
+        free(old[i].text);
+    }
+    free(old);
+    freeDocument(&doc);
+    return same;
+}
+
+//Copies text without its ``` blocks
+static void dropPreformatted(const char* text, Buffer* out) {
+    int preformatted = 0;
+    while (*text != '\0') {
+        const char* end = strchr(text, '\n');
+        end = end != NULL ? end + 1 : text + strlen(text);
+        if (strncmp(text, "```", 3) == 0) {
+            preformatted = !preformatted;
+        } else if (!preformatted) {
+            bufferAppend(out, text, end - text);
+        }
+        text = end;
+    }
+}
+
+//Outside of ``` blocks, which the old parser didn't know about, the new one
+//gives back what the old one did
+static void differential(void) {
+    CHECK(agreesWithOld(
+        "#Title\n"
+        "  ## \tSpaced\r\n"
+        "####Four\n"
+        "\n"
+        "   \n"
+        "\r\n"
+        "=>\n"
+        "=>/bare\n"
+        "=> /tabbed\tTab caption\n"
+        "=>   /spaced    Spaced   caption  \n"
+        "=> gemini://example.org/ ...\n"
+        "=> /a?b=c&d \xc3\xa9t\xc3\xa9\r\n"
+        "* item\n"
+        "> quote\x0b" "with a vertical tab\n"
+        "#\n"
+        "no newline at the end"));
+    Buffer text;
+    Buffer plain;
+    bufferInit(&text, MEM_OTHER);
+    bufferInit(&plain, MEM_OTHER);
+    for (unsigned int seed = 1; seed <= 8; seed++) {
+        bufferClear(&text);
+        bufferClear(&plain);
+        pageMake(&text, 48 * 1024, seed);
+        dropPreformatted(text.data, &plain);
+        CHECK(agreesWithOld(plain.data));
+    }
+    bufferFree(&text);
+    bufferFree(&plain);
+}
+
+//The arenas are charged while the page lives and given back all at once
+static void accounts(void) {
+    MemStats before;
+    MemStats during;
+    memStats(MEM_DOCUMENT, &before);
+    Document doc;
+    parseGemtext(sample, &doc);
+    memStats(MEM_DOCUMENT, &during);
+    CHECK(during.current > before.current);
+    freeDocument(&doc);
+}
+
+const TestCase gemtextTests[] = {
+    { "types", types },
+    { "links", links },
+    { "empty", empty },
+    { "chunked", chunked },
+    { "unterminated", unterminated },
+    { "differential", differential },
+    { "accounts", accounts },
+    { NULL, NULL },
+};
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "browser.h"
+#include "fakenet.h"
+#include "history.h"
+#include "memstats.h"
+#include "pagecache.h"
+#include "pages.h"
+#include "platform.h"
+#include "test.h"
+
+static void backForward(void) {
+    History history;
+    historyInit(&history);
+    CHECK(historyCurrent(&history) == NULL);
+    CHECK(historyBack(&history) == NULL);
+    historyVisit(&history, "gemini://a/");
+    historyVisit(&history, "gemini://b/");
+    historyVisit(&history, "gemini://c/");
+    CHECK_STR(historyBack(&history), "gemini://b/");
+    CHECK_STR(historyBack(&history), "gemini://a/");
+    CHECK(historyBack(&history) == NULL);
+    CHECK_STR(historyForward(&history), "gemini://b/");
+    CHECK_STR(historyForward(&history), "gemini://c/");
+    CHECK(historyForward(&history) == NULL);
+
+    //Somewhere new from the middle drops what was ahead
+    historyBack(&history);
+    historyVisit(&history, "gemini://d/");
+    CHECK(historyForward(&history) == NULL);
+    CHECK_STR(historyBack(&history), "gemini://b/");
+}
+
+//Reloading the current page keeps the forward history
+static void reload(void) {
+    History history;
+    historyInit(&history);
+    historyVisit(&history, "gemini://a/");
+    historyVisit(&history, "gemini://b/");
+    historyBack(&history);
+    historyVisit(&history, "gemini://a/");
+    CHECK_INT(history.count, 2);
+    CHECK_STR(historyCurrent(&history), "gemini://a/");
+    CHECK_STR(historyForward(&history), "gemini://b/");
+}
+
+//Past HISTORY_MAX the oldest entries go
+static void full(void) {
+    History history;
+    historyInit(&history);
+    char url[64];
+    for (int i = 0; i < HISTORY_MAX + 10; i++) {
+        snprintf(url, sizeof url, "gemini://host/%d", i);
+        historyVisit(&history, url);
+    }
+    CHECK_INT(history.count, HISTORY_MAX);
+    snprintf(url, sizeof url, "gemini://host/%d", HISTORY_MAX + 9);
+    CHECK_STR(historyCurrent(&history), url);
+    const char* oldest = NULL;
+    for (const char* back; (back = historyBack(&history)) != NULL;) {
+        oldest = back;
+    }
+    CHECK_STR(oldest, "gemini://host/10");
+}
+
+static void makePage(Document* doc, PageLayout* layout, size_t size, unsigned int seed) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, size, seed);
+    parseGemtext(text.data, doc);
+    bufferFree(&text);
+    resetLayout(layout);
+    layoutDocument(doc, layout);
+}
+
+//A page comes back as it went in, scroll and all, and only once
+static void cacheTake(void) {
+    PageCache cache;
+    pageCacheInit(&cache, 1024 * 1024, 0);
+    Document doc;
+    PageLayout layout;
+    makePage(&doc, &layout, 8 * 1024, 1);
+    Document copy;
+    PageLayout copyLayout;
+    makePage(&copy, &copyLayout, 8 * 1024, 1);
+
+    pageCachePut(&cache, "gemini://a/", &doc, &layout, 120, 0);
+    CHECK(pageCacheContains(&cache, "gemini://a/"));
+    int scroll = 0;
+    REQUIRE(pageCacheTake(&cache, "gemini://a/", &doc, &layout, &scroll) == 0);
+    CHECK_INT(scroll, 120);
+    CHECK(pageSameDocument(&doc, &copy));
+    CHECK_INT(layoutHeight(&layout), layoutHeight(&copyLayout));
+    CHECK(pageCacheTake(&cache, "gemini://a/", &doc, &layout, &scroll) != 0);
+    CHECK_INT(cache.hits, 1);
+    CHECK_INT(cache.misses, 1);
+    CHECK_INT(cache.bytes, 0);
+    freeDocument(&doc);
+    freeDocument(&copy);
+    pageCacheFree(&cache);
+}
+
+//Over the budget the least recently used pages go first
+static void cacheEviction(void) {
+    Document doc;
+    PageLayout layout;
+    makePage(&doc, &layout, 16 * 1024, 1);
+    size_t pageSize = doc.arena.reserved + doc.layoutArena.reserved + sizeof(CachedPage);
+    freeDocument(&doc);
+
+    PageCache cache;
+    pageCacheInit(&cache, pageSize * 3 + pageSize / 2, 0);
+    char url[64];
+    for (int i = 0; i < 5; i++) {
+        makePage(&doc, &layout, 16 * 1024, 1);
+        snprintf(url, sizeof url, "gemini://host/%d", i);
+        pageCachePut(&cache, url, &doc, &layout, 0, 0);
+        //Looking at the first page keeps it fresh
+        if (i == 2) {
+            int scroll;
+            REQUIRE(pageCacheTake(&cache, "gemini://host/0", &doc, &layout, &scroll) == 0);
+            pageCachePut(&cache, "gemini://host/0", &doc, &layout, scroll, 0);
+        }
+    }
+    CHECK_INT(cache.count, 3);
+    CHECK(cache.bytes <= cache.budget);
+    CHECK(pageCacheContains(&cache, "gemini://host/0"));
+    CHECK(!pageCacheContains(&cache, "gemini://host/1"));
+    CHECK(!pageCacheContains(&cache, "gemini://host/2"));
+    CHECK(pageCacheContains(&cache, "gemini://host/4"));
+    CHECK_INT(cache.evictions, 2);
+    pageCacheFree(&cache);
+}
+
+//A page bigger than the whole budget isn't kept, and doesn't flush the others
+static void cacheTooBig(void) {
+    PageCache cache;
+    pageCacheInit(&cache, 64 * 1024, 0);
+    Document doc;
+    PageLayout layout;
+    makePage(&doc, &layout, 4 * 1024, 1);
+    pageCachePut(&cache, "gemini://small/", &doc, &layout, 0, 0);
+    makePage(&doc, &layout, 256 * 1024, 2);
+    pageCachePut(&cache, "gemini://big/", &doc, &layout, 0, 0);
+    CHECK(!pageCacheContains(&cache, "gemini://big/"));
+    CHECK(pageCacheContains(&cache, "gemini://small/"));
+    pageCacheFree(&cache);
+}
+
+//With compression on the most recent pages stay parsed and the older ones are
+//packed, either way they come back the same
+static void cachePacked(void) {
+    PageCache cache;
+    pageCacheInit(&cache, 4 * 1024 * 1024, 1);
+    Document doc;
+    PageLayout layout;
+    char url[64];
+    int pages = PAGE_CACHE_PARSED + 3;
+    for (int i = 0; i < pages; i++) {
+        makePage(&doc, &layout, 16 * 1024, i);
+        snprintf(url, sizeof url, "gemini://host/%d", i);
+        pageCachePut(&cache, url, &doc, &layout, i, 0);
+    }
+    CHECK_INT(cache.count, pages);
+    size_t bytes = 0;
+    for (int i = 0; i < cache.count; i++) {
+        int seed = atoi(cache.pages[i].url + strlen("gemini://host/"));
+        CHECK_INT(cache.pages[i].packed != NULL, seed < 3);
+        bytes += cache.pages[i].bytes;
+    }
+    CHECK_INT(cache.bytes, bytes);
+
+    //Going back, each page put back in is the newest and the oldest parsed one is packed
+    for (int i = pages - 1; i >= 0; i--) {
+        snprintf(url, sizeof url, "gemini://host/%d", i);
+        int scroll;
+        REQUIRE(pageCacheTake(&cache, url, &doc, &layout, &scroll) == 0);
+        CHECK_INT(scroll, i);
+        Document expected;
+        PageLayout expectedLayout;
+        makePage(&expected, &expectedLayout, 16 * 1024, i);
+        CHECK(pageSameDocument(&doc, &expected));
+        CHECK_INT(layoutHeight(&layout), layoutHeight(&expectedLayout));
+        freeDocument(&expected);
+        freeDocument(&doc);
+    }
+    CHECK_INT(cache.hits, pages);
+    CHECK_INT(cache.bytes, 0);
+    pageCacheFree(&cache);
+}
+
+//Cached pages move over to MEM_CACHE and back out with the page
+static void cacheAccounts(void) {
+    PageCache cache;
+    pageCacheInit(&cache, 1024 * 1024, 0);
+    Document doc;
+    PageLayout layout;
+    makePage(&doc, &layout, 8 * 1024, 1);
+    MemStats document;
+    MemStats cached;
+    memStats(MEM_DOCUMENT, &document);
+    memStats(MEM_CACHE, &cached);
+    size_t documentBefore = document.current;
+    size_t cachedBefore = cached.current;
+    pageCachePut(&cache, "gemini://a/", &doc, &layout, 0, 0);
+    memStats(MEM_DOCUMENT, &document);
+    memStats(MEM_CACHE, &cached);
+    CHECK(document.current < documentBefore);
+    CHECK(cached.current > cachedBefore);
+    int scroll;
+    REQUIRE(pageCacheTake(&cache, "gemini://a/", &doc, &layout, &scroll) == 0);
+    memStats(MEM_DOCUMENT, &document);
+    CHECK_INT(document.current, documentBefore);
+    freeDocument(&doc);
+    pageCacheFree(&cache);
+}
+
+static void press(Browser* browser, uint32_t buttons) {
+    SessionInput input = { buttons, buttons, 0, 0 };
+    browserInput(browser, &input);
+    browserAct(browser);
+    SessionInput idle = { 0, 0, 0, 0 };
+    for (int i = 0; i < FAKE_FETCH_TIMEOUT_MS && browser->loading != NULL; i++) {
+        platformSleepMs(1);
+        browserInput(browser, &idle);
+    }
+}
+
+//Going back to a page that isn't cached and whose server doesn't answer
+//leaves the page on screen and the history where it was, so the next
+//step still goes where it should
+static void failedStep(void) {
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAddError(&net, "gemini://gone.example/", FETCH_CONNECT_FAILED);
+    fakeNetworkAddText(&net, "gemini://capsule.example/", "20 text/gemini\r\n# Capsule\n");
+    FetchNetwork network;
+    networkInitFake(&network, &net);
+    Fetcher fetcher;
+    REQUIRE(fetcherStart(&fetcher, &network, NULL, NULL) == 0);
+    static Browser browser;
+    Renderer renderer;
+    StubRenderer stub;
+    rendererInitStub(&renderer, &stub);
+    BrowserHooks hooks = { NULL, NULL, NULL };
+    browserInit(&browser, &renderer, &renderer, &fetcher, &hooks);
+
+    //Its error page is shown but never cached
+    browserNavigate(&browser, "gemini://gone.example/");
+    press(&browser, 0);
+    CHECK_STR(browser.key, "gemini://gone.example/");
+    browserNavigate(&browser, "gemini://capsule.example/");
+    press(&browser, 0);
+    CHECK_STR(browser.key, "gemini://capsule.example/");
+
+    press(&browser, BUTTON_L);
+    CHECK_STR(browser.key, "gemini://capsule.example/");
+    CHECK_STR(historyCurrent(&browser.history), "gemini://capsule.example/");
+    CHECK_STR(browser.statusMessage, "Failed to connect!");
+    CHECK_INT(net.opens, 3);
+    //Forward has nowhere to go, back tries the same page again
+    press(&browser, BUTTON_R);
+    CHECK_INT(net.opens, 3);
+    press(&browser, BUTTON_L);
+    CHECK_INT(net.opens, 4);
+    CHECK_STR(historyCurrent(&browser.history), "gemini://capsule.example/");
+    CHECK_INT(browser.history.count, 3);
+
+    browserStop(&browser);
+    fetcherStop(&fetcher);
+    browserFree(&browser);
+}
+
+const TestCase historyTests[] = {
+    { "back-forward", backForward },
+    { "reload", reload },
+    { "full", full },
+    { "cache-take", cacheTake },
+    { "cache-eviction", cacheEviction },
+    { "cache-too-big", cacheTooBig },
+    { "cache-packed", cachePacked },
+    { "cache-accounts", cacheAccounts },
+    { "failed-step", failedStep },
+    { NULL, NULL },
+};
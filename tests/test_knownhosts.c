@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "knownhosts.h"
+#include "test.h"
+
+static void fingerprint(uint8_t out[KNOWN_HOST_FINGERPRINT_SIZE], int seed) {
+    for (int i = 0; i < KNOWN_HOST_FINGERPRINT_SIZE; i++) {
+        out[i] = (uint8_t)(seed * 31 + i);
+    }
+}
+
+static void storePath(char* out, size_t size) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    snprintf(out, size, "%s/known_hosts.bin", dir);
+}
+
+static int exists(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file != NULL) {
+        fclose(file);
+    }
+    return file != NULL;
+}
+
+static void copyFile(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    char buf[4096];
+    size_t length;
+    while (in != NULL && out != NULL && (length = fread(buf, 1, sizeof buf, in)) > 0) {
+        fwrite(buf, 1, length, out);
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+}
+
+static void firstUse(void) {
+    char path[300];
+    storePath(path, sizeof path);
+    KnownHosts hosts;
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    uint8_t a[KNOWN_HOST_FINGERPRINT_SIZE];
+    uint8_t b[KNOWN_HOST_FINGERPRINT_SIZE];
+    fingerprint(a, 1);
+    fingerprint(b, 2);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", a, 0), KNOWN_HOST_NEW);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", a, 0), KNOWN_HOST_MATCH);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", b, 0), KNOWN_HOST_CHANGED);
+    //Still the first one until told otherwise
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", a, 0), KNOWN_HOST_MATCH);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", b, 1), KNOWN_HOST_REPLACED);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", b, 0), KNOWN_HOST_MATCH);
+    //Another port is another server
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1966", a, 0), KNOWN_HOST_NEW);
+    CHECK_INT(hosts.count, 2);
+    knownHostsClose(&hosts);
+
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    CHECK_INT(hosts.count, 2);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", b, 0), KNOWN_HOST_MATCH);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1966", b, 0), KNOWN_HOST_CHANGED);
+    knownHostsClose(&hosts);
+}
+
+//Thousands of hosts, the table grows on the way and every one is still found
+static void growing(void) {
+    char path[300];
+    char host[64];
+    storePath(path, sizeof path);
+    KnownHosts hosts;
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    uint8_t print[KNOWN_HOST_FINGERPRINT_SIZE];
+    for (int i = 0; i < 3000; i++) {
+        snprintf(host, sizeof host, "host%d.example", i);
+        fingerprint(print, i);
+        CHECK_INT(knownHostsCheck(&hosts, host, "1965", print, 0), KNOWN_HOST_NEW);
+    }
+    CHECK(hosts.capacity >= 4096);
+    knownHostsClose(&hosts);
+
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    CHECK_INT(hosts.count, 3000);
+    int matched = 0;
+    for (int i = 0; i < 3000; i++) {
+        snprintf(host, sizeof host, "host%d.example", i);
+        fingerprint(print, i);
+        matched += knownHostsCheck(&hosts, host, "1965", print, 0) == KNOWN_HOST_MATCH;
+    }
+    CHECK_INT(matched, 3000);
+    //Lookups read a slot run, not the table
+    CHECK(hosts.slotReads < hosts.lookups * 2);
+    knownHostsClose(&hosts);
+}
+
+//A grow cut short between removing the old table and renaming the new one
+//leaves only path.new, or a damaged path next to it
+static void interruptedGrow(void) {
+    char path[300];
+    char spare[310];
+    storePath(path, sizeof path);
+    snprintf(spare, sizeof spare, "%s.new", path);
+    KnownHosts hosts;
+    uint8_t print[KNOWN_HOST_FINGERPRINT_SIZE];
+    fingerprint(print, 7);
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    knownHostsCheck(&hosts, "example.org", "1965", print, 0);
+    knownHostsClose(&hosts);
+
+    CHECK_INT(rename(path, spare), 0);
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", print, 0), KNOWN_HOST_MATCH);
+    knownHostsClose(&hosts);
+    CHECK(!exists(spare));
+
+    copyFile(path, spare);
+    FILE* file = fopen(path, "wb");
+    REQUIRE(file != NULL);
+    fputs("half a header", file);
+    fclose(file);
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", print, 0), KNOWN_HOST_MATCH);
+    knownHostsClose(&hosts);
+
+    //With a good table at path a leftover path.new is an unfinished grow, dropped
+    copyFile(path, spare);
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    knownHostsClose(&hosts);
+    CHECK(!exists(spare));
+}
+
+//Anything that isn't a whole table starts an empty store
+static void damaged(void) {
+    char path[300];
+    storePath(path, sizeof path);
+    FILE* file = fopen(path, "wb");
+    REQUIRE(file != NULL);
+    fputs("not a table at all", file);
+    fclose(file);
+    KnownHosts hosts;
+    REQUIRE(knownHostsOpen(&hosts, path) == 0);
+    CHECK_INT(hosts.count, 0);
+    uint8_t print[KNOWN_HOST_FINGERPRINT_SIZE];
+    fingerprint(print, 3);
+    CHECK_INT(knownHostsCheck(&hosts, "example.org", "1965", print, 0), KNOWN_HOST_NEW);
+    knownHostsClose(&hosts);
+}
+
+const TestCase knownHostsTests[] = {
+    { "first-use", firstUse },
+    { "growing", growing },
+    { "interrupted-grow", interruptedGrow },
+    { "damaged", damaged },
+    { NULL, NULL },
+};
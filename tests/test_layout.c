@@ -0,0 +1,294 @@
+#include <ctype.h>
+#include <string.h>
+
+#include "layout.h"
+#include "memstats.h"
+#include "pages.h"
+#include "test.h"
+
+#define WIDTH 388
+
+//Without a glyph table every character is 12px at scale 1
+static int textWidth(enum LineType type, int length) {
+    return length * 12 * GLYPH_UNIT * lineStyle(type)->scale / GLYPH_UNIT;
+}
+
+static void parse(Document* doc, size_t size, unsigned int seed) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, size, seed);
+    parseGemtext(text.data, doc);
+    bufferFree(&text);
+}
+
+//Rows cover each line's text in order, fit the width and only break at spaces
+//unless a word is wider than a whole row
+static void wrapping(void) {
+    layoutSetFont(NULL, WIDTH);
+    Document doc;
+    parse(&doc, 32 * 1024, 3);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    REQUIRE(layout.lineCount == doc.lineCount);
+    for (int i = 0; i < doc.lineCount; i++) {
+        const Line* line = &doc.lines[i];
+        int first = layout.firstRows[i];
+        int end = layout.firstRows[i + 1];
+        REQUIRE(end > first);
+        int at = 0;
+        for (int r = first; r < end; r++) {
+            const LayoutRow* row = &layout.rows[r];
+            CHECK(row->start >= at);
+            for (int c = at; c < row->start; c++) {
+                CHECK(isspace((unsigned char)line->text[c]));
+            }
+            if (line->type != LINE_PRE) {
+                CHECK(textWidth(line->type, row->length) <= WIDTH);
+            }
+            at = row->start + row->length;
+        }
+        CHECK(at <= line->length);
+    }
+    CHECK(layout.preWidth > 0);
+    freeDocument(&doc);
+}
+
+static void offsets(void) {
+    layoutSetFont(NULL, WIDTH);
+    Document doc;
+    parseGemtext("# Title\nshort\n=> /link\n```\npre\n```\n", &doc);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    REQUIRE(layout.lineCount == 4);
+    int top = 0;
+    for (int i = 0; i < 4; i++) {
+        enum LineType type = doc.lines[i].type;
+        CHECK_INT(layout.offsets[i], top);
+        top += lineStyle(type)->top + rowHeight(type) + lineStyle(type)->bottom;
+    }
+    CHECK_INT(layoutHeight(&layout), top);
+    freeDocument(&doc);
+
+    resetLayout(&layout);
+    CHECK_INT(layoutHeight(&layout), 0);
+}
+
+//Laying out a page as it streams in ends up where laying it out whole does
+static void incremental(void) {
+    layoutSetFont(NULL, WIDTH);
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, 48 * 1024, 5);
+    Document whole;
+    parseGemtext(text.data, &whole);
+    PageLayout wholeLayout;
+    resetLayout(&wholeLayout);
+    layoutDocument(&whole, &wholeLayout);
+
+    Document doc;
+    PageLayout layout;
+    beginDocument(&doc, 0);
+    resetLayout(&layout);
+    for (size_t at = 0; at < text.length; at += 1000) {
+        size_t length = text.length - at < 1000 ? text.length - at : 1000;
+        feedGemtext(&doc, text.data + at, length);
+        layoutDocument(&doc, &layout);
+    }
+    endDocument(&doc);
+    layoutDocument(&doc, &layout);
+
+    REQUIRE(layout.lineCount == wholeLayout.lineCount);
+    CHECK_INT(layout.rowCount, wholeLayout.rowCount);
+    CHECK_INT(layoutHeight(&layout), layoutHeight(&wholeLayout));
+    CHECK_INT(layout.preWidth, wholeLayout.preWidth);
+    for (int i = 0; i <= layout.lineCount; i++) {
+        CHECK_INT(layout.offsets[i], wholeLayout.offsets[i]);
+    }
+    freeDocument(&doc);
+    freeDocument(&whole);
+    bufferFree(&text);
+}
+
+//The binary search agrees with walking every line
+static void visible(void) {
+    layoutSetFont(NULL, WIDTH);
+    Document doc;
+    parse(&doc, 16 * 1024, 9);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    int height = layoutHeight(&layout);
+    for (int top = -50; top < height + 50; top += 37) {
+        int bottom = top + 240;
+        int first = 0;
+        while (first < layout.lineCount && layout.offsets[first + 1] <= top) {
+            first++;
+        }
+        int last = first;
+        while (last < layout.lineCount && layout.offsets[last] < bottom) {
+            last++;
+        }
+        int end;
+        CHECK_INT(layoutVisibleLines(&layout, top, bottom, &end), first);
+        CHECK_INT(end, last);
+    }
+    freeDocument(&doc);
+}
+
+//A word wider than the screen is cut rather than running off it
+static void longWord(void) {
+    layoutSetFont(NULL, WIDTH);
+    Document doc;
+    parseGemtext("aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", &doc);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    REQUIRE(layout.lineCount == 1);
+    CHECK(layout.rowCount >= 3);
+    int total = 0;
+    for (int r = 0; r < layout.rowCount; r++) {
+        CHECK(textWidth(LINE_PLAIN, layout.rows[r].length) <= WIDTH);
+        total += layout.rows[r].length;
+    }
+    CHECK_INT(total, doc.lines[0].length);
+    freeDocument(&doc);
+}
+
+//Layout lives in its own arena so it can be charged apart from the text
+static void accounts(void) {
+    layoutSetFont(NULL, WIDTH);
+    Document doc;
+    parse(&doc, 8 * 1024, 2);
+    MemStats before;
+    MemStats after;
+    memStats(MEM_LAYOUT, &before);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    memStats(MEM_LAYOUT, &after);
+    CHECK(after.current > before.current);
+    freeDocument(&doc);
+}
+
+//Characters are decoded from UTF-8 and looked up, anything undecodable or
+//outside the table gets the fallback
+static void glyphs(void) {
+    GlyphTable table;
+    REQUIRE(glyphTableInit(&table, 10, 25) == 0);
+    glyphTableSet(&table, 'a', 7.5);
+    glyphTableSet(&table, 0xE9, 9);
+    glyphTableSet(&table, 0x2014, 16);
+    glyphTableSet(&table, 0x1F600, 1);
+    int size;
+    CHECK_INT(glyphAdvance(&table, "b", 1, &size), 10 * GLYPH_UNIT);
+    CHECK_INT(size, 1);
+    CHECK_INT(glyphAdvance(&table, "a", 1, &size), 480);
+    CHECK_INT(glyphAdvance(&table, "\xC3\xA9", 2, &size), 9 * GLYPH_UNIT);
+    CHECK_INT(size, 2);
+    CHECK_INT(glyphAdvance(&table, "\xE2\x80\x94", 3, &size), 16 * GLYPH_UNIT);
+    CHECK_INT(size, 3);
+    CHECK_INT(glyphAdvance(&table, "\xF0\x9F\x98\x80", 4, &size), table.fallback);
+    CHECK_INT(size, 4);
+    //Cut short, a stray continuation byte and a sequence broken off by ASCII
+    CHECK_INT(glyphAdvance(&table, "\xC3", 1, &size), table.fallback);
+    CHECK_INT(size, 1);
+    CHECK_INT(glyphAdvance(&table, "\x80", 1, &size), table.fallback);
+    CHECK_INT(size, 1);
+    CHECK_INT(glyphAdvance(&table, "\xE2\x41\x41", 3, &size), table.fallback);
+    CHECK_INT(size, 1);
+    CHECK(glyphMeasure(&table, "a\xC3\xA9", 3, .5) == 8.25f);
+    CHECK(glyphMeasure(&table, "", 0, 1) == 0);
+    glyphTableFree(&table);
+}
+
+static int units(const GlyphTable* table, const char* text, int length) {
+    int width = 0;
+    int size;
+    for (int i = 0; i < length; i += size) {
+        width += glyphAdvance(table, text + i, length - i, &size);
+    }
+    return width;
+}
+
+//With a proportional font every row fits, is greedy (the next row's first
+//word wouldn't have fit on it) and never splits a character
+static void proportional(void) {
+    GlyphTable table;
+    REQUIRE(glyphTableInit(&table, 8, 25) == 0);
+    for (int c = 'A'; c <= 'Z'; c++) {
+        glyphTableSet(&table, c, 11);
+    }
+    const char* narrow = " il.,'";
+    for (const char* c = narrow; *c != '\0'; c++) {
+        glyphTableSet(&table, *c, 3);
+    }
+    glyphTableSet(&table, 'm', 15);
+    glyphTableSet(&table, 'w', 15);
+    glyphTableSet(&table, 0xE9, 8);
+    glyphTableSet(&table, 0x2014, 16);
+    layoutSetFont(&table, WIDTH);
+    CHECK_INT(rowHeight(LINE_H1), 25);
+    CHECK_INT(rowHeight(LINE_PRE), 13);
+
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    const char* accents = "Caf\xC3\xA9 \xE2\x80\x94 na\xC3\xAFve r\xC3\xA9sum\xC3\xA9 \xF0\x9F\x98\x80 ";
+    for (int i = 0; i < 40; i++) {
+        bufferAppend(&text, accents, strlen(accents));
+    }
+    bufferAppend(&text, "\n", 1);
+    pageMake(&text, 32 * 1024, 7);
+    Document doc;
+    parseGemtext(text.data, &doc);
+    bufferFree(&text);
+    PageLayout layout;
+    resetLayout(&layout);
+    layoutDocument(&doc, &layout);
+    REQUIRE(layout.lineCount == doc.lineCount);
+
+    int wide = 0;
+    int loose = 0;
+    int split = 0;
+    for (int i = 0; i < doc.lineCount; i++) {
+        const Line* line = &doc.lines[i];
+        if (line->type == LINE_PRE) {
+            continue;
+        }
+        int limit = WIDTH * GLYPH_UNIT / lineStyle(line->type)->scale;
+        for (int r = layout.firstRows[i]; r < layout.firstRows[i + 1]; r++) {
+            const LayoutRow* row = &layout.rows[r];
+            int end = row->start + row->length;
+            wide += units(&table, line->text + row->start, row->length) > limit;
+            split += (line->text[row->start] & 0xC0) == 0x80 || (end < line->length && (line->text[end] & 0xC0) == 0x80);
+            if (r + 1 < layout.firstRows[i + 1]) {
+                const LayoutRow* next = &layout.rows[r + 1];
+                int wordEnd = next->start;
+                do {
+                    wordEnd++;
+                } while (wordEnd < next->start + next->length && !isspace((unsigned char)line->text[wordEnd]));
+                loose += units(&table, line->text + row->start, wordEnd - row->start) <= limit;
+            }
+        }
+    }
+    CHECK_INT(wide, 0);
+    CHECK_INT(loose, 0);
+    CHECK_INT(split, 0);
+    CHECK(layout.rowCount > layout.lineCount);
+    freeDocument(&doc);
+    layoutSetFont(NULL, WIDTH);
+    glyphTableFree(&table);
+}
+
+const TestCase layoutTests[] = {
+    { "wrapping", wrapping },
+    { "offsets", offsets },
+    { "incremental", incremental },
+    { "visible", visible },
+    { "long-word", longWord },
+    { "accounts", accounts },
+    { "glyphs", glyphs },
+    { "proportional", proportional },
+    { NULL, NULL },
+};
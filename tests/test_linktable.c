@@ -0,0 +1,131 @@
+#include <stdio.h>
+
+#include "linktable.h"
+#include "memstats.h"
+#include "pages.h"
+#include "test.h"
+
+#define LINKS 5000
+#define ROW 20
+
+//The slot under y found the slow way
+static int linearHit(const LinkTable* table, int y) {
+    for (int i = 0; i < table->count; i++) {
+        if (table->slots[i].y <= y && y < table->slots[i].y + table->slots[i].height) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//Every y on a long directory page, and past either end, finds the slot the
+//linear scan does
+static void hit(void) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMakeLinks(&text, LINKS, 1);
+    Document doc;
+    parseGemtext(text.data, &doc);
+    bufferFree(&text);
+    REQUIRE(doc.linkCount == LINKS);
+
+    LinkTable table;
+    linkTableInit(&table);
+    REQUIRE(linkTableBuild(&table, &doc, ROW) == 0);
+    CHECK_INT(table.count, LINKS);
+    CHECK_INT(table.height, LINKS * ROW);
+    int wrong = 0;
+    for (int y = -ROW; y < table.height + ROW; y++) {
+        wrong += linkTableHit(&table, y) != linearHit(&table, y);
+    }
+    CHECK_INT(wrong, 0);
+    CHECK_INT(table.slots[linkTableHit(&table, 0)].link, 0);
+    CHECK_INT(table.slots[linkTableHit(&table, table.height - 1)].link, LINKS - 1);
+    linkTableFree(&table);
+    freeDocument(&doc);
+}
+
+//The slots in a window are the ones that overlap it, no more
+static void visible(void) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMakeLinks(&text, LINKS, 2);
+    Document doc;
+    parseGemtext(text.data, &doc);
+    bufferFree(&text);
+    LinkTable table;
+    linkTableInit(&table);
+    REQUIRE(linkTableBuild(&table, &doc, ROW) == 0);
+
+    int wrong = 0;
+    for (int top = -240; top < table.height + 240; top += 7) {
+        int end;
+        int first = linkTableVisible(&table, top, top + 240, &end);
+        int expectedFirst = table.count;
+        int expectedEnd = table.count;
+        for (int i = table.count - 1; i >= 0; i--) {
+            const LinkSlot* slot = &table.slots[i];
+            if (slot->y + slot->height > top) {
+                expectedFirst = i;
+            }
+            if (slot->y >= top + 240) {
+                expectedEnd = i;
+            }
+        }
+        if (expectedEnd < expectedFirst) {
+            expectedEnd = expectedFirst;
+        }
+        wrong += first != expectedFirst || end != expectedEnd;
+    }
+    CHECK_INT(wrong, 0);
+    linkTableFree(&table);
+    freeDocument(&doc);
+}
+
+//Building for a page with fewer links reuses the slots, a page with none is empty
+static void rebuild(void) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMakeLinks(&text, 300, 3);
+    Document big;
+    parseGemtext(text.data, &big);
+    bufferFree(&text);
+    bufferInit(&text, MEM_OTHER);
+    pageMakeLinks(&text, 10, 4);
+    Document small;
+    parseGemtext(text.data, &small);
+    bufferFree(&text);
+    Document none;
+    parseGemtext("# Nothing to follow\n", &none);
+
+    LinkTable table;
+    linkTableInit(&table);
+    REQUIRE(linkTableBuild(&table, &big, ROW) == 0);
+    MemStats before;
+    memStats(MEM_UI, &before);
+    REQUIRE(linkTableBuild(&table, &small, ROW) == 0);
+    CHECK_INT(table.count, 10);
+    CHECK_INT(table.height, 10 * ROW);
+    REQUIRE(linkTableBuild(&table, &none, ROW) == 0);
+    CHECK_INT(table.count, 0);
+    CHECK_INT(table.height, 0);
+    CHECK_INT(linkTableHit(&table, 0), -1);
+    int end;
+    CHECK_INT(linkTableVisible(&table, 0, 240, &end), 0);
+    CHECK_INT(end, 0);
+    MemStats after;
+    memStats(MEM_UI, &after);
+    CHECK_INT(after.allocations, before.allocations);
+
+    linkTableFree(&table);
+    freeDocument(&big);
+    freeDocument(&small);
+    freeDocument(&none);
+}
+
+const TestCase linkTableTests[] = {
+    { "hit", hit },
+    { "visible", visible },
+    { "rebuild", rebuild },
+    { NULL, NULL },
+};
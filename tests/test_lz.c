@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "diskcache.h"
+#include "fakenet.h"
+#include "lz.h"
+#include "memstats.h"
+#include "pagecache.h"
+#include "pages.h"
+#include "test.h"
+
+static void collect(void* user, const char* data, size_t len) {
+    bufferAppend(user, data, len);
+}
+
+//1 if data comes back out of the codec exactly as it went in
+static int roundTrips(const char* data, size_t length) {
+    Buffer packed;
+    Buffer unpacked;
+    bufferInit(&packed, MEM_OTHER);
+    bufferInit(&unpacked, MEM_OTHER);
+    int same = lzCompress(data, length, &packed) == 0 && packed.length <= lzBound(length) &&
+        lzDecode(packed.data, packed.length, collect, &unpacked) == 0 && unpacked.length == length &&
+        (length == 0 || memcmp(unpacked.data, data, length) == 0);
+    bufferFree(&packed);
+    bufferFree(&unpacked);
+    return same;
+}
+
+static void roundTrip(void) {
+    CHECK(roundTrips("", 0));
+    CHECK(roundTrips("a", 1));
+    CHECK(roundTrips("# Title\n", 8));
+
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    //Runs long enough for the length bytes after a 15, and past 255 of them
+    for (size_t length = 14; length < 70000; length = length * 3 + 1) {
+        bufferClear(&text);
+        for (size_t i = 0; i < length; i++) {
+            bufferAppend(&text, "x", 1);
+        }
+        CHECK(roundTrips(text.data, text.length));
+    }
+
+    //Bigger than the window, matches have to come from what was slid back
+    bufferClear(&text);
+    pageMake(&text, 300 * 1024, 1);
+    CHECK(roundTrips(text.data, text.length));
+    Buffer packed;
+    bufferInit(&packed, MEM_OTHER);
+    REQUIRE(lzCompress(text.data, text.length, &packed) == 0);
+    CHECK(packed.length < text.length * 2 / 3);
+    bufferFree(&packed);
+
+    //Nothing to find, it mustn't grow past the bound
+    bufferClear(&text);
+    srand(1);
+    for (int i = 0; i < 100000; i++) {
+        char byte = rand();
+        bufferAppend(&text, &byte, 1);
+    }
+    CHECK(roundTrips(text.data, text.length));
+    bufferFree(&text);
+}
+
+//Damaged data either decodes to something or is refused, it never reads or
+//writes outside what it was given
+static void corruption(void) {
+    Buffer text;
+    Buffer packed;
+    Buffer damaged;
+    Buffer unpacked;
+    bufferInit(&text, MEM_OTHER);
+    bufferInit(&packed, MEM_OTHER);
+    bufferInit(&damaged, MEM_OTHER);
+    bufferInit(&unpacked, MEM_OTHER);
+    pageMake(&text, 96 * 1024, 2);
+    REQUIRE(lzCompress(text.data, text.length, &packed) == 0);
+
+    srand(2);
+    int refused = 0;
+    for (int round = 0; round < 2000; round++) {
+        bufferClear(&damaged);
+        bufferAppend(&damaged, packed.data, packed.length);
+        if (round % 4 == 0) {
+            damaged.length = rand() % packed.length;
+        } else {
+            for (int flips = 1 + rand() % 3; flips > 0; flips--) {
+                damaged.data[rand() % damaged.length] ^= 1 << (rand() % 8);
+            }
+        }
+        bufferClear(&unpacked);
+        refused += lzDecode(damaged.data, damaged.length, collect, &unpacked) != 0;
+    }
+    //Most cuts land inside a sequence
+    CHECK(refused > 250);
+
+    //An offset back past the start of the text
+    CHECK(lzDecode("\x10" "a" "\x05\x00", 4, collect, &unpacked) != 0);
+    CHECK(lzDecode("\x10" "a" "\x00\x00", 4, collect, &unpacked) != 0);
+    //A length that runs off the end
+    CHECK(lzDecode("\xff\xff\xff", 3, collect, &unpacked) != 0);
+    bufferFree(&text);
+    bufferFree(&packed);
+    bufferFree(&damaged);
+    bufferFree(&unpacked);
+}
+
+static void makePage(Document* doc, PageLayout* layout, unsigned int seed) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, 32 * 1024, seed);
+    parseGemtext(text.data, doc);
+    bufferFree(&text);
+    resetLayout(layout);
+    layoutDocument(doc, layout);
+}
+
+//A packed page that won't unpack is dropped and counted as a miss, the caller fetches it again
+static void damagedPage(void) {
+    PageCache cache;
+    pageCacheInit(&cache, 4 * 1024 * 1024, 1);
+    Document doc;
+    PageLayout layout;
+    char url[64];
+    //The two oldest get packed
+    for (int i = 0; i < PAGE_CACHE_PARSED + 2; i++) {
+        makePage(&doc, &layout, i);
+        snprintf(url, sizeof url, "gemini://host/%d", i);
+        pageCachePut(&cache, url, &doc, &layout, 0, 0);
+    }
+    CachedPage* first = NULL;
+    CachedPage* second = NULL;
+    for (int i = 0; i < cache.count; i++) {
+        if (strcmp(cache.pages[i].url, "gemini://host/0") == 0) {
+            first = &cache.pages[i];
+        } else if (strcmp(cache.pages[i].url, "gemini://host/1") == 0) {
+            second = &cache.pages[i];
+        }
+    }
+    REQUIRE(first != NULL && first->packed != NULL && second != NULL && second->packed != NULL);
+
+    memset(first->packed + first->packedLength / 2, 0xff, first->packedLength - first->packedLength / 2);
+    //Text that decodes fine but not to what was packed
+    second->textLength++;
+    int scroll;
+    CHECK(pageCacheTake(&cache, "gemini://host/0", &doc, &layout, &scroll) != 0);
+    CHECK(!pageCacheContains(&cache, "gemini://host/0"));
+    CHECK(pageCacheTake(&cache, "gemini://host/1", &doc, &layout, &scroll) != 0);
+    CHECK(!pageCacheContains(&cache, "gemini://host/1"));
+    CHECK_INT(cache.count, PAGE_CACHE_PARSED);
+    CHECK_INT(cache.hits, 0);
+    CHECK_INT(cache.misses, 2);
+    pageCacheFree(&cache);
+}
+
+//Damages the packed body of url's record in data.bin and signs it again, so
+//only unpacking it can tell
+static int damageRecord(const char* dir, const char* url) {
+    char path[300];
+    snprintf(path, sizeof path, "%s/data.bin", dir);
+    FILE* file = fopen(path, "r+b");
+    if (file == NULL) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    char* data = malloc(length);
+    rewind(file);
+    int ret = -1;
+    char* found;
+    if (data != NULL && fread(data, length, 1, file) == 1 && (found = memmem(data, length, url, strlen(url) + 1)) != NULL) {
+        char* record = found - sizeof(DiskRecordHeader);
+        DiskRecordHeader* header = (DiskRecordHeader*)record;
+        char* body = found + header->urlLength + header->metaLength;
+        memset(body + header->bodyLength / 2, 0xff, header->bodyLength - header->bodyLength / 2);
+        size_t offsetOfTime = offsetof(DiskRecordHeader, time);
+        size_t total = sizeof *header + header->urlLength + header->metaLength + header->bodyLength;
+        uint32_t sum = 2166136261u;
+        for (size_t i = offsetOfTime; i < total; i++) {
+            sum = (sum ^ (unsigned char)record[i]) * 16777619u;
+        }
+        header->checksum = sum;
+        fseek(file, record - data, SEEK_SET);
+        ret = fwrite(record, total, 1, file) == 1 && header->unpackedLength != 0 ? 0 : -1;
+    }
+    free(data);
+    fclose(file);
+    return ret;
+}
+
+//A page on the card that won't unpack is fetched from the server instead, and
+//the good copy replaces it
+static void damagedRecord(void) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    const char* url = "gemini://capsule.example/";
+    Buffer response;
+    bufferInit(&response, MEM_OTHER);
+    bufferAppend(&response, "20 text/gemini\r\n", 16);
+    pageMake(&response, 32 * 1024, 5);
+    const char* body = strstr(response.data, "\r\n") + 2;
+
+    DiskCache disk;
+    REQUIRE(diskCacheOpen(&disk, dir, 4 * 1024 * 1024, 3600, 1) == 0);
+    REQUIRE(diskCachePut(&disk, url, 20, "text/gemini", body, strlen(body)) == 0);
+    REQUIRE(damageRecord(dir, url) == 0);
+
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAdd(&net, url, response.data, response.length);
+    FetchNetwork network;
+    networkInitFake(&network, &net);
+    RedirectMap redirects;
+    Fetcher fetcher;
+    REQUIRE(redirectsInit(&redirects) == 0);
+    REQUIRE(fetcherStart(&fetcher, &network, &disk, &redirects) == 0);
+
+    Document expected;
+    parseGemtext(body, &expected);
+    FetchJob* job = fakeFetch(&fetcher, url);
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_OK);
+    CHECK_INT(job->fromDisk, 0);
+    CHECK_INT(net.opens, 1);
+    CHECK_INT(job->bytes, strlen(body));
+    CHECK(pageSameDocument(&job->doc, &expected));
+    fetchJobFree(job);
+
+    job = fakeFetch(&fetcher, url);
+    REQUIRE(job != NULL);
+    CHECK_INT(job->fromDisk, 1);
+    CHECK_INT(net.opens, 1);
+    CHECK(pageSameDocument(&job->doc, &expected));
+    //Unpacked straight into the page, not into a copy of the body as well
+    CHECK_INT(job->body.length, 0);
+    fetchJobFree(job);
+
+    fetcherStop(&fetcher);
+    freeDocument(&expected);
+    redirectsFree(&redirects);
+    diskCacheClose(&disk);
+    bufferFree(&response);
+}
+
+const TestCase lzTests[] = {
+    { "round-trip", roundTrip },
+    { "corruption", corruption },
+    { "damaged-page", damagedPage },
+    { "damaged-record", damagedRecord },
+    { NULL, NULL },
+};
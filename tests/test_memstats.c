@@ -0,0 +1,227 @@
+#include <stdio.h>
+
+#include "diskcache.h"
+#include "fakenet.h"
+#include "fetch.h"
+#include "history.h"
+#include "memstats.h"
+#include "pagecache.h"
+#include "pages.h"
+#include "test.h"
+
+#define PAGES 24
+#define PAGE_SIZE (16 * 1024)
+
+static size_t current(int account) {
+    MemStats stats;
+    memStats(account, &stats);
+    return stats.current;
+}
+
+static void charges(void) {
+    MemStats before;
+    MemStats after;
+    memStats(MEM_OTHER, &before);
+    char* block = memAlloc(MEM_OTHER, 1000);
+    REQUIRE(block != NULL);
+    //Plus the size kept in front of the block
+    size_t small = current(MEM_OTHER) - before.current;
+    CHECK(small >= 1000 && small < 1100);
+    block = memRealloc(MEM_OTHER, block, 3000);
+    REQUIRE(block != NULL);
+    CHECK_INT(current(MEM_OTHER) - before.current, small + 2000);
+    memFree(block);
+    memStats(MEM_OTHER, &after);
+    CHECK_INT(after.current, before.current);
+    CHECK_INT(after.allocations, before.allocations + 2);
+    CHECK(after.peak >= before.current + 3000);
+
+    memMove(MEM_OTHER, MEM_UI, 0);
+    size_t ui = current(MEM_UI);
+    memCharge(MEM_OTHER, 500);
+    memMove(MEM_OTHER, MEM_UI, 500);
+    CHECK_INT(current(MEM_UI), ui + 500);
+    CHECK_INT(current(MEM_OTHER), before.current);
+    memRelease(MEM_UI, 500);
+}
+
+//Crossing the budget is counted once per crossing, not once per allocation over it
+static void budget(void) {
+    MemStats before;
+    MemStats after;
+    memStats(MEM_FEEDS, &before);
+    memSetBudget(MEM_FEEDS, before.current + 1000);
+    CHECK(!memOverBudget(MEM_FEEDS));
+    memCharge(MEM_FEEDS, 800);
+    CHECK(!memOverBudget(MEM_FEEDS));
+    memCharge(MEM_FEEDS, 800);
+    memCharge(MEM_FEEDS, 800);
+    CHECK(memOverBudget(MEM_FEEDS));
+    memRelease(MEM_FEEDS, 2400);
+    CHECK(!memOverBudget(MEM_FEEDS));
+    memStats(MEM_FEEDS, &after);
+    CHECK_INT(after.overBudget, before.overBudget + 1);
+    memSetBudget(MEM_FEEDS, 0);
+}
+
+static void makePage(Document* doc, PageLayout* layout, unsigned int seed) {
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, PAGE_SIZE, seed);
+    parseGemtext(text.data, doc);
+    bufferFree(&text);
+    resetLayout(layout);
+    layoutDocument(doc, layout);
+}
+
+//A big page read from the disk cache while the page cache is close to the
+//cache budget mustn't push the pages out
+static void diskReadKeepsPages(void) {
+    char dir[256];
+    testTempDir(dir, sizeof dir);
+    DiskCache disk;
+    REQUIRE(diskCacheOpen(&disk, dir, 4 * 1024 * 1024, 3600, 0) == 0);
+    Buffer body;
+    bufferInit(&body, MEM_OTHER);
+    pageMake(&body, 256 * 1024, 4);
+    diskCachePut(&disk, "gemini://big/", 20, "text/gemini", body.data, body.length);
+    bufferFree(&body);
+
+    PageCache cache;
+    pageCacheInit(&cache, 1024 * 1024, 0);
+    Document doc;
+    PageLayout layout;
+    makePage(&doc, &layout, 1);
+    pageCachePut(&cache, "gemini://a/", &doc, &layout, 0, 0);
+    makePage(&doc, &layout, 2);
+    memSetBudget(MEM_CACHE, current(MEM_CACHE) + 2 * cache.bytes);
+
+    DiskCacheEntry entry;
+    REQUIRE(diskCacheGet(&disk, "gemini://big/", &entry) == 0);
+    pageCachePut(&cache, "gemini://b/", &doc, &layout, 0, 0);
+    CHECK(pageCacheContains(&cache, "gemini://a/"));
+    CHECK(pageCacheContains(&cache, "gemini://b/"));
+    CHECK_INT(cache.evictions, 0);
+    diskCacheEntryFree(&entry);
+
+    memSetBudget(MEM_CACHE, 0);
+    pageCacheFree(&cache);
+    diskCacheClose(&disk);
+}
+
+typedef struct {
+    FakeNetwork net;
+    Buffer responses[PAGES];
+    Fetcher fetcher;
+    DiskCache disk;
+    RedirectMap redirects;
+    PageCache cache;
+    History history;
+    Document doc;
+    PageLayout layout;
+    int fetched;
+    int fromDisk;
+} Browser;
+
+static void pageUrl(char* out, size_t size, int i) {
+    snprintf(out, size, "gemini://capsule.example/%d.gmi", i);
+}
+
+//What the UI does with a page it is leaving and the one it is going to
+static int go(Browser* b, const char* url, int step) {
+    if (historyCurrent(&b->history) != NULL) {
+        pageCachePut(&b->cache, historyCurrent(&b->history), &b->doc, &b->layout, 0, 0);
+    }
+    char at[URL_MAX];
+    snprintf(at, sizeof at, "%s", step < 0 ? historyBack(&b->history) : step > 0 ? historyForward(&b->history) : url);
+    int scroll;
+    if (pageCacheTake(&b->cache, at, &b->doc, &b->layout, &scroll) != 0) {
+        FetchJob* job = fakeFetch(&b->fetcher, at);
+        if (job == NULL || job->error != FETCH_OK) {
+            fetchJobFree(job);
+            return -1;
+        }
+        //Redirects may have taken it somewhere else
+        snprintf(at, sizeof at, "%s", job->url);
+        b->fetched++;
+        b->fromDisk += job->fromDisk;
+        b->doc = job->doc;
+        b->layout = job->layout;
+        memset(&job->doc, 0, sizeof job->doc);
+        fetchJobFree(job);
+    }
+    if (step == 0) {
+        historyVisit(&b->history, at);
+    }
+    return 0;
+}
+
+//A session of browsing with every cache in play: new pages, a redirect, back
+//through the history, forward again and revisits served from the SD card.
+//Nothing may be left charged afterwards and no account may run away.
+static void navigation(void) {
+    static Browser b;
+    char dir[256];
+    char url[64];
+    testTempDir(dir, sizeof dir);
+    memset(&b, 0, sizeof b);
+    layoutSetFont(NULL, 388);
+    fakeNetworkInit(&b.net);
+    for (int i = 0; i < PAGES; i++) {
+        bufferInit(&b.responses[i], MEM_OTHER);
+        bufferAppend(&b.responses[i], "20 text/gemini\r\n", 16);
+        pageMake(&b.responses[i], PAGE_SIZE, i);
+        pageUrl(url, sizeof url, i);
+        fakeNetworkAdd(&b.net, url, b.responses[i].data, b.responses[i].length);
+    }
+    fakeNetworkAddText(&b.net, "gemini://capsule.example/old", "31 gemini://capsule.example/0.gmi\r\n");
+    FetchNetwork network;
+    networkInitFake(&network, &b.net);
+    REQUIRE(diskCacheOpen(&b.disk, dir, 4 * 1024 * 1024, 3600, 0) == 0);
+    REQUIRE(redirectsInit(&b.redirects) == 0);
+    REQUIRE(fetcherStart(&b.fetcher, &network, &b.disk, &b.redirects) == 0);
+    pageCacheInit(&b.cache, 8 * PAGE_SIZE, 0);
+    historyInit(&b.history);
+
+    memResetPeaks();
+    size_t cacheBase = current(MEM_CACHE);
+    CHECK_INT(go(&b, "gemini://capsule.example/old", 0), 0);
+    for (int i = 1; i < PAGES; i++) {
+        pageUrl(url, sizeof url, i);
+        CHECK_INT(go(&b, url, 0), 0);
+    }
+    for (int i = 0; i < PAGES - 1; i++) {
+        CHECK_INT(go(&b, NULL, -1), 0);
+    }
+    CHECK_STR(historyCurrent(&b.history), "gemini://capsule.example/0.gmi");
+    for (int i = 0; i < PAGES / 2; i++) {
+        CHECK_INT(go(&b, NULL, 1), 0);
+    }
+
+    //The page cache only held a few pages, the rest came back off the card
+    CHECK(b.fromDisk > PAGES / 2);
+    CHECK(b.cache.hits > 0 && b.cache.evictions > 0);
+    MemStats stats;
+    memStats(MEM_CACHE, &stats);
+    //The pages, one more on its way in before the oldest goes and the disk cache index
+    CHECK(stats.peak - cacheBase < 2 * b.cache.budget);
+    memStats(MEM_DOCUMENT, &stats);
+    CHECK(stats.peak < 8 * PAGE_SIZE);
+
+    fetcherStop(&b.fetcher);
+    freeDocument(&b.doc);
+    pageCacheFree(&b.cache);
+    redirectsFree(&b.redirects);
+    diskCacheClose(&b.disk);
+    for (int i = 0; i < PAGES; i++) {
+        bufferFree(&b.responses[i]);
+    }
+}
+
+const TestCase memStatsTests[] = {
+    { "charges", charges },
+    { "budget", budget },
+    { "disk-read-keeps-pages", diskReadKeepsPages },
+    { "navigation", navigation },
+    { NULL, NULL },
+};
@@ -0,0 +1,205 @@
+#include <stdio.h>
+
+#include "fakenet.h"
+#include "memstats.h"
+#include "pages.h"
+#include "platform.h"
+#include "prefetch.h"
+#include "test.h"
+
+#define HOME "gemini://cap.example/dir/"
+
+static const char* homeText =
+    "# Home\n"
+    "=> a First\n"
+    "=> /b Second\n"
+    "=> a Again\n"
+    "=> " HOME " Here\n"
+    "=> gemini://other.example/ Elsewhere\n"
+    "=> https://cap.example/c Web\n"
+    "=> gemini://CAP.example:1965/d Third\n";
+
+typedef struct {
+    FakeNetwork net;
+    FetchNetwork network;
+    Fetcher fetcher;
+    PageCache pages;
+    Prefetcher prefetcher;
+} Prefetching;
+
+//The responses have to be in before this
+static int prefetchingStart(Prefetching* p, size_t byteBudget) {
+    networkInitFake(&p->network, &p->net);
+    if (fetcherStart(&p->fetcher, &p->network, NULL, NULL) != 0) {
+        return -1;
+    }
+    pageCacheInit(&p->pages, 1024 * 1024, 0);
+    prefetchInit(&p->prefetcher, &p->fetcher, &p->pages, 8, 2, byteBudget);
+    p->prefetcher.enabled = 1;
+    return 0;
+}
+
+static void prefetchingStop(Prefetching* p) {
+    prefetchCancel(&p->prefetcher);
+    fetcherStop(&p->fetcher);
+    pageCacheFree(&p->pages);
+}
+
+//Idle frames until every candidate has been fetched or given up on, returns
+//how many jobs ran at once at most
+static int prefetchSettle(Prefetching* p) {
+    Prefetcher* prefetcher = &p->prefetcher;
+    int most = 0;
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS; waited++) {
+        prefetchIdle(prefetcher);
+        if (prefetcher->jobCount > most) {
+            most = prefetcher->jobCount;
+        }
+        FetchJob* done;
+        while ((done = fetcherPoll(&p->fetcher)) != NULL) {
+            CHECK_INT(prefetchFinish(prefetcher, done), 1);
+        }
+        if (prefetcher->jobCount == 0 && (prefetcher->nextUrl == prefetcher->urlCount || prefetcher->bytesUsed >= prefetcher->byteBudget)) {
+            return most;
+        }
+        platformSleepMs(1);
+    }
+    CHECK(!"prefetching never settled");
+    return most;
+}
+
+//Same server links only, each once, never the page itself, up to the limit
+static void candidates(void) {
+    Prefetcher prefetcher;
+    prefetchInit(&prefetcher, NULL, NULL, 8, 2, 1024);
+    Document doc;
+    parseGemtext(homeText, &doc);
+    prefetchPage(&prefetcher, HOME, &doc);
+    CHECK_STR(prefetcher.origin, "gemini://cap.example/");
+    REQUIRE(prefetcher.urlCount == 3);
+    CHECK_STR(prefetcher.urls[0], "gemini://cap.example/dir/a");
+    CHECK_STR(prefetcher.urls[1], "gemini://cap.example/b");
+    CHECK_STR(prefetcher.urls[2], "gemini://cap.example/d");
+
+    prefetchInit(&prefetcher, NULL, NULL, 2, 2, 1024);
+    prefetchPage(&prefetcher, HOME, &doc);
+    CHECK_INT(prefetcher.urlCount, 2);
+
+    //Nothing to go on for a page that isn't on a gemini server
+    prefetchPage(&prefetcher, "about:welcome", &doc);
+    CHECK_INT(prefetcher.urlCount, 0);
+    freeDocument(&doc);
+}
+
+//Idle frames fill the page cache, a few jobs at a time, and following a
+//link takes the page from there and counts a hit
+static void hits(void) {
+    static Prefetching p;
+    fakeNetworkInit(&p.net);
+    fakeNetworkAddText(&p.net, "gemini://cap.example/dir/a", "20 text/gemini\r\n# A\n");
+    fakeNetworkAddText(&p.net, "gemini://cap.example/b", "20 text/gemini\r\n# B\n");
+    fakeNetworkAddText(&p.net, "gemini://cap.example/d", "51 Not found\r\n");
+    REQUIRE(prefetchingStart(&p, 64 * 1024) == 0);
+    Document doc;
+    parseGemtext(homeText, &doc);
+    prefetchPage(&p.prefetcher, HOME, &doc);
+    freeDocument(&doc);
+
+    CHECK(prefetchSettle(&p) <= 2);
+    CHECK_INT(p.prefetcher.issued, 3);
+    CHECK_INT(p.prefetcher.stored, 2);
+    CHECK(pageCacheContains(&p.pages, "gemini://cap.example/dir/a"));
+    CHECK(pageCacheContains(&p.pages, "gemini://cap.example/b"));
+    CHECK(!pageCacheContains(&p.pages, "gemini://cap.example/d"));
+    //The not found answer had no body, so nothing went to waste
+    CHECK_INT(p.prefetcher.wastedBytes, 0);
+
+    PageLayout layout;
+    int scroll;
+    REQUIRE(pageCacheTake(&p.pages, "gemini://cap.example/b", &doc, &layout, &scroll) == 0);
+    CHECK_INT(p.pages.prefetchHits, 1);
+    CHECK_INT(doc.lineCount, 1);
+    freeDocument(&doc);
+
+    //Coming back only fetches what isn't cached any more, b was taken and d failed
+    parseGemtext(homeText, &doc);
+    prefetchPage(&p.prefetcher, HOME, &doc);
+    freeDocument(&doc);
+    prefetchSettle(&p);
+    CHECK_INT(p.prefetcher.issued, 5);
+    CHECK_INT(p.net.opens, 5);
+    prefetchingStop(&p);
+}
+
+//Moving on to another page cancels what's in flight, and the bytes it had
+//read count as wasted
+static void moveOn(void) {
+    static Prefetching p;
+    static Buffer slow;
+    bufferInit(&slow, MEM_OTHER);
+    bufferAppend(&slow, "20 text/gemini\r\n", 16);
+    pageMake(&slow, 32 * 1024, 2);
+    fakeNetworkInit(&p.net);
+    fakeNetworkAdd(&p.net, "gemini://cap.example/dir/a", slow.data, slow.length);
+    fakeNetworkAdd(&p.net, "gemini://cap.example/b", slow.data, slow.length);
+    p.net.recordSize = 512;
+    p.net.delayMs = 5;
+    REQUIRE(prefetchingStart(&p, 1024 * 1024) == 0);
+    Document doc;
+    parseGemtext(homeText, &doc);
+    prefetchPage(&p.prefetcher, HOME, &doc);
+    freeDocument(&doc);
+
+    prefetchIdle(&p.prefetcher);
+    REQUIRE(p.prefetcher.jobCount == 2);
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS && fetchJobBytes(p.prefetcher.jobs[0]) == 0; waited++) {
+        platformSleepMs(1);
+    }
+    parseGemtext("# Elsewhere\n", &doc);
+    prefetchPage(&p.prefetcher, "gemini://other.example/", &doc);
+    freeDocument(&doc);
+    prefetchSettle(&p);
+    CHECK_INT(p.prefetcher.stored, 0);
+    CHECK(p.prefetcher.fetchedBytes > 0);
+    CHECK_INT(p.prefetcher.wastedBytes, p.prefetcher.fetchedBytes);
+    CHECK(!pageCacheContains(&p.pages, "gemini://cap.example/dir/a"));
+    prefetchingStop(&p);
+    bufferFree(&slow);
+}
+
+//A page's prefetching stops once it has used its budget, the job that goes
+//over is cut off
+static void budget(void) {
+    static Prefetching p;
+    static Buffer big;
+    bufferInit(&big, MEM_OTHER);
+    bufferAppend(&big, "20 text/gemini\r\n", 16);
+    pageMake(&big, 16 * 1024, 3);
+    fakeNetworkInit(&p.net);
+    fakeNetworkAdd(&p.net, "gemini://cap.example/dir/a", big.data, big.length);
+    fakeNetworkAdd(&p.net, "gemini://cap.example/b", big.data, big.length);
+    fakeNetworkAdd(&p.net, "gemini://cap.example/d", big.data, big.length);
+    REQUIRE(prefetchingStart(&p, 20 * 1024) == 0);
+    p.prefetcher.maxInFlight = 1;
+    Document doc;
+    parseGemtext(homeText, &doc);
+    prefetchPage(&p.prefetcher, HOME, &doc);
+    freeDocument(&doc);
+
+    prefetchSettle(&p);
+    CHECK_INT(p.prefetcher.issued, 2);
+    CHECK_INT(p.prefetcher.stored, 1);
+    CHECK(p.prefetcher.wastedBytes > 0);
+    CHECK(!pageCacheContains(&p.pages, "gemini://cap.example/b"));
+    CHECK(!pageCacheContains(&p.pages, "gemini://cap.example/d"));
+    prefetchingStop(&p);
+    bufferFree(&big);
+}
+
+const TestCase prefetchTests[] = {
+    { "candidates", candidates },
+    { "hits", hits },
+    { "move-on", moveOn },
+    { "budget", budget },
+    { NULL, NULL },
+};
@@ -0,0 +1,233 @@
+#include <stdio.h>
+
+#include "fakenet.h"
+#include "redirects.h"
+#include "test.h"
+
+typedef struct {
+    FakeNetwork net;
+    FetchNetwork network;
+    RedirectMap redirects;
+    Fetcher fetcher;
+} Capsules;
+
+//The responses have to be in before this
+static int capsulesStart(Capsules* c) {
+    networkInitFake(&c->network, &c->net);
+    if (redirectsInit(&c->redirects) != 0) {
+        return -1;
+    }
+    return fetcherStart(&c->fetcher, &c->network, NULL, &c->redirects);
+}
+
+static void capsulesStop(Capsules* c) {
+    fetcherStop(&c->fetcher);
+    redirectsFree(&c->redirects);
+}
+
+//Temporary and permanent hops are followed on the worker, only the permanent
+//ones are remembered and the next visit skips them
+static void chain(void) {
+    static Capsules c;
+    fakeNetworkInit(&c.net);
+    fakeNetworkAddText(&c.net, "gemini://a.example/", "30 gemini://b.example/\r\n");
+    fakeNetworkAddText(&c.net, "gemini://b.example/", "31 /moved\r\n");
+    fakeNetworkAddText(&c.net, "gemini://b.example/moved", "20 text/gemini\r\n# Here\n");
+    REQUIRE(capsulesStart(&c) == 0);
+
+    FetchJob* job = fakeFetch(&c.fetcher, "gemini://a.example/");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_OK);
+    CHECK_STR(job->url, "gemini://b.example/moved");
+    CHECK_STR(job->requested, "gemini://a.example/");
+    REQUIRE(job->hopCount == 2);
+    CHECK_STR(job->hops[0].url, "gemini://a.example/");
+    CHECK_INT(job->hops[0].status, 30);
+    CHECK_STR(job->hops[1].url, "gemini://b.example/");
+    CHECK_INT(job->hops[1].status, 31);
+    CHECK_INT(job->doc.lineCount, 1);
+    CHECK_INT(c.net.opens, 3);
+    fetchJobFree(job);
+    CHECK_INT(c.redirects.count, 1);
+
+    job = fakeFetch(&c.fetcher, "gemini://b.example/");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_OK);
+    CHECK_STR(job->url, "gemini://b.example/moved");
+    REQUIRE(job->hopCount == 1);
+    CHECK(job->hops[0].remembered);
+    CHECK_INT(c.net.opens, 4);
+    fetchJobFree(job);
+    capsulesStop(&c);
+}
+
+//Back to anywhere already on the chain stops there, whichever hop closes it
+static void loop(void) {
+    static Capsules c;
+    fakeNetworkInit(&c.net);
+    fakeNetworkAddText(&c.net, "gemini://a.example/", "30 gemini://b.example/\r\n");
+    fakeNetworkAddText(&c.net, "gemini://b.example/", "30 gemini://c.example/\r\n");
+    fakeNetworkAddText(&c.net, "gemini://c.example/", "30 gemini://A.EXAMPLE:1965/\r\n");
+    fakeNetworkAddText(&c.net, "gemini://self.example/", "31 /\r\n");
+    REQUIRE(capsulesStart(&c) == 0);
+
+    FetchJob* job = fakeFetch(&c.fetcher, "gemini://a.example/");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_REDIRECT_LOOP);
+    CHECK_INT(job->hopCount, 2);
+    CHECK_INT(c.net.opens, 3);
+    fetchJobFree(job);
+
+    job = fakeFetch(&c.fetcher, "gemini://self.example/");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_REDIRECT_LOOP);
+    CHECK_INT(job->hopCount, 0);
+    CHECK_INT(c.redirects.count, 0);
+    fetchJobFree(job);
+    capsulesStop(&c);
+}
+
+//A stored redirect the server has since turned around is forgotten, the next
+//visit asks again instead of going round the same loop
+static void staleLoop(void) {
+    static Capsules c;
+    fakeNetworkInit(&c.net);
+    fakeNetworkAddText(&c.net, "gemini://new.example/", "31 gemini://old.example/\r\n");
+    REQUIRE(capsulesStart(&c) == 0);
+    redirectsAdd(&c.redirects, "gemini://old.example/", "gemini://new.example/");
+
+    FetchJob* job = fakeFetch(&c.fetcher, "gemini://old.example/");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_REDIRECT_LOOP);
+    REQUIRE(job->hopCount == 1);
+    CHECK(job->hops[0].remembered);
+    fetchJobFree(job);
+    char target[URL_MAX];
+    CHECK_INT(redirectsLookup(&c.redirects, "gemini://old.example/", target), -1);
+    capsulesStop(&c);
+}
+
+//A chain one longer than REDIRECTS_MAX_HOPS is given up on at the last hop
+static void tooMany(void) {
+    static Capsules c;
+    static char responses[REDIRECTS_MAX_HOPS + 1][64];
+    fakeNetworkInit(&c.net);
+    char url[64];
+    for (int i = 0; i <= REDIRECTS_MAX_HOPS; i++) {
+        snprintf(url, sizeof url, "gemini://hop.example/%d", i);
+        snprintf(responses[i], sizeof responses[i], "30 /%d\r\n", i + 1);
+        fakeNetworkAddText(&c.net, url, responses[i]);
+    }
+    snprintf(url, sizeof url, "gemini://hop.example/%d", REDIRECTS_MAX_HOPS + 1);
+    fakeNetworkAddText(&c.net, url, "20 text/gemini\r\n# End\n");
+    REQUIRE(capsulesStart(&c) == 0);
+
+    FetchJob* job = fakeFetch(&c.fetcher, "gemini://hop.example/0");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_TOO_MANY_REDIRECTS);
+    CHECK_INT(job->hopCount, REDIRECTS_MAX_HOPS);
+    CHECK_INT(c.net.opens, REDIRECTS_MAX_HOPS + 1);
+    //The page says where it was going next
+    CHECK(job->doc.linkCount == 1);
+    fetchJobFree(job);
+
+    //One hop fewer is fine
+    job = fakeFetch(&c.fetcher, "gemini://hop.example/1");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_OK);
+    CHECK_INT(job->hopCount, REDIRECTS_MAX_HOPS);
+    fetchJobFree(job);
+    capsulesStop(&c);
+}
+
+//Other schemes and urls that don't parse are shown rather than followed
+static void elsewhere(void) {
+    static Capsules c;
+    fakeNetworkInit(&c.net);
+    fakeNetworkAddText(&c.net, "gemini://a.example/web", "31 https://example.com/\r\n");
+    fakeNetworkAddText(&c.net, "gemini://a.example/bad", "30 gemini://[::1/\r\n");
+    REQUIRE(capsulesStart(&c) == 0);
+
+    FetchJob* job = fakeFetch(&c.fetcher, "gemini://a.example/web");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_BAD_REDIRECT);
+    CHECK_INT(job->doc.linkCount, 1);
+    fetchJobFree(job);
+    job = fakeFetch(&c.fetcher, "gemini://a.example/bad");
+    REQUIRE(job != NULL);
+    CHECK_INT(job->error, FETCH_BAD_REDIRECT);
+    fetchJobFree(job);
+    CHECK_INT(c.net.opens, 2);
+    CHECK_INT(c.redirects.count, 0);
+    capsulesStop(&c);
+}
+
+//Stored chains are followed as far as REDIRECTS_MAX_HOPS and a stored loop is no redirect at all
+static void stored(void) {
+    RedirectMap map;
+    REQUIRE(redirectsInit(&map) == 0);
+    char from[64];
+    char to[64];
+    char target[URL_MAX];
+    for (int i = 0; i < REDIRECTS_MAX_HOPS + 1; i++) {
+        snprintf(from, sizeof from, "gemini://x.example/%d", i);
+        snprintf(to, sizeof to, "gemini://x.example/%d", i + 1);
+        redirectsAdd(&map, from, to);
+    }
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/1", target), 0);
+    CHECK_STR(target, "gemini://x.example/6");
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/0", target), -1);
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/6", target), -1);
+
+    redirectsAdd(&map, "gemini://y.example/", "gemini://z.example/");
+    redirectsAdd(&map, "gemini://z.example/", "gemini://y.example/");
+    CHECK_INT(redirectsLookup(&map, "gemini://y.example/", target), -1);
+    //Pointing at itself isn't stored
+    redirectsAdd(&map, "gemini://w.example/", "gemini://w.example/");
+    CHECK_INT(redirectsLookup(&map, "gemini://w.example/", target), -1);
+    redirectsFree(&map);
+}
+
+//Full, the least recently used pair goes, and the file keeps the order
+static void storedFull(void) {
+    char dir[256];
+    char path[300];
+    testTempDir(dir, sizeof dir);
+    snprintf(path, sizeof path, "%s/redirects.txt", dir);
+    RedirectMap map;
+    REQUIRE(redirectsInit(&map) == 0);
+    char from[64];
+    char target[URL_MAX];
+    for (int i = 0; i < REDIRECTS_MAX; i++) {
+        snprintf(from, sizeof from, "gemini://x.example/%d", i);
+        redirectsAdd(&map, from, "gemini://x.example/");
+    }
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/0", target), 0);
+    redirectsAdd(&map, "gemini://x.example/new", "gemini://x.example/");
+    CHECK_INT(map.count, REDIRECTS_MAX);
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/0", target), 0);
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/1", target), -1);
+    CHECK_INT(redirectsSave(&map, path), 0);
+    redirectsFree(&map);
+
+    REQUIRE(redirectsInit(&map) == 0);
+    CHECK_INT(redirectsLoad(&map, path), 0);
+    CHECK_INT(map.count, REDIRECTS_MAX);
+    CHECK(!map.dirty);
+    //Loaded in the order they were used, so 2 is still the next to go
+    redirectsAdd(&map, "gemini://x.example/newer", "gemini://x.example/");
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/2", target), -1);
+    CHECK_INT(redirectsLookup(&map, "gemini://x.example/0", target), 0);
+    redirectsFree(&map);
+}
+
+const TestCase redirectsTests[] = {
+    { "chain", chain },
+    { "loop", loop },
+    { "stale-loop", staleLoop },
+    { "too-many", tooMany },
+    { "elsewhere", elsewhere },
+    { "stored", stored },
+    { "stored-full", storedFull },
+    { NULL, NULL },
+};
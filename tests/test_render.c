@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "browser.h"
+#include "fakenet.h"
+#include "memstats.h"
+#include "pages.h"
+#include "render_soft.h"
+#include "test.h"
+#include "textcache.h"
+#include "tilecache.h"
+
+//Slots are only good until the next reset, and a reset only allocates when it needs more room
+static void textCache(void) {
+    Renderer renderer;
+    StubRenderer stub;
+    rendererInitStub(&renderer, &stub);
+    TextCache cache;
+    textCacheInit(&cache, &renderer);
+    textCacheReset(&cache, 1, 3, 64);
+    CHECK_INT(textCacheAdd(&cache, "one", 3), 0);
+    CHECK_INT(textCacheAdd(&cache, "two", 3), 1);
+    CHECK_INT(textCacheAdd(&cache, "three", 5), 2);
+    CHECK_INT(textCacheAdd(&cache, "four", 4), -1);
+    textCacheDraw(&cache, 1, 0, 0, 0, 1, 0, 0);
+    textCacheDraw(&cache, 3, 0, 0, 0, 1, 0, 0);
+    textCacheDraw(&cache, -1, 0, 0, 0, 1, 0, 0);
+    CHECK_INT(cache.hits, 1);
+    CHECK_INT(cache.misses, 2);
+    CHECK_INT(stub.textDraws, 1);
+    unsigned long allocations = stub.allocations;
+
+    textCacheReset(&cache, 2, 2, 32);
+    CHECK_INT(cache.generation, 2);
+    textCacheDraw(&cache, 0, 0, 0, 0, 1, 0, 0);
+    CHECK_INT(cache.misses, 3);
+    CHECK_INT(stub.allocations, allocations);
+    textCacheReset(&cache, 3, 8, 1024);
+    CHECK(stub.allocations > allocations);
+    CHECK_INT(cache.builds, 3);
+    textCacheFree(&cache);
+}
+
+typedef struct {
+    FakeNetwork net;
+    FetchNetwork network;
+    Fetcher fetcher;
+    Renderer renderer;
+    Renderer statusRenderer;
+    StubRenderer stub;
+    StubRenderer statusStub;
+    Browser browser;
+} Screen;
+
+static int screenStart(Screen* s) {
+    layoutSetFont(NULL, TOP_SCREEN_WIDTH - 12);
+    fakeNetworkInit(&s->net);
+    networkInitFake(&s->network, &s->net);
+    if (fetcherStart(&s->fetcher, &s->network, NULL, NULL) != 0) {
+        return -1;
+    }
+    rendererInitStub(&s->renderer, &s->stub);
+    rendererInitStub(&s->statusRenderer, &s->statusStub);
+    BrowserHooks hooks = { NULL, NULL, NULL };
+    browserInit(&s->browser, &s->renderer, &s->statusRenderer, &s->fetcher, &hooks);
+    return 0;
+}
+
+static void screenStop(Screen* s) {
+    browserStop(&s->browser);
+    fetcherStop(&s->fetcher);
+    browserFree(&s->browser);
+}
+
+static void screenFrame(Screen* s, uint32_t kHeld) {
+    SessionInput input = { 0, kHeld, 0, 0 };
+    browserInput(&s->browser, &input);
+    browserDrawPage(&s->browser);
+    browserDrawControls(&s->browser);
+    browserAct(&s->browser);
+}
+
+//Once a page is up, frames are only draw calls: no text is prepared again
+//and nothing is allocated, whether the page sits still or scrolls
+static void steadyFrames(void) {
+    static Screen s;
+    REQUIRE(screenStart(&s) == 0);
+    Buffer text;
+    bufferInit(&text, MEM_OTHER);
+    pageMake(&text, 128 * 1024, 4);
+    browserShowText(&s.browser, "gemini://capsule.example/", text.data, 0, 0);
+    bufferFree(&text);
+
+    screenFrame(&s, 0);
+    unsigned long builds = s.browser.text.builds;
+    unsigned long allocations = s.stub.allocations;
+    unsigned long draws = s.stub.textDraws;
+    unsigned long paints = s.stub.surfacePaints;
+    MemStats ui;
+    memStats(MEM_UI, &ui);
+    unsigned long uiAllocations = ui.allocations;
+    for (int i = 0; i < 60; i++) {
+        screenFrame(&s, 0);
+    }
+    CHECK_INT(s.browser.text.builds, builds);
+    CHECK_INT(s.stub.allocations, allocations);
+    CHECK_INT(s.stub.surfacePaints, paints);
+    //The buttons and the links in view, the page itself is blitted
+    unsigned long perFrame = (s.stub.textDraws - draws) / 60;
+    CHECK(perFrame > 0 && perFrame <= FIXED_BUTTONS + 10);
+    CHECK(s.browser.text.misses == 0);
+
+    for (int i = 0; i < 600; i++) {
+        screenFrame(&s, BUTTON_DDOWN);
+    }
+    CHECK(s.browser.scroll <= -1800);
+    CHECK_INT(s.browser.text.builds, builds);
+    //Only the bands scrolled into were painted, into no more tiles than the cache holds
+    CHECK(s.stub.surfacePaints - paints <= 1800 / PAGE_TILE_HEIGHT + TILE_CACHE_SIZE);
+    CHECK(s.stub.allocations <= allocations + TILE_CACHE_SIZE);
+    allocations = s.stub.allocations;
+    for (int i = 0; i < 600; i++) {
+        screenFrame(&s, BUTTON_DDOWN);
+    }
+    CHECK_INT(s.stub.allocations, allocations);
+    memStats(MEM_UI, &ui);
+    CHECK_INT(ui.allocations, uiAllocations);
+    screenStop(&s);
+}
+
+#define SOFT_WIDTH 400
+#define SOFT_HEIGHT 240
+
+static int countColor(const SoftSurface* surface, int x, int y, int w, int h, uint32_t color) {
+    int count = 0;
+    for (int row = y; row < y + h; row++) {
+        for (int col = x; col < x + w; col++) {
+            count += surface->pixels[row * surface->width + col] == color;
+        }
+    }
+    return count;
+}
+
+//Rects are clipped to the target, text lands inside its box and skips
+//spaces, and blits copy a surface over the screen at any offset
+static void softDraw(void) {
+    Renderer renderer;
+    SoftRenderer soft;
+    REQUIRE(rendererInitSoft(&renderer, &soft, SOFT_WIDTH, SOFT_HEIGHT, NULL) == 0);
+    const SoftSurface* screen = &soft.surfaces[0];
+    uint32_t black = renderColor(0, 0, 0, 0xFF);
+    uint32_t red = renderColor(0xFF, 0, 0, 0xFF);
+    uint32_t white = renderColor(0xFF, 0xFF, 0xFF, 0xFF);
+    softClear(&soft, black);
+    CHECK_INT(countColor(screen, 0, 0, SOFT_WIDTH, SOFT_HEIGHT, black), SOFT_WIDTH * SOFT_HEIGHT);
+
+    renderer.drawRect(renderer.ctx, -10, -10, 0, 20, 30, red);
+    renderer.drawRect(renderer.ctx, SOFT_WIDTH - 5, SOFT_HEIGHT - 5, 0, 50, 50, red);
+    CHECK_INT(countColor(screen, 0, 0, SOFT_WIDTH, SOFT_HEIGHT, red), 10 * 20 + 5 * 5);
+
+    //Two glyphs of 8x18 at scale .6, with a space between them
+    softClear(&soft, black);
+    renderer.textReset(renderer.ctx, 2, 8);
+    int handle = renderer.textPrepare(renderer.ctx, "H H", 3);
+    CHECK_INT(handle, 0);
+    CHECK_INT(renderer.textPrepare(renderer.ctx, "too long", 8), -1);
+    renderer.drawText(renderer.ctx, handle, 100, 50, 0, .6, white, 0);
+    CHECK_INT(soft.glyphDraws, 2);
+    int inside = countColor(screen, 100, 50, 24, 18, white);
+    CHECK(inside > 0);
+    CHECK_INT(countColor(screen, 0, 0, SOFT_WIDTH, SOFT_HEIGHT, white), inside);
+    CHECK_INT(countColor(screen, 108, 50, 8, 18, white), 0);
+
+    //A surface blitted partly off the top left corner
+    int surface = renderer.surfaceNew(renderer.ctx, 32, 16);
+    REQUIRE(surface > 0);
+    renderer.surfaceBegin(renderer.ctx, surface, red);
+    renderer.drawRect(renderer.ctx, 0, 0, 0, 32, 8, white);
+    renderer.surfaceEnd(renderer.ctx);
+    softClear(&soft, black);
+    renderer.drawSurface(renderer.ctx, surface, -8, -4, 0);
+    CHECK_INT(countColor(screen, 0, 0, 24, 4, white), 24 * 4);
+    CHECK_INT(countColor(screen, 0, 4, 24, 8, red), 24 * 8);
+    CHECK_INT(countColor(screen, 0, 0, SOFT_WIDTH, SOFT_HEIGHT, black), SOFT_WIDTH * SOFT_HEIGHT - 24 * 12);
+    renderer.drawSurface(renderer.ctx, surface, SOFT_WIDTH - 8, SOFT_HEIGHT - 4, 0);
+    CHECK_INT(countColor(screen, SOFT_WIDTH - 8, SOFT_HEIGHT - 4, 8, 4, white), 8 * 4);
+    CHECK_INT(soft.blits, 2);
+    renderer.surfaceFree(renderer.ctx, surface);
+    rendererFreeSoft(&soft);
+}
+
+#define BAND 9
+#define BANDS 400
+#define TILE 64
+
+//A made up page of colored bands with a label on each, drawn wherever it
+//overlaps the rows asked for
+typedef struct {
+    Renderer* renderer;
+} StripePage;
+
+static void paintStripes(void* user, int top, int bottom) {
+    StripePage* page = user;
+    Renderer* renderer = page->renderer;
+    //Labels hang 15px below their band's top, so start a few bands up
+    int first = top / BAND - 2;
+    for (int band = first < 0 ? 0 : first; band < BANDS && band * BAND < bottom; band++) {
+        int y = band * BAND - top;
+        uint32_t color = renderColor(band * 37, band * 11, band * 5, 0xFF);
+        renderer->drawRect(renderer->ctx, 0, y, 0, SOFT_WIDTH, BAND, color);
+        renderer->drawText(renderer->ctx, band % 4, (band * 13) % 200, y + 1, 0, .5, renderColor(0xFF, 0xFF, 0xFF, 0xFF), 0);
+    }
+}
+
+//Going through the tiles gives the same pixels as painting the page straight
+//to the screen, at every scroll position, and scrolling back over tiles
+//already painted costs nothing
+static void tiles(void) {
+    static Renderer renderer;
+    static SoftRenderer soft;
+    static uint32_t direct[SOFT_WIDTH * SOFT_HEIGHT];
+    REQUIRE(rendererInitSoft(&renderer, &soft, SOFT_WIDTH, SOFT_HEIGHT, NULL) == 0);
+    renderer.textReset(renderer.ctx, 4, 64);
+    const char* labels[] = { "alpha", "beta", "gamma", "delta" };
+    for (int i = 0; i < 4; i++) {
+        REQUIRE(renderer.textPrepare(renderer.ctx, labels[i], strlen(labels[i])) == i);
+    }
+    StripePage page = { &renderer };
+    uint32_t background = renderColor(1, 2, 3, 0xFF);
+    TileCache cache;
+    tileCacheInit(&cache, &renderer, SOFT_WIDTH, TILE, background);
+
+    int mismatches = 0;
+    int height = BANDS * BAND;
+    int scroll;
+    for (scroll = -30; scroll < height; scroll += 23) {
+        softClear(&soft, background);
+        paintStripes(&page, scroll, scroll + SOFT_HEIGHT);
+        memcpy(direct, soft.surfaces[0].pixels, sizeof direct);
+        softClear(&soft, background);
+        REQUIRE(tileCacheDraw(&cache, 1, scroll, SOFT_HEIGHT, paintStripes, &page) == 0);
+        mismatches += memcmp(direct, soft.surfaces[0].pixels, sizeof direct) != 0;
+    }
+    CHECK_INT(mismatches, 0);
+    //Every band was painted once on the way down
+    int lastTile = (scroll - 23 + SOFT_HEIGHT - 1) / TILE;
+    CHECK_INT(cache.misses, lastTile + 1);
+
+    //Back up a tile, it is still there
+    unsigned long misses = cache.misses;
+    scroll = ((scroll - 23) / TILE - 1) * TILE + 4;
+    for (int i = 0; i < 20; i++) {
+        tileCacheDraw(&cache, 1, scroll + i % 2, SOFT_HEIGHT, paintStripes, &page);
+    }
+    CHECK_INT(cache.misses, misses);
+
+    //A new generation paints again, a window taller than the cache can't be tiled
+    tileCacheDraw(&cache, 2, scroll, SOFT_HEIGHT, paintStripes, &page);
+    CHECK_INT(cache.misses - misses, (scroll + SOFT_HEIGHT - 1) / TILE - scroll / TILE + 1);
+    CHECK_INT(tileCacheDraw(&cache, 2, 0, TILE * TILE_CACHE_SIZE + 1, paintStripes, &page), -1);
+
+    tileCacheFree(&cache);
+    rendererFreeSoft(&soft);
+}
+
+const TestCase renderTests[] = {
+    { "text-cache", textCache },
+    { "steady-frames", steadyFrames },
+    { "soft-draw", softDraw },
+    { "tiles", tiles },
+    { NULL, NULL },
+};
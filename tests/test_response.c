@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fakenet.h"
+#include "memstats.h"
+#include "pages.h"
+#include "platform.h"
+#include "response.h"
+#include "test.h"
+
+#define URL "gemini://example.org/"
+
+typedef struct {
+    Buffer body;
+    int calls;
+} Collected;
+
+static void collect(void* user, const char* data, size_t len) {
+    Collected* collected = user;
+    bufferAppend(&collected->body, data, len);
+    collected->calls++;
+}
+
+//Reads the response net has for URL the way the fetch worker would
+static int readFake(FakeNetwork* net, GeminiHeader* header, Collected* collected, int cancel) {
+    bufferInit(&collected->body, MEM_OTHER);
+    collected->calls = 0;
+    FetchNetwork network;
+    networkInitFake(&network, net);
+    FetchJob* job = fetchJobNew(URL);
+    if (job == NULL) {
+        return RESPONSE_NO_MEMORY;
+    }
+    job->cancelled = cancel;
+    Transport transport;
+    void* conn = NULL;
+    int result = RESPONSE_RECV_FAILED;
+    if (network.open(network.ctx, job, URL "\r\n", &transport, &conn) == FETCH_OK) {
+        result = readGeminiResponse(&transport, header, collect, collected);
+        network.close(network.ctx, conn);
+    }
+    fetchJobFree(job);
+    return result;
+}
+
+static void header(void) {
+    GeminiHeader header;
+    const char* text = "20 text/gemini; lang=en\r\nbody";
+    CHECK_INT(parseGeminiHeader(text, strlen(text), &header), 25);
+    CHECK_INT(header.status, 20);
+    CHECK_STR(header.meta, "text/gemini; lang=en");
+
+    //Lenient about a bare LF and a missing space before an empty meta
+    CHECK_INT(parseGeminiHeader("31 /moved\n", 10, &header), 10);
+    CHECK_STR(header.meta, "/moved");
+    CHECK_INT(parseGeminiHeader("20\r\n", 4, &header), 4);
+    CHECK_STR(header.meta, "");
+
+    //Not there yet
+    CHECK_INT(parseGeminiHeader("20 text/gem", 11, &header), 0);
+
+    static const char* bad[] = { "2 text\r\n", "xx text\r\n", "20text\r\n", "\r\n" };
+    for (size_t i = 0; i < sizeof bad / sizeof bad[0]; i++) {
+        CHECK_INT(parseGeminiHeader(bad[i], strlen(bad[i]), &header), RESPONSE_BAD_HEADER);
+    }
+}
+
+//The longest meta allowed fits, a header that never ends is refused once it can't be one
+static void headerLimits(void) {
+    GeminiHeader header;
+    char text[GEMINI_HEADER_MAX + 16];
+    memcpy(text, "20 ", 3);
+    memset(text + 3, 'm', GEMINI_META_MAX);
+    memcpy(text + 3 + GEMINI_META_MAX, "\r\n", 2);
+    CHECK_INT(parseGeminiHeader(text, GEMINI_HEADER_MAX, &header), GEMINI_HEADER_MAX);
+    CHECK_INT(strlen(header.meta), GEMINI_META_MAX);
+
+    //A bare LF leaves room in the header for a meta one byte too long
+    memset(text + 3, 'm', GEMINI_META_MAX + 1);
+    text[3 + GEMINI_META_MAX + 1] = '\n';
+    CHECK_INT(parseGeminiHeader(text, GEMINI_HEADER_MAX, &header), RESPONSE_BAD_HEADER);
+
+    memset(text, 'm', sizeof text);
+    CHECK_INT(parseGeminiHeader(text, GEMINI_HEADER_MAX - 1, &header), 0);
+    CHECK_INT(parseGeminiHeader(text, GEMINI_HEADER_MAX, &header), RESPONSE_BAD_HEADER);
+}
+
+static void mime(void) {
+    CHECK(geminiIsGemtext(""));
+    CHECK(geminiIsGemtext("text/gemini"));
+    CHECK(geminiIsGemtext("TEXT/Gemini; charset=utf-8"));
+    CHECK(geminiIsGemtext("; lang=en"));
+    CHECK(!geminiIsGemtext("text/gemini2"));
+    CHECK(!geminiIsGemtext("text/plain"));
+    CHECK_STR(geminiStatusName(51), "Not found");
+    CHECK_STR(geminiStatusName(39), "Redirect");
+    CHECK_STR(geminiStatusName(99), "Unexpected status");
+}
+
+//A header split across reads a byte at a time still comes out whole
+static void splitRecords(void) {
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAddText(&net, URL, "20 text/gemini\r\n# Hi\n");
+    net.recordSize = 1;
+    GeminiHeader header;
+    Collected collected;
+    REQUIRE(readFake(&net, &header, &collected, 0) == RESPONSE_OK);
+    CHECK_INT(header.status, 20);
+    CHECK_STR(header.meta, "text/gemini");
+    CHECK_STR(collected.body.data, "# Hi\n");
+    CHECK_INT(collected.calls, 5);
+    bufferFree(&collected.body);
+}
+
+//A body of a few MB arrives intact, a TLS record at a time
+static void largeBody(void) {
+    size_t length = 3 * 1024 * 1024 + 123;
+    char* data = malloc(length);
+    REQUIRE(data != NULL);
+    int headerLength = sprintf(data, "20 application/octet-stream\r\n");
+    for (size_t i = headerLength; i < length; i++) {
+        data[i] = (char)(i * 31 + (i >> 11));
+    }
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAdd(&net, URL, data, length);
+    GeminiHeader header;
+    Collected collected;
+    if (readFake(&net, &header, &collected, 0) == RESPONSE_OK) {
+        CHECK_INT(collected.body.length, length - headerLength);
+        CHECK(memcmp(collected.body.data, data + headerLength, length - headerLength) == 0);
+        CHECK(collected.calls >= (int)((length - headerLength) / RESPONSE_RECORD_SIZE));
+        bufferFree(&collected.body);
+    } else {
+        CHECK(0);
+    }
+    free(data);
+}
+
+//A slow server's page shows its first lines long before the rest of it
+//arrives, and the whole of it comes out as if it had been parsed at once
+static void slowDrip(void) {
+    Buffer response;
+    bufferInit(&response, MEM_OTHER);
+    bufferAppend(&response, "20 text/gemini\r\n", 16);
+    pageMake(&response, 32 * 1024, 3);
+    size_t bodyLength = response.length - 16;
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAdd(&net, URL, response.data, response.length);
+    net.recordSize = 512;
+    net.delayMs = 2;
+    FetchNetwork network;
+    networkInitFake(&network, &net);
+    Fetcher fetcher;
+    REQUIRE(fetcherStart(&fetcher, &network, NULL, NULL) == 0);
+    layoutSetFont(NULL, 388);
+
+    FetchJob* job = fetchJobNew(URL);
+    REQUIRE(job != NULL);
+    REQUIRE(fetcherSubmit(&fetcher, job) == 0);
+    size_t firstLineBytes = 0;
+    for (int waited = 0; waited < FAKE_FETCH_TIMEOUT_MS && firstLineBytes == 0; waited++) {
+        const PageSnapshot* snapshot = fetchJobSnapshot(job);
+        if (snapshot != NULL && snapshot->layout.lineCount > 0) {
+            firstLineBytes = fetchJobBytes(job);
+            CHECK(snapshot->layout.offsets[snapshot->layout.lineCount] > 0);
+        } else {
+            platformSleepMs(1);
+        }
+    }
+    CHECK(firstLineBytes > 0 && firstLineBytes < bodyLength / 4);
+    FetchJob* done = fakeWait(&fetcher);
+    REQUIRE(done == job);
+    CHECK_INT(job->error, FETCH_OK);
+    CHECK_INT(job->bytes, bodyLength);
+    Document whole;
+    parseGemtext(response.data + 16, &whole);
+    CHECK(pageSameDocument(&job->doc, &whole));
+    freeDocument(&whole);
+    fetchJobFree(job);
+    fetcherStop(&fetcher);
+    bufferFree(&response);
+}
+
+//Only a success has a body
+static void noBody(void) {
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAddText(&net, URL, "51 Not here\r\nignored");
+    GeminiHeader header;
+    Collected collected;
+    REQUIRE(readFake(&net, &header, &collected, 0) == RESPONSE_OK);
+    CHECK_INT(header.status, 51);
+    CHECK_STR(header.meta, "Not here");
+    CHECK_INT(collected.calls, 0);
+    bufferFree(&collected.body);
+}
+
+static void failures(void) {
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    GeminiHeader header;
+    Collected collected;
+
+    //Closed before a whole header
+    fakeNetworkAddText(&net, URL, "20 text/gem");
+    CHECK_INT(readFake(&net, &header, &collected, 0), RESPONSE_BAD_HEADER);
+    bufferFree(&collected.body);
+
+    //Nothing read at all, the connection failed
+    fakeNetworkInit(&net);
+    fakeNetworkAddText(&net, URL, "20 text/gemini\r\n");
+    CHECK_INT(readFake(&net, &header, &collected, 1), RESPONSE_RECV_FAILED);
+    bufferFree(&collected.body);
+
+    fakeNetworkInit(&net);
+    fakeNetworkAddText(&net, URL, "20 text/gemini\r\n");
+    CHECK_INT(readFake(&net, &header, &collected, 0), RESPONSE_OK);
+    CHECK_INT(collected.body.length, 0);
+    bufferFree(&collected.body);
+}
+
+const TestCase responseTests[] = {
+    { "header", header },
+    { "header-limits", headerLimits },
+    { "mime", mime },
+    { "split-records", splitRecords },
+    { "large-body", largeBody },
+    { "slow-drip", slowDrip },
+    { "no-body", noBody },
+    { "failures", failures },
+    { NULL, NULL },
+};
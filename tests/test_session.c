@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "browser.h"
+#include "fakenet.h"
+#include "memstats.h"
+#include "platform.h"
+#include "session.h"
+#include "test.h"
+
+//What the user does, a frame or more each. Loads are waited out in between,
+//on the device the frames would just keep coming while nothing happens.
+static const SessionInput script[] = {
+    { BUTTON_TOUCH, BUTTON_TOUCH, 200, 10 },    //The url button, typing capsule.example
+    { 0, BUTTON_DOWN, 0, 0 },
+    { 0, BUTTON_DOWN, 0, 0 },
+    { BUTTON_TOUCH, BUTTON_TOUCH, 100, 30 },    //The first link
+    { BUTTON_L, BUTTON_L, 0, 0 },
+    { BUTTON_R, BUTTON_R, 0, 0 },
+    { BUTTON_L, BUTTON_L, 0, 0 },
+    { BUTTON_TOUCH, BUTTON_TOUCH, 100, 30 + LINK_ROW_HEIGHT },  //The second link
+    { 0, BUTTON_UP, 0, 0 },
+    { 0, 0, 0, 0 },
+};
+
+typedef struct {
+    SessionRecorder* recorder;
+    SessionReplay* replay;
+} Typing;
+
+static int typeUrl(void* user, const char* prompt, char* out, size_t size) {
+    Typing* typing = user;
+    if (typing->replay != NULL) {
+        return sessionReplayText(typing->replay, out, size);
+    }
+    snprintf(out, size, "capsule.example");
+    sessionRecordText(typing->recorder, out);
+    return 0;
+}
+
+//One frame of the app, the way sockets.c and the replayer run it
+static void frame(Browser* browser, const SessionInput* input) {
+    browserInput(browser, input);
+    browserDrawPage(browser);
+    browserDrawControls(browser);
+    browserAct(browser);
+}
+
+static void settle(Browser* browser) {
+    SessionInput idle = { 0, 0, 0, 0 };
+    for (int i = 0; i < 5000 && browser->loading != NULL; i++) {
+        platformSleepMs(1);
+        browserInput(browser, &idle);
+    }
+}
+
+typedef struct {
+    char key[PAGE_URL_SIZE];
+    int scroll;
+    int historyCount;
+    unsigned long hits;
+} Outcome;
+
+static void outcomeOf(const Browser* browser, Outcome* out) {
+    snprintf(out->key, sizeof out->key, "%s", browser->key);
+    out->scroll = browser->scroll;
+    out->historyCount = browser->history.count;
+    out->hits = browser->pages.hits;
+}
+
+//A session recorded against fake servers plays back to the same place
+//without them, every page coming out of the recording
+static void recordReplay(void) {
+    char dir[256];
+    char path[300];
+    testTempDir(dir, sizeof dir);
+    snprintf(path, sizeof path, "%s/session.gss", dir);
+    layoutSetFont(NULL, TOP_SCREEN_WIDTH - 12);
+
+    FakeNetwork net;
+    fakeNetworkInit(&net);
+    fakeNetworkAddText(&net, "gemini://capsule.example/",
+        "20 text/gemini\r\n# Capsule\n=> one.gmi One\n=> two.gmi Two\nSome text\n");
+    fakeNetworkAddText(&net, "gemini://capsule.example/one.gmi", "20 text/gemini\r\n# One\n=> / Home\n");
+    fakeNetworkAddText(&net, "gemini://capsule.example/two.gmi", "20 text/gemini\r\n# Two\n");
+    FetchNetwork inner;
+    networkInitFake(&inner, &net);
+
+    static SessionRecorder recorder;
+    FetchNetwork network;
+    REQUIRE(sessionRecordStart(&recorder, path, &inner) == 0);
+    networkInitRecording(&network, &recorder);
+    Fetcher fetcher;
+    REQUIRE(fetcherStart(&fetcher, &network, NULL, NULL) == 0);
+    static Browser browser;
+    Renderer renderer;
+    Renderer statusRenderer;
+    StubRenderer stub;
+    StubRenderer statusStub;
+    rendererInitStub(&renderer, &stub);
+    rendererInitStub(&statusRenderer, &statusStub);
+    Typing typing = { &recorder, NULL };
+    BrowserHooks hooks = { &typing, typeUrl, NULL };
+    browserInit(&browser, &renderer, &statusRenderer, &fetcher, &hooks);
+    for (size_t i = 0; i < sizeof script / sizeof script[0]; i++) {
+        sessionRecordFrame(&recorder, &script[i]);
+        frame(&browser, &script[i]);
+        settle(&browser);
+    }
+    Outcome recorded;
+    outcomeOf(&browser, &recorded);
+    browserStop(&browser);
+    fetcherStop(&fetcher);
+    browserFree(&browser);
+    CHECK_INT(sessionRecordStop(&recorder), 0);
+    CHECK_STR(recorded.key, "gemini://capsule.example/two.gmi");
+    CHECK_INT(recorded.historyCount, 3);
+    //Back and forward came out of the page cache
+    CHECK(recorded.hits >= 2);
+    CHECK(stub.textDraws > 0);
+
+    static SessionReplay replay;
+    REQUIRE(sessionReplayOpen(&replay, path) == 0);
+    CHECK_INT(replay.frameCount, sizeof script / sizeof script[0]);
+    networkInitReplay(&network, &replay);
+    REQUIRE(fetcherStart(&fetcher, &network, NULL, NULL) == 0);
+    typing.replay = &replay;
+    browserInit(&browser, &renderer, &statusRenderer, &fetcher, &hooks);
+    SessionInput input;
+    while (sessionReplayFrame(&replay, &input) == 0) {
+        frame(&browser, &input);
+        settle(&browser);
+    }
+    Outcome replayed;
+    outcomeOf(&browser, &replayed);
+    browserStop(&browser);
+    fetcherStop(&fetcher);
+    browserFree(&browser);
+
+    CHECK_STR(replayed.key, recorded.key);
+    CHECK_INT(replayed.scroll, recorded.scroll);
+    CHECK_INT(replayed.historyCount, recorded.historyCount);
+    CHECK_INT(replayed.hits, recorded.hits);
+    CHECK_INT(replay.served, recorder.responses);
+    CHECK_INT(replay.missing, 0);
+    //The network was only ever asked while recording
+    CHECK_INT(net.opens, recorder.responses);
+
+    FILE* report = fopen("/dev/null", "w");
+    if (report != NULL) {
+        sessionReplayReport(&replay, report);
+        fclose(report);
+    }
+    sessionReplayFree(&replay);
+}
+
+const TestCase sessionTests[] = {
+    { "record-replay", recordReplay },
+    { NULL, NULL },
+};
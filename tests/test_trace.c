@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "trace.h"
+
+//While tracing is off nothing is timed or kept
+static void off(void) {
+    traceSetEnabled(0);
+    CHECK_INT(traceStart(), 0);
+    traceEnd(TRACE_PARSE, traceStart());
+    traceSpan(TRACE_PARSE, 10, 20);
+    traceCount(TRACE_BYTES, 5);
+    TraceSummary summary;
+    traceSummarize(TRACE_PARSE, &summary);
+    CHECK_INT(summary.count, 0);
+    traceSummarize(TRACE_BYTES, &summary);
+    CHECK_INT(summary.count, 0);
+}
+
+//Percentiles over one name, other names don't get mixed in and a clear starts over
+static void summarize(void) {
+    traceSetEnabled(1);
+    for (int i = 100; i >= 1; i--) {
+        traceSpan(TRACE_LAYOUT, 1000, 1000 + i);
+        traceSpan(TRACE_DRAW, 0, 7);
+    }
+    traceCount(TRACE_BYTES, 4096);
+    TraceSummary summary;
+    traceSummarize(TRACE_LAYOUT, &summary);
+    CHECK_INT(summary.count, 100);
+    CHECK_INT(summary.p50, 51);
+    CHECK_INT(summary.p95, 96);
+    CHECK_INT(summary.max, 100);
+    traceSummarize(TRACE_BYTES, &summary);
+    CHECK_INT(summary.count, 1);
+    CHECK_INT(summary.max, 4096);
+    //Turning it on again starts from an empty ring too
+    traceClear();
+    traceSummarize(TRACE_LAYOUT, &summary);
+    CHECK_INT(summary.count, 0);
+    traceSpan(TRACE_LAYOUT, 0, 3);
+    traceSetEnabled(0);
+    traceSetEnabled(1);
+    traceSummarize(TRACE_LAYOUT, &summary);
+    CHECK_INT(summary.count, 0);
+    traceSetEnabled(0);
+}
+
+//Once the ring is full the oldest events go
+static void wrap(void) {
+    traceSetEnabled(1);
+    for (int i = 0; i < TRACE_RING_SIZE + 500; i++) {
+        traceSpan(TRACE_PARSE, 0, i);
+    }
+    TraceSummary summary;
+    traceSummarize(TRACE_PARSE, &summary);
+    CHECK_INT(summary.count, TRACE_RING_SIZE);
+    CHECK_INT(summary.max, TRACE_RING_SIZE + 499);
+    CHECK_INT(summary.p50, 500 + TRACE_RING_SIZE / 2);
+    traceSetEnabled(0);
+}
+
+#define WRITERS 4
+#define WRITES 1000
+
+static void writer(void* arg) {
+    int name = *(int*)arg;
+    for (int i = 0; i < WRITES; i++) {
+        traceSpan(name, i, i + name * 10);
+    }
+}
+
+//Threads writing at once all get their events in whole, while the UI reads
+static void threads(void) {
+    static int names[WRITERS] = { TRACE_RESOLVE, TRACE_CONNECT, TRACE_HANDSHAKE, TRACE_READ };
+    traceSetEnabled(1);
+    PlatformThread* running[WRITERS];
+    for (int i = 0; i < WRITERS; i++) {
+        running[i] = platformThreadStart(writer, &names[i], 32 * 1024);
+        REQUIRE(running[i] != NULL);
+    }
+    TraceSummary summary;
+    for (int i = 0; i < 50; i++) {
+        traceSummarize(TRACE_CONNECT, &summary);
+        CHECK(summary.count == 0 || (summary.p50 == TRACE_CONNECT * 10 && summary.max == TRACE_CONNECT * 10));
+    }
+    for (int i = 0; i < WRITERS; i++) {
+        platformThreadJoin(running[i]);
+    }
+    for (int i = 0; i < WRITERS; i++) {
+        traceSummarize(names[i], &summary);
+        CHECK_INT(summary.count, WRITES);
+        CHECK_INT(summary.p50, names[i] * 10);
+        CHECK_INT(summary.max, names[i] * 10);
+    }
+    traceSetEnabled(0);
+}
+
+//Brackets and braces outside strings balance and never close early
+static int balanced(const char* json) {
+    int depth = 0;
+    int inString = 0;
+    for (const char* c = json; *c != '\0'; c++) {
+        if (inString) {
+            inString = *c != '"';
+        } else if (*c == '"') {
+            inString = 1;
+        } else if (*c == '{' || *c == '[') {
+            depth++;
+        } else if ((*c == '}' || *c == ']') && --depth < 0) {
+            return 0;
+        }
+    }
+    return depth == 0 && !inString;
+}
+
+static int occurrences(const char* text, const char* needle) {
+    int count = 0;
+    for (const char* at = strstr(text, needle); at != NULL; at = strstr(at + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+//The export is Chrome trace events: complete events for spans, counter events for counts
+static void export(void) {
+    FILE* file = tmpfile();
+    REQUIRE(file != NULL);
+    traceSetEnabled(1);
+    REQUIRE(traceExport(file) == 0);
+    traceSpan(TRACE_FIRST_BYTE, 5000, 5250);
+    traceSpan(TRACE_FRAME, 6000, 6016);
+    traceCount(TRACE_BYTES, 1234);
+    traceSetEnabled(0);
+    REQUIRE(traceExport(file) == 0);
+
+    long length = ftell(file);
+    char* json = malloc(length + 1);
+    REQUIRE(json != NULL);
+    rewind(file);
+    json[fread(json, 1, length, file)] = '\0';
+    fclose(file);
+
+    //An empty ring is a valid export too
+    const char* empty = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n\n]}\n";
+    CHECK(strncmp(json, empty, strlen(empty)) == 0);
+    const char* full = json + strlen(empty);
+    CHECK(balanced(full));
+    CHECK(strstr(full, "{\"name\":\"first byte\",\"ph\":\"X\",\"ts\":5000,\"dur\":250,\"pid\":1,\"tid\":") != NULL);
+    CHECK(strstr(full, "{\"name\":\"frame\",\"ph\":\"X\",\"ts\":6000,\"dur\":16,") != NULL);
+    CHECK(strstr(full, "\"ph\":\"C\"") != NULL);
+    CHECK(strstr(full, "\"args\":{\"bytes\":1234}}") != NULL);
+    CHECK_INT(occurrences(full, "},\n{"), 2);
+    CHECK(strcmp(full + strlen(full) - 4, "\n]}\n") == 0);
+    free(json);
+}
+
+const TestCase traceTests[] = {
+    { "off", off },
+    { "summarize", summarize },
+    { "wrap", wrap },
+    { "threads", threads },
+    { "export", export },
+    { NULL, NULL },
+};
@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "url.h"
+
+//Resolves ref against base, with the result or "(error)" in out
+static const char* resolve(const char* base, const char* ref, char* out, size_t size) {
+    Url baseUrl;
+    Url refUrl;
+    if (urlParse(base, strlen(base), &baseUrl) != 0 || urlParse(ref, strlen(ref), &refUrl) != 0 ||
+        urlResolve(&baseUrl, &refUrl, out, size) < 0) {
+        snprintf(out, size, "(error)");
+    }
+    return out;
+}
+
+static void parts(void) {
+    Url url;
+    const char* str = "gemini://user@Example.ORG:1966/a/b.gmi?q=1#top";
+    REQUIRE(urlParse(str, strlen(str), &url) == 0);
+    CHECK_VIEW(url.scheme, url.schemeLength, "gemini");
+    CHECK_VIEW(url.host, url.hostLength, "Example.ORG");
+    CHECK_VIEW(url.port, url.portLength, "1966");
+    CHECK_VIEW(url.path, url.pathLength, "/a/b.gmi");
+    CHECK_VIEW(url.query, url.queryLength, "q=1");
+    CHECK(url.hasScheme && url.hasAuthority && url.hasQuery);
+
+    str = "gemini://[::1]:1965/";
+    REQUIRE(urlParse(str, strlen(str), &url) == 0);
+    CHECK_VIEW(url.host, url.hostLength, "[::1]");
+
+    str = "../up?";
+    REQUIRE(urlParse(str, strlen(str), &url) == 0);
+    CHECK(!url.hasScheme && !url.hasAuthority && url.hasQuery);
+    CHECK_INT(url.queryLength, 0);
+}
+
+static void invalid(void) {
+    Url url;
+    static const char* bad[] = {
+        "gemini://host:12345678/",
+        "gemini://host:80a/",
+        "gemini://host:65536/",
+        "gemini://[::1/",
+        "gemini://host/a\tb",
+        "gemini://host/\x7f",
+    };
+    for (size_t i = 0; i < sizeof bad / sizeof bad[0]; i++) {
+        CHECK_INT(urlParse(bad[i], strlen(bad[i]), &url), -1);
+    }
+}
+
+static void normalize(void) {
+    static const char* cases[][2] = {
+        { "GEMINI://Example.org", "gemini://example.org/" },
+        { "gemini://example.org:1965/a", "gemini://example.org/a" },
+        { "gemini://example.org:1966/a", "gemini://example.org:1966/a" },
+        { "gemini://example.org/a/./b/../c", "gemini://example.org/a/c" },
+        { "gemini://example.org/%7euser/%2f%20x y", "gemini://example.org/~user/%2F%20x%20y" },
+        { "gemini://example.org/page#section", "gemini://example.org/page" },
+        { "gemini://example.org/?a b", "gemini://example.org/?a%20b" },
+    };
+    char out[URL_MAX];
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+        REQUIRE(urlNormalize(cases[i][0], out, sizeof out) >= 0);
+        CHECK_STR(out, cases[i][1]);
+    }
+}
+
+static void relative(void) {
+    char out[URL_MAX];
+    const char* base = "gemini://example.org/dir/page.gmi?x";
+    CHECK_STR(resolve(base, "other.gmi", out, sizeof out), "gemini://example.org/dir/other.gmi");
+    CHECK_STR(resolve(base, "/top", out, sizeof out), "gemini://example.org/top");
+    CHECK_STR(resolve(base, "../up", out, sizeof out), "gemini://example.org/up");
+    CHECK_STR(resolve(base, "?query", out, sizeof out), "gemini://example.org/dir/page.gmi?query");
+    CHECK_STR(resolve(base, "//other.net/x", out, sizeof out), "gemini://other.net/x");
+    CHECK_STR(resolve(base, "https://example.com/", out, sizeof out), "https://example.com/");
+    CHECK_STR(resolve("gemini://example.org", "a", out, sizeof out), "gemini://example.org/a");
+}
+
+//The examples from RFC 3986 section 5.4. Fragments are dropped and an empty
+//path becomes "/", otherwise the results are the RFC's.
+static void rfcExamples(void) {
+    static const char* cases[][2] = {
+        { "g:h", "g:h" },
+        { "g", "http://a/b/c/g" },
+        { "./g", "http://a/b/c/g" },
+        { "g/", "http://a/b/c/g/" },
+        { "/g", "http://a/g" },
+        { "//g", "http://g/" },
+        { "?y", "http://a/b/c/d;p?y" },
+        { "g?y", "http://a/b/c/g?y" },
+        { "#s", "http://a/b/c/d;p?q" },
+        { "g#s", "http://a/b/c/g" },
+        { "g?y#s", "http://a/b/c/g?y" },
+        { ";x", "http://a/b/c/;x" },
+        { "g;x", "http://a/b/c/g;x" },
+        { "g;x?y#s", "http://a/b/c/g;x?y" },
+        { "", "http://a/b/c/d;p?q" },
+        { ".", "http://a/b/c/" },
+        { "./", "http://a/b/c/" },
+        { "..", "http://a/b/" },
+        { "../", "http://a/b/" },
+        { "../g", "http://a/b/g" },
+        { "../..", "http://a/" },
+        { "../../", "http://a/" },
+        { "../../g", "http://a/g" },
+        //Abnormal ones
+        { "../../../g", "http://a/g" },
+        { "../../../../g", "http://a/g" },
+        { "/./g", "http://a/g" },
+        { "/../g", "http://a/g" },
+        { "g.", "http://a/b/c/g." },
+        { ".g", "http://a/b/c/.g" },
+        { "g..", "http://a/b/c/g.." },
+        { "..g", "http://a/b/c/..g" },
+        { "./../g", "http://a/b/g" },
+        { "./g/.", "http://a/b/c/g/" },
+        { "g/./h", "http://a/b/c/g/h" },
+        { "g/../h", "http://a/b/c/h" },
+        { "g;x=1/./y", "http://a/b/c/g;x=1/y" },
+        { "g;x=1/../y", "http://a/b/c/y" },
+        { "g?y/./x", "http://a/b/c/g?y/./x" },
+        { "g?y/../x", "http://a/b/c/g?y/../x" },
+        { "g#s/./x", "http://a/b/c/g" },
+        { "g#s/../x", "http://a/b/c/g" },
+        { "http:g", "http:g" },
+    };
+    char out[URL_MAX];
+    for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+        CHECK_STR(resolve("http://a/b/c/d;p?q", cases[i][0], out, sizeof out), cases[i][1]);
+    }
+}
+
+//Whatever junk a page links to, a url that resolves is already canonical and
+//fits in what it said it wrote
+static void fuzz(void) {
+    static const char alphabet[] = "gemini:/?#[]@.%20aZ9-_~ \t\x7f\xc3\xa9..//";
+    const char* base = "gemini://example.org/a/b/c";
+    Url baseUrl;
+    REQUIRE(urlParse(base, strlen(base), &baseUrl) == 0);
+    srand(3);
+    int resolved = 0;
+    for (int round = 0; round < 100000; round++) {
+        char str[48];
+        int length = rand() % 40;
+        for (int i = 0; i < length; i++) {
+            str[i] = alphabet[rand() % (sizeof alphabet - 1)];
+        }
+        str[length] = '\0';
+        Url ref;
+        char out[URL_MAX];
+        char again[URL_MAX];
+        int written;
+        if (urlParse(str, length, &ref) != 0 || (written = urlResolve(&baseUrl, &ref, out, sizeof out)) < 0) {
+            continue;
+        }
+        resolved++;
+        CHECK_INT(written, strlen(out));
+        CHECK(urlNormalize(out, again, sizeof again) == written && strcmp(out, again) == 0);
+    }
+    CHECK(resolved > 10000);
+}
+
+//A result that doesn't fit is an error, never a cut off url
+static void tooLong(void) {
+    char out[24];
+    CHECK_INT(urlNormalize("gemini://example.org/a/long/path", out, sizeof out), -1);
+    CHECK_INT(urlNormalize("gemini://example.org/", out, 0), -1);
+    CHECK(urlNormalize("gemini://example.org/ab", out, sizeof out) > 0);
+}
+
+//Input typed for a prompt goes into the query as it is, reserved characters and all
+static void escape(void) {
+    char out[64];
+    CHECK_INT(urlEscape("a-b_c.d~e", out, sizeof out), 9);
+    CHECK_STR(out, "a-b_c.d~e");
+    urlEscape("what? 5/5 & \xc3\xa9", out, sizeof out);
+    CHECK_STR(out, "what%3F%205%2F5%20%26%20%C3%A9");
+    CHECK_INT(urlEscape("a b", out, 4), -1);
+}
+
+const TestCase urlTests[] = {
+    { "parts", parts },
+    { "invalid", invalid },
+    { "normalize", normalize },
+    { "relative", relative },
+    { "rfc-examples", rfcExamples },
+    { "fuzz", fuzz },
+    { "too-long", tooLong },
+    { "escape", escape },
+    { NULL, NULL },
+};